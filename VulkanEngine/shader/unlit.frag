@@ -1,12 +1,34 @@
 #version 450
 
+#ifdef CHIKU_BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Every registered texture, indexed by the material's texture index
+layout(set = 1, binding = 0) uniform sampler2D u_Textures[];
+
+layout(push_constant) uniform MaterialConstants {
+    uint u_TextureIndex;
+} material;
+#else
 layout(binding = 1) uniform sampler2D texSampler;
+#endif
 
 layout(location = 0) in vec3 fragColor;  // Input from vertex shader
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec4 fragBaseColor; // The material's, tints the texture
 
 layout(location = 0) out vec4 outColor;  // Output color
 
+// The vertexColor feature, set per pipeline through VkSpecializationInfo so the untaken branch is compiled out
+layout(constant_id = 0) const bool VERTEX_COLOR = false;
+
 void main() {
-	outColor = texture(texSampler, fragTexCoord);
-}
\ No newline at end of file
+#ifdef CHIKU_BINDLESS
+	outColor = texture(u_Textures[material.u_TextureIndex], fragTexCoord) * fragBaseColor;
+#else
+	outColor = texture(texSampler, fragTexCoord) * fragBaseColor;
+#endif
+	if (VERTEX_COLOR) {
+		outColor.rgb *= fragColor;
+	}
+}
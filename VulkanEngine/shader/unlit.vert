@@ -1,22 +1,46 @@
 #version 450
 
 
-layout(binding = 0) uniform UniformBufferObject {
+// Per draw, see UniformBuffer::DRAW_BINDING
+layout(binding = 0) uniform DrawUniforms {
     mat4 u_Model;
+    vec4 u_BaseColor;
+} ubo;
+
+// Written once per frame, see UniformBuffer::FRAME_BINDING
+layout(binding = 2) uniform FrameUniforms {
     mat4 u_View;
     mat4 u_Proj;
-} ubo;
+} frame;
 
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec3 inTexCoord;
 
+#ifdef CHIKU_INSTANCING
+// Per instance stream, see InstanceData. u_Model and u_BaseColor are unused. A batch never mixes materials, so the
+// texture still comes from the material's push constant and inInstanceMaterial is left to other programs.
+layout(location = 3) in vec4 inInstanceTransform0;
+layout(location = 4) in vec4 inInstanceTransform1;
+layout(location = 5) in vec4 inInstanceTransform2;
+layout(location = 6) in vec4 inInstanceTransform3;
+layout(location = 7) in vec4 inInstanceColor;
+#endif
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 fragBaseColor;
 
 void main() {
-    gl_Position = ubo.u_Proj * ubo.u_View * ubo.u_Model * vec4(inPosition, 1.0);
+#ifdef CHIKU_INSTANCING
+    mat4 model = mat4(inInstanceTransform0, inInstanceTransform1, inInstanceTransform2, inInstanceTransform3);
+    fragBaseColor = inInstanceColor;
+#else
+    mat4 model = ubo.u_Model;
+    fragBaseColor = ubo.u_BaseColor;
+#endif
     fragColor = inColor;
+    gl_Position = frame.u_Proj * frame.u_View * model * vec4(inPosition, 1.0);
     fragTexCoord = vec2(inTexCoord.x,inTexCoord.y);
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #include "Application.h"
 #include "Renderer/Renderer.h"
+#include "Utils/JobSystem.h"
 
 namespace CHIKU
 {
@@ -9,6 +10,7 @@ namespace CHIKU
 
 	void Application::Init()
 	{
+		Utils::JobSystem::Init();
 		m_Window.Init();
 		m_Engine.Init(m_Window.GetWindow());
 		Renderer::s_Instance->Init();
@@ -30,5 +32,6 @@ namespace CHIKU
 		m_Engine.Wait();
 		Renderer::s_Instance->CleanUp();
 		m_Engine.CleanUp();
+		Utils::JobSystem::Shutdown();
 	}
 }
\ No newline at end of file
@@ -1,6 +1,94 @@
 #include "AssetManager.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
 
 namespace CHIKU
 {
+	std::vector<std::unique_ptr<Utils::AssetArchive>> AssetManager::sm_Archives;
 
-}
\ No newline at end of file
+	void AssetManager::Init()
+	{
+		if (std::filesystem::exists(SOURCE_DIR + "assets.chpk"))
+		{
+			Mount("assets.chpk");
+		}
+	}
+
+	bool AssetManager::Mount(const std::string& archivePath)
+	{
+		auto archive = std::make_unique<Utils::AssetArchive>();
+		if (!archive->Open(SOURCE_DIR + archivePath))
+		{
+			std::cerr << "Failed to mount asset archive: " << archivePath << std::endl;
+			return false;
+		}
+
+		sm_Archives.push_back(std::move(archive));
+		return true;
+	}
+
+	void AssetManager::CleanUp()
+	{
+		sm_Archives.clear();
+	}
+
+	bool AssetManager::Exists(const std::string& path)
+	{
+		for (const auto& archive : sm_Archives)
+		{
+			if (archive->Find(path) != nullptr)
+			{
+				return true;
+			}
+		}
+
+		return std::filesystem::exists(SOURCE_DIR + path);
+	}
+
+	bool AssetManager::ReadFile(const std::string& path, std::vector<char>& data)
+	{
+		for (auto it = sm_Archives.rbegin(); it != sm_Archives.rend(); ++it)
+		{
+			if (const Utils::ArchiveEntry* entry = (*it)->Find(path))
+			{
+				return (*it)->Read(*entry, data);
+			}
+		}
+
+		std::ifstream file(SOURCE_DIR + path, std::ios::ate | std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		return static_cast<bool>(file);
+	}
+
+	std::vector<char> AssetManager::ReadFile(const std::string& path)
+	{
+		std::vector<char> data;
+		if (!ReadFile(path, data))
+		{
+			throw std::runtime_error("Failed to open asset: " + path);
+		}
+
+		return data;
+	}
+
+	bool AssetManager::MapFile(const std::string& path, Utils::MappedFile& file)
+	{
+		for (const auto& archive : sm_Archives)
+		{
+			if (archive->Find(path) != nullptr)
+			{
+				return false;
+			}
+		}
+
+		return file.Open(SOURCE_DIR + path);
+	}
+}
@@ -1,9 +1,27 @@
 #pragma once
+#include "VulkanHeader.h"
+#include "Utils/AssetArchive.h"
+#include "Utils/MappedFile.h"
+#include <memory>
 
 namespace CHIKU
 {
+	//Virtual file system every loader reads through. Mounted archives are searched newest first, then loose files under SOURCE_DIR.
 	class AssetManager
 	{
+	public:
+		static void Init();
+		static bool Mount(const std::string& archivePath);
+		static void CleanUp();
 
+		static bool Exists(const std::string& path);
+		static bool ReadFile(const std::string& path, std::vector<char>& data);
+		static std::vector<char> ReadFile(const std::string& path);
+		//Maps the file in place when it resolves to a loose file. False when it is missing or inside an archive, read it
+		//with ReadFile then.
+		static bool MapFile(const std::string& path, Utils::MappedFile& file);
+
+	private:
+		static std::vector<std::unique_ptr<Utils::AssetArchive>> sm_Archives;
 	};
-}
\ No newline at end of file
+}
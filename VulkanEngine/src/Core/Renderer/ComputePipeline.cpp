@@ -0,0 +1,374 @@
+#include "ComputePipeline.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "Shader.h"
+#include "PipelineCache.h"
+#include "DescriptorAllocator.h"
+#include <algorithm>
+#include <iostream>
+
+namespace CHIKU
+{
+    std::unordered_map<uint64_t, std::unique_ptr<ComputeProgram>> ComputePipeline::sm_Programs;
+    std::vector<std::unique_ptr<ComputePipeline::ProgramCompile>> ComputePipeline::sm_Reloads;
+    std::vector<ComputePipeline::RetiredPipeline> ComputePipeline::sm_RetiredPipelines;
+    Utils::JobGroup ComputePipeline::sm_PendingCompiles;
+
+    struct BarrierScope
+    {
+        VkPipelineStageFlags SrcStage;
+        VkAccessFlags SrcAccess;
+        VkPipelineStageFlags DstStage;
+        VkAccessFlags DstAccess;
+    };
+
+    static BarrierScope GetBarrierScope(ComputeBarrier barrier)
+    {
+        switch (barrier)
+        {
+        case ComputeBarrier::ComputeToCompute:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+        case ComputeBarrier::ComputeToIndirect:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT };
+        case ComputeBarrier::ComputeToVertexInput:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT };
+        case ComputeBarrier::ComputeToGraphicsShader:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT };
+        case ComputeBarrier::GraphicsToCompute:
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+        case ComputeBarrier::ComputeToHost:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT };
+        case ComputeBarrier::ComputeToAttachment:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+        }
+
+        throw std::runtime_error("unknown compute barrier!");
+    }
+
+    const ComputeProgram* ComputePipeline::Get(const std::string& shaderID, uint32_t features)
+    {
+        features &= ShaderManager::GetSupportedFeatures(shaderID);
+        uint64_t key = (static_cast<uint64_t>(ShaderManager::InternID(shaderID)) << 32) | features;
+
+        auto found = sm_Programs.find(key);
+        if (found == sm_Programs.end())
+        {
+            //Failures are cached as nullptr so a missing program is reported once
+            found = sm_Programs.emplace(key, CreateProgram(shaderID, features)).first;
+        }
+
+        return found->second.get();
+    }
+
+    std::unique_ptr<ComputeProgram> ComputePipeline::CreateProgram(const std::string& shaderID, uint32_t features)
+    {
+        std::unique_ptr<ProgramCompile> compile = PrepareCompile(shaderID, features);
+        if (!compile)
+        {
+            return nullptr;
+        }
+
+        BuildPipeline(shaderID, *compile);
+        if (compile->Pipeline == VK_NULL_HANDLE)
+        {
+            return nullptr;
+        }
+
+        auto program = std::make_unique<ComputeProgram>();
+        program->Pipeline = compile->Pipeline;
+        program->Layout = compile->Layout;
+        program->LocalSize = compile->LocalSize;
+        program->ShaderID = shaderID;
+        program->Features = features;
+        return program;
+    }
+
+    std::unique_ptr<ComputePipeline::ProgramCompile> ComputePipeline::PrepareCompile(const std::string& shaderID, uint32_t features)
+    {
+        auto compile = std::make_unique<ProgramCompile>();
+        std::vector<VkPipelineShaderStageCreateInfo> stages;
+        std::array<uint32_t, 3> localSize;
+        try
+        {
+            stages = ShaderManager::GetShaderStages(shaderID, features);
+            compile->Layout = ShaderManager::GetPipelineLayout(shaderID, features);
+            localSize = ShaderManager::GetShaderLayout(shaderID, features).LocalSize;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Cannot create compute pipeline for " << shaderID << ": " << e.what() << std::endl;
+            return nullptr;
+        }
+
+        if (stages.size() != 1 || stages[0].stage != VK_SHADER_STAGE_COMPUTE_BIT)
+        {
+            std::cerr << "Cannot create compute pipeline for " << shaderID << ": not a compute program" << std::endl;
+            return nullptr;
+        }
+
+        ShaderManager::GetSpecialization(shaderID, features, compile->Entries, compile->Values);
+        compile->Specialization.mapEntryCount = static_cast<uint32_t>(compile->Entries.size());
+        compile->Specialization.pMapEntries = compile->Entries.data();
+        compile->Specialization.dataSize = compile->Values.size() * sizeof(VkBool32);
+        compile->Specialization.pData = compile->Values.data();
+
+        compile->Stage = stages[0];
+        compile->Stage.pSpecializationInfo = compile->Entries.empty() ? nullptr : &compile->Specialization;
+        compile->LocalSize = { std::max(localSize[0], 1u), std::max(localSize[1], 1u), std::max(localSize[2], 1u) };
+        return compile;
+    }
+
+    void ComputePipeline::BuildPipeline(const std::string& shaderID, ProgramCompile& compile)
+    {
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = compile.Stage;
+        pipelineInfo.layout = compile.Layout;
+
+        if (vkCreateComputePipelines(VulkanEngine::GetDevice(), PipelineCache::Get(), 1, &pipelineInfo, nullptr, &compile.Pipeline) != VK_SUCCESS)
+        {
+            std::cerr << "Cannot create compute pipeline for " << shaderID << ": vkCreateComputePipelines failed" << std::endl;
+            compile.Pipeline = VK_NULL_HANDLE;
+        }
+        else
+        {
+            PipelineCache::MarkDirty();
+        }
+        compile.Ready.store(true, std::memory_order_release);
+    }
+
+    void ComputePipeline::Reload(const std::string& shaderID)
+    {
+        for (auto it = sm_Programs.begin(); it != sm_Programs.end();)
+        {
+            ComputeProgram* program = it->second.get();
+            if (ShaderManager::GetInternedID(static_cast<uint32_t>(it->first >> 32)) != shaderID)
+            {
+                ++it;
+                continue;
+            }
+
+            //A program that failed before is created again on its next Get
+            if (!program)
+            {
+                it = sm_Programs.erase(it);
+                continue;
+            }
+            ++it;
+
+            std::unique_ptr<ProgramCompile> compile = PrepareCompile(shaderID, program->Features);
+            if (!compile)
+            {
+                std::cerr << "Keeping the previous compute pipeline for " << shaderID << std::endl;
+                continue;
+            }
+
+            compile->Target = program;
+            ProgramCompile* pending = compile.get();
+            sm_Reloads.push_back(std::move(compile));
+            Utils::JobSystem::Submit([pending, shaderID]() { BuildPipeline(shaderID, *pending); }, &sm_PendingCompiles);
+        }
+    }
+
+    void ComputePipeline::Update()
+    {
+        for (size_t i = 0; i < sm_RetiredPipelines.size();)
+        {
+            if (--sm_RetiredPipelines[i].FramesLeft == 0)
+            {
+                vkDestroyPipeline(VulkanEngine::GetDevice(), sm_RetiredPipelines[i].Handle, nullptr);
+                sm_RetiredPipelines[i] = sm_RetiredPipelines.back();
+                sm_RetiredPipelines.pop_back();
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        //In submission order, so with two reloads of one program the later build wins
+        for (auto it = sm_Reloads.begin(); it != sm_Reloads.end();)
+        {
+            ProgramCompile& compile = **it;
+            if (!compile.Ready.load(std::memory_order_acquire))
+            {
+                ++it;
+                continue;
+            }
+
+            if (compile.Pipeline != VK_NULL_HANDLE)
+            {
+                //Command buffers of the frames in flight may still reference the old pipeline
+                sm_RetiredPipelines.push_back({ compile.Target->Pipeline, MAX_FRAMES_IN_FLIGHT });
+                compile.Target->Pipeline = compile.Pipeline;
+                compile.Target->Layout = compile.Layout;
+                compile.Target->LocalSize = compile.LocalSize;
+            }
+            else
+            {
+                std::cerr << "Keeping the previous compute pipeline for " << compile.Target->ShaderID << std::endl;
+            }
+            it = sm_Reloads.erase(it);
+        }
+    }
+
+    VkCommandBuffer ComputePipeline::GetRecordingCommandBuffer()
+    {
+        if (VulkanEngine::IsInRenderPass())
+        {
+            throw std::runtime_error("compute work must be recorded before the render pass begins!");
+        }
+        return VulkanEngine::GetCommandBuffer();
+    }
+
+    void ComputePipeline::Bind(const ComputeProgram& program)
+    {
+        vkCmdBindPipeline(GetRecordingCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, program.Pipeline);
+    }
+
+    void ComputePipeline::PushConstants(const ComputeProgram& program, const void* data, uint32_t size, uint32_t offset)
+    {
+        vkCmdPushConstants(GetRecordingCommandBuffer(), program.Layout, VK_SHADER_STAGE_COMPUTE_BIT, offset, size, data);
+    }
+
+    void ComputePipeline::Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+    {
+        vkCmdDispatch(GetRecordingCommandBuffer(), groupsX, groupsY, groupsZ);
+    }
+
+    void ComputePipeline::DispatchThreads(const ComputeProgram& program, uint32_t threadsX, uint32_t threadsY, uint32_t threadsZ)
+    {
+        Dispatch((threadsX + program.LocalSize[0] - 1) / program.LocalSize[0],
+            (threadsY + program.LocalSize[1] - 1) / program.LocalSize[1],
+            (threadsZ + program.LocalSize[2] - 1) / program.LocalSize[2]);
+    }
+
+    void ComputePipeline::DispatchIndirect(VkBuffer buffer, VkDeviceSize offset)
+    {
+        vkCmdDispatchIndirect(GetRecordingCommandBuffer(), buffer, offset);
+    }
+
+    void ComputePipeline::Barrier(ComputeBarrier barrier)
+    {
+        //A global memory barrier, per-buffer barriers buy nothing on current drivers
+        BarrierScope scope = GetBarrierScope(barrier);
+
+        VkMemoryBarrier memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = scope.SrcAccess;
+        memoryBarrier.dstAccessMask = scope.DstAccess;
+
+        vkCmdPipelineBarrier(GetRecordingCommandBuffer(), scope.SrcStage, scope.DstStage, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void ComputePipeline::ImageBarrier(ComputeBarrier barrier, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkImageAspectFlags aspect)
+    {
+        BarrierScope scope = GetBarrierScope(barrier);
+
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = scope.SrcAccess;
+        imageBarrier.dstAccessMask = scope.DstAccess;
+        imageBarrier.oldLayout = oldLayout;
+        imageBarrier.newLayout = newLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = image;
+        imageBarrier.subresourceRange.aspectMask = aspect;
+        imageBarrier.subresourceRange.baseMipLevel = 0;
+        imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        imageBarrier.subresourceRange.baseArrayLayer = 0;
+        imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+        vkCmdPipelineBarrier(GetRecordingCommandBuffer(), scope.SrcStage, scope.DstStage, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+    }
+
+    void ComputePipeline::CleanUp()
+    {
+        sm_PendingCompiles.Wait();
+        for (const auto& compile : sm_Reloads)
+        {
+            if (compile->Pipeline != VK_NULL_HANDLE)
+            {
+                vkDestroyPipeline(VulkanEngine::GetDevice(), compile->Pipeline, nullptr);
+            }
+        }
+        for (const auto& retired : sm_RetiredPipelines)
+        {
+            vkDestroyPipeline(VulkanEngine::GetDevice(), retired.Handle, nullptr);
+        }
+        sm_Reloads.clear();
+        sm_RetiredPipelines.clear();
+
+        for (auto& [_, program] : sm_Programs)
+        {
+            if (program)
+            {
+                vkDestroyPipeline(VulkanEngine::GetDevice(), program->Pipeline, nullptr);
+            }
+        }
+
+        sm_Programs.clear();
+    }
+
+    ComputeBindings& ComputeBindings::StorageBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+    {
+        m_Writes.push_back({ binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { buffer, offset, range }, {} });
+        return *this;
+    }
+
+    ComputeBindings& ComputeBindings::Uniform(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+    {
+        m_Writes.push_back({ binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, { buffer, offset, range }, {} });
+        return *this;
+    }
+
+    ComputeBindings& ComputeBindings::StorageImage(uint32_t binding, VkImageView view, VkImageLayout layout)
+    {
+        m_Writes.push_back({ binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, {}, { VK_NULL_HANDLE, view, layout } });
+        return *this;
+    }
+
+    ComputeBindings& ComputeBindings::SampledImage(uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout)
+    {
+        m_Writes.push_back({ binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, {}, { sampler, view, layout } });
+        return *this;
+    }
+
+    void ComputeBindings::Bind(const ComputeProgram& program, uint32_t set) const
+    {
+        VkDescriptorSetLayout setLayout = ShaderManager::GetSetLayout(program.ShaderID, set, program.Features);
+        if (setLayout == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("compute program " + program.ShaderID + " has no set " + std::to_string(set) + "!");
+        }
+
+        VkDescriptorSet descriptorSet = DescriptorAllocator::GetFrameAllocator().Allocate(setLayout);
+
+        std::vector<VkWriteDescriptorSet> writes(m_Writes.size());
+        for (size_t i = 0; i < m_Writes.size(); i++)
+        {
+            const Write& source = m_Writes[i];
+            bool image = source.Type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || source.Type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = descriptorSet;
+            writes[i].dstBinding = source.Binding;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = source.Type;
+            writes[i].pBufferInfo = image ? nullptr : &source.Buffer;
+            writes[i].pImageInfo = image ? &source.Image : nullptr;
+        }
+        vkUpdateDescriptorSets(VulkanEngine::GetDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+        vkCmdBindDescriptorSets(ComputePipeline::GetRecordingCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, program.Layout, set, 1, &descriptorSet, 0, nullptr);
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "Utils/JobSystem.h"
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace CHIKU
+{
+	//A compute program listed in shaderlist.json (a single .comp stage), ready to dispatch
+	struct ComputeProgram
+	{
+		VkPipeline Pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout Layout = VK_NULL_HANDLE; //Owned by DescriptorLayoutCache
+		std::array<uint32_t, 3> LocalSize{ 1, 1, 1 }; //From reflection
+		std::string ShaderID;
+		uint32_t Features = 0;
+	};
+
+	//Hazards around compute work, named after the writer and the next reader
+	enum class ComputeBarrier
+	{
+		ComputeToCompute,        //Storage written by a dispatch, read or written by a later one
+		ComputeToIndirect,       //Indirect draw or dispatch arguments written by a dispatch
+		ComputeToVertexInput,    //Vertex or index data written by a dispatch
+		ComputeToGraphicsShader, //Storage buffers or images written by a dispatch, read by vertex or fragment shaders
+		GraphicsToCompute,       //Attachments or storage written by the previous render pass, read by a dispatch
+		ComputeToHost,           //Storage written by a dispatch, read back through a mapped buffer after the frame's fence
+		ComputeToAttachment      //Images read or written by a dispatch, attachments of the next render pass
+	};
+
+	//Counterpart of GraphicsPipeline for compute programs. Everything records into the frame command buffer and must
+	//happen before VulkanEngine::BeginRenderPass, dispatches are not allowed inside a render pass.
+	class ComputePipeline
+	{
+	public:
+		//Created on the calling thread the first time it is asked for, through the shared pipeline cache.
+		//nullptr when the program is missing, fails to build or is not a compute program.
+		static const ComputeProgram* Get(const std::string& shaderID, uint32_t features = 0);
+
+		static void Bind(const ComputeProgram& program);
+		static void PushConstants(const ComputeProgram& program, const void* data, uint32_t size, uint32_t offset = 0);
+		static void Dispatch(uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1);
+		//Enough workgroups to cover the given number of invocations, rounded up by the program's local size
+		static void DispatchThreads(const ComputeProgram& program, uint32_t threadsX, uint32_t threadsY = 1, uint32_t threadsZ = 1);
+		static void DispatchIndirect(VkBuffer buffer, VkDeviceSize offset = 0); //Arguments are a VkDispatchIndirectCommand
+
+		static void Barrier(ComputeBarrier barrier);
+		//Same hazard plus a layout transition, e.g. GENERAL after a storage write to SHADER_READ_ONLY_OPTIMAL for sampling
+		static void ImageBarrier(ComputeBarrier barrier, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+			VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+		//Rebuilds the programs made from a hot reloaded shader on the workers. The ComputeProgram pointers stay valid,
+		//Update switches them to the new pipeline once it is built.
+		static void Reload(const std::string& shaderID);
+		//Once per frame after the frame's fence wait
+		static void Update();
+		static bool IsCompiling() { return !sm_PendingCompiles.IsDone(); }
+
+		static uint32_t GetProgramCount() { return static_cast<uint32_t>(sm_Programs.size()); }
+		static void CleanUp();
+
+	private:
+		//Everything vkCreateComputePipelines needs, resolved on the main thread so the pipeline can be created on any
+		struct ProgramCompile
+		{
+			ComputeProgram* Target = nullptr; //Reloads only
+			VkPipelineShaderStageCreateInfo Stage{};
+			VkPipelineLayout Layout = VK_NULL_HANDLE;
+			std::array<uint32_t, 3> LocalSize{ 1, 1, 1 };
+			std::vector<VkSpecializationMapEntry> Entries;
+			std::vector<VkBool32> Values;
+			VkSpecializationInfo Specialization{};
+
+			VkPipeline Pipeline = VK_NULL_HANDLE; //Stays null when creation failed
+			std::atomic<bool> Ready{ false };
+		};
+
+		struct RetiredPipeline
+		{
+			VkPipeline Handle;
+			uint32_t FramesLeft;
+		};
+
+		static VkCommandBuffer GetRecordingCommandBuffer(); //Throws when called inside the render pass
+		static std::unique_ptr<ComputeProgram> CreateProgram(const std::string& shaderID, uint32_t features);
+		static std::unique_ptr<ProgramCompile> PrepareCompile(const std::string& shaderID, uint32_t features); //nullptr when the program cannot be used
+		static void BuildPipeline(const std::string& shaderID, ProgramCompile& compile);
+
+	private:
+		friend class ComputeBindings; //Records its descriptor binds under the same render pass check
+
+		static std::unordered_map<uint64_t, std::unique_ptr<ComputeProgram>> sm_Programs; //Interned shader ID in the high bits, features in the low ones
+		static std::vector<std::unique_ptr<ProgramCompile>> sm_Reloads;
+		static std::vector<RetiredPipeline> sm_RetiredPipelines;
+		static Utils::JobGroup sm_PendingCompiles;
+	};
+
+	//Descriptor writes for one set of a compute program. The set is allocated from the frame's DescriptorAllocator when
+	//bound, so it lives until this frame slot is recorded again and needs no cleanup.
+	class ComputeBindings
+	{
+	public:
+		ComputeBindings& StorageBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		ComputeBindings& Uniform(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		ComputeBindings& StorageImage(uint32_t binding, VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL);
+		ComputeBindings& SampledImage(uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		void Bind(const ComputeProgram& program, uint32_t set = 0) const;
+
+	private:
+		struct Write
+		{
+			uint32_t Binding;
+			VkDescriptorType Type;
+			VkDescriptorBufferInfo Buffer;
+			VkDescriptorImageInfo Image;
+		};
+
+		std::vector<Write> m_Writes;
+	};
+}
@@ -0,0 +1,158 @@
+#include "DepthPyramid.h"
+#include "ComputePipeline.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "Utils/ImageUtils.h"
+#include <algorithm>
+
+namespace CHIKU
+{
+    static const char* REDUCE_SHADER = "default/hiz";
+    static const VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+    //Push constants of hiz.comp
+    struct ReduceConstants
+    {
+        int32_t SourceWidth;
+        int32_t SourceHeight;
+        int32_t Width;
+        int32_t Height;
+    };
+
+    static uint32_t GetPreviousPowerOfTwo(uint32_t value)
+    {
+        uint32_t power = 1;
+        while (power <= value / 2)
+        {
+            power *= 2;
+        }
+        return power;
+    }
+
+    bool DepthPyramid::IsSupported()
+    {
+        return ComputePipeline::Get(REDUCE_SHADER) != nullptr;
+    }
+
+    void DepthPyramid::Update()
+    {
+        const VkExtent2D& extent = VulkanEngine::GetSwapchainExtent();
+        if (m_Image != VK_NULL_HANDLE && extent.width == m_DepthExtent.width && extent.height == m_DepthExtent.height)
+        {
+            return;
+        }
+
+        CleanUp();
+        Create(extent);
+        //Nothing to keep, Build overwrites every level
+        ComputePipeline::ImageBarrier(ComputeBarrier::ComputeToCompute, m_Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    }
+
+    void DepthPyramid::Create(const VkExtent2D& depthExtent)
+    {
+        //A power of two halves evenly down to 1x1, level 0 takes the up to 3x3 footprint of the odd ratio
+        m_DepthExtent = depthExtent;
+        m_Width = GetPreviousPowerOfTwo(depthExtent.width);
+        m_Height = GetPreviousPowerOfTwo(depthExtent.height);
+
+        uint32_t levelCount = 1;
+        while ((std::max(m_Width, m_Height) >> levelCount) > 0)
+        {
+            levelCount++;
+        }
+
+        Utils::CreateImage(m_Width, m_Height, PYRAMID_FORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_Image, m_ImageMemory, levelCount);
+
+        m_View = Utils::CreateImageView(m_Image, PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount);
+        m_LevelViews.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            m_LevelViews[level] = Utils::CreateImageView(m_Image, PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+        }
+
+        //Only read with texelFetch, the filter does not matter
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        if (vkCreateSampler(VulkanEngine::GetDevice(), &samplerInfo, nullptr, &m_Sampler) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create depth pyramid sampler!");
+        }
+    }
+
+    void DepthPyramid::Build()
+    {
+        const ComputeProgram* program = ComputePipeline::Get(REDUCE_SHADER);
+        VkImage depthImage = VulkanEngine::GetDepthImage();
+
+        VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        VkFormat depthFormat = VulkanEngine::GetDepthFormat();
+        if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+        {
+            depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+
+        ComputePipeline::ImageBarrier(ComputeBarrier::GraphicsToCompute, depthImage,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, depthAspect);
+
+        ComputePipeline::Bind(*program);
+        ReduceConstants constants{ static_cast<int32_t>(m_DepthExtent.width), static_cast<int32_t>(m_DepthExtent.height),
+            static_cast<int32_t>(m_Width), static_cast<int32_t>(m_Height) };
+        for (uint32_t level = 0; level < m_LevelViews.size(); level++)
+        {
+            ComputeBindings bindings;
+            if (level == 0)
+            {
+                bindings.SampledImage(0, VulkanEngine::GetDepthImageView(), m_Sampler);
+            }
+            else
+            {
+                bindings.SampledImage(0, m_LevelViews[level - 1], m_Sampler, VK_IMAGE_LAYOUT_GENERAL);
+            }
+            bindings.StorageImage(1, m_LevelViews[level]).Bind(*program);
+
+            ComputePipeline::PushConstants(*program, &constants, sizeof(constants));
+            ComputePipeline::DispatchThreads(*program, constants.Width, constants.Height);
+            //Read by the next level, or by the occlusion test after the last one
+            ComputePipeline::Barrier(ComputeBarrier::ComputeToCompute);
+
+            constants = { constants.Width, constants.Height, std::max(constants.Width / 2, 1), std::max(constants.Height / 2, 1) };
+        }
+
+        ComputePipeline::ImageBarrier(ComputeBarrier::ComputeToAttachment, depthImage,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, depthAspect);
+    }
+
+    void DepthPyramid::CleanUp()
+    {
+        if (m_Image != VK_NULL_HANDLE)
+        {
+            //Recorded frames may still read the old pyramid
+            vkDeviceWaitIdle(VulkanEngine::GetDevice());
+
+            for (VkImageView view : m_LevelViews)
+            {
+                vkDestroyImageView(VulkanEngine::GetDevice(), view, nullptr);
+            }
+            vkDestroyImageView(VulkanEngine::GetDevice(), m_View, nullptr);
+            vkDestroySampler(VulkanEngine::GetDevice(), m_Sampler, nullptr);
+            vkDestroyImage(VulkanEngine::GetDevice(), m_Image, nullptr);
+            vkFreeMemory(VulkanEngine::GetDevice(), m_ImageMemory, nullptr);
+        }
+
+        m_Image = VK_NULL_HANDLE;
+        m_View = VK_NULL_HANDLE;
+        m_Sampler = VK_NULL_HANDLE;
+        m_LevelViews.clear();
+        m_DepthExtent = { 0, 0 };
+        m_Width = 0;
+        m_Height = 0;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "VulkanHeader.h"
+#include <vector>
+
+namespace CHIKU
+{
+	//Hierarchical depth (HiZ) of the swapchain's depth attachment for occlusion tests. Level 0 is the depth image
+	//reduced to the power of two below its size, every further level keeps the farthest depth of the texels under it,
+	//so a texel is never nearer than anything drawn in its footprint. Built by shader/hiz.comp between two render passes.
+	class DepthPyramid
+	{
+	public:
+		//Needs the reduction program, the depth image is always sampleable
+		static bool IsSupported();
+
+		//Before the render pass. (Re)creates the pyramid for the swapchain's size, a new one reads as undefined until Build.
+		void Update();
+		//Outside the render pass, after the depth to reduce was drawn. Leaves the pyramid readable by compute and the
+		//depth image back in DEPTH_STENCIL_ATTACHMENT_OPTIMAL.
+		void Build();
+		void CleanUp();
+
+		//Every level, in VK_IMAGE_LAYOUT_GENERAL, for texelFetch with an explicit level
+		VkImageView GetView() const { return m_View; }
+		VkSampler GetSampler() const { return m_Sampler; }
+		uint32_t GetWidth() const { return m_Width; }
+		uint32_t GetHeight() const { return m_Height; }
+		uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_LevelViews.size()); }
+
+	private:
+		void Create(const VkExtent2D& depthExtent);
+
+	private:
+		VkImage m_Image = VK_NULL_HANDLE;
+		VkDeviceMemory m_ImageMemory = VK_NULL_HANDLE;
+		VkImageView m_View = VK_NULL_HANDLE;
+		std::vector<VkImageView> m_LevelViews; //One per level, storage target of its reduction and source of the next one
+		VkSampler m_Sampler = VK_NULL_HANDLE;
+
+		VkExtent2D m_DepthExtent{ 0, 0 };
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+	};
+}
@@ -0,0 +1,164 @@
+#include "DescriptorAllocator.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include <algorithm>
+
+namespace CHIKU
+{
+    std::array<DescriptorAllocator, MAX_FRAMES_IN_FLIGHT> DescriptorAllocator::sm_FrameAllocators;
+    DescriptorAllocator DescriptorAllocator::sm_PersistentAllocator;
+
+    //Descriptors of each type reserved per set. Pools are sized from these, a set using more only ends its pool early.
+    static const DescriptorAllocator::PoolRatio POOL_RATIOS[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+    };
+
+    void DescriptorAllocator::Init(uint32_t initialSetsPerPool)
+    {
+        m_SetsPerPool = initialSetsPerPool;
+        m_CurrentPool = VK_NULL_HANDLE;
+    }
+
+    VkDescriptorPool DescriptorAllocator::CreatePool()
+    {
+        if (!m_FreePools.empty())
+        {
+            VkDescriptorPool pool = m_FreePools.back();
+            m_FreePools.pop_back();
+            return pool;
+        }
+
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (const auto& ratio : POOL_RATIOS)
+        {
+            poolSizes.push_back({ ratio.Type, std::max(1u, static_cast<uint32_t>(ratio.DescriptorsPerSet * m_SetsPerPool)) });
+        }
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = m_SetsPerPool;
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(VulkanEngine::GetDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+
+        //Each new pool is larger so a busy allocator settles on a few pools
+        m_SetsPerPool = std::min(m_SetsPerPool * 2, MAX_SETS_PER_POOL);
+        return pool;
+    }
+
+    VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+    {
+        if (m_CurrentPool == VK_NULL_HANDLE)
+        {
+            m_CurrentPool = CreatePool();
+            m_UsedPools.push_back(m_CurrentPool);
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_CurrentPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        VkDescriptorSet set;
+        VkResult result = vkAllocateDescriptorSets(VulkanEngine::GetDevice(), &allocInfo, &set);
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+        {
+            m_CurrentPool = CreatePool();
+            m_UsedPools.push_back(m_CurrentPool);
+
+            allocInfo.descriptorPool = m_CurrentPool;
+            result = vkAllocateDescriptorSets(VulkanEngine::GetDevice(), &allocInfo, &set);
+        }
+
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+
+        return set;
+    }
+
+    void DescriptorAllocator::Reset()
+    {
+        for (VkDescriptorPool pool : m_UsedPools)
+        {
+            vkResetDescriptorPool(VulkanEngine::GetDevice(), pool, 0);
+            m_FreePools.push_back(pool);
+        }
+
+        m_UsedPools.clear();
+        m_CurrentPool = VK_NULL_HANDLE;
+    }
+
+    void DescriptorAllocator::CleanUp()
+    {
+        for (VkDescriptorPool pool : m_UsedPools)
+        {
+            vkDestroyDescriptorPool(VulkanEngine::GetDevice(), pool, nullptr);
+        }
+        for (VkDescriptorPool pool : m_FreePools)
+        {
+            vkDestroyDescriptorPool(VulkanEngine::GetDevice(), pool, nullptr);
+        }
+
+        m_UsedPools.clear();
+        m_FreePools.clear();
+        m_CurrentPool = VK_NULL_HANDLE;
+    }
+
+    void DescriptorAllocator::InitFrameAllocators()
+    {
+        for (auto& allocator : sm_FrameAllocators)
+        {
+            allocator.Init(64);
+        }
+        sm_PersistentAllocator.Init(16);
+    }
+
+    void DescriptorAllocator::BeginFrame()
+    {
+        //VulkanEngine::BeginFrame has waited for this frame's fence, nothing on the GPU still reads these sets
+        sm_FrameAllocators[VulkanEngine::GetCurrentFrame()].Reset();
+    }
+
+    DescriptorAllocator& DescriptorAllocator::GetFrameAllocator()
+    {
+        return sm_FrameAllocators[VulkanEngine::GetCurrentFrame()];
+    }
+
+    void DescriptorAllocator::CleanUpFrameAllocators()
+    {
+        for (auto& allocator : sm_FrameAllocators)
+        {
+            allocator.CleanUp();
+        }
+        sm_PersistentAllocator.CleanUp();
+    }
+
+    VkDescriptorUpdateTemplate DescriptorAllocator::CreateUpdateTemplate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries)
+    {
+        VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        templateInfo.pDescriptorUpdateEntries = entries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = layout;
+
+        VkDescriptorUpdateTemplate updateTemplate;
+        if (vkCreateDescriptorUpdateTemplate(VulkanEngine::GetDevice(), &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor update template!");
+        }
+
+        return updateTemplate;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "VulkanHeader.h"
+#include <array>
+#include <vector>
+
+namespace CHIKU
+{
+	//Hands out descriptor sets from a list of pools. When the current pool is exhausted a new, larger one is created,
+	//so allocation never fails for lack of space. Sets are never freed one by one, Reset recycles every pool at once.
+	class DescriptorAllocator
+	{
+	public:
+		struct PoolRatio
+		{
+			VkDescriptorType Type;
+			float DescriptorsPerSet;
+		};
+
+		void Init(uint32_t initialSetsPerPool);
+		VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+		void Reset(); //Every set handed out so far becomes invalid
+		void CleanUp();
+
+		//One transient allocator per frame in flight, reset at the start of its frame once that frame's fence has signalled
+		static void InitFrameAllocators();
+		static void BeginFrame();
+		static DescriptorAllocator& GetFrameAllocator();
+		//For sets that live as long as the object that owns them
+		static DescriptorAllocator& GetPersistentAllocator() { return sm_PersistentAllocator; }
+		static void CleanUpFrameAllocators();
+
+		//Update template for a set layout. Entries read their descriptor infos from the struct passed to vkUpdateDescriptorSetWithTemplate.
+		static VkDescriptorUpdateTemplate CreateUpdateTemplate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries);
+
+	private:
+		VkDescriptorPool CreatePool();
+
+	private:
+		static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+		uint32_t m_SetsPerPool = 0;
+		VkDescriptorPool m_CurrentPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> m_UsedPools; //Includes the current pool
+		std::vector<VkDescriptorPool> m_FreePools; //Reset and ready for reuse
+
+		static std::array<DescriptorAllocator, MAX_FRAMES_IN_FLIGHT> sm_FrameAllocators;
+		static DescriptorAllocator sm_PersistentAllocator;
+	};
+}
@@ -0,0 +1,127 @@
+#include "DescriptorLayoutCache.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "Utils/Hash.h"
+#include <algorithm>
+
+namespace CHIKU
+{
+    std::unordered_map<DescriptorLayoutCache::SetLayoutKey, VkDescriptorSetLayout, DescriptorLayoutCache::KeyHash> DescriptorLayoutCache::sm_SetLayouts;
+    std::unordered_map<DescriptorLayoutCache::PipelineLayoutKey, VkPipelineLayout, DescriptorLayoutCache::KeyHash> DescriptorLayoutCache::sm_PipelineLayouts;
+
+    bool DescriptorLayoutCache::SetLayoutKey::operator==(const SetLayoutKey& other) const
+    {
+        return std::equal(Bindings.begin(), Bindings.end(), other.Bindings.begin(), other.Bindings.end(),
+            [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+            {
+                return a.binding == b.binding && a.descriptorType == b.descriptorType &&
+                    a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags;
+            });
+    }
+
+    bool DescriptorLayoutCache::PipelineLayoutKey::operator==(const PipelineLayoutKey& other) const
+    {
+        return SetLayouts == other.SetLayouts &&
+            std::equal(PushConstants.begin(), PushConstants.end(), other.PushConstants.begin(), other.PushConstants.end(),
+                [](const VkPushConstantRange& a, const VkPushConstantRange& b)
+                {
+                    return a.stageFlags == b.stageFlags && a.offset == b.offset && a.size == b.size;
+                });
+    }
+
+    size_t DescriptorLayoutCache::KeyHash::operator()(const SetLayoutKey& key) const noexcept
+    {
+        //Field by field, the struct has a pointer and padding that must not affect the key
+        uint64_t hash = Utils::FNV_OFFSET_BASIS;
+        for (const auto& binding : key.Bindings)
+        {
+            uint32_t fields[4] = { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags };
+            hash = Utils::HashBytes(fields, sizeof(fields), hash);
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    size_t DescriptorLayoutCache::KeyHash::operator()(const PipelineLayoutKey& key) const noexcept
+    {
+        uint64_t hash = Utils::HashBytes(key.SetLayouts.data(), key.SetLayouts.size() * sizeof(VkDescriptorSetLayout));
+        for (const auto& range : key.PushConstants)
+        {
+            uint32_t fields[3] = { range.stageFlags, range.offset, range.size };
+            hash = Utils::HashBytes(fields, sizeof(fields), hash);
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    VkDescriptorSetLayout DescriptorLayoutCache::GetSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+    {
+        std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+            {
+                return a.binding < b.binding;
+            });
+        for (auto& binding : bindings)
+        {
+            binding.pImmutableSamplers = nullptr;
+        }
+
+        SetLayoutKey key{ std::move(bindings) };
+        auto found = sm_SetLayouts.find(key);
+        if (found != sm_SetLayouts.end())
+        {
+            return found->second;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(key.Bindings.size());
+        layoutInfo.pBindings = key.Bindings.data();
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(VulkanEngine::GetDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+
+        sm_SetLayouts.emplace(std::move(key), layout);
+        return layout;
+    }
+
+    VkPipelineLayout DescriptorLayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+    {
+        PipelineLayoutKey key{ setLayouts, pushConstants };
+        auto found = sm_PipelineLayouts.find(key);
+        if (found != sm_PipelineLayouts.end())
+        {
+            return found->second;
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+        pipelineLayoutInfo.pPushConstantRanges = pushConstants.data();
+
+        VkPipelineLayout layout;
+        if (vkCreatePipelineLayout(VulkanEngine::GetDevice(), &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        sm_PipelineLayouts.emplace(std::move(key), layout);
+        return layout;
+    }
+
+    void DescriptorLayoutCache::CleanUp()
+    {
+        for (auto& [_, layout] : sm_PipelineLayouts)
+        {
+            vkDestroyPipelineLayout(VulkanEngine::GetDevice(), layout, nullptr);
+        }
+        for (auto& [_, layout] : sm_SetLayouts)
+        {
+            vkDestroyDescriptorSetLayout(VulkanEngine::GetDevice(), layout, nullptr);
+        }
+
+        sm_PipelineLayouts.clear();
+        sm_SetLayouts.clear();
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "VulkanHeader.h"
+#include <unordered_map>
+#include <vector>
+
+namespace CHIKU
+{
+	//Owns every descriptor set layout and pipeline layout. Identical requests return the same handle,
+	//so programs with matching reflected layouts share them and stay descriptor set compatible.
+	class DescriptorLayoutCache
+	{
+	public:
+		//Bindings may come in any order, pImmutableSamplers is not supported and ignored
+		static VkDescriptorSetLayout GetSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+		static VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+		static void CleanUp();
+
+		static size_t GetSetLayoutCount() { return sm_SetLayouts.size(); }
+		static size_t GetPipelineLayoutCount() { return sm_PipelineLayouts.size(); }
+
+	private:
+		struct SetLayoutKey
+		{
+			std::vector<VkDescriptorSetLayoutBinding> Bindings; //Sorted by binding
+
+			bool operator==(const SetLayoutKey& other) const;
+		};
+
+		struct PipelineLayoutKey
+		{
+			std::vector<VkDescriptorSetLayout> SetLayouts;
+			std::vector<VkPushConstantRange> PushConstants;
+
+			bool operator==(const PipelineLayoutKey& other) const;
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const SetLayoutKey& key) const noexcept;
+			size_t operator()(const PipelineLayoutKey& key) const noexcept;
+		};
+
+	private:
+		static std::unordered_map<SetLayoutKey, VkDescriptorSetLayout, KeyHash> sm_SetLayouts;
+		static std::unordered_map<PipelineLayoutKey, VkPipelineLayout, KeyHash> sm_PipelineLayouts;
+	};
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace CHIKU
+{
+	//SPIR-V compiled at build time when CHIKU_EMBED_SHADERS is set. The table is generated by tools/ShaderEmbedder.
+	struct EmbeddedShader
+	{
+		const char* Path; //Prebuilt name of the variant, see GetPrebuiltShaderPath
+		const unsigned char* Data;
+		size_t Size;
+	};
+
+	const EmbeddedShader* FindEmbeddedShader(const std::string& prebuiltPath);
+
+	//Where the prebuilt SPIR-V of one variant lives, relative to SOURCE_DIR: the source path, then each define in the
+	//order ShaderManager::GetDefines lists them with '=' written as '-', then ".spv". The variant without defines is
+	//"<shader>.spv", e.g. "shader/unlit.vert.spv" and "shader/unlit.vert.CHIKU_BINDLESS-1.spv".
+	//Shared by the engine, AssetPacker and ShaderEmbedder, so the tools write what the engine looks up.
+	inline std::string GetPrebuiltShaderPath(const std::string& shaderPath, const std::vector<std::string>& defines)
+	{
+		std::string path = shaderPath;
+		for (const auto& define : defines)
+		{
+			path += "." + define;
+			std::replace(path.end() - define.size(), path.end(), '=', '-');
+		}
+		return path + ".spv";
+	}
+}
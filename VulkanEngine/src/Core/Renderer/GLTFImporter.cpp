@@ -0,0 +1,896 @@
+#include "GLTFImporter.h"
+#include "Utils/BufferUtils.h"
+#include "AssetManager.h"
+#include <json.hpp>
+#include <iostream>
+#include <filesystem>
+#include <numeric>
+#include <algorithm>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace CHIKU
+{
+	static constexpr uint32_t GLB_MAGIC = 0x46546C67; //"glTF"
+	static constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	static constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+	enum GLTFComponentType : uint32_t
+	{
+		GLTF_BYTE = 5120,
+		GLTF_UNSIGNED_BYTE = 5121,
+		GLTF_SHORT = 5122,
+		GLTF_UNSIGNED_SHORT = 5123,
+		GLTF_UNSIGNED_INT = 5125,
+		GLTF_FLOAT = 5126
+	};
+
+	static const std::pair<const char*, const char*> s_SemanticToField[] = {
+		{ "POSITION",   VERTEX_FIELD_POSITION },
+		{ "NORMAL",     VERTEX_FIELD_NORMAL },
+		{ "TANGENT",    VERTEX_FIELD_TANGENT },
+		{ "TEXCOORD_0", VERTEX_FIELD_TEXCOORD },
+		{ "COLOR_0",    VERTEX_FIELD_COLOR },
+		{ "JOINTS_0",   VERTEX_FIELD_BONEIDS },
+		{ "WEIGHTS_0",  VERTEX_FIELD_WEIGHTS }
+	};
+
+	static uint32_t GetComponentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case GLTF_BYTE:
+		case GLTF_UNSIGNED_BYTE: return 1;
+		case GLTF_SHORT:
+		case GLTF_UNSIGNED_SHORT: return 2;
+		case GLTF_UNSIGNED_INT:
+		case GLTF_FLOAT: return 4;
+		}
+
+		return 0;
+	}
+
+	static uint32_t GetComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT4") return 16;
+		return 0;
+	}
+
+	static uint32_t GetFloatComponentCount(VertexAttributeType type)
+	{
+		switch (type)
+		{
+		case VertexAttributeType::Float: return 1;
+		case VertexAttributeType::Vec2:  return 2;
+		case VertexAttributeType::Vec3:  return 3;
+		case VertexAttributeType::Vec4:  return 4;
+		}
+
+		return 0;
+	}
+
+	static float ReadComponent(const uint8_t* src, uint32_t componentType, bool normalized)
+	{
+		switch (componentType)
+		{
+		case GLTF_FLOAT: { float v; memcpy(&v, src, sizeof(v)); return v; }
+		case GLTF_UNSIGNED_BYTE: return normalized ? *src / 255.0f : static_cast<float>(*src);
+		case GLTF_BYTE: return normalized ? std::max(static_cast<int8_t>(*src) / 127.0f, -1.0f) : static_cast<float>(static_cast<int8_t>(*src));
+		case GLTF_UNSIGNED_SHORT: { uint16_t v; memcpy(&v, src, sizeof(v)); return normalized ? v / 65535.0f : static_cast<float>(v); }
+		case GLTF_SHORT: { int16_t v; memcpy(&v, src, sizeof(v)); return normalized ? std::max(v / 32767.0f, -1.0f) : static_cast<float>(v); }
+		case GLTF_UNSIGNED_INT: { uint32_t v; memcpy(&v, src, sizeof(v)); return static_cast<float>(v); }
+		}
+
+		return 0.0f;
+	}
+
+	bool GLTFImporter::Load(const std::string& path)
+	{
+		std::vector<char> fileData;
+		if (!AssetManager::ReadFile(path, fileData))
+		{
+			std::cerr << "Failed to open model file: " << path << std::endl;
+			return false;
+		}
+
+		std::string baseDir = std::filesystem::path(path).parent_path().generic_string();
+		if (!baseDir.empty())
+		{
+			baseDir += "/";
+		}
+
+		m_FileData.push_back(std::move(fileData));
+
+		std::string json;
+		if (std::filesystem::path(path).extension() == ".glb")
+		{
+			if (!ParseGLB(m_FileData.back(), json))
+			{
+				std::cerr << "Invalid GLB container: " << path << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			json.assign(m_FileData.back().begin(), m_FileData.back().end());
+		}
+
+		//Malformed documents throw from the accessor and JSON lookups
+		try
+		{
+			return ParseDocument(json, baseDir);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Invalid glTF file " << path << ": " << e.what() << std::endl;
+			return false;
+		}
+	}
+
+	bool GLTFImporter::ParseGLB(const std::vector<char>& file, std::string& json)
+	{
+		uint32_t header[3];
+		if (file.size() < sizeof(header))
+		{
+			return false;
+		}
+
+		memcpy(header, file.data(), sizeof(header));
+		if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > file.size())
+		{
+			return false;
+		}
+
+		size_t offset = sizeof(header);
+		while (offset + 8 <= header[2])
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, file.data() + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+
+			if (offset + chunk[0] > header[2])
+			{
+				return false;
+			}
+
+			if (chunk[1] == GLB_CHUNK_JSON)
+			{
+				json.assign(reinterpret_cast<const char*>(file.data() + offset), chunk[0]);
+			}
+			else if (chunk[1] == GLB_CHUNK_BIN)
+			{
+				m_BinaryChunk = { reinterpret_cast<const uint8_t*>(file.data()) + offset, chunk[0] };
+			}
+
+			offset += (chunk[0] + 3) & ~3u;
+		}
+
+		return !json.empty();
+	}
+
+	bool GLTFImporter::ParseDocument(const std::string& json, const std::string& baseDir)
+	{
+		nlohmann::json document;
+		try
+		{
+			document = nlohmann::json::parse(json);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Error parsing glTF JSON: " << e.what() << std::endl;
+			return false;
+		}
+
+		for (const auto& buffer : document.value("buffers", nlohmann::json::array()))
+		{
+			if (!buffer.contains("uri"))
+			{
+				m_Buffers.push_back(m_BinaryChunk);
+				continue;
+			}
+
+			std::string uri = buffer["uri"].get<std::string>();
+			if (uri.rfind("data:", 0) == 0)
+			{
+				std::cerr << "Embedded data URIs are not supported, use GLB instead" << std::endl;
+				return false;
+			}
+
+			std::vector<char> data;
+			if (!AssetManager::ReadFile(baseDir + uri, data))
+			{
+				std::cerr << "Failed to open glTF buffer: " << uri << std::endl;
+				return false;
+			}
+
+			m_FileData.push_back(std::move(data));
+			m_Buffers.push_back({ reinterpret_cast<const uint8_t*>(m_FileData.back().data()), m_FileData.back().size() });
+		}
+
+		for (const auto& view : document.value("bufferViews", nlohmann::json::array()))
+		{
+			BufferView bufferView;
+			bufferView.Buffer = view.at("buffer").get<uint32_t>();
+			bufferView.ByteOffset = view.value("byteOffset", size_t(0));
+			bufferView.ByteLength = view.at("byteLength").get<size_t>();
+			bufferView.ByteStride = view.value("byteStride", 0u);
+
+			if (bufferView.Buffer >= m_Buffers.size() || bufferView.ByteOffset + bufferView.ByteLength > m_Buffers[bufferView.Buffer].Size)
+			{
+				std::cerr << "glTF buffer view is out of bounds" << std::endl;
+				return false;
+			}
+
+			m_BufferViews.push_back(bufferView);
+		}
+
+		for (const auto& entry : document.value("accessors", nlohmann::json::array()))
+		{
+			if (entry.contains("sparse"))
+			{
+				std::cerr << "Sparse glTF accessors are not supported" << std::endl;
+				return false;
+			}
+
+			Accessor accessor;
+			accessor.BufferView = entry.value("bufferView", -1);
+			accessor.ByteOffset = entry.value("byteOffset", size_t(0));
+			accessor.Count = entry.at("count").get<uint32_t>();
+			accessor.ComponentType = entry.at("componentType").get<uint32_t>();
+			accessor.ComponentCount = GetComponentCount(entry.at("type").get<std::string>());
+			accessor.Normalized = entry.value("normalized", false);
+
+			//Without a buffer view every element is zero, see GetAccessorData
+			if (accessor.BufferView >= static_cast<int32_t>(m_BufferViews.size()))
+			{
+				std::cerr << "glTF accessor references a missing buffer view" << std::endl;
+				return false;
+			}
+
+			m_Accessors.push_back(accessor);
+		}
+
+		const auto textures = document.value("textures", nlohmann::json::array());
+		const auto images = document.value("images", nlohmann::json::array());
+
+		for (const auto& entry : document.value("materials", nlohmann::json::array()))
+		{
+			GLTFMaterial material;
+			material.Name = entry.value("name", std::string());
+
+			const auto pbr = entry.value("pbrMetallicRoughness", nlohmann::json::object());
+			if (pbr.contains("baseColorFactor"))
+			{
+				auto factor = pbr["baseColorFactor"].get<std::vector<float>>();
+				material.BaseColorFactor = glm::make_vec4(factor.data());
+			}
+
+			if (pbr.contains("baseColorTexture"))
+			{
+				uint32_t texture = pbr["baseColorTexture"].at("index").get<uint32_t>();
+				if (texture < textures.size() && textures[texture].contains("source"))
+				{
+					const auto& image = images.at(textures[texture]["source"].get<uint32_t>());
+					if (image.contains("uri"))
+					{
+						material.BaseColorTexture = baseDir + image["uri"].get<std::string>();
+					}
+					else
+					{
+						material.BaseColorTextureView = image.value("bufferView", -1);
+					}
+				}
+			}
+
+			m_Materials.push_back(material);
+		}
+
+		auto isAccessor = [this](int32_t index) { return index >= 0 && index < static_cast<int32_t>(m_Accessors.size()); };
+
+		for (const auto& entry : document.value("meshes", nlohmann::json::array()))
+		{
+			GLTFMesh mesh;
+			std::vector<PrimitiveSource> sources;
+			mesh.Name = entry.value("name", std::string());
+
+			for (const auto& primitive : entry.at("primitives"))
+			{
+				//Only triangle lists map onto the current pipelines
+				if (primitive.value("mode", 4) != 4)
+				{
+					std::cerr << "Skipping non-triangle primitive in mesh: " << mesh.Name << std::endl;
+					continue;
+				}
+
+				PrimitiveSource source;
+				source.Indices = primitive.value("indices", -1);
+
+				const auto& attributes = primitive.at("attributes");
+				for (const auto& [semantic, field] : s_SemanticToField)
+				{
+					if (attributes.contains(semantic))
+					{
+						source.Attributes.emplace_back(field, attributes[semantic].get<int32_t>());
+					}
+				}
+
+				if (!attributes.contains("POSITION"))
+				{
+					std::cerr << "Skipping primitive without POSITION in mesh: " << mesh.Name << std::endl;
+					continue;
+				}
+
+				if ((primitive.contains("indices") && !isAccessor(source.Indices)) ||
+					std::any_of(source.Attributes.begin(), source.Attributes.end(), [&](const auto& attribute) { return !isAccessor(attribute.second); }))
+				{
+					std::cerr << "glTF primitive references a missing accessor in mesh: " << mesh.Name << std::endl;
+					return false;
+				}
+
+				GLTFPrimitive range;
+				range.MaterialIndex = primitive.value("material", -1);
+				range.VertexCount = m_Accessors[attributes["POSITION"].get<int32_t>()].Count;
+				range.IndexCount = source.Indices >= 0 ? m_Accessors[source.Indices].Count : range.VertexCount;
+
+				if (range.MaterialIndex >= static_cast<int32_t>(m_Materials.size()))
+				{
+					std::cerr << "glTF primitive references a missing material in mesh: " << mesh.Name << std::endl;
+					return false;
+				}
+
+				//Every attribute has one element per vertex, a shorter one would leave the rest of the vertices unwritten
+				if (std::any_of(source.Attributes.begin(), source.Attributes.end(), [&](const auto& attribute) { return m_Accessors[attribute.second].Count != range.VertexCount; }))
+				{
+					std::cerr << "Skipping primitive whose attributes differ in length in mesh: " << mesh.Name << std::endl;
+					continue;
+				}
+
+				//Indices reach the GPU as they are, one past the primitive's vertices reads another primitive or past the buffer
+				if (!ValidateIndices(source, range.VertexCount))
+				{
+					std::cerr << "glTF indices out of range of their primitive's " << range.VertexCount << " vertices in mesh: " << mesh.Name << std::endl;
+					return false;
+				}
+
+				//Throws for attributes past the end of their buffer view, so Upload never stops halfway through a buffer
+				for (const auto& [field, accessor] : source.Attributes)
+				{
+					uint32_t stride;
+					if (m_Accessors.at(accessor).BufferView >= 0)
+					{
+						GetAccessorData(m_Accessors[accessor], stride);
+					}
+				}
+
+				mesh.Primitives.push_back(range);
+				sources.push_back(source);
+			}
+
+			m_Meshes.push_back(mesh);
+			m_PrimitiveSources.push_back(sources);
+		}
+
+		const auto nodes = document.value("nodes", nlohmann::json::array());
+		const auto scenes = document.value("scenes", nlohmann::json::array());
+		std::vector<bool> visited(nodes.size(), false);
+
+		if (!scenes.empty())
+		{
+			const auto& scene = scenes.at(document.value("scene", 0));
+			for (const auto& root : scene.value("nodes", nlohmann::json::array()))
+			{
+				ParseNode(nodes, root.get<uint32_t>(), glm::mat4(1.0f), visited);
+			}
+		}
+		else
+		{
+			//Without a scene every node that is nobody's child is a root
+			std::vector<bool> isChild(nodes.size(), false);
+			for (const auto& node : nodes)
+			{
+				for (const auto& child : node.value("children", nlohmann::json::array()))
+				{
+					isChild.at(child.get<uint32_t>()) = true;
+				}
+			}
+
+			for (uint32_t i = 0; i < nodes.size(); i++)
+			{
+				if (!isChild[i])
+				{
+					ParseNode(nodes, i, glm::mat4(1.0f), visited);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void GLTFImporter::ParseNode(const nlohmann::json& nodes, uint32_t nodeIndex, const glm::mat4& parent, std::vector<bool>& visited)
+	{
+		//Nodes form disjoint trees, reaching one twice means a cycle or a node with two parents
+		if (visited.at(nodeIndex))
+		{
+			throw std::runtime_error("glTF node " + std::to_string(nodeIndex) + " is reached twice, the node graph is not a tree");
+		}
+		visited[nodeIndex] = true;
+
+		const auto& node = nodes[nodeIndex];
+		glm::mat4 local(1.0f);
+
+		if (node.contains("matrix"))
+		{
+			auto matrix = node["matrix"].get<std::vector<float>>();
+			local = glm::make_mat4(matrix.data());
+		}
+		else
+		{
+			if (node.contains("translation"))
+			{
+				auto t = node["translation"].get<std::vector<float>>();
+				local = glm::translate(local, glm::make_vec3(t.data()));
+			}
+
+			if (node.contains("rotation"))
+			{
+				auto r = node["rotation"].get<std::vector<float>>();
+				local = local * glm::mat4_cast(glm::quat(r[3], r[0], r[1], r[2]));
+			}
+
+			if (node.contains("scale"))
+			{
+				auto s = node["scale"].get<std::vector<float>>();
+				local = glm::scale(local, glm::make_vec3(s.data()));
+			}
+		}
+
+		glm::mat4 world = parent * local;
+
+		if (node.contains("mesh"))
+		{
+			uint32_t mesh = node["mesh"].get<uint32_t>();
+			if (mesh >= m_Meshes.size())
+			{
+				throw std::runtime_error("glTF node " + std::to_string(nodeIndex) + " references a missing mesh");
+			}
+			m_Instances.push_back({ mesh, world });
+		}
+
+		for (const auto& child : node.value("children", nlohmann::json::array()))
+		{
+			ParseNode(nodes, child.get<uint32_t>(), world, visited);
+		}
+	}
+
+	const uint8_t* GLTFImporter::GetBufferViewData(int32_t bufferView, size_t& size) const
+	{
+		if (bufferView < 0 || bufferView >= static_cast<int32_t>(m_BufferViews.size()))
+		{
+			size = 0;
+			return nullptr;
+		}
+
+		const BufferView& view = m_BufferViews[bufferView];
+		size = view.ByteLength;
+		return m_Buffers[view.Buffer].Data + view.ByteOffset;
+	}
+
+	const uint8_t* GLTFImporter::GetAccessorData(const Accessor& accessor, uint32_t& stride) const
+	{
+		//Accessors without a buffer view are all zeros, callers handle them before reading
+		if (accessor.BufferView < 0)
+		{
+			throw std::runtime_error("glTF accessor has no buffer view to read");
+		}
+
+		const BufferView& view = m_BufferViews[accessor.BufferView];
+		uint32_t elementSize = GetComponentSize(accessor.ComponentType) * accessor.ComponentCount;
+		stride = view.ByteStride ? view.ByteStride : elementSize;
+
+		if (accessor.Count > 0 && accessor.ByteOffset + size_t(accessor.Count - 1) * stride + elementSize > view.ByteLength)
+		{
+			throw std::runtime_error("glTF accessor is out of bounds of its buffer view");
+		}
+
+		return m_Buffers[view.Buffer].Data + view.ByteOffset + accessor.ByteOffset;
+	}
+
+	VertexAttributeType GLTFImporter::GetAttributeType(const Accessor& accessor)
+	{
+		switch (accessor.ComponentType)
+		{
+		case GLTF_FLOAT:
+			switch (accessor.ComponentCount)
+			{
+			case 1: return VertexAttributeType::Float;
+			case 2: return VertexAttributeType::Vec2;
+			case 3: return VertexAttributeType::Vec3;
+			case 4: return VertexAttributeType::Vec4;
+			}
+			break;
+		case GLTF_UNSIGNED_INT:
+			switch (accessor.ComponentCount)
+			{
+			case 1: return VertexAttributeType::UInt;
+			case 2: return VertexAttributeType::UVec2;
+			case 3: return VertexAttributeType::UVec3;
+			case 4: return VertexAttributeType::UVec4;
+			}
+			break;
+		case GLTF_UNSIGNED_BYTE:
+			if (accessor.ComponentCount == 4) return accessor.Normalized ? VertexAttributeType::UByte4N : VertexAttributeType::UByte4;
+			break;
+		case GLTF_BYTE:
+			if (accessor.ComponentCount == 4) return accessor.Normalized ? VertexAttributeType::Byte4N : VertexAttributeType::Byte4;
+			break;
+		case GLTF_SHORT:
+			if (accessor.ComponentCount == 2) return accessor.Normalized ? VertexAttributeType::Short2N : VertexAttributeType::Short2;
+			if (accessor.ComponentCount == 4) return accessor.Normalized ? VertexAttributeType::Short4N : VertexAttributeType::Short4;
+			break;
+		}
+
+		return VertexAttributeType::Unknown;
+	}
+
+	void GLTFImporter::GetPrimitiveBounds(const PrimitiveSource& source, glm::vec3& min, glm::vec3& max) const
+	{
+		for (const auto& [name, index] : source.Attributes)
+		{
+			if (name != VERTEX_FIELD_POSITION || index < 0)
+			{
+				continue;
+			}
+
+			if (m_Accessors.at(index).BufferView < 0)
+			{
+				min = glm::min(min, glm::vec3(0.0f));
+				max = glm::max(max, glm::vec3(0.0f));
+				continue;
+			}
+
+			//Read from the file rather than the upload, which may be write-combined device memory
+			const Accessor& accessor = m_Accessors[index];
+			uint32_t stride;
+			const uint8_t* src = GetAccessorData(accessor, stride);
+			uint32_t componentSize = GetComponentSize(accessor.ComponentType);
+			uint32_t components = std::min(accessor.ComponentCount, 3u);
+			for (uint32_t v = 0; v < accessor.Count; v++)
+			{
+				glm::vec3 position(0.0f);
+				for (uint32_t c = 0; c < components; c++)
+				{
+					position[c] = ReadComponent(src + size_t(v) * stride + c * componentSize, accessor.ComponentType, accessor.Normalized);
+				}
+				min = glm::min(min, position);
+				max = glm::max(max, position);
+			}
+		}
+	}
+
+	void GLTFImporter::WritePrimitiveVertices(const PrimitiveSource& source, const VertexBufferLayout& layout, uint8_t* dst) const
+	{
+		auto findAccessor = [&source](const std::string& field) -> int32_t
+			{
+				for (const auto& [name, accessor] : source.Attributes)
+				{
+					if (name == field) return accessor;
+				}
+				return -1;
+			};
+
+		uint32_t vertexCount = m_Accessors.at(findAccessor(VERTEX_FIELD_POSITION)).Count;
+
+		//Fast path: the file is already interleaved exactly like the engine layout, copy the whole block at once
+		int32_t sharedView = -1;
+		int64_t blockOffset = -1;
+		bool interleaved = true;
+		for (const auto& element : layout.VertexElements)
+		{
+			int32_t index = findAccessor(element.ElementName);
+			if (index < 0)
+			{
+				interleaved = false;
+				break;
+			}
+
+			const Accessor& accessor = m_Accessors.at(index);
+			int64_t offset = static_cast<int64_t>(accessor.ByteOffset) - element.Offset;
+			if (accessor.BufferView < 0 || GetAttributeType(accessor) != element.AttributeType ||
+				m_BufferViews.at(accessor.BufferView).ByteStride != layout.Stride ||
+				(sharedView >= 0 && (sharedView != accessor.BufferView || blockOffset != offset)) ||
+				offset < 0)
+			{
+				interleaved = false;
+				break;
+			}
+
+			sharedView = accessor.BufferView;
+			blockOffset = offset;
+		}
+
+		if (interleaved && sharedView >= 0)
+		{
+			const BufferView& view = m_BufferViews[sharedView];
+			size_t blockSize = size_t(vertexCount) * layout.Stride;
+			if (blockOffset + blockSize <= view.ByteLength)
+			{
+				memcpy(dst, m_Buffers[view.Buffer].Data + view.ByteOffset + blockOffset, blockSize);
+				return;
+			}
+		}
+
+		//Slow path: gather each attribute into its slot, converting component types where needed
+		for (const auto& element : layout.VertexElements)
+		{
+			size_t elementSize = Utils::GetAttributeSize(element.AttributeType);
+			uint32_t dstComponents = GetFloatComponentCount(element.AttributeType);
+			int32_t index = findAccessor(element.ElementName);
+			//A missing color is white, an accessor without a buffer view is zeros
+			float fill = index < 0 && element.ElementName == VERTEX_FIELD_COLOR ? 1.0f : 0.0f;
+
+			if (index < 0 || m_Accessors[index].BufferView < 0)
+			{
+				for (uint32_t v = 0; v < vertexCount; v++)
+				{
+					uint8_t* out = dst + size_t(v) * layout.Stride + element.Offset;
+					memset(out, 0, elementSize);
+					for (uint32_t c = 0; c < dstComponents; c++)
+					{
+						memcpy(out + c * sizeof(float), &fill, sizeof(float));
+					}
+				}
+				continue;
+			}
+
+			const Accessor& accessor = m_Accessors[index];
+			uint32_t srcStride;
+			const uint8_t* src = GetAccessorData(accessor, srcStride);
+			uint32_t count = std::min(vertexCount, accessor.Count);
+
+			if (GetAttributeType(accessor) == element.AttributeType)
+			{
+				for (uint32_t v = 0; v < count; v++)
+				{
+					memcpy(dst + size_t(v) * layout.Stride + element.Offset, src + size_t(v) * srcStride, elementSize);
+				}
+			}
+			else if (dstComponents > 0)
+			{
+				uint32_t componentSize = GetComponentSize(accessor.ComponentType);
+				for (uint32_t v = 0; v < count; v++)
+				{
+					float values[4] = { fill, fill, fill, fill };
+					for (uint32_t c = 0; c < std::min(dstComponents, accessor.ComponentCount); c++)
+					{
+						values[c] = ReadComponent(src + size_t(v) * srcStride + c * componentSize, accessor.ComponentType, accessor.Normalized);
+					}
+					memcpy(dst + size_t(v) * layout.Stride + element.Offset, values, dstComponents * sizeof(float));
+				}
+			}
+			else
+			{
+				std::cerr << "Unsupported conversion for vertex attribute: " << element.ElementName << std::endl;
+				for (uint32_t v = 0; v < count; v++)
+				{
+					memset(dst + size_t(v) * layout.Stride + element.Offset, 0, elementSize);
+				}
+			}
+		}
+	}
+
+	bool GLTFImporter::ValidateIndices(const PrimitiveSource& source, uint32_t vertexCount) const
+	{
+		if (source.Indices < 0)
+		{
+			return true;
+		}
+
+		const Accessor& accessor = m_Accessors.at(source.Indices);
+		if (accessor.ComponentCount != 1 || (accessor.ComponentType != GLTF_UNSIGNED_BYTE && accessor.ComponentType != GLTF_UNSIGNED_SHORT &&
+			accessor.ComponentType != GLTF_UNSIGNED_INT))
+		{
+			return false;
+		}
+
+		if (accessor.BufferView < 0)
+		{
+			return accessor.Count == 0 || vertexCount > 0;
+		}
+
+		uint32_t stride;
+		const uint8_t* src = GetAccessorData(accessor, stride);
+		uint32_t componentSize = GetComponentSize(accessor.ComponentType);
+		for (uint32_t i = 0; i < accessor.Count; i++)
+		{
+			uint32_t index = 0;
+			memcpy(&index, src + size_t(i) * stride, componentSize); //Little endian like the file
+			if (index >= vertexCount)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void GLTFImporter::WritePrimitiveIndices(const PrimitiveSource& source, uint32_t vertexCount, uint32_t baseVertex, uint32_t* dst) const
+	{
+		if (source.Indices < 0)
+		{
+			std::iota(dst, dst + vertexCount, baseVertex);
+			return;
+		}
+
+		//Every index is below vertexCount, ValidateIndices checked it at load
+		const Accessor& accessor = m_Accessors.at(source.Indices);
+		if (accessor.BufferView < 0)
+		{
+			std::fill(dst, dst + accessor.Count, baseVertex);
+			return;
+		}
+
+		uint32_t stride;
+		const uint8_t* src = GetAccessorData(accessor, stride);
+
+		if (accessor.ComponentType == GLTF_UNSIGNED_INT && stride == sizeof(uint32_t) && baseVertex == 0)
+		{
+			memcpy(dst, src, size_t(accessor.Count) * sizeof(uint32_t));
+			return;
+		}
+
+		for (uint32_t i = 0; i < accessor.Count; i++)
+		{
+			dst[i] = baseVertex + static_cast<uint32_t>(ReadComponent(src + size_t(i) * stride, accessor.ComponentType, false));
+		}
+	}
+
+	void GLTFImporter::Build(VertexLayoutPreset layout)
+	{
+		m_Layout = VertexBuffer::GetVertexBufferLayout(layout);
+		Utils::FinalizeLayout(m_Layout);
+
+		//A file without nodes still shows every mesh once, where it was modelled
+		if (m_Instances.empty())
+		{
+			for (uint32_t m = 0; m < m_Meshes.size(); m++)
+			{
+				m_Instances.push_back({ m, glm::mat4(1.0f) });
+			}
+		}
+
+		for (size_t m = 0; m < m_Meshes.size(); m++)
+		{
+			for (size_t p = 0; p < m_Meshes[m].Primitives.size(); p++)
+			{
+				GLTFPrimitive& primitive = m_Meshes[m].Primitives[p];
+				primitive.BoundsMin = glm::vec3(FLT_MAX);
+				primitive.BoundsMax = glm::vec3(-FLT_MAX);
+				GetPrimitiveBounds(m_PrimitiveSources[m][p], primitive.BoundsMin, primitive.BoundsMax);
+			}
+		}
+
+		//Which windings each mesh is drawn with, bit 0 as modelled and bit 1 mirrored
+		std::vector<uint8_t> windings(m_Meshes.size(), 0);
+		for (const GLTFMeshInstance& instance : m_Instances)
+		{
+			windings.at(instance.Mesh) |= instance.IsMirrored() ? 2 : 1;
+		}
+
+		//One copy of the vertices per mesh, shared by every node that places it and by both windings
+		m_Placements.clear();
+		m_VertexCount = 0;
+		for (uint32_t m = 0; m < m_Meshes.size(); m++)
+		{
+			GLTFMesh& mesh = m_Meshes[m];
+			mesh.Ranges.clear();
+			mesh.MirroredRanges.clear();
+			for (uint32_t p = 0; p < mesh.Primitives.size(); p++)
+			{
+				mesh.Primitives[p].VertexOffset = static_cast<int32_t>(m_VertexCount);
+				m_VertexCount += windings[m] != 0 ? mesh.Primitives[p].VertexCount : 0;
+			}
+
+			for (bool mirrored : { false, true })
+			{
+				if ((windings[m] & (mirrored ? 2 : 1)) == 0)
+				{
+					continue;
+				}
+				for (uint32_t p = 0; p < mesh.Primitives.size(); p++)
+				{
+					m_Placements.push_back({ m, p, 0, mirrored, !mirrored || (windings[m] & 1) == 0 });
+				}
+			}
+		}
+
+		//Grouped by material within each mesh and winding, so a mesh is one draw per material
+		std::stable_sort(m_Placements.begin(), m_Placements.end(), [this](const Placement& a, const Placement& b)
+			{
+				if (a.Mesh != b.Mesh || a.Mirrored != b.Mirrored)
+				{
+					return a.Mesh != b.Mesh ? a.Mesh < b.Mesh : !a.Mirrored;
+				}
+				return GetPrimitive(a).MaterialIndex < GetPrimitive(b).MaterialIndex;
+			});
+
+		m_IndexCount = 0;
+		for (Placement& placement : m_Placements)
+		{
+			placement.FirstIndex = m_IndexCount;
+
+			GLTFPrimitive range = GetPrimitive(placement);
+			range.FirstIndex = placement.FirstIndex;
+			m_IndexCount += range.IndexCount;
+
+			std::vector<GLTFPrimitive>& ranges = placement.Mirrored ? m_Meshes[placement.Mesh].MirroredRanges : m_Meshes[placement.Mesh].Ranges;
+			if (!ranges.empty() && ranges.back().MaterialIndex == range.MaterialIndex)
+			{
+				ranges.back().IndexCount += range.IndexCount;
+				ranges.back().VertexCount += range.VertexCount;
+				ranges.back().BoundsMin = glm::min(ranges.back().BoundsMin, range.BoundsMin);
+				ranges.back().BoundsMax = glm::max(ranges.back().BoundsMax, range.BoundsMax);
+				continue;
+			}
+			ranges.push_back(range);
+		}
+
+		if (m_VertexCount == 0 || m_IndexCount == 0)
+		{
+			throw std::runtime_error("glTF file contains no drawable geometry");
+		}
+	}
+
+	void GLTFImporter::WriteVertices(void* data) const
+	{
+		for (const Placement& placement : m_Placements)
+		{
+			if (placement.WritesVertices)
+			{
+				const GLTFPrimitive& primitive = GetPrimitive(placement);
+				uint8_t* dst = static_cast<uint8_t*>(data) + size_t(primitive.VertexOffset) * m_Layout.Stride;
+				WritePrimitiveVertices(m_PrimitiveSources[placement.Mesh][placement.Primitive], m_Layout, dst);
+			}
+		}
+	}
+
+	void GLTFImporter::WriteIndices(uint32_t* data) const
+	{
+		std::vector<uint32_t> scratch;
+		for (const Placement& placement : m_Placements)
+		{
+			const GLTFPrimitive& primitive = GetPrimitive(placement);
+			const PrimitiveSource& source = m_PrimitiveSources[placement.Mesh][placement.Primitive];
+			uint32_t baseVertex = static_cast<uint32_t>(primitive.VertexOffset);
+
+			if (!placement.Mirrored)
+			{
+				WritePrimitiveIndices(source, primitive.VertexCount, baseVertex, data + placement.FirstIndex);
+				continue;
+			}
+
+			//For mirroring nodes, swap two corners of every triangle to keep the front face
+			scratch.resize(primitive.IndexCount);
+			WritePrimitiveIndices(source, primitive.VertexCount, baseVertex, scratch.data());
+			for (size_t i = 0; i + 2 < scratch.size(); i += 3)
+			{
+				std::swap(scratch[i + 1], scratch[i + 2]);
+			}
+			memcpy(data + placement.FirstIndex, scratch.data(), scratch.size() * sizeof(uint32_t));
+		}
+	}
+
+	void GLTFImporter::Upload(VertexLayoutPreset layout, VertexBuffer& vertexBuffer, IndexBuffer& indexBuffer)
+	{
+		Build(layout);
+
+		vertexBuffer.SetLayout(layout);
+		vertexBuffer.CreateVertexBuffer(VkDeviceSize(m_VertexCount) * m_Layout.Stride, [this](void* data) { WriteVertices(data); });
+		indexBuffer.CreateIndexBuffer(m_IndexCount, [this](void* data) { WriteIndices(static_cast<uint32_t*>(data)); });
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "VertexBuffer.h"
+#include "IndexBuffer.h"
+#include <glm/glm.hpp>
+#include <json_fwd.hpp>
+#include <cfloat>
+
+namespace CHIKU
+{
+	//A mesh's primitives keep their model space bounds. The mesh's draws, with indices absolute into the shared buffers,
+	//are the ranges of GLTFMesh::Ranges.
+	struct GLTFPrimitive
+	{
+		uint32_t FirstIndex = 0;
+		uint32_t IndexCount = 0;
+		int32_t VertexOffset = 0;
+		uint32_t VertexCount = 0;
+		int32_t MaterialIndex = -1; //-1 when the primitive uses the default material
+		glm::vec3 BoundsMin = glm::vec3(FLT_MAX); //Of the POSITION data, empty (min > max) until Build
+		glm::vec3 BoundsMax = glm::vec3(-FLT_MAX);
+	};
+
+	struct GLTFMesh
+	{
+		std::string Name;
+		std::vector<GLTFPrimitive> Primitives;
+		std::vector<GLTFPrimitive> Ranges; //After Build, one per material of the mesh in model space, empty when no node uses the mesh
+		std::vector<GLTFPrimitive> MirroredRanges; //The same with the winding reversed, only when a mirroring node uses the mesh
+	};
+
+	struct GLTFMaterial
+	{
+		std::string Name;
+		glm::vec4 BaseColorFactor = glm::vec4(1.0f);
+		std::string BaseColorTexture; //Path relative to SOURCE_DIR, empty for embedded or missing textures
+		int32_t BaseColorTextureView = -1; //Buffer view holding an embedded image, -1 when not embedded
+	};
+
+	struct GLTFMeshInstance
+	{
+		uint32_t Mesh;
+		glm::mat4 Transform; //World transform of the node that references the mesh, applied per instance when drawing
+
+		//Turns the winding around, such a node draws its mesh's MirroredRanges to keep the front face
+		bool IsMirrored() const { return glm::determinant(glm::mat3(Transform)) < 0.0f; }
+	};
+
+	class GLTFImporter
+	{
+	public:
+		//Loads a .glb or .gltf file relative to SOURCE_DIR. Only the JSON chunk is parsed, vertex data stays binary.
+		bool Load(const std::string& path);
+
+		//Lays out every mesh a node uses once, in model space, as the given preset. Within a mesh the primitives are
+		//grouped by material, so primitives sharing a material are one index range, see GLTFMesh::Ranges. Nodes place the
+		//mesh through their transform when drawing, see GetInstances. No GPU work.
+		void Build(VertexLayoutPreset layout);
+		//After Build, GetVertexCount vertices of GetLayout and GetIndexCount indices
+		void WriteVertices(void* data) const;
+		void WriteIndices(uint32_t* data) const;
+		//Build, then one vertex/index buffer pair written in place
+		void Upload(VertexLayoutPreset layout, VertexBuffer& vertexBuffer, IndexBuffer& indexBuffer);
+
+		const std::vector<GLTFMesh>& GetMeshes() const { return m_Meshes; }
+		const std::vector<GLTFMaterial>& GetMaterials() const { return m_Materials; }
+		const std::vector<GLTFMeshInstance>& GetInstances() const { return m_Instances; }
+		const VertexBufferLayout& GetLayout() const { return m_Layout; }
+		uint32_t GetVertexCount() const { return m_VertexCount; }
+		uint32_t GetIndexCount() const { return m_IndexCount; }
+
+		//Raw bytes of a buffer view, used for embedded images
+		const uint8_t* GetBufferViewData(int32_t bufferView, size_t& size) const;
+
+	private:
+		struct Accessor
+		{
+			int32_t BufferView = -1;
+			size_t ByteOffset = 0;
+			uint32_t Count = 0;
+			uint32_t ComponentType = 0;
+			uint32_t ComponentCount = 0;
+			bool Normalized = false;
+		};
+
+		struct Buffer
+		{
+			const uint8_t* Data = nullptr;
+			size_t Size = 0;
+		};
+
+		struct BufferView
+		{
+			uint32_t Buffer = 0;
+			size_t ByteOffset = 0;
+			size_t ByteLength = 0;
+			uint32_t ByteStride = 0;
+		};
+
+		struct PrimitiveSource
+		{
+			std::vector<std::pair<std::string, int32_t>> Attributes; //Engine vertex field name to accessor
+			int32_t Indices = -1;
+		};
+
+		//Where Build put the indices of one primitive, once per winding its mesh is drawn with
+		struct Placement
+		{
+			uint32_t Mesh;
+			uint32_t Primitive;
+			uint32_t FirstIndex;
+			bool Mirrored;
+			bool WritesVertices; //The first placement of the primitive, the other winding shares its vertices
+		};
+
+		bool ParseGLB(const std::vector<char>& file, std::string& json);
+		bool ParseDocument(const std::string& json, const std::string& baseDir);
+		void ParseNode(const nlohmann::json& nodes, uint32_t nodeIndex, const glm::mat4& parent, std::vector<bool>& visited);
+
+		const uint8_t* GetAccessorData(const Accessor& accessor, uint32_t& stride) const;
+		void WritePrimitiveVertices(const PrimitiveSource& source, const VertexBufferLayout& layout, uint8_t* dst) const;
+		void GetPrimitiveBounds(const PrimitiveSource& source, glm::vec3& min, glm::vec3& max) const;
+		//Unsigned scalar indices that all address one of the primitive's vertices
+		bool ValidateIndices(const PrimitiveSource& source, uint32_t vertexCount) const;
+		void WritePrimitiveIndices(const PrimitiveSource& source, uint32_t vertexCount, uint32_t baseVertex, uint32_t* dst) const;
+
+		const GLTFPrimitive& GetPrimitive(const Placement& placement) const { return m_Meshes[placement.Mesh].Primitives[placement.Primitive]; }
+
+		static VertexAttributeType GetAttributeType(const Accessor& accessor);
+
+	private:
+		std::vector<std::vector<char>> m_FileData; //Owns the .glb file and any external .bin buffers
+		std::vector<Buffer> m_Buffers;
+		Buffer m_BinaryChunk;
+		std::vector<BufferView> m_BufferViews;
+		std::vector<Accessor> m_Accessors;
+
+		std::vector<GLTFMesh> m_Meshes;
+		std::vector<std::vector<PrimitiveSource>> m_PrimitiveSources;
+		std::vector<GLTFMaterial> m_Materials;
+		std::vector<GLTFMeshInstance> m_Instances;
+
+		VertexBufferLayout m_Layout;
+		std::vector<Placement> m_Placements;
+		uint32_t m_VertexCount = 0;
+		uint32_t m_IndexCount = 0;
+	};
+}
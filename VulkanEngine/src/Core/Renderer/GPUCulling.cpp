@@ -0,0 +1,402 @@
+#include "GPUCulling.h"
+#include "Scene.h"
+#include "GraphicsPipeline.h"
+#include "ComputePipeline.h"
+#include "UniformBuffer.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
+#include "Utils/BufferUtils.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+
+namespace CHIKU
+{
+    bool GPUCulling::sm_Enabled = false;
+    bool GPUCulling::sm_Validation = false;
+    bool GPUCulling::sm_Occlusion = false;
+
+    static const char* CULL_SHADER = "default/cull";
+    static const char* OCCLUSION_SHADER = "default/occlusion";
+
+    //cull.comp and occlusion.comp read InstanceData as a float array
+    static_assert(sizeof(InstanceData) == 21 * sizeof(float), "update INSTANCE_FLOATS in shader/cull.comp and shader/occlusion.comp");
+
+    //Push constants of cull.comp and occlusion.comp, cull.comp ignores BucketCount and Phase
+    struct CullConstants
+    {
+        glm::vec4 Planes[6];
+        uint32_t ObjectCount;
+        uint32_t BucketCount;
+        uint32_t Phase;
+        uint32_t Padding;
+    };
+
+    //std140 uniform block of occlusion.comp
+    struct OcclusionData
+    {
+        glm::mat4 ViewProjection;
+        glm::vec2 PyramidSize;
+        uint32_t PyramidLevels;
+        uint32_t Padding;
+    };
+
+    //Smallest signed distance of the sphere's far side to a plane, negative when it is outside the frustum
+    static float GetSphereMargin(const Utils::FrustumPlanes& planes, const glm::vec4& sphere)
+    {
+        float margin = FLT_MAX;
+        for (const glm::vec4& plane : planes)
+        {
+            margin = std::min(margin, glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w + sphere.w);
+        }
+        return margin;
+    }
+
+    //Only draws RenderQueue could record instanced and in the opaque pass, order inside a bucket is not kept
+    static bool IsCullable(const Material& material, VertexLayoutPreset layout)
+    {
+        return material.GetRenderState().Blend == static_cast<uint32_t>(BlendMode::Opaque) &&
+            material.SupportsInstancing() && VertexBuffer::GetInstancedLayout(layout) != layout;
+    }
+
+    bool GPUCulling::IsSupported()
+    {
+        return VulkanEngine::IsIndirectFirstInstanceEnabled() && VulkanEngine::GetDrawIndexedIndirectCount() != nullptr;
+    }
+
+    void GPUCulling::Build(const Scene& scene, GraphicsPipeline& pipeline)
+    {
+        CleanUp();
+
+        const Utils::SceneView& view = scene.GetView();
+        const glm::mat4* transforms = view.GetTransforms();
+        const uint32_t* meshHandles = view.GetMeshHandles();
+        const uint32_t* materialHandles = view.GetMaterialHandles();
+
+        //Without the pass every entity stays with the RenderQueue
+        bool available = IsSupported() && ComputePipeline::Get(CULL_SHADER) != nullptr;
+
+        std::vector<CullSource> sources;
+
+        for (uint32_t entity = 0; entity < view.GetEntityCount(); entity++)
+        {
+            const Model& model = scene.GetModel(meshHandles[entity]);
+            const Material* material = materialHandles[entity] != Utils::SCENE_INVALID_HANDLE ? &scene.GetMaterial(materialHandles[entity]) : nullptr;
+            VertexLayoutPreset layout = model.GetGeometry().Vertices ? model.GetGeometry().Vertices->GetBufferLayout() : VertexLayoutPreset::Custom;
+
+            bool cullable = available && model.GetGeometry().Vertices;
+            for (const Submesh& submesh : model.GetSubmeshes())
+            {
+                cullable = cullable && IsCullable(material ? *material : model.GetMaterials()[submesh.MaterialIndex], layout);
+            }
+
+            if (!cullable)
+            {
+                m_CPUEntities.push_back(entity);
+                continue;
+            }
+
+            const GeometryPool::Range& geometry = model.GetGeometry();
+            for (const MeshInstance& instance : model.GetInstances())
+            {
+                glm::mat4 transform = instance.Identity ? transforms[entity] : transforms[entity] * instance.Transform;
+                for (uint32_t i = instance.FirstSubmesh; i < instance.FirstSubmesh + instance.SubmeshCount; i++)
+                {
+                    const Submesh& submesh = model.GetSubmeshes()[i];
+                    sources.push_back({ material ? material : &model.GetMaterials()[submesh.MaterialIndex], geometry.Vertices, geometry.Indices,
+                        submesh, transform });
+                }
+            }
+        }
+
+        if (sources.empty())
+        {
+            return;
+        }
+
+        BuildObjects(sources, m_Objects, m_Instances, m_Buckets);
+        for (const Bucket& bucket : m_Buckets)
+        {
+            //Queues the compile now rather than on the first frame
+            pipeline.GetPipelineIndex(*bucket.DrawMaterial, VertexBuffer::GetInstancedLayout(bucket.Vertices->GetBufferLayout()));
+        }
+
+        Utils::CreateDeviceLocalBuffer(m_Objects.data(), sizeof(CullObject) * m_Objects.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            m_ObjectBuffer, m_ObjectBufferMemory);
+        Utils::CreateDeviceLocalBuffer(m_Instances.data(), sizeof(InstanceData) * m_Instances.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            m_InstanceBuffer, m_InstanceBufferMemory);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            //Every object has a slot in its bucket's range of each pass, so the commands never overflow
+            Utils::CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * m_Objects.size() * 2, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_CommandBuffers[i], m_CommandBuffersMemory[i]);
+            Utils::CreateMappedBuffer(sizeof(uint32_t) * m_Buckets.size() * 2, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                m_CountBuffers[i], m_CountBuffersMemory[i], m_CountBuffersMapped[i]);
+        }
+
+        if (ComputePipeline::Get(OCCLUSION_SHADER) != nullptr && DepthPyramid::IsSupported())
+        {
+            //Nothing is visible yet, the first frame draws everything in the second phase against an empty pyramid
+            std::vector<uint32_t> visibility(m_Objects.size(), 0);
+            Utils::CreateDeviceLocalBuffer(visibility.data(), sizeof(uint32_t) * visibility.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                m_VisibilityBuffer, m_VisibilityBufferMemory);
+            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            {
+                Utils::CreateMappedBuffer(sizeof(OcclusionData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                    m_OcclusionBuffers[i], m_OcclusionBuffersMemory[i], m_OcclusionBuffersMapped[i]);
+            }
+        }
+
+        if (!sm_Validation)
+        {
+            m_Instances.clear();
+            m_Instances.shrink_to_fit();
+        }
+    }
+
+    void GPUCulling::BuildObjects(std::vector<CullSource>& sources, std::vector<CullObject>& objects, std::vector<InstanceData>& instances,
+        std::vector<Bucket>& buckets)
+    {
+        //Buckets follow the RenderQueue's opaque order: material, then buffers
+        std::stable_sort(sources.begin(), sources.end(), [](const CullSource& a, const CullSource& b)
+            {
+                if (a.DrawMaterial->GetSortID() != b.DrawMaterial->GetSortID())
+                {
+                    return a.DrawMaterial->GetSortID() < b.DrawMaterial->GetSortID();
+                }
+                if (a.DrawMaterial != b.DrawMaterial)
+                {
+                    return std::less<const Material*>()(a.DrawMaterial, b.DrawMaterial);
+                }
+                if (a.Vertices != b.Vertices)
+                {
+                    return std::less<const VertexBuffer*>()(a.Vertices, b.Vertices);
+                }
+                return std::less<const IndexBuffer*>()(a.Indices, b.Indices);
+            });
+
+        objects.resize(sources.size());
+        instances.resize(sources.size());
+        buckets.clear();
+        for (uint32_t i = 0; i < sources.size(); i++)
+        {
+            const CullSource& source = sources[i];
+            if (buckets.empty() || buckets.back().DrawMaterial != source.DrawMaterial ||
+                buckets.back().Vertices != source.Vertices || buckets.back().Indices != source.Indices)
+            {
+                buckets.push_back({ source.DrawMaterial, source.Vertices, source.Indices, i, 0 });
+            }
+            Bucket& bucket = buckets.back();
+            bucket.ObjectCount++;
+
+            const Submesh& submesh = source.Range;
+            objects[i] = { submesh.Bounds, submesh.FirstIndex, submesh.IndexCount, submesh.VertexOffset, i,
+                static_cast<uint32_t>(buckets.size() - 1), bucket.FirstCommand, {} };
+            instances[i] = { source.Transform, source.DrawMaterial->GetBaseColor(), source.DrawMaterial->GetTextureIndex() };
+        }
+    }
+
+    void GPUCulling::CullReference(const std::vector<CullObject>& objects, const std::vector<InstanceData>& instances, uint32_t bucketCount,
+        const Utils::FrustumPlanes& planes, std::vector<uint32_t>& minimum, std::vector<uint32_t>& maximum)
+    {
+        //Objects within this distance of a plane may go either way on the GPU
+        const float tolerance = 1e-3f;
+
+        minimum.assign(bucketCount, 0);
+        maximum.assign(bucketCount, 0);
+        for (const CullObject& object : objects)
+        {
+            glm::vec4 sphere = Utils::TransformSphere(instances[object.Instance].Transform, object.Bounds);
+            float margin = GetSphereMargin(planes, sphere);
+            float slack = tolerance * std::max(1.0f, sphere.w);
+            minimum[object.Bucket] += margin > slack ? 1 : 0;
+            maximum[object.Bucket] += margin >= -slack ? 1 : 0;
+        }
+    }
+
+    void GPUCulling::Cull(const glm::mat4& viewProjection)
+    {
+        uint32_t frame = VulkanEngine::GetCurrentFrame();
+        bool occlusion = IsOcclusionActive();
+
+        //The frame's fence has passed, its counts are final
+        if (m_ValidationPending[frame])
+        {
+            Validate(frame);
+            m_ValidationPending[frame] = false;
+        }
+
+        memset(m_CountBuffersMapped[frame], 0, sizeof(uint32_t) * m_Buckets.size() * 2);
+
+        if (occlusion)
+        {
+            m_DepthPyramid.Update();
+
+            OcclusionData* data = static_cast<OcclusionData*>(m_OcclusionBuffersMapped[frame]);
+            data->ViewProjection = viewProjection;
+            data->PyramidSize = glm::vec2(static_cast<float>(m_DepthPyramid.GetWidth()), static_cast<float>(m_DepthPyramid.GetHeight()));
+            data->PyramidLevels = m_DepthPyramid.GetLevelCount();
+
+            //The visibility was written by the previous frame's second phase
+            ComputePipeline::Barrier(ComputeBarrier::ComputeToCompute);
+        }
+
+        Utils::FrustumPlanes planes = Utils::GetFrustumPlanes(viewProjection);
+        Dispatch(*ComputePipeline::Get(occlusion ? OCCLUSION_SHADER : CULL_SHADER), planes, occlusion, 0);
+
+        if (sm_Validation && !m_Instances.empty())
+        {
+            ComputePipeline::Barrier(ComputeBarrier::ComputeToHost);
+            m_ValidationPlanes[frame] = planes;
+            m_ValidationOcclusion[frame] = occlusion;
+            m_ValidationPending[frame] = true;
+        }
+    }
+
+    void GPUCulling::CullOcclusion(const glm::mat4& viewProjection)
+    {
+        m_DepthPyramid.Build();
+        Dispatch(*ComputePipeline::Get(OCCLUSION_SHADER), Utils::GetFrustumPlanes(viewProjection), true, 1);
+
+        if (sm_Validation && !m_Instances.empty())
+        {
+            ComputePipeline::Barrier(ComputeBarrier::ComputeToHost);
+        }
+    }
+
+    void GPUCulling::Dispatch(const ComputeProgram& program, const Utils::FrustumPlanes& planes, bool occlusion, uint32_t phase) const
+    {
+        uint32_t frame = VulkanEngine::GetCurrentFrame();
+
+        CullConstants constants{};
+        std::copy(planes.begin(), planes.end(), constants.Planes);
+        constants.ObjectCount = static_cast<uint32_t>(m_Objects.size());
+        constants.BucketCount = static_cast<uint32_t>(m_Buckets.size());
+        constants.Phase = phase;
+
+        ComputeBindings bindings;
+        bindings.StorageBuffer(0, m_ObjectBuffer)
+            .StorageBuffer(1, m_InstanceBuffer)
+            .StorageBuffer(2, m_CommandBuffers[frame])
+            .StorageBuffer(3, m_CountBuffers[frame]);
+        if (occlusion)
+        {
+            bindings.StorageBuffer(4, m_VisibilityBuffer)
+                .SampledImage(5, m_DepthPyramid.GetView(), m_DepthPyramid.GetSampler(), VK_IMAGE_LAYOUT_GENERAL)
+                .Uniform(6, m_OcclusionBuffers[frame]);
+        }
+
+        ComputePipeline::Bind(program);
+        bindings.Bind(program);
+        ComputePipeline::PushConstants(program, &constants, sizeof(constants));
+        ComputePipeline::DispatchThreads(program, constants.ObjectCount);
+        ComputePipeline::Barrier(ComputeBarrier::ComputeToIndirect);
+    }
+
+    uint32_t GPUCulling::Draw(GraphicsPipeline& pipeline, uint32_t pass) const
+    {
+        uint32_t frame = VulkanEngine::GetCurrentFrame();
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+        uint32_t drawCalls = 0;
+        for (uint32_t i = 0; i < m_Buckets.size(); i++)
+        {
+            const Bucket& bucket = m_Buckets[i];
+            GraphicsPipeline::BoundPipeline bound = pipeline.BindPipeline(*bucket.DrawMaterial, VertexBuffer::GetInstancedLayout(bucket.Vertices->GetBufferLayout()));
+            if (bound.Layout == VK_NULL_HANDLE)
+            {
+                continue; //Still compiling and no fallback, or failed
+            }
+
+            bucket.DrawMaterial->Bind(bound.Layout, bound.UsesTextureTable);
+            bucket.Vertices->Bind();
+            bucket.Indices->Bind();
+            CommandRecorder::BindVertexBuffer(VertexBuffer::INSTANCE_BINDING, m_InstanceBuffer);
+
+            //Still needed for the camera, the instanced program ignores the model matrix
+            UniformBuffer::Bind(bound.Layout);
+            CommandRecorder::DrawIndexedIndirectCount(m_CommandBuffers[frame], VkDeviceSize(pass * m_Objects.size() + bucket.FirstCommand) * stride,
+                m_CountBuffers[frame], VkDeviceSize(pass * m_Buckets.size() + i) * sizeof(uint32_t), bucket.ObjectCount, stride);
+            drawCalls++;
+        }
+
+        return drawCalls;
+    }
+
+    void GPUCulling::Validate(uint32_t frame) const
+    {
+        std::vector<uint32_t> minimum;
+        std::vector<uint32_t> maximum;
+        CullReference(m_Objects, m_Instances, static_cast<uint32_t>(m_Buckets.size()), m_ValidationPlanes[frame], minimum, maximum);
+
+        //Occlusion only removes objects, and no object may be drawn by both passes
+        bool occlusion = m_ValidationOcclusion[frame];
+        const uint32_t* counts = static_cast<const uint32_t*>(m_CountBuffersMapped[frame]);
+        uint32_t mismatches = 0;
+        uint32_t visible = 0;
+        for (size_t i = 0; i < m_Buckets.size(); i++)
+        {
+            uint32_t drawn = counts[i] + (occlusion ? counts[m_Buckets.size() + i] : 0);
+            uint32_t lowest = occlusion ? 0 : minimum[i];
+            visible += drawn;
+            if (drawn < lowest || drawn > maximum[i])
+            {
+                if (mismatches++ < 4)
+                {
+                    std::cerr << "GPU culling: bucket " << i << " drew " << drawn << " objects, the CPU expects "
+                        << lowest << " to " << maximum[i] << std::endl;
+                }
+            }
+        }
+
+        static bool reported = false;
+        if (mismatches > 0)
+        {
+            std::cerr << "GPU culling: " << mismatches << " of " << m_Buckets.size() << " buckets differ from the CPU reference" << std::endl;
+        }
+        else if (!reported)
+        {
+            std::cout << "GPU culling matches the CPU reference: " << visible << " of " << m_Objects.size() << " objects visible in "
+                << m_Buckets.size() << " buckets" << (occlusion ? " after occlusion culling" : "") << std::endl;
+            reported = true;
+        }
+    }
+
+    void GPUCulling::CleanUp()
+    {
+        if (m_ObjectBuffer != VK_NULL_HANDLE)
+        {
+            //Recorded frames may still draw from the old buffers
+            vkDeviceWaitIdle(VulkanEngine::GetDevice());
+
+            Utils::DestroyBuffer(m_ObjectBuffer, m_ObjectBufferMemory);
+            Utils::DestroyBuffer(m_InstanceBuffer, m_InstanceBufferMemory);
+            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            {
+                Utils::DestroyBuffer(m_CommandBuffers[i], m_CommandBuffersMemory[i]);
+                Utils::DestroyBuffer(m_CountBuffers[i], m_CountBuffersMemory[i]);
+            }
+        }
+
+        if (m_VisibilityBuffer != VK_NULL_HANDLE)
+        {
+            Utils::DestroyBuffer(m_VisibilityBuffer, m_VisibilityBufferMemory);
+            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            {
+                Utils::DestroyBuffer(m_OcclusionBuffers[i], m_OcclusionBuffersMemory[i]);
+            }
+        }
+        m_DepthPyramid.CleanUp();
+
+        m_ObjectBuffer = VK_NULL_HANDLE;
+        m_VisibilityBuffer = VK_NULL_HANDLE;
+        m_InstanceBuffer = VK_NULL_HANDLE;
+        m_Objects.clear();
+        m_Instances.clear();
+        m_Buckets.clear();
+        m_CPUEntities.clear();
+        m_ValidationPending.fill(false);
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "VertexBuffer.h"
+#include "DepthPyramid.h"
+#include "Model.h"
+#include "Utils/FrustumCulling.h"
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+
+namespace CHIKU
+{
+	class Scene;
+	class Material;
+	class IndexBuffer;
+	class GraphicsPipeline;
+	struct ComputeProgram;
+
+	//Frustum culling in compute for the opaque, instanceable part of a scene. Build uploads one object per entity and
+	//submesh (bounds, submesh range, bucket and InstanceData) once; each frame shader/cull.comp tests every object and
+	//appends the visible ones to their bucket's range of the frame's command buffer, counting them in the bucket's
+	//draw count. Draw records one vkCmdDrawIndexedIndirectCountKHR per bucket, so the CPU cost follows the number of
+	//buckets and not the number of objects.
+	//With occlusion culling the frame is drawn in two phases. shader/occlusion.comp first appends only the objects that
+	//were visible last frame; once those are drawn, DepthPyramid is built from their depth and every object is tested
+	//against it, the newly visible ones are drawn in a second pass and the visibility is kept for the next frame.
+	class GPUCulling
+	{
+	public:
+		//Needs VK_KHR_draw_indirect_count and drawIndirectFirstInstance
+		static bool IsSupported();
+		//Set by Renderer from the draw mode, see Renderer::Init
+		static void SetEnabled(bool enabled) { sm_Enabled = enabled; }
+		static bool IsEnabled() { return sm_Enabled; }
+		//Reads back every frame's counts once its fence has passed and compares them with a CPU reference.
+		//Enabled with CHIKU_VALIDATE_GPU_CULLING=1, costs a CPU pass over every object.
+		static void SetValidation(bool enabled) { sm_Validation = enabled; }
+		//On unless CHIKU_DISABLE_OCCLUSION_CULLING is set, see Renderer::Init
+		static void SetOcclusion(bool enabled) { sm_Occlusion = enabled; }
+
+		//Takes over the scene's entities whose draws are all opaque and instanceable and queues their instanced pipelines.
+		//The rest is listed in GetCPUEntities. Call again whenever the scene is loaded.
+		void Build(const Scene& scene, GraphicsPipeline& pipeline);
+		//Before the render pass, with the matrices the frame is drawn with
+		void Cull(const glm::mat4& viewProjection);
+		//Only when IsOcclusionActive, outside a render pass after Draw(pipeline, 0). Builds the depth pyramid from what
+		//the frame drew so far and appends the objects it does not hide that were not drawn yet.
+		void CullOcclusion(const glm::mat4& viewProjection);
+		//Inside the render pass, pass 1 draws what CullOcclusion added. Returns the number of draw calls recorded.
+		uint32_t Draw(GraphicsPipeline& pipeline, uint32_t pass = 0) const;
+		void CleanUp();
+
+		bool IsActive() const { return sm_Enabled && !m_Buckets.empty(); }
+		bool IsOcclusionActive() const { return IsActive() && sm_Occlusion && m_VisibilityBuffer != VK_NULL_HANDLE; }
+		const std::vector<uint32_t>& GetCPUEntities() const { return m_CPUEntities; }
+		uint32_t GetObjectCount() const { return static_cast<uint32_t>(m_Objects.size()); }
+		uint32_t GetBucketCount() const { return static_cast<uint32_t>(m_Buckets.size()); }
+
+		//One placed submesh of one entity Build takes over, Transform already includes the model instance's
+		struct CullSource
+		{
+			const Material* DrawMaterial;
+			const VertexBuffer* Vertices;
+			const IndexBuffer* Indices;
+			Submesh Range;
+			glm::mat4 Transform;
+		};
+
+		//std430 layout of CullObject in shader/cull.comp
+		struct CullObject
+		{
+			glm::vec4 Bounds; //Model space sphere, see Submesh::Bounds
+			uint32_t FirstIndex;
+			uint32_t IndexCount;
+			int32_t VertexOffset;
+			uint32_t Instance; //InstanceData the transform is read from, also the draw's firstInstance
+			uint32_t Bucket;
+			uint32_t BucketFirstCommand;
+			uint32_t Padding[2];
+		};
+
+		//One pipeline, material and set of GeometryPool buffers. Owns commands [FirstCommand, FirstCommand + ObjectCount).
+		struct Bucket
+		{
+			const Material* DrawMaterial;
+			const VertexBuffer* Vertices;
+			const IndexBuffer* Indices;
+			uint32_t FirstCommand;
+			uint32_t ObjectCount;
+		};
+
+		//The CPU side of Build, no GPU work. Sorts the sources into buckets in the RenderQueue's opaque order and lays
+		//out one object and one instance per source.
+		static void BuildObjects(std::vector<CullSource>& sources, std::vector<CullObject>& objects, std::vector<InstanceData>& instances,
+			std::vector<Bucket>& buckets);
+		//What cull.comp should count per bucket under the planes. Objects within a small tolerance of a plane may go either
+		//way on the GPU, so each bucket gets the lowest and highest count it may report.
+		static void CullReference(const std::vector<CullObject>& objects, const std::vector<InstanceData>& instances, uint32_t bucketCount,
+			const Utils::FrustumPlanes& planes, std::vector<uint32_t>& minimum, std::vector<uint32_t>& maximum);
+
+	private:
+		void Dispatch(const ComputeProgram& program, const Utils::FrustumPlanes& planes, bool occlusion, uint32_t phase) const;
+		void Validate(uint32_t frame) const;
+
+	private:
+		std::vector<CullObject> m_Objects;
+		std::vector<InstanceData> m_Instances; //Kept on the CPU for validation only
+		std::vector<Bucket> m_Buckets;
+		std::vector<uint32_t> m_CPUEntities;
+
+		VkBuffer m_ObjectBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_ObjectBufferMemory = VK_NULL_HANDLE;
+		VkBuffer m_InstanceBuffer = VK_NULL_HANDLE; //Vertex stream at VertexBuffer::INSTANCE_BINDING and storage for the cull pass
+		VkDeviceMemory m_InstanceBufferMemory = VK_NULL_HANDLE;
+		//Two halves of one command per object and one count per bucket, the second one for pass 1
+		std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_CommandBuffers{};
+		std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_CommandBuffersMemory{};
+		std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_CountBuffers{}; //One draw count per bucket, cleared by the CPU
+		std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_CountBuffersMemory{};
+		std::array<void*, MAX_FRAMES_IN_FLIGHT> m_CountBuffersMapped{};
+
+		DepthPyramid m_DepthPyramid;
+		VkBuffer m_VisibilityBuffer = VK_NULL_HANDLE; //One uint per object, written by the second phase for the next frame
+		VkDeviceMemory m_VisibilityBufferMemory = VK_NULL_HANDLE;
+		std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_OcclusionBuffers{}; //OcclusionData of occlusion.comp
+		std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_OcclusionBuffersMemory{};
+		std::array<void*, MAX_FRAMES_IN_FLIGHT> m_OcclusionBuffersMapped{};
+
+		std::array<Utils::FrustumPlanes, MAX_FRAMES_IN_FLIGHT> m_ValidationPlanes{};
+		std::array<bool, MAX_FRAMES_IN_FLIGHT> m_ValidationPending{};
+		std::array<bool, MAX_FRAMES_IN_FLIGHT> m_ValidationOcclusion{}; //Counts are split over both passes
+
+		static bool sm_Enabled;
+		static bool sm_Validation;
+		static bool sm_Occlusion;
+	};
+}
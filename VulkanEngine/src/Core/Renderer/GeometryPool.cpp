@@ -0,0 +1,98 @@
+#include "GeometryPool.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "Utils/BufferUtils.h"
+#include <algorithm>
+
+namespace CHIKU
+{
+    //First allocation of a pool, enough for a few mid-sized meshes before the first doubling
+    static constexpr VkDeviceSize INITIAL_VERTEX_BYTES = 4ull * 1024 * 1024;
+    static constexpr uint32_t INITIAL_INDEX_COUNT = 1024 * 1024;
+
+    std::map<VertexLayoutPreset, std::unique_ptr<GeometryPool::Pool>> GeometryPool::sm_Pools;
+
+    GeometryPool::Range GeometryPool::Add(const VertexBuffer& vertices, const IndexBuffer& indices)
+    {
+        VertexLayoutPreset layout = vertices.GetBufferLayout();
+        std::unique_ptr<Pool>& slot = sm_Pools[layout];
+        if (!slot)
+        {
+            slot = std::make_unique<Pool>();
+            slot->Vertices.SetLayout(layout);
+        }
+        Pool& pool = *slot;
+
+        VkDeviceSize vertexBytes = vertices.GetSize();
+        uint32_t indexCount = indices.GetCount();
+        if (pool.VertexBytesUsed + vertexBytes > pool.Vertices.GetSize() || pool.IndicesUsed + indexCount > pool.Indices.GetCount())
+        {
+            Grow(pool, layout, pool.VertexBytesUsed + vertexBytes, pool.IndicesUsed + indexCount);
+        }
+
+        VertexBufferLayout bufferLayout = VertexBuffer::GetVertexBufferLayout(layout);
+        Utils::FinalizeLayout(bufferLayout);
+
+        Range range;
+        range.Vertices = &pool.Vertices;
+        range.Indices = &pool.Indices;
+        range.VertexOffset = static_cast<int32_t>(pool.VertexBytesUsed / bufferLayout.Stride);
+        range.FirstIndex = pool.IndicesUsed;
+
+        Utils::CopyBuffer(vertices.GetHandle(), pool.Vertices.GetHandle(), vertexBytes, 0, pool.VertexBytesUsed);
+        Utils::CopyBuffer(indices.GetHandle(), pool.Indices.GetHandle(), sizeof(uint32_t) * VkDeviceSize(indexCount), 0, sizeof(uint32_t) * VkDeviceSize(pool.IndicesUsed));
+        pool.VertexBytesUsed += vertexBytes;
+        pool.IndicesUsed += indexCount;
+
+        return range;
+    }
+
+    void GeometryPool::Grow(Pool& pool, VertexLayoutPreset layout, VkDeviceSize vertexBytes, uint32_t indexCount)
+    {
+        VertexBuffer vertices;
+        vertices.SetLayout(layout);
+        vertices.CreateVertexBuffer(std::max({ vertexBytes, pool.Vertices.GetSize() * 2, INITIAL_VERTEX_BYTES }));
+
+        IndexBuffer indices;
+        indices.CreateIndexBuffer(std::max({ indexCount, pool.Indices.GetCount() * 2, INITIAL_INDEX_COUNT }));
+
+        if (pool.VertexBytesUsed > 0)
+        {
+            Utils::CopyBuffer(pool.Vertices.GetHandle(), vertices.GetHandle(), pool.VertexBytesUsed);
+        }
+        if (pool.IndicesUsed > 0)
+        {
+            Utils::CopyBuffer(pool.Indices.GetHandle(), indices.GetHandle(), sizeof(uint32_t) * VkDeviceSize(pool.IndicesUsed));
+        }
+
+        //Recorded frames may still read the old buffers
+        if (pool.Vertices.GetHandle() != VK_NULL_HANDLE)
+        {
+            vkDeviceWaitIdle(VulkanEngine::GetDevice());
+        }
+        pool.Vertices.CleanUp();
+        pool.Indices.CleanUp();
+
+        //Same objects, new handles, so ranges handed out earlier stay valid
+        pool.Vertices = vertices;
+        pool.Indices = indices;
+    }
+
+    void GeometryPool::Reset()
+    {
+        for (auto& [_, pool] : sm_Pools)
+        {
+            pool->VertexBytesUsed = 0;
+            pool->IndicesUsed = 0;
+        }
+    }
+
+    void GeometryPool::CleanUp()
+    {
+        for (auto& [_, pool] : sm_Pools)
+        {
+            pool->Vertices.CleanUp();
+            pool->Indices.CleanUp();
+        }
+        sm_Pools.clear();
+    }
+}
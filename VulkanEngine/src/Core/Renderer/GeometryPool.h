@@ -0,0 +1,45 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "VertexBuffer.h"
+#include "IndexBuffer.h"
+#include <map>
+#include <memory>
+
+namespace CHIKU
+{
+	//Vertex and index data of every loaded model, in one buffer pair per vertex layout. Draws of different meshes
+	//then bind the same buffers, so a whole pipeline/material bucket can go out as one indirect multi-draw.
+	class GeometryPool
+	{
+	public:
+		//Where a model's data landed. Add VertexOffset and FirstIndex to the model's own draw ranges.
+		struct Range
+		{
+			const VertexBuffer* Vertices = nullptr;
+			const IndexBuffer* Indices = nullptr;
+			int32_t VertexOffset = 0;
+			uint32_t FirstIndex = 0;
+		};
+
+		//Copies both buffers into the pool of the vertex buffer's layout; the caller may destroy them afterwards.
+		//A full pool grows by doubling, which waits for the device, so models are best added at load time.
+		static Range Add(const VertexBuffer& vertices, const IndexBuffer& indices);
+		//Forgets every range once all models using the pool were unloaded. The buffers are kept for the next ones.
+		static void Reset();
+		static void CleanUp();
+
+	private:
+		struct Pool
+		{
+			VertexBuffer Vertices;
+			IndexBuffer Indices;
+			VkDeviceSize VertexBytesUsed = 0;
+			uint32_t IndicesUsed = 0;
+		};
+
+		static void Grow(Pool& pool, VertexLayoutPreset layout, VkDeviceSize vertexBytes, uint32_t indexCount);
+
+	private:
+		static std::map<VertexLayoutPreset, std::unique_ptr<Pool>> sm_Pools; //unique_ptr keeps Range pointers stable
+	};
+}
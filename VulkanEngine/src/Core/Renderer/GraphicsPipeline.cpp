@@ -1,167 +1,765 @@
 #include "GraphicsPipeline.h"
+#include "TextureTable.h"
 #include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
 #include "Utils/BufferUtils.h"
 #include "Shader.h"
 #include <chrono>
 #include <array>
 #include "UniformBuffer.h"
+#include "PipelineCache.h"
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <json.hpp>
+#include <map>
+#include <set>
+#include <bitset>
 
 namespace CHIKU
 {
-    std::unordered_map<PipelineKey, GraphicsPipeline::Pipeline> GraphicsPipeline::sm_GrphicsPipeline;
+    //Keys seen by earlier runs, compiled ahead of the first frame so their first draw never waits
+    static const std::string PIPELINE_MANIFEST_PATH = "shader/cache/pipelines.json";
+    //Pipelines per program after which a warning is printed, every feature doubles the worst case
+    static constexpr uint32_t PERMUTATION_WARNING_THRESHOLD = 32;
+
+    std::vector<std::unique_ptr<GraphicsPipeline::PipelineEntry>> GraphicsPipeline::sm_GrphicsPipeline;
+    std::vector<GraphicsPipeline::PipelineSlot> GraphicsPipeline::sm_PipelineSlots;
+    Utils::JobGroup GraphicsPipeline::sm_PendingCompiles;
+    Utils::JobGroup GraphicsPipeline::sm_PendingOptimizations;
+    std::vector<GraphicsPipeline::PipelineEntry*> GraphicsPipeline::sm_Optimizing;
+    std::vector<GraphicsPipeline::RetiredPipeline> GraphicsPipeline::sm_RetiredPipelines;
+    std::vector<GraphicsPipeline::Replacement> GraphicsPipeline::sm_Replacements;
+    std::vector<GraphicsPipeline::RetiredEntry> GraphicsPipeline::sm_RetiredEntries;
+    PipelineFallback GraphicsPipeline::sm_Fallback = PipelineFallback::UseFallback;
+    bool GraphicsPipeline::sm_ManifestDirty = false;
+    uint32_t GraphicsPipeline::sm_BenchmarkIterations = 0;
 
 	void GraphicsPipeline::Init()
 	{
+        if (const char* iterations = std::getenv("CHIKU_BENCHMARK_PIPELINES"))
+        {
+            sm_BenchmarkIterations = static_cast<uint32_t>(std::max(1, std::atoi(iterations)));
+        }
+
+        PipelineLibrary::Init();
 	}
 
-    void GraphicsPipeline::Bind(const Material& material, const VertexBuffer& vertexbuffer)
+    void GraphicsPipeline::Update()
     {
-        PipelineKey key = {
-           material.GetShaderID(),
-           vertexbuffer.GetBufferLayout(),
-           material.GetMaterialType()
-        };
+        for (size_t i = 0; i < sm_RetiredPipelines.size();)
+        {
+            if (--sm_RetiredPipelines[i].FramesLeft == 0)
+            {
+                vkDestroyPipeline(VulkanEngine::GetDevice(), sm_RetiredPipelines[i].Handle, nullptr);
+                sm_RetiredPipelines[i] = sm_RetiredPipelines.back();
+                sm_RetiredPipelines.pop_back();
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        for (size_t i = 0; i < sm_RetiredEntries.size();)
+        {
+            RetiredEntry& retired = sm_RetiredEntries[i];
+            if (retired.FramesLeft > 0)
+            {
+                retired.FramesLeft--;
+            }
+
+            if (retired.FramesLeft == 0 && retired.Entry->OptimizedReady.load(std::memory_order_acquire))
+            {
+                DestroyEntry(*retired.Entry);
+                sm_RetiredEntries[i] = std::move(sm_RetiredEntries.back());
+                sm_RetiredEntries.pop_back();
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        for (size_t i = 0; i < sm_Replacements.size();)
+        {
+            Replacement& replacement = sm_Replacements[i];
+            if (!replacement.Entry->Ready.load(std::memory_order_acquire))
+            {
+                i++;
+                continue;
+            }
 
-        GetOrCreateGraphicsPipeline(key, material, vertexbuffer);
+            std::unique_ptr<PipelineEntry> retired = std::move(replacement.Entry);
+            if (retired->Failed)
+            {
+                std::cerr << "Keeping the previous pipeline for " << ShaderManager::GetInternedID(retired->Key.shaderID) << std::endl;
+            }
+            else
+            {
+                //Same key, so only the owner and the slot pointing at it change
+                auto live = std::find_if(sm_GrphicsPipeline.begin(), sm_GrphicsPipeline.end(),
+                    [&replacement](const std::unique_ptr<PipelineEntry>& entry) { return entry.get() == replacement.Target; });
+                std::swap(*live, retired);
+                for (auto& slot : sm_PipelineSlots)
+                {
+                    if (slot.Entry == replacement.Target)
+                    {
+                        slot.Entry = live->get();
+                        break;
+                    }
+                }
+            }
+            Retire(std::move(retired));
 
-        UniformBuffer::Update();
-        UniformBuffer::Bind(sm_GrphicsPipeline.at(key).PipelineLayout);
-        vkCmdBindPipeline(VulkanEngine::GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, sm_GrphicsPipeline.at(key).GraphicsPipeline);
+            sm_Replacements[i] = std::move(sm_Replacements.back());
+            sm_Replacements.pop_back();
+        }
+
+        for (size_t i = 0; i < sm_Optimizing.size();)
+        {
+            PipelineEntry* entry = sm_Optimizing[i];
+            if (!entry->OptimizedReady.load(std::memory_order_acquire))
+            {
+                i++;
+                continue;
+            }
+
+            if (entry->Optimized != VK_NULL_HANDLE)
+            {
+                //Command buffers of the frames in flight may still reference the fast-linked pipeline
+                sm_RetiredPipelines.push_back({ entry->Handles.GraphicsPipeline, MAX_FRAMES_IN_FLIGHT });
+                entry->Handles.GraphicsPipeline = entry->Optimized;
+                entry->Optimized = VK_NULL_HANDLE;
+            }
+
+            sm_Optimizing[i] = sm_Optimizing.back();
+            sm_Optimizing.pop_back();
+        }
+
+        PipelineLibrary::Update();
+    }
+
+    bool GraphicsPipeline::Bind(const Material& material, const VertexBuffer& vertexbuffer, const glm::mat4& transform)
+    {
+        BoundPipeline bound = BindPipeline(material, vertexbuffer.GetBufferLayout());
+        if (bound.Layout == VK_NULL_HANDLE)
+        {
+            return false;
+        }
 
-        material.Bind(sm_GrphicsPipeline.at(key).PipelineLayout);
+        UniformBuffer::Bind(bound.Layout, transform, material.GetBaseColor());
+        material.Bind(bound.Layout, bound.UsesTextureTable);
         vertexbuffer.Bind();
+        return true;
+    }
+
+    uint32_t GraphicsPipeline::GetPipelineIndex(const Material& material, VertexLayoutPreset inputDescription)
+    {
+        return GetOrCreateGraphicsPipeline(PipelineKey::Create(material, inputDescription))->Index;
+    }
+
+    GraphicsPipeline::BoundPipeline GraphicsPipeline::BindPipeline(const Material& material, VertexLayoutPreset inputDescription)
+    {
+        const PipelineEntry* entry = GetOrCreateGraphicsPipeline(PipelineKey::Create(material, inputDescription));
+
+        if (!entry->Ready.load(std::memory_order_acquire))
+        {
+            if (sm_Fallback == PipelineFallback::Block)
+            {
+                sm_PendingCompiles.Wait();
+            }
+            else
+            {
+                const PipelineEntry* fallback = nullptr;
+                if (sm_Fallback == PipelineFallback::UseFallback)
+                {
+                    for (const auto& i : sm_GrphicsPipeline)
+                    {
+                        if (i->Key.inputDescription == entry->Key.inputDescription && i->Ready.load(std::memory_order_acquire) && !i->Failed)
+                        {
+                            fallback = i.get();
+                            break;
+                        }
+                    }
+                }
+
+                if (!fallback)
+                {
+                    return {};
+                }
+                entry = fallback;
+            }
+        }
+
+        if (entry->Failed)
+        {
+            return {};
+        }
+
+        CommandRecorder::BindPipeline(entry->Handles.GraphicsPipeline);
+        return { entry->Handles.PipelineLayout, entry->UsesTextureTable };
     }
 
     void GraphicsPipeline::CleanUp()
     {
-        for (auto i : sm_GrphicsPipeline)
+        sm_PendingCompiles.Wait();
+        sm_PendingOptimizations.Wait();
+
+        uint32_t createdPipelines = 0;
+        uint32_t linkedPipelines = 0;
+        double creationMilliseconds = 0.0;
+        double optimizeMilliseconds = 0.0;
+        for (const auto& i : sm_GrphicsPipeline)
+        {
+            if (!i->Failed)
+            {
+                createdPipelines++;
+                creationMilliseconds += i->CreationMilliseconds;
+            }
+            if (i->Linked)
+            {
+                linkedPipelines++;
+                optimizeMilliseconds += i->OptimizeMilliseconds;
+            }
+        }
+
+        if (createdPipelines > 0)
+        {
+            std::cout << "Created " << createdPipelines << " pipelines in " << creationMilliseconds << " ms of worker time ("
+                << (PipelineCache::WasLoadedFromDisk() ? "warm" : "cold") << " pipeline cache)" << std::endl;
+        }
+        if (linkedPipelines > 0)
+        {
+            std::cout << linkedPipelines << " of them fast-linked from " << PipelineLibrary::GetLibraryCount(PipelineLibrary::VertexInput) << " vertex input, "
+                << PipelineLibrary::GetLibraryCount(PipelineLibrary::PreRasterization) << " pre-rasterization, "
+                << PipelineLibrary::GetLibraryCount(PipelineLibrary::FragmentShader) << " fragment shader and "
+                << PipelineLibrary::GetLibraryCount(PipelineLibrary::FragmentOutput) << " fragment output libraries, optimized links took "
+                << optimizeMilliseconds << " ms" << std::endl;
+        }
+
+        ReportPermutations();
+
+        if (sm_ManifestDirty)
         {
-            vkDestroyPipeline(VulkanEngine::GetDevice(), i.second.GraphicsPipeline, nullptr);
-            vkDestroyPipelineLayout(VulkanEngine::GetDevice(), i.second.PipelineLayout, nullptr);
+            SaveManifest();
+        }
+
+        for (const auto& i : sm_GrphicsPipeline)
+        {
+            DestroyEntry(*i);
+        }
+        for (const auto& replacement : sm_Replacements)
+        {
+            DestroyEntry(*replacement.Entry);
+        }
+        for (const auto& retired : sm_RetiredEntries)
+        {
+            DestroyEntry(*retired.Entry);
+        }
+        for (const auto& retired : sm_RetiredPipelines)
+        {
+            vkDestroyPipeline(VulkanEngine::GetDevice(), retired.Handle, nullptr);
         }
 
         sm_GrphicsPipeline.clear();
+        sm_PipelineSlots.clear();
+        sm_Optimizing.clear();
+        sm_RetiredPipelines.clear();
+        sm_Replacements.clear();
+        sm_RetiredEntries.clear();
+        PipelineLibrary::CleanUp();
     }
 
-    GraphicsPipeline::Pipeline GraphicsPipeline::GetOrCreateGraphicsPipeline(PipelineKey key, const Material& material, const VertexBuffer& vertexBuffer)
+    //The manifest is a plain file that may be edited or left over from another build, so every field is checked
+    //before it becomes part of a key. Enums must be in range, a stray value would reach vkCreateGraphicsPipelines.
+    static bool ReadManifestRecord(const nlohmann::json& record, std::string& shaderID, uint32_t& features, RenderState& state,
+        VertexLayoutPreset& layout, MaterialPresets& material, std::string& error)
     {
-        if (sm_GrphicsPipeline.find(key) == sm_GrphicsPipeline.end())
+        auto isUnsigned32 = [](const nlohmann::json& value)
+            {
+                return value.is_number_unsigned() && value.get<uint64_t>() <= UINT32_MAX;
+            };
+
+        if (!record.is_object())
+        {
+            error = "not an object";
+            return false;
+        }
+        if (!record.contains("shader") || !record["shader"].is_string())
         {
-            sm_GrphicsPipeline[key] = CreateGraphicsPipeline(
-                ShaderManager::GetShaderStages(material.GetShaderID()).data(),
-                vertexBuffer.GetBufferDescription(),
-                UniformBuffer::GetDescriptorSetLayout(GenericUniformBuffers::MVP)
-            );
+            error = "\"shader\" is missing or not a string";
+            return false;
+        }
+        if (!record.contains("layout") || !isUnsigned32(record["layout"]) ||
+            record["layout"].get<uint32_t>() > static_cast<uint32_t>(VertexLayoutPreset::InstancedUnLitMesh))
+        {
+            error = "\"layout\" is missing or not a vertex layout";
+            return false;
+        }
+        if (!record.contains("material") || !isUnsigned32(record["material"]) || record["material"].get<uint32_t>() > MaterialPresets::Unlit)
+        {
+            error = "\"material\" is missing or not a material preset";
+            return false;
+        }
+        if (record.contains("features") && !isUnsigned32(record["features"]))
+        {
+            error = "\"features\" is not a 32 bit mask";
+            return false;
+        }
+        if (record.contains("state") && !isUnsigned32(record["state"]))
+        {
+            error = "\"state\" is not a packed render state";
+            return false;
+        }
+
+        state = RenderState::Unpack(record.value("state", RenderState().Pack()));
+        if (state.Topology > VK_PRIMITIVE_TOPOLOGY_PATCH_LIST || state.PolygonMode > VK_POLYGON_MODE_POINT ||
+            state.Blend > static_cast<uint32_t>(BlendMode::Additive) || state.Unused != 0)
+        {
+            error = "\"state\" holds an out of range field";
+            return false;
         }
 
-        return sm_GrphicsPipeline.at(key);
+        shaderID = record["shader"].get<std::string>();
+        features = record.value("features", 0u);
+        layout = static_cast<VertexLayoutPreset>(record["layout"].get<uint32_t>());
+        material = static_cast<MaterialPresets>(record["material"].get<uint32_t>());
+        return true;
     }
 
-    GraphicsPipeline::Pipeline GraphicsPipeline::CreateGraphicsPipeline(const VkPipelineShaderStageCreateInfo* pipelineStages, VertexBuffer::VertexInputDescription description, VkDescriptorSetLayout layout)
-	{
-        VkPipelineLayout pipelineLayout;
-        VkPipeline graphicsPipeline;
+    void GraphicsPipeline::Prewarm()
+    {
+        std::ifstream file(SOURCE_DIR + PIPELINE_MANIFEST_PATH);
+        if (!file.is_open())
+        {
+            return;
+        }
 
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.AttributeDescription.size());
-        vertexInputInfo.pVertexBindingDescriptions = &description.BindingDescription;
-        vertexInputInfo.pVertexAttributeDescriptions = description.AttributeDescription.data();
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-        VkPipelineViewportStateCreateInfo viewportState{};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.scissorCount = 1;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_NONE;
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-        rasterizer.depthBiasEnable = VK_FALSE;
-
-        VkPipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-
-        VkPipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-        colorBlending.blendConstants[0] = 0.0f;
-        colorBlending.blendConstants[1] = 0.0f;
-        colorBlending.blendConstants[2] = 0.0f;
-        colorBlending.blendConstants[3] = 0.0f;
-
-        std::vector<VkDynamicState> dynamicStates = {
-            VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_SCISSOR
-        };
+        nlohmann::json manifest = nlohmann::json::parse(file, nullptr, false);
+        if (!manifest.is_array())
+        {
+            std::cerr << "Ignoring malformed pipeline manifest " << PIPELINE_MANIFEST_PATH << std::endl;
+            return;
+        }
+
+        for (size_t i = 0; i < manifest.size(); i++)
+        {
+            std::string shaderID;
+            uint32_t features = 0;
+            RenderState state;
+            VertexLayoutPreset layout;
+            MaterialPresets material;
+            std::string error;
+            if (!ReadManifestRecord(manifest[i], shaderID, features, state, layout, material, error))
+            {
+                std::cerr << "Skipping pipeline manifest record " << i << ": " << error << std::endl;
+                continue;
+            }
+
+            PipelineKey key;
+            key.shaderID = ShaderManager::InternID(shaderID);
+            key.features = features & ShaderManager::GetSupportedFeatures(shaderID);
+            key.renderState = state;
+            key.inputDescription = layout;
+            key.materialPreset = material;
+            key.ComputeHash();
+
+            if (!FindPipeline(key))
+            {
+                QueueCompile(key);
+            }
+        }
+
+        //Keys read back from the manifest do not need to be written again
+        sm_ManifestDirty = false;
+    }
+
+    const GraphicsPipeline::PipelineEntry* GraphicsPipeline::GetOrCreateGraphicsPipeline(const PipelineKey& key)
+    {
+        PipelineEntry* entry = FindPipeline(key);
+        if (!entry)
+        {
+            QueueCompile(key);
+            sm_ManifestDirty = true;
+            entry = sm_GrphicsPipeline.back().get();
+        }
+
+        return entry;
+    }
+
+    GraphicsPipeline::PipelineEntry* GraphicsPipeline::FindPipeline(const PipelineKey& key)
+    {
+        if (sm_PipelineSlots.empty())
+        {
+            return nullptr;
+        }
 
-        VkPipelineDynamicStateCreateInfo dynamicState{};
-        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-        dynamicState.pDynamicStates = dynamicStates.data();
+        size_t mask = sm_PipelineSlots.size() - 1;
+        for (size_t i = static_cast<size_t>(key.hash) & mask;; i = (i + 1) & mask)
+        {
+            const PipelineSlot& slot = sm_PipelineSlots[i];
+            if (!slot.Entry)
+            {
+                return nullptr;
+            }
+            if (slot.Hash == key.hash && slot.Entry->Key == key)
+            {
+                return slot.Entry;
+            }
+        }
+    }
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
+    void GraphicsPipeline::InsertSlot(PipelineEntry* entry)
+    {
+        size_t mask = sm_PipelineSlots.size() - 1;
+        size_t i = static_cast<size_t>(entry->Key.hash) & mask;
+        while (sm_PipelineSlots[i].Entry)
+        {
+            i = (i + 1) & mask;
+        }
+        sm_PipelineSlots[i] = { entry->Key.hash, entry };
+    }
 
-        pipelineLayoutInfo.pSetLayouts = &layout;
+    void GraphicsPipeline::QueueCompile(const PipelineKey& key)
+    {
+        sm_GrphicsPipeline.push_back(std::make_unique<PipelineEntry>());
+        PipelineEntry* entry = sm_GrphicsPipeline.back().get();
+        entry->Key = key;
+        entry->Index = static_cast<uint32_t>(sm_GrphicsPipeline.size() - 1);
 
-        if (vkCreatePipelineLayout(VulkanEngine::GetDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        //Only new keys reach this point, so growing here keeps Bind free of allocations
+        if (sm_GrphicsPipeline.size() * 2 > sm_PipelineSlots.size())
+        {
+            sm_PipelineSlots.assign(std::max<size_t>(64, sm_PipelineSlots.size() * 2), PipelineSlot{});
+            for (const auto& i : sm_GrphicsPipeline)
+            {
+                InsertSlot(i.get());
+            }
+        }
+        else
         {
-            throw std::runtime_error("failed to create pipeline layout!");
+            InsertSlot(entry);
         }
 
-        VkPipelineDepthStencilStateCreateInfo depthStencil{};
-        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-        depthStencil.depthTestEnable = VK_TRUE;
-        depthStencil.depthWriteEnable = VK_TRUE;
-        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-        depthStencil.depthBoundsTestEnable = VK_FALSE;
-        depthStencil.minDepthBounds = 0.0f; // Optional
-        depthStencil.maxDepthBounds = 1.0f; // Optional
-        depthStencil.stencilTestEnable = VK_FALSE;
-        depthStencil.front = {}; // Optional
-        depthStencil.back = {}; // Optional
+        uint32_t permutations = 0;
+        for (const auto& i : sm_GrphicsPipeline)
+        {
+            permutations += i->Key.shaderID == key.shaderID;
+        }
+        if (permutations == PERMUTATION_WARNING_THRESHOLD)
+        {
+            std::cerr << "Warning: " << ShaderManager::GetInternedID(key.shaderID) << " reached " << permutations << " pipeline permutations" << std::endl;
+        }
+
+        Compile(entry);
+    }
+
+    void GraphicsPipeline::Compile(PipelineEntry* entry)
+    {
+        const PipelineKey& key = entry->Key;
+        const std::string shaderID = ShaderManager::GetInternedID(key.shaderID);
+
+        //Everything the worker needs is resolved here, the shader and vertex registries are only touched on the main thread
+        std::vector<VkPipelineShaderStageCreateInfo> stages;
+        VertexBuffer::VertexInputDescription description;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        try
+        {
+            stages = ShaderManager::GetShaderStages(shaderID, key.features);
+            if (stages.empty() || stages[0].stage == VK_SHADER_STAGE_COMPUTE_BIT)
+            {
+                throw std::runtime_error("not a graphics program");
+            }
+            layout = ShaderManager::GetPipelineLayout(shaderID, key.features);
+            if (!VertexBuffer::BuildInputDescription(key.inputDescription, ShaderManager::GetShaderLayout(shaderID, key.features).VertexInputs, description))
+            {
+                throw std::runtime_error("vertex layout does not match the shader inputs");
+            }
+            //E.g. an offline build that fell back to the prebuilt SPIR-V without the instancing define
+            if (VertexBuffer::IsInstancedLayout(key.inputDescription) && std::none_of(description.AttributeDescription.begin(), description.AttributeDescription.end(),
+                [](const VkVertexInputAttributeDescription& attribute) { return attribute.binding == VertexBuffer::INSTANCE_BINDING; }))
+            {
+                throw std::runtime_error("program does not read the instance stream");
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Cannot create pipeline for " << shaderID << ": " << e.what() << std::endl;
+            entry->Failed = true;
+            entry->OptimizedReady.store(true, std::memory_order_release);
+            entry->Ready.store(true, std::memory_order_release);
+            return;
+        }
+
+        //Both layouts come from DescriptorLayoutCache, so equal bindings give the same handle
+        if (ShaderManager::GetSetLayout(shaderID, 0, key.features) != UniformBuffer::GetDescriptorSetLayout(GenericUniformBuffers::MVP))
+        {
+            std::cerr << "Warning: set 0 of " << shaderID << " does not match the per-draw uniform layout" << std::endl;
+        }
+
+        //Checked on the program rather than the feature bit, an offline build loads the prebuilt SPIR-V for define variants
+        entry->UsesTextureTable = TextureTable::IsEnabled() && ShaderManager::GetSetLayout(shaderID, TextureTable::SET, key.features) == TextureTable::GetSetLayout();
+
+        //Constant features are baked in at pipeline creation, so disabled branches never reach the GPU
+        auto specialization = std::make_shared<Specialization>();
+        ShaderManager::GetSpecialization(shaderID, key.features, specialization->Entries, specialization->Values);
+        specialization->Info.mapEntryCount = static_cast<uint32_t>(specialization->Entries.size());
+        specialization->Info.pMapEntries = specialization->Entries.data();
+        specialization->Info.dataSize = specialization->Values.size() * sizeof(VkBool32);
+        specialization->Info.pData = specialization->Values.data();
+        if (!specialization->Entries.empty())
+        {
+            for (auto& stage : stages)
+            {
+                stage.pSpecializationInfo = &specialization->Info;
+            }
+        }
+
+        if (sm_BenchmarkIterations > 0)
+        {
+            BenchmarkCreation(stages, description, layout, key.renderState, sm_BenchmarkIterations);
+            sm_BenchmarkIterations = 0;
+        }
+
+        //Parts are looked up here, the library map is only touched on the main thread
+        bool useLibraries = PipelineLibrary::IsEnabled();
+        PipelineLibrary::LibrarySet libraries{};
+        if (useLibraries)
+        {
+            libraries = PipelineLibrary::Acquire(stages, key.inputDescription, layout, key.features, key.renderState);
+            sm_Optimizing.push_back(entry);
+        }
+
+        Utils::JobSystem::Submit([this, entry, stages = std::move(stages), specialization, description = std::move(description), layout, state = key.renderState, shaderID, useLibraries, libraries]()
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                try
+                {
+                    if (useLibraries && PipelineLibrary::BuildParts(libraries, stages, description, layout, state, PipelineCache::Get()))
+                    {
+                        try
+                        {
+                            entry->Handles = { layout, PipelineLibrary::Link(libraries, layout, false, PipelineCache::Get()) };
+                            entry->Linked = true;
+                        }
+                        catch (const std::exception& e)
+                        {
+                            std::cerr << "Cannot link pipeline for " << shaderID << ", compiling it whole: " << e.what() << std::endl;
+                        }
+                    }
+                    if (!entry->Linked)
+                    {
+                        entry->Handles = CreateGraphicsPipeline(stages, description, layout, state, PipelineCache::Get());
+                    }
+                    PipelineCache::MarkDirty();
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << "Cannot create pipeline for " << shaderID << ": " << e.what() << std::endl;
+                    entry->Failed = true;
+                }
+                entry->CreationMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                entry->Ready.store(true, std::memory_order_release);
+
+                if (!entry->Linked)
+                {
+                    if (useLibraries)
+                    {
+                        PipelineLibrary::Release(libraries);
+                    }
+                    entry->OptimizedReady.store(true, std::memory_order_release);
+                    return;
+                }
+
+                //The fast link is already drawing, the optimized one replaces it when done
+                Utils::JobSystem::Submit([entry, layout, libraries, shaderID]()
+                    {
+                        auto optimizeStart = std::chrono::high_resolution_clock::now();
+                        try
+                        {
+                            entry->Optimized = PipelineLibrary::Link(libraries, layout, true, PipelineCache::Get());
+                            PipelineCache::MarkDirty();
+                        }
+                        catch (const std::exception& e)
+                        {
+                            std::cerr << "Cannot optimize pipeline for " << shaderID << ", keeping the fast link: " << e.what() << std::endl;
+                        }
+                        entry->OptimizeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - optimizeStart).count();
+                        PipelineLibrary::Release(libraries);
+                        entry->OptimizedReady.store(true, std::memory_order_release);
+                    }, &sm_PendingOptimizations);
+            }, &sm_PendingCompiles);
+    }
+
+    void GraphicsPipeline::Reload(const std::string& shaderID)
+    {
+        uint32_t shaderHandle = ShaderManager::InternID(shaderID);
+
+        //Replacements from an earlier edit that were not swapped in yet hold outdated code
+        for (size_t i = 0; i < sm_Replacements.size();)
+        {
+            if (sm_Replacements[i].Entry->Key.shaderID != shaderHandle)
+            {
+                i++;
+                continue;
+            }
+
+            Retire(std::move(sm_Replacements[i].Entry));
+            sm_Replacements[i] = std::move(sm_Replacements.back());
+            sm_Replacements.pop_back();
+        }
+
+        for (const auto& live : sm_GrphicsPipeline)
+        {
+            if (live->Key.shaderID != shaderHandle)
+            {
+                continue;
+            }
+
+            auto entry = std::make_unique<PipelineEntry>();
+            entry->Key = live->Key;
+            entry->Index = live->Index;
+            Compile(entry.get());
+            sm_Replacements.push_back({ live.get(), std::move(entry) });
+        }
+    }
+
+    void GraphicsPipeline::Retire(std::unique_ptr<PipelineEntry> entry)
+    {
+        //The entry destroys its own optimized link, whenever that finishes
+        sm_Optimizing.erase(std::remove(sm_Optimizing.begin(), sm_Optimizing.end(), entry.get()), sm_Optimizing.end());
+        sm_RetiredEntries.push_back({ std::move(entry), MAX_FRAMES_IN_FLIGHT });
+    }
+
+    void GraphicsPipeline::DestroyEntry(PipelineEntry& entry)
+    {
+        if (entry.Handles.GraphicsPipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(VulkanEngine::GetDevice(), entry.Handles.GraphicsPipeline, nullptr);
+        }
+        if (entry.Optimized != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(VulkanEngine::GetDevice(), entry.Optimized, nullptr);
+        }
+    }
+
+    void GraphicsPipeline::ReportPermutations() const
+    {
+        std::map<std::string, std::set<uint32_t>> permutations;
+        for (const auto& i : sm_GrphicsPipeline)
+        {
+            permutations[ShaderManager::GetInternedID(i->Key.shaderID)].insert(i->Key.features);
+        }
+
+        for (const auto& [shaderID, features] : permutations)
+        {
+            uint32_t supported = ShaderManager::GetSupportedFeatures(shaderID);
+            size_t possible = size_t(1) << std::bitset<32>(supported).count();
+            std::cout << shaderID << ": " << features.size() << " of " << possible << " feature permutations used, "
+                << ShaderManager::GetVariantCount(shaderID) << " SPIR-V variants" << std::endl;
+        }
+    }
+
+    void GraphicsPipeline::SaveManifest() const
+    {
+        nlohmann::json manifest = nlohmann::json::array();
+        for (const auto& i : sm_GrphicsPipeline)
+        {
+            if (i->Failed)
+            {
+                continue;
+            }
+
+            manifest.push_back({
+                { "shader", ShaderManager::GetInternedID(i->Key.shaderID) },
+                { "layout", static_cast<int>(i->Key.inputDescription) },
+                { "material", static_cast<int>(i->Key.materialPreset) },
+                { "features", i->Key.features },
+                { "state", i->Key.renderState.Pack() }
+            });
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(SOURCE_DIR + PIPELINE_MANIFEST_PATH).parent_path(), error);
+
+        std::ofstream file(SOURCE_DIR + PIPELINE_MANIFEST_PATH, std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to write pipeline manifest " << PIPELINE_MANIFEST_PATH << std::endl;
+            return;
+        }
+        file << manifest.dump(4);
+    }
+
+    void GraphicsPipeline::BenchmarkCreation(const std::vector<VkPipelineShaderStageCreateInfo>& pipelineStages, const VertexBuffer::VertexInputDescription& description, VkPipelineLayout layout, RenderState state, uint32_t iterations)
+    {
+        VkDevice device = VulkanEngine::GetDevice();
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+        auto timeCreation = [&](VkPipelineCache cache) -> double
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                Pipeline pipeline = CreateGraphicsPipeline(pipelineStages, description, layout, state, cache);
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+                vkDestroyPipeline(device, pipeline.GraphicsPipeline, nullptr);
+                return milliseconds;
+            };
+
+        double cold = 0.0;
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            VkPipelineCache emptyCache;
+            vkCreatePipelineCache(device, &cacheInfo, nullptr, &emptyCache);
+            cold += timeCreation(emptyCache);
+            vkDestroyPipelineCache(device, emptyCache, nullptr);
+        }
+
+        VkPipelineCache primedCache;
+        vkCreatePipelineCache(device, &cacheInfo, nullptr, &primedCache);
+        timeCreation(primedCache);
+
+        double warm = 0.0;
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            warm += timeCreation(primedCache);
+        }
+        vkDestroyPipelineCache(device, primedCache, nullptr);
+
+        //Drivers with their own on-disk shader cache make the cold number optimistic
+        std::cout << "Pipeline creation over " << iterations << " iterations: cold " << cold / iterations
+            << " ms, warm " << warm / iterations << " ms" << std::endl;
+    }
+
+    GraphicsPipeline::Pipeline GraphicsPipeline::CreateGraphicsPipeline(const std::vector<VkPipelineShaderStageCreateInfo>& pipelineStages, VertexBuffer::VertexInputDescription description, VkPipelineLayout pipelineLayout, RenderState state, VkPipelineCache cache)
+	{
+        VkPipeline graphicsPipeline;
+        PipelineStateInfo stateInfo(description, state);
 
         VkGraphicsPipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-
-        pipelineInfo.pStages = pipelineStages;
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.stageCount = static_cast<uint32_t>(pipelineStages.size());
+
+        pipelineInfo.pStages = pipelineStages.data();
+        pipelineInfo.pVertexInputState = &stateInfo.VertexInput;
+        pipelineInfo.pInputAssemblyState = &stateInfo.InputAssembly;
+        pipelineInfo.pViewportState = &stateInfo.Viewport;
+        pipelineInfo.pRasterizationState = &stateInfo.Rasterization;
+        pipelineInfo.pMultisampleState = &stateInfo.Multisample;
+        pipelineInfo.pColorBlendState = &stateInfo.ColorBlend;
+        pipelineInfo.pDynamicState = &stateInfo.Dynamic;
         pipelineInfo.layout = pipelineLayout;
         pipelineInfo.renderPass = VulkanEngine::GetRenderPass();
         pipelineInfo.subpass = 0;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pDepthStencilState = &stateInfo.DepthStencil;
 
-        if (vkCreateGraphicsPipelines(VulkanEngine::GetDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+        if (vkCreateGraphicsPipelines(VulkanEngine::GetDevice(), cache, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
@@ -3,44 +3,184 @@
 #include "Material.h"
 #include "VertexBuffer.h"
 #include "IndexBuffer.h"
+#include "RenderState.h"
+#include "PipelineLibrary.h"
+#include "Utils/JobSystem.h"
+#include "Utils/Hash.h"
 #include <vector>
 #include <functional>
+#include <memory>
+#include <atomic>
 	
 namespace CHIKU
 {
+	//Plain 32 byte key. The hash is built from the material's precomputed state hash, so making a key per draw
+	//costs a few integer operations and never allocates.
 	struct PipelineKey
 	{
-		std::string shaderID;
+		uint32_t shaderID; //Interned, see ShaderManager::InternID
+		uint32_t features; //ShaderFeatures bits, already masked to the ones the program supports
+		RenderState renderState;
 		VertexLayoutPreset inputDescription;
 		MaterialPresets materialPreset;
+		uint64_t hash;
+
+		static PipelineKey Create(const Material& material, VertexLayoutPreset inputDescription)
+		{
+			bool instanced = VertexBuffer::IsInstancedLayout(inputDescription);
+			return { material.GetShaderHandle(), material.GetPipelineFeatures(instanced), material.GetRenderState(),
+				inputDescription, material.GetMaterialType(), CombineLayout(material.GetStateHash(instanced), inputDescription) };
+		}
+
+		//For keys not made from a material, e.g. read back from the prewarm manifest
+		void ComputeHash()
+		{
+			hash = CombineLayout(HashMaterialState(shaderID, features, renderState, static_cast<uint32_t>(materialPreset)), inputDescription);
+		}
+
+		static uint64_t CombineLayout(uint64_t stateHash, VertexLayoutPreset inputDescription)
+		{
+			uint32_t layout = static_cast<uint32_t>(inputDescription);
+			return Utils::HashBytes(&layout, sizeof(layout), stateHash);
+		}
 
 		bool operator==(const PipelineKey& other) const
 		{
-			return shaderID == other.shaderID &&
+			return hash == other.hash &&
+				shaderID == other.shaderID &&
+				features == other.features &&
+				renderState == other.renderState &&
 				inputDescription == other.inputDescription &&
 				materialPreset == other.materialPreset;
 		}
 	};
 
+	//What Bind does while the pipeline for a key is still compiling on a worker
+	enum class PipelineFallback
+	{
+		Skip,        //Bind fails and the draw is dropped for this frame
+		UseFallback, //Any ready pipeline with the same vertex layout is bound instead, otherwise the draw is skipped
+		Block        //Wait for the compile, the old synchronous behaviour
+	};
+
 	class GraphicsPipeline
 	{
 	public:
 		void Init();
-		void Bind(const Material& material, const VertexBuffer& vertexbuffers);
+		//Once per frame after the frame's fence wait. Swaps in pipelines whose optimized link finished and destroys retired ones.
+		void Update();
+		//Returns false when no pipeline could be bound and the draw must be skipped
+		bool Bind(const Material& material, const VertexBuffer& vertexbuffers, const glm::mat4& transform = glm::mat4(1.0f));
+
+		//What a draw needs after BindPipeline. Layout is VK_NULL_HANDLE when nothing was bound and the draw must be skipped.
+		struct BoundPipeline
+		{
+			VkPipelineLayout Layout = VK_NULL_HANDLE;
+			bool UsesTextureTable = false;
+		};
+
+		//Binds only the pipeline, for callers like RenderQueue that bind the rest when it changes
+		BoundPipeline BindPipeline(const Material& material, VertexLayoutPreset inputDescription);
+		//Dense, stable ID of the pipeline a draw will use, queueing its compile if it is new
+		uint32_t GetPipelineIndex(const Material& material, VertexLayoutPreset inputDescription);
 		void CleanUp();
 
+		//Queues compiles for every key recorded in the prewarm manifest by earlier runs
+		void Prewarm();
+		//Recompiles every pipeline of a hot reloaded program on the workers. The current ones keep drawing until Update swaps the new ones in.
+		void Reload(const std::string& shaderID);
+		bool IsCompiling() const { return !sm_PendingCompiles.IsDone(); }
+		static void SetFallback(PipelineFallback fallback) { sm_Fallback = fallback; }
+
 	private:
 		struct Pipeline
 		{
-			VkPipelineLayout PipelineLayout;
+			VkPipelineLayout PipelineLayout; //Owned by DescriptorLayoutCache
 			VkPipeline GraphicsPipeline;
 		};
 
-		Pipeline GetOrCreateGraphicsPipeline(PipelineKey key, const Material& material, const VertexBuffer& vertexBuffer);
-		Pipeline CreateGraphicsPipeline(const VkPipelineShaderStageCreateInfo* pipelineStages, VertexBuffer::VertexInputDescription description, VkDescriptorSetLayout layout);
+		//Written once by the compile job, read by the main thread after Ready is set
+		struct PipelineEntry
+		{
+			PipelineKey Key;
+			uint32_t Index = 0; //Position in sm_GrphicsPipeline, kept by a reloaded replacement
+			Pipeline Handles{ VK_NULL_HANDLE, VK_NULL_HANDLE };
+			std::atomic<bool> Ready{ false };
+			bool Failed = false;
+			bool UsesTextureTable = false; //Reads textures from TextureTable by a pushed index instead of the per-draw set
+			double CreationMilliseconds = 0.0;
+
+			//Pipeline library path: Handles holds the fast link until the optimized link replaces it in Update
+			bool Linked = false;
+			VkPipeline Optimized = VK_NULL_HANDLE;
+			std::atomic<bool> OptimizedReady{ false }; //Also set when there is nothing to swap in
+			double OptimizeMilliseconds = 0.0;
+		};
+
+		//Replaced while frames in flight may still use it, destroyed once those frames have finished
+		struct RetiredPipeline
+		{
+			VkPipeline Handle;
+			uint32_t FramesLeft;
+		};
+
+		//A recompile of a live entry after a hot reload. Update moves Entry into Target's place once it is ready.
+		struct Replacement
+		{
+			PipelineEntry* Target;
+			std::unique_ptr<PipelineEntry> Entry;
+		};
+
+		//A whole entry taken out of the table. Destroyed with its pipelines once the frames in flight are done with it
+		//and its optimized link, which writes into it, has finished.
+		struct RetiredEntry
+		{
+			std::unique_ptr<PipelineEntry> Entry;
+			uint32_t FramesLeft;
+		};
+
+		//Kept alive by the compile job, the stage create infos point into it
+		struct Specialization
+		{
+			std::vector<VkSpecializationMapEntry> Entries;
+			std::vector<VkBool32> Values;
+			VkSpecializationInfo Info{};
+		};
+
+		//Open addressing with linear probing. Slots keep the hash so a probe only touches the entry on a hash match.
+		struct PipelineSlot
+		{
+			uint64_t Hash = 0;
+			PipelineEntry* Entry = nullptr;
+		};
+
+		const PipelineEntry* GetOrCreateGraphicsPipeline(const PipelineKey& key);
+		static PipelineEntry* FindPipeline(const PipelineKey& key);
+		static void InsertSlot(PipelineEntry* entry);
+		void QueueCompile(const PipelineKey& key);
+		void Compile(PipelineEntry* entry);
+		static void Retire(std::unique_ptr<PipelineEntry> entry);
+		static void DestroyEntry(PipelineEntry& entry);
+		void SaveManifest() const;
+		void ReportPermutations() const;
+		Pipeline CreateGraphicsPipeline(const std::vector<VkPipelineShaderStageCreateInfo>& pipelineStages, VertexBuffer::VertexInputDescription description, VkPipelineLayout layout, RenderState state, VkPipelineCache cache);
+
+		//Times pipeline creation against a fresh empty cache (cold) and a primed cache (warm). Enabled with CHIKU_BENCHMARK_PIPELINES=<iterations>.
+		void BenchmarkCreation(const std::vector<VkPipelineShaderStageCreateInfo>& pipelineStages, const VertexBuffer::VertexInputDescription& description, VkPipelineLayout layout, RenderState state, uint32_t iterations);
 
 	private:
-		static std::unordered_map<PipelineKey, Pipeline> sm_GrphicsPipeline;
+		static std::vector<std::unique_ptr<PipelineEntry>> sm_GrphicsPipeline; //Creation order
+		static std::vector<PipelineSlot> sm_PipelineSlots; //Power of two, at most half full
+		static Utils::JobGroup sm_PendingCompiles;
+		static Utils::JobGroup sm_PendingOptimizations; //Optimized links, kept apart so IsCompiling and Block only wait for the fast path
+		static std::vector<PipelineEntry*> sm_Optimizing; //Entries whose OptimizedReady Update still has to check
+		static std::vector<RetiredPipeline> sm_RetiredPipelines;
+		static std::vector<Replacement> sm_Replacements;
+		static std::vector<RetiredEntry> sm_RetiredEntries;
+		static PipelineFallback sm_Fallback;
+		static bool sm_ManifestDirty;
+
+		static uint32_t sm_BenchmarkIterations;
 	};
 }
 
@@ -63,23 +203,4 @@ namespace std
 			return static_cast<size_t>(preset);
 		}
 	};
-
-	template <>
-	struct hash<CHIKU::PipelineKey>
-	{
-		std::size_t operator()(const CHIKU::PipelineKey& key) const noexcept
-		{
-			std::size_t h = 0;
-
-			// hash_combine utility
-			auto hash_combine = [](std::size_t& seed, std::size_t val) {
-				seed ^= val + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-				};
-
-			hash_combine(h, std::hash<std::string>{}(key.shaderID));
-			hash_combine(h, std::hash<CHIKU::VertexLayoutPreset>{}(key.inputDescription));
-			hash_combine(h, std::hash<CHIKU::MaterialPresets>{}(key.materialPreset));
-			return h;
-		}
-	};
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "IndexBuffer.h"
 #include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
 #include "Utils/BufferUtils.h"
 
 namespace CHIKU
@@ -9,31 +10,35 @@ namespace CHIKU
         count = (uint32_t)indices.size();
         VkDeviceSize bufferSize = sizeof(indices[0]) * count;
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        Utils::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(VulkanEngine::GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t)bufferSize);
-        vkUnmapMemory(VulkanEngine::GetDevice(), stagingBufferMemory);
+        //Transfer source so GeometryPool can copy it
+        Utils::CreateDeviceLocalBuffer(indices.data(), bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, m_IndexBuffer, m_IndexBufferMemory);
+    }
 
-        Utils::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
+    void IndexBuffer::CreateIndexBuffer(uint32_t indexCount, const std::function<void(void*)>& writeIndices)
+    {
+        count = indexCount;
+        VkDeviceSize bufferSize = sizeof(uint32_t) * count;
 
-        Utils::CopyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);
+        Utils::CreateDeviceLocalBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, writeIndices, m_IndexBuffer, m_IndexBufferMemory);
+    }
 
-        vkDestroyBuffer(VulkanEngine::GetDevice(), stagingBuffer, nullptr);
-        vkFreeMemory(VulkanEngine::GetDevice(), stagingBufferMemory, nullptr);
+    void IndexBuffer::CreateIndexBuffer(uint32_t indexCount)
+    {
+        count = indexCount;
+        Utils::CreateBuffer(sizeof(uint32_t) * VkDeviceSize(count), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
     }
 
-    void IndexBuffer::Bind()
+    void IndexBuffer::Bind() const
     {
-        vkCmdBindIndexBuffer(VulkanEngine::GetCommandBuffer(), m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        CommandRecorder::BindIndexBuffer(m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
     }
 
     void IndexBuffer::CleanUp()
     {
-        vkDestroyBuffer(VulkanEngine::GetDevice(), m_IndexBuffer, nullptr);
-        vkFreeMemory(VulkanEngine::GetDevice(), m_IndexBufferMemory, nullptr);
+        Utils::DestroyBuffer(m_IndexBuffer, m_IndexBufferMemory);
+        m_IndexBuffer = VK_NULL_HANDLE;
+        m_IndexBufferMemory = VK_NULL_HANDLE;
+        count = 0;
     }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "VulkanHeader.h"
+#include <functional>
 
 namespace CHIKU
 {
@@ -7,14 +8,17 @@ namespace CHIKU
 	{
     public:
         void CreateIndexBuffer(const std::vector<uint32_t>& indices);
-        void Bind();
+        void CreateIndexBuffer(uint32_t indexCount, const std::function<void(void*)>& writeIndices);
+        void CreateIndexBuffer(uint32_t indexCount); //Uninitialized, filled by buffer copies (GeometryPool)
+        void Bind() const;
 
         uint32_t GetCount() const { return count; }
+        VkBuffer GetHandle() const { return m_IndexBuffer; }
         void CleanUp();
 
     private:
-        uint32_t count;
-        VkBuffer m_IndexBuffer;
-        VkDeviceMemory m_IndexBufferMemory;
+        uint32_t count = 0;
+        VkBuffer m_IndexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory m_IndexBufferMemory = VK_NULL_HANDLE;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "IndirectBuffer.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
+#include "Utils/BufferUtils.h"
+#include <iostream>
+
+namespace CHIKU
+{
+    std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> IndirectBuffer::sm_CommandBuffers{};
+    std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> IndirectBuffer::sm_CommandBuffersMemory{};
+    std::array<void*, MAX_FRAMES_IN_FLIGHT> IndirectBuffer::sm_CommandBuffersMapped{};
+    std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> IndirectBuffer::sm_CountBuffers{};
+    std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> IndirectBuffer::sm_CountBuffersMemory{};
+    std::array<void*, MAX_FRAMES_IN_FLIGHT> IndirectBuffer::sm_CountBuffersMapped{};
+    uint32_t IndirectBuffer::sm_Capacity = 0;
+    uint32_t IndirectBuffer::sm_Cursor = 0;
+    uint32_t IndirectBuffer::sm_CountCursor = 0;
+
+    bool IndirectBuffer::IsSupported()
+    {
+        return VulkanEngine::IsIndirectFirstInstanceEnabled();
+    }
+
+    void IndirectBuffer::Reserve(uint32_t commandCount)
+    {
+        if (commandCount <= sm_Capacity)
+        {
+            return;
+        }
+
+        if (sm_Capacity > 0)
+        {
+            //Recorded frames may still read the old commands
+            vkDeviceWaitIdle(VulkanEngine::GetDevice());
+            CleanUp();
+        }
+
+        //A call draws at least one command, so there are never more counts than commands
+        sm_Capacity = commandCount;
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            Utils::CreateMappedBuffer(sizeof(VkDrawIndexedIndirectCommand) * VkDeviceSize(sm_Capacity), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                sm_CommandBuffers[i], sm_CommandBuffersMemory[i], sm_CommandBuffersMapped[i]);
+            Utils::CreateMappedBuffer(sizeof(uint32_t) * VkDeviceSize(sm_Capacity), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                sm_CountBuffers[i], sm_CountBuffersMemory[i], sm_CountBuffersMapped[i]);
+        }
+    }
+
+    void IndirectBuffer::BeginFrame()
+    {
+        sm_Cursor = 0;
+        sm_CountCursor = 0;
+    }
+
+    VkDrawIndexedIndirectCommand* IndirectBuffer::Allocate(uint32_t count, uint32_t& first)
+    {
+        if (sm_Cursor + count > sm_Capacity)
+        {
+            static bool warned = false;
+            if (!warned)
+            {
+                std::cerr << "IndirectBuffer: more draws than reserved (" << sm_Capacity << "), recording the rest directly" << std::endl;
+                warned = true;
+            }
+            return nullptr;
+        }
+
+        first = sm_Cursor;
+        sm_Cursor += count;
+        return static_cast<VkDrawIndexedIndirectCommand*>(sm_CommandBuffersMapped[VulkanEngine::GetCurrentFrame()]) + first;
+    }
+
+    uint32_t IndirectBuffer::Draw(uint32_t first, uint32_t count)
+    {
+        uint32_t frame = VulkanEngine::GetCurrentFrame();
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        VkDeviceSize offset = VkDeviceSize(first) * stride;
+
+        //The count is written here for now; a GPU pass that drops draws can write it instead
+        if (VulkanEngine::GetDrawIndexedIndirectCount())
+        {
+            static_cast<uint32_t*>(sm_CountBuffersMapped[frame])[sm_CountCursor] = count;
+            CommandRecorder::DrawIndexedIndirectCount(sm_CommandBuffers[frame], offset, sm_CountBuffers[frame], VkDeviceSize(sm_CountCursor) * sizeof(uint32_t), count, stride);
+            sm_CountCursor++;
+            return 1;
+        }
+
+        if (VulkanEngine::IsMultiDrawIndirectEnabled())
+        {
+            CommandRecorder::DrawIndexedIndirect(sm_CommandBuffers[frame], offset, count, stride);
+            return 1;
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            CommandRecorder::DrawIndexedIndirect(sm_CommandBuffers[frame], offset + VkDeviceSize(i) * stride, 1, stride);
+        }
+        return count;
+    }
+
+    void IndirectBuffer::CleanUp()
+    {
+        if (sm_Capacity == 0)
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            Utils::DestroyBuffer(sm_CommandBuffers[i], sm_CommandBuffersMemory[i]);
+            Utils::DestroyBuffer(sm_CountBuffers[i], sm_CountBuffersMemory[i]);
+        }
+        sm_Capacity = 0;
+        sm_Cursor = 0;
+        sm_CountCursor = 0;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "VulkanHeader.h"
+#include <array>
+
+namespace CHIKU
+{
+	//Per-frame VkDrawIndexedIndirectCommand array, plus one draw count per call for vkCmdDrawIndexedIndirectCount.
+	//Calls take consecutive ranges, so commands and counts are only ever appended within a frame.
+	class IndirectBuffer
+	{
+	public:
+		//Needs drawIndirectFirstInstance, the commands address their InstanceBuffer range through firstInstance
+		static bool IsSupported();
+		static void Reserve(uint32_t commandCount); //Grows the per-frame buffers. Waits for the device when it has to reallocate.
+		static void BeginFrame(); //Once per frame, rewinds the current frame's buffers
+		//Room for count commands in the current frame's buffer, nullptr when it is full
+		static VkDrawIndexedIndirectCommand* Allocate(uint32_t count, uint32_t& first);
+		//Records commands [first, first + count) in one call when the device has multiDrawIndirect, through the count
+		//buffer when it also has VK_KHR_draw_indirect_count. Returns the number of calls recorded.
+		static uint32_t Draw(uint32_t first, uint32_t count);
+		static void CleanUp();
+
+	private:
+		static std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> sm_CommandBuffers;
+		static std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> sm_CommandBuffersMemory;
+		static std::array<void*, MAX_FRAMES_IN_FLIGHT> sm_CommandBuffersMapped;
+		static std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> sm_CountBuffers;
+		static std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> sm_CountBuffersMemory;
+		static std::array<void*, MAX_FRAMES_IN_FLIGHT> sm_CountBuffersMapped;
+		static uint32_t sm_Capacity;
+		static uint32_t sm_Cursor;
+		static uint32_t sm_CountCursor;
+	};
+}
@@ -0,0 +1,79 @@
+#include "InstanceBuffer.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
+#include "Utils/BufferUtils.h"
+#include <iostream>
+
+namespace CHIKU
+{
+    std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> InstanceBuffer::sm_Buffers{};
+    std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> InstanceBuffer::sm_BuffersMemory{};
+    std::array<void*, MAX_FRAMES_IN_FLIGHT> InstanceBuffer::sm_BuffersMapped{};
+    uint32_t InstanceBuffer::sm_Capacity = 0;
+    uint32_t InstanceBuffer::sm_Cursor = 0;
+
+    void InstanceBuffer::Reserve(uint32_t instanceCount)
+    {
+        if (instanceCount <= sm_Capacity)
+        {
+            return;
+        }
+
+        if (sm_Capacity > 0)
+        {
+            //Recorded frames may still read the old streams
+            vkDeviceWaitIdle(VulkanEngine::GetDevice());
+            CleanUp();
+        }
+
+        sm_Capacity = instanceCount;
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            Utils::CreateMappedBuffer(sizeof(InstanceData) * sm_Capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                sm_Buffers[i], sm_BuffersMemory[i], sm_BuffersMapped[i]);
+        }
+    }
+
+    void InstanceBuffer::BeginFrame()
+    {
+        sm_Cursor = 0;
+    }
+
+    InstanceData* InstanceBuffer::Allocate(uint32_t count, uint32_t& first)
+    {
+        if (sm_Cursor + count > sm_Capacity)
+        {
+            static bool warned = false;
+            if (!warned)
+            {
+                std::cerr << "InstanceBuffer: more instances than reserved (" << sm_Capacity << "), drawing the rest one by one" << std::endl;
+                warned = true;
+            }
+            return nullptr;
+        }
+
+        first = sm_Cursor;
+        sm_Cursor += count;
+        return static_cast<InstanceData*>(sm_BuffersMapped[VulkanEngine::GetCurrentFrame()]) + first;
+    }
+
+    void InstanceBuffer::Bind()
+    {
+        CommandRecorder::BindVertexBuffer(VertexBuffer::INSTANCE_BINDING, sm_Buffers[VulkanEngine::GetCurrentFrame()]);
+    }
+
+    void InstanceBuffer::CleanUp()
+    {
+        if (sm_Capacity == 0)
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            Utils::DestroyBuffer(sm_Buffers[i], sm_BuffersMemory[i]);
+        }
+        sm_Capacity = 0;
+        sm_Cursor = 0;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "VertexBuffer.h"
+#include <array>
+
+namespace CHIKU
+{
+	//Per-frame InstanceData stream read at VertexBuffer::INSTANCE_BINDING. Instanced draws take consecutive ranges
+	//and address them through firstInstance, so the stream is bound once per frame.
+	class InstanceBuffer
+	{
+	public:
+		static void Reserve(uint32_t instanceCount); //Grows the per-frame streams. Waits for the device when it has to reallocate.
+		static void BeginFrame(); //Once per frame, rewinds the current frame's stream
+		//Room for count instances in the current frame's stream, nullptr when it is full. Draw with firstInstance = first.
+		static InstanceData* Allocate(uint32_t count, uint32_t& first);
+		static void Bind();
+		static void CleanUp();
+
+	private:
+		static std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> sm_Buffers;
+		static std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> sm_BuffersMemory;
+		static std::array<void*, MAX_FRAMES_IN_FLIGHT> sm_BuffersMapped;
+		static uint32_t sm_Capacity;
+		static uint32_t sm_Cursor;
+	};
+}
@@ -2,6 +2,7 @@
 #include "VulkanEngine/VulkanEngine.h"
 #include "Utils/BufferUtils.h"
 #include "VulkanEngine/Window.h"
+#include "TextureTable.h"
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
@@ -13,6 +14,8 @@
 
 namespace CHIKU
 {
+	uint32_t Material::sm_NextSortID = 0;
+
 	std::string Material::GetMaterialShader(MaterialPresets presets)
 	{
 		switch (presets)
@@ -26,12 +29,52 @@ namespace CHIKU
 
 	void Material::CreateMaterial(MaterialPresets presets)
 	{
+		m_SortID = sm_NextSortID++;
 		m_Preset = presets;
 		m_ShaderID = GetMaterialShader(m_Preset);
+		m_ShaderHandle = ShaderManager::InternID(m_ShaderID);
+		UpdatePipelineKey();
+	}
+
+	void Material::SetTexturePath(const std::string& path)
+	{
+		m_TexturePath = path;
+		m_TextureIndex = TextureTable::Register(path);
+	}
+
+	void Material::SetFeatures(uint32_t features)
+	{
+		m_Features = features;
+		UpdatePipelineKey();
+	}
+
+	void Material::SetRenderState(const RenderState& state)
+	{
+		m_RenderState = state;
+		UpdatePipelineKey();
+	}
+
+	void Material::UpdatePipelineKey()
+	{
+		//Bindless follows the device rather than the material; a shader without it keeps using the per-draw texture
+		uint32_t features = TextureTable::IsEnabled() ? m_Features | ShaderFeature_Bindless : m_Features & ~ShaderFeature_Bindless;
+		//Instancing follows the vertex layout a draw is recorded with, see VertexBuffer::GetInstancedLayout
+		features &= ~ShaderFeature_Instancing;
+
+		//Unsupported bits are dropped so they cannot create duplicate pipelines
+		uint32_t supported = ShaderManager::GetSupportedFeatures(m_ShaderID);
+		m_PipelineFeatures = features & supported;
+		m_StateHash = HashMaterialState(m_ShaderHandle, m_PipelineFeatures, m_RenderState, static_cast<uint32_t>(m_Preset));
+		m_InstancedPipelineFeatures = (features | ShaderFeature_Instancing) & supported;
+		m_InstancedStateHash = HashMaterialState(m_ShaderHandle, m_InstancedPipelineFeatures, m_RenderState, static_cast<uint32_t>(m_Preset));
 	}
 
-	void Material::Bind(VkPipelineLayout pipelineLayout) const
+	void Material::Bind(VkPipelineLayout pipelineLayout, bool usesTextureTable) const
 	{
-		//vkCmdBindDescriptorSets(VulkanEngine::GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &m_DescriptorSets[VulkanEngine::GetCurrentFrame()], 0, nullptr);
+		if (usesTextureTable)
+		{
+			TextureTable::Bind(pipelineLayout);
+			TextureTable::PushTextureIndex(pipelineLayout, m_TextureIndex);
+		}
 	}
 }
\ No newline at end of file
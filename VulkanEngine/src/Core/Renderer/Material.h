@@ -3,6 +3,8 @@
 #include "VulkanHeader.h"
 #include "VertexBuffer.h"
 #include "Shader.h"
+#include "ShaderFeatures.h"
+#include "RenderState.h"
 
 namespace CHIKU
 {
@@ -27,18 +29,56 @@ namespace CHIKU
 
 		void CreateMaterial(MaterialPresets presets);
 		inline MaterialPresets GetMaterialType() const { return m_Preset; }
-		inline std::string GetShaderID() const { return m_ShaderID; }
+		inline const std::string& GetShaderID() const { return m_ShaderID; }
+		inline uint32_t GetShaderHandle() const { return m_ShaderHandle; } //Interned, see ShaderManager::InternID
+		inline uint32_t GetSortID() const { return m_SortID; } //Distinct per created material, groups draws in RenderQueue
 
-		void Bind(VkPipelineLayout pipelineLayout) const;
+		inline void SetName(const std::string& name) { m_Name = name; }
+		inline void SetBaseColor(const glm::vec4& color) { m_BaseColor = color; }
+		void SetTexturePath(const std::string& path); //Registers the texture with TextureTable
+		inline const std::string& GetName() const { return m_Name; }
+		inline const glm::vec4& GetBaseColor() const { return m_BaseColor; }
+		inline const std::string& GetTexturePath() const { return m_TexturePath; }
+		inline uint32_t GetTextureIndex() const { return m_TextureIndex; } //Into TextureTable, DEFAULT_TEXTURE when bindless is off
+		void SetFeatures(uint32_t features); //ShaderFeatures bits
+		inline uint32_t GetFeatures() const { return m_Features; }
+		void SetRenderState(const RenderState& state);
+		inline const RenderState& GetRenderState() const { return m_RenderState; }
+
+		//Pipeline key inputs, refreshed whenever the shader, features or render state change. The instanced ones are
+		//for draws recorded with an instanced vertex layout.
+		inline uint32_t GetPipelineFeatures(bool instanced = false) const { return instanced ? m_InstancedPipelineFeatures : m_PipelineFeatures; } //Features masked to what the shader supports
+		inline uint64_t GetStateHash(bool instanced = false) const { return instanced ? m_InstancedStateHash : m_StateHash; }
+		inline bool SupportsInstancing() const { return (m_InstancedPipelineFeatures & ShaderFeature_Instancing) != 0; }
+
+		//usesTextureTable describes the pipeline actually bound, which may be a fallback for this material's own
+		void Bind(VkPipelineLayout pipelineLayout, bool usesTextureTable) const;
 		void CleanUp() {}
 
 	private:
 		std::string GetMaterialShader(MaterialPresets presets);
+		void UpdatePipelineKey();
 
 	private:
 
 		MaterialPresets m_Preset;
 		std::string m_ShaderID;
+
+		std::string m_Name;
+		glm::vec4 m_BaseColor = glm::vec4(1.0f);
+		std::string m_TexturePath;
+		uint32_t m_TextureIndex = 0;
+		uint32_t m_Features = ShaderFeature_None;
+		RenderState m_RenderState;
+
+		uint32_t m_ShaderHandle = 0;
+		uint32_t m_PipelineFeatures = ShaderFeature_None;
+		uint64_t m_StateHash = 0;
+		uint32_t m_InstancedPipelineFeatures = ShaderFeature_None;
+		uint64_t m_InstancedStateHash = 0;
+		uint32_t m_SortID = 0;
+
+		static uint32_t sm_NextSortID;
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,455 @@
+#include "Model.h"
+#include "GraphicsPipeline.h"
+#include "RenderQueue.h"
+#include "GLTFImporter.h"
+#include "AssetManager.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "Utils/BufferUtils.h"
+#include "Utils/FrustumCulling.h"
+#include <tiny_obj_loader.h>
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <sstream>
+#include <unordered_map>
+#include <cstring>
+#include <cfloat>
+
+namespace CHIKU
+{
+    uint32_t Model::sm_NextSortID = 0;
+
+    //Resolves mtllib references through the asset manager so OBJs load from archives too
+    class AssetMaterialReader : public tinyobj::MaterialReader
+    {
+    public:
+        explicit AssetMaterialReader(const std::string& baseDir) : m_BaseDir(baseDir) {}
+
+        bool operator()(const std::string& matId, std::vector<tinyobj::material_t>* materials,
+            std::map<std::string, int>* matMap, std::string* warn, std::string* err) override
+        {
+            std::vector<char> data;
+            if (!AssetManager::ReadFile(m_BaseDir + matId, data))
+            {
+                if (warn)
+                {
+                    (*warn) += "Material file [ " + m_BaseDir + matId + " ] not found.\n";
+                }
+                return false;
+            }
+
+            std::istringstream stream(std::string(data.begin(), data.end()));
+            tinyobj::LoadMtl(matMap, materials, &stream, warn, err);
+            return true;
+        }
+
+    private:
+        std::string m_BaseDir;
+    };
+
+    //OBJ corners that share position, uv and normal become one vertex
+    struct OBJVertexKey
+    {
+        int Position;
+        int Texcoord;
+        int Normal;
+
+        bool operator==(const OBJVertexKey& other) const
+        {
+            return Position == other.Position && Texcoord == other.Texcoord && Normal == other.Normal;
+        }
+    };
+
+    struct OBJVertexKeyHash
+    {
+        size_t operator()(const OBJVertexKey& key) const noexcept
+        {
+            size_t h = std::hash<int>{}(key.Position);
+            h ^= std::hash<int>{}(key.Texcoord) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<int>{}(key.Normal) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    static void WriteVertexField(uint8_t* vertex, const VertexAttribute& element, const glm::vec4& value)
+    {
+        size_t components = 0;
+        switch (element.AttributeType)
+        {
+        case VertexAttributeType::Float: components = 1; break;
+        case VertexAttributeType::Vec2: components = 2; break;
+        case VertexAttributeType::Vec3: components = 3; break;
+        case VertexAttributeType::Vec4: components = 4; break;
+        default: return;
+        }
+
+        memcpy(vertex + element.Offset, &value[0], components * sizeof(float));
+    }
+
+    //Sphere around a bounding box, looser than the minimal sphere but stable and cheap
+    static glm::vec4 GetBoundingSphere(const glm::vec3& min, const glm::vec3& max)
+    {
+        if (min.x > max.x)
+        {
+            return glm::vec4(0.0f);
+        }
+        return glm::vec4((min + max) * 0.5f, glm::length(max - min) * 0.5f);
+    }
+
+    static Material CreateDefaultMaterial()
+    {
+        Material material;
+        material.CreateMaterial(MaterialPresets::Unlit);
+        material.SetName("default");
+        return material;
+    }
+
+    void Model::Load(const std::string& path, VertexLayoutPreset layout)
+    {
+        CleanUp();
+
+        //Uploaded on their own first, then copied into the shared pool
+        VertexBuffer vertices;
+        IndexBuffer indices;
+        std::string extension = std::filesystem::path(path).extension().string();
+        if (extension == ".glb" || extension == ".gltf")
+        {
+            LoadGLTF(path, layout, vertices, indices);
+        }
+        else
+        {
+            LoadOBJ(path, layout, vertices, indices);
+        }
+
+        m_Geometry = GeometryPool::Add(vertices, indices);
+        vertices.CleanUp();
+        indices.CleanUp();
+        for (auto& submesh : m_Submeshes)
+        {
+            submesh.FirstIndex += m_Geometry.FirstIndex;
+            submesh.VertexOffset += m_Geometry.VertexOffset;
+        }
+
+        //Every placed copy of a submesh
+        std::vector<glm::vec4> spheres;
+        m_DrawCount = 0;
+        for (const auto& instance : m_Instances)
+        {
+            for (uint32_t i = instance.FirstSubmesh; i < instance.FirstSubmesh + instance.SubmeshCount; i++)
+            {
+                spheres.push_back(instance.Identity ? m_Submeshes[i].Bounds : Utils::TransformSphere(instance.Transform, m_Submeshes[i].Bounds));
+            }
+            m_DrawCount += instance.SubmeshCount;
+        }
+
+        glm::vec3 boundsMin(FLT_MAX);
+        glm::vec3 boundsMax(-FLT_MAX);
+        for (const auto& sphere : spheres)
+        {
+            boundsMin = glm::min(boundsMin, glm::vec3(sphere) - glm::vec3(sphere.w));
+            boundsMax = glm::max(boundsMax, glm::vec3(sphere) + glm::vec3(sphere.w));
+        }
+
+        //Centered on the box around the copies' spheres, with the smallest radius that still holds all of them
+        m_Bounds = glm::vec4(glm::vec3(GetBoundingSphere(boundsMin, boundsMax)), 0.0f);
+        for (const auto& sphere : spheres)
+        {
+            m_Bounds.w = std::max(m_Bounds.w, glm::length(glm::vec3(sphere) - glm::vec3(m_Bounds)) + sphere.w);
+        }
+
+        m_SortID = sm_NextSortID;
+        sm_NextSortID += std::max<uint32_t>(1, static_cast<uint32_t>(m_Submeshes.size()));
+    }
+
+    void Model::LoadGLTF(const std::string& path, VertexLayoutPreset layout, VertexBuffer& vertexBuffer, IndexBuffer& indexBuffer)
+    {
+        GLTFImporter importer;
+        if (!importer.Load(path))
+        {
+            throw std::runtime_error("failed to load glTF model: " + path);
+        }
+
+        importer.Upload(layout, vertexBuffer, indexBuffer);
+
+        m_Materials.clear();
+        for (const auto& source : importer.GetMaterials())
+        {
+            Material material;
+            material.CreateMaterial(MaterialPresets::Unlit);
+            material.SetName(source.Name);
+            material.SetBaseColor(source.BaseColorFactor);
+            material.SetTexturePath(source.BaseColorTexture);
+            m_Materials.push_back(material);
+        }
+
+        //One submesh per material of each mesh, in model space. Every node placing the mesh is an instance of those
+        //submeshes, so its copies share their sort IDs and are drawn instanced.
+        const std::vector<GLTFMesh>& meshes = importer.GetMeshes();
+        std::vector<std::array<MeshInstance, 2>> runs(meshes.size());
+        int32_t defaultMaterial = -1;
+        m_Submeshes.clear();
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            for (bool mirrored : { false, true })
+            {
+                MeshInstance& run = runs[m][mirrored ? 1 : 0];
+                run.FirstSubmesh = static_cast<uint32_t>(m_Submeshes.size());
+
+                for (const auto& range : mirrored ? meshes[m].MirroredRanges : meshes[m].Ranges)
+                {
+                    Submesh submesh;
+                    submesh.FirstIndex = range.FirstIndex;
+                    submesh.IndexCount = range.IndexCount;
+                    submesh.Bounds = GetBoundingSphere(range.BoundsMin, range.BoundsMax);
+
+                    if (range.MaterialIndex >= 0 && range.MaterialIndex < static_cast<int32_t>(m_Materials.size()))
+                    {
+                        submesh.MaterialIndex = static_cast<uint32_t>(range.MaterialIndex);
+                    }
+                    else
+                    {
+                        if (defaultMaterial < 0)
+                        {
+                            defaultMaterial = static_cast<int32_t>(m_Materials.size());
+                            m_Materials.push_back(CreateDefaultMaterial());
+                        }
+                        submesh.MaterialIndex = static_cast<uint32_t>(defaultMaterial);
+                    }
+
+                    m_Submeshes.push_back(submesh);
+                }
+
+                run.SubmeshCount = static_cast<uint32_t>(m_Submeshes.size()) - run.FirstSubmesh;
+            }
+        }
+
+        m_Instances.clear();
+        for (const auto& node : importer.GetInstances())
+        {
+            MeshInstance instance = runs[node.Mesh][node.IsMirrored() ? 1 : 0];
+            instance.Transform = node.Transform;
+            instance.Identity = node.Transform == glm::mat4(1.0f);
+            m_Instances.push_back(instance);
+        }
+    }
+
+    void Model::LoadOBJ(const std::string& path, VertexLayoutPreset layout, VertexBuffer& vertexBuffer, IndexBuffer& indexBuffer)
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+
+        std::vector<char> fileData = AssetManager::ReadFile(path);
+        std::istringstream stream(std::string(fileData.begin(), fileData.end()));
+
+        std::string baseDir = std::filesystem::path(path).parent_path().generic_string();
+        if (!baseDir.empty())
+        {
+            baseDir += "/";
+        }
+        AssetMaterialReader materialReader(baseDir);
+
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader))
+        {
+            throw std::runtime_error(warn + err);
+        }
+
+        VertexBufferLayout vertexLayout = VertexBuffer::GetVertexBufferLayout(layout);
+        Utils::FinalizeLayout(vertexLayout);
+
+        //One index list per material, the last slot collects faces without a valid material
+        std::vector<std::vector<uint32_t>> materialIndices(materials.size() + 1);
+        std::vector<std::pair<glm::vec3, glm::vec3>> materialBounds(materials.size() + 1, { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) });
+        std::unordered_map<OBJVertexKey, uint32_t, OBJVertexKeyHash> uniqueVertices;
+        std::vector<uint8_t> vertices;
+
+        for (const auto& shape : shapes)
+        {
+            for (size_t face = 0; face < shape.mesh.num_face_vertices.size(); face++)
+            {
+                int materialID = shape.mesh.material_ids[face];
+                size_t slot = (materialID >= 0 && materialID < static_cast<int>(materials.size())) ? materialID : materials.size();
+
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    const tinyobj::index_t& index = shape.mesh.indices[3 * face + corner];
+                    OBJVertexKey key = { index.vertex_index, index.texcoord_index, index.normal_index };
+
+                    glm::vec3 cornerPosition(attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1], attrib.vertices[3 * index.vertex_index + 2]);
+                    materialBounds[slot].first = glm::min(materialBounds[slot].first, cornerPosition);
+                    materialBounds[slot].second = glm::max(materialBounds[slot].second, cornerPosition);
+
+                    auto found = uniqueVertices.find(key);
+                    if (found != uniqueVertices.end())
+                    {
+                        materialIndices[slot].push_back(found->second);
+                        continue;
+                    }
+
+                    glm::vec4 position = {
+                        attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2],
+                        1.0f };
+
+                    glm::vec4 texCoord(0.0f, 0.0f, 1.0f, 0.0f);
+                    if (index.texcoord_index >= 0)
+                    {
+                        texCoord.x = attrib.texcoords[2 * index.texcoord_index + 0];
+                        texCoord.y = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
+                    }
+
+                    glm::vec4 normal(0.0f);
+                    if (index.normal_index >= 0)
+                    {
+                        normal = { attrib.normals[3 * index.normal_index + 0],
+                                   attrib.normals[3 * index.normal_index + 1],
+                                   attrib.normals[3 * index.normal_index + 2],
+                                   0.0f };
+                    }
+
+                    size_t vertexStart = vertices.size();
+                    vertices.resize(vertexStart + vertexLayout.Stride);
+                    for (const auto& element : vertexLayout.VertexElements)
+                    {
+                        uint8_t* dst = vertices.data() + vertexStart;
+                        if (element.ElementName == VERTEX_FIELD_POSITION) WriteVertexField(dst, element, position);
+                        else if (element.ElementName == VERTEX_FIELD_COLOR) WriteVertexField(dst, element, glm::vec4(1.0f));
+                        else if (element.ElementName == VERTEX_FIELD_TEXCOORD) WriteVertexField(dst, element, texCoord);
+                        else if (element.ElementName == VERTEX_FIELD_NORMAL) WriteVertexField(dst, element, normal);
+                    }
+
+                    uint32_t vertexIndex = static_cast<uint32_t>(uniqueVertices.size());
+                    uniqueVertices.emplace(key, vertexIndex);
+                    materialIndices[slot].push_back(vertexIndex);
+                }
+            }
+        }
+
+        std::vector<uint32_t> indices;
+        m_Submeshes.clear();
+        m_Materials.clear();
+        for (size_t slot = 0; slot < materialIndices.size(); slot++)
+        {
+            if (materialIndices[slot].empty())
+            {
+                continue;
+            }
+
+            if (slot < materials.size())
+            {
+                const tinyobj::material_t& source = materials[slot];
+                Material material;
+                material.CreateMaterial(MaterialPresets::Unlit);
+                material.SetName(source.name);
+                material.SetBaseColor(glm::vec4(source.diffuse[0], source.diffuse[1], source.diffuse[2], source.dissolve));
+                if (!source.diffuse_texname.empty())
+                {
+                    material.SetTexturePath(baseDir + source.diffuse_texname);
+                }
+                m_Materials.push_back(material);
+            }
+            else
+            {
+                m_Materials.push_back(CreateDefaultMaterial());
+            }
+
+            Submesh submesh;
+            submesh.FirstIndex = static_cast<uint32_t>(indices.size());
+            submesh.IndexCount = static_cast<uint32_t>(materialIndices[slot].size());
+            submesh.MaterialIndex = static_cast<uint32_t>(m_Materials.size() - 1);
+            submesh.Bounds = GetBoundingSphere(materialBounds[slot].first, materialBounds[slot].second);
+            m_Submeshes.push_back(submesh);
+
+            indices.insert(indices.end(), materialIndices[slot].begin(), materialIndices[slot].end());
+        }
+
+        //Drawn once, where it was modelled
+        m_Instances.clear();
+        m_Instances.push_back({ glm::mat4(1.0f), 0, static_cast<uint32_t>(m_Submeshes.size()), true });
+
+        vertexBuffer.SetLayout(layout);
+        vertexBuffer.CreateVertexBuffer(vertices);
+        indexBuffer.CreateIndexBuffer(indices);
+    }
+
+    static RenderQueue::Pass GetPass(const Material& material)
+    {
+        return material.GetRenderState().Blend == static_cast<uint32_t>(BlendMode::Opaque) ? RenderQueue::Pass::Opaque : RenderQueue::Pass::Transparent;
+    }
+
+    //Instanced drawing needs a program with the instancing feature and a layout that has an instanced counterpart
+    static uint32_t GetInstancedPipelineIndex(GraphicsPipeline& pipeline, const Material& material, VertexLayoutPreset layout)
+    {
+        VertexLayoutPreset instancedLayout = VertexBuffer::GetInstancedLayout(layout);
+        if (!material.SupportsInstancing() || instancedLayout == layout)
+        {
+            return RenderQueue::NO_INSTANCING;
+        }
+        return pipeline.GetPipelineIndex(material, instancedLayout);
+    }
+
+    //The entity's transform for identity instances, otherwise the combined one, kept by the queue until it is cleared
+    static const glm::mat4* GetInstanceTransform(RenderQueue& queue, const MeshInstance& instance, const glm::mat4& transform)
+    {
+        return instance.Identity ? &transform : queue.StoreTransform(transform * instance.Transform);
+    }
+
+    void Model::Submit(RenderQueue& queue, GraphicsPipeline& pipeline, const glm::mat4& transform, float depth) const
+    {
+        for (const MeshInstance& instance : m_Instances)
+        {
+            const glm::mat4* instanceTransform = GetInstanceTransform(queue, instance, transform);
+            for (uint32_t i = instance.FirstSubmesh; i < instance.FirstSubmesh + instance.SubmeshCount; i++)
+            {
+                const Submesh& submesh = m_Submeshes[i];
+                const Material& material = m_Materials[submesh.MaterialIndex];
+                uint32_t pipelineIndex = pipeline.GetPipelineIndex(material, m_Geometry.Vertices->GetBufferLayout());
+                uint32_t instancedPipelineIndex = GetInstancedPipelineIndex(pipeline, material, m_Geometry.Vertices->GetBufferLayout());
+
+                queue.Submit(RenderQueue::MakeSortKey(GetPass(material), pipelineIndex, material.GetSortID(), m_SortID + i, depth),
+                    { &material, m_Geometry.Vertices, m_Geometry.Indices, instanceTransform, submesh.FirstIndex, submesh.IndexCount, submesh.VertexOffset, pipelineIndex, instancedPipelineIndex });
+            }
+        }
+    }
+
+    void Model::Submit(RenderQueue& queue, GraphicsPipeline& pipeline, const Material& material, const glm::mat4& transform, float depth) const
+    {
+        uint32_t pipelineIndex = pipeline.GetPipelineIndex(material, m_Geometry.Vertices->GetBufferLayout());
+        uint32_t instancedPipelineIndex = GetInstancedPipelineIndex(pipeline, material, m_Geometry.Vertices->GetBufferLayout());
+        RenderQueue::Pass pass = GetPass(material);
+
+        for (const MeshInstance& instance : m_Instances)
+        {
+            const glm::mat4* instanceTransform = GetInstanceTransform(queue, instance, transform);
+            for (uint32_t i = instance.FirstSubmesh; i < instance.FirstSubmesh + instance.SubmeshCount; i++)
+            {
+                const Submesh& submesh = m_Submeshes[i];
+                queue.Submit(RenderQueue::MakeSortKey(pass, pipelineIndex, material.GetSortID(), m_SortID + i, depth),
+                    { &material, m_Geometry.Vertices, m_Geometry.Indices, instanceTransform, submesh.FirstIndex, submesh.IndexCount, submesh.VertexOffset, pipelineIndex, instancedPipelineIndex });
+            }
+        }
+    }
+
+    void Model::CleanUp()
+    {
+        if (m_Submeshes.empty())
+        {
+            return;
+        }
+
+        for (auto& material : m_Materials)
+        {
+            material.CleanUp();
+        }
+
+        m_Materials.clear();
+        m_Submeshes.clear();
+        m_Instances.clear();
+        m_DrawCount = 0;
+        //The pool's space is given back by GeometryPool::Reset
+        m_Geometry = {};
+        m_Bounds = glm::vec4(0.0f);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "VertexBuffer.h"
+#include "IndexBuffer.h"
+#include "Material.h"
+#include "GeometryPool.h"
+#include <string>
+#include <vector>
+
+namespace CHIKU
+{
+	class GraphicsPipeline;
+	class RenderQueue;
+
+	//Contiguous index range drawn with a single material, absolute in the GeometryPool buffers
+	struct Submesh
+	{
+		uint32_t FirstIndex = 0;
+		uint32_t IndexCount = 0;
+		int32_t VertexOffset = 0;
+		uint32_t MaterialIndex = 0; //Index into Model::GetMaterials
+		glm::vec4 Bounds = glm::vec4(0.0f); //Model space bounding sphere, center in xyz and radius in w
+	};
+
+	//One placement of a run of submeshes inside the model, a glTF node for example. Every copy of a submesh draws the same
+	//index range, so copies end up in one instanced draw.
+	struct MeshInstance
+	{
+		glm::mat4 Transform = glm::mat4(1.0f); //Model space
+		uint32_t FirstSubmesh = 0;
+		uint32_t SubmeshCount = 0;
+		bool Identity = true; //Transform is the identity, the entity's transform is used as is
+	};
+
+	//A range of the GeometryPool shared by every submesh. Faces are grouped by material at load
+	//time so each material is bound once per draw.
+	class Model
+	{
+	public:
+		//Loads an .obj, .glb or .gltf file through the asset manager
+		void Load(const std::string& path, VertexLayoutPreset layout = VertexLayoutPreset::UnLitMesh);
+		//Adds a packet per submesh of every instance. transform must stay valid until the queue is executed.
+		void Submit(RenderQueue& queue, GraphicsPipeline& pipeline, const glm::mat4& transform, float depth) const;
+		//Submits with the given material in place of the model's own
+		void Submit(RenderQueue& queue, GraphicsPipeline& pipeline, const Material& material, const glm::mat4& transform, float depth) const;
+		void CleanUp();
+
+		const std::vector<Submesh>& GetSubmeshes() const { return m_Submeshes; }
+		const std::vector<MeshInstance>& GetInstances() const { return m_Instances; }
+		uint32_t GetDrawCount() const { return m_DrawCount; } //Packets per Submit
+		const std::vector<Material>& GetMaterials() const { return m_Materials; }
+		const GeometryPool::Range& GetGeometry() const { return m_Geometry; }
+		const glm::vec4& GetBounds() const { return m_Bounds; } //Model space sphere around every instance
+
+	private:
+		void LoadOBJ(const std::string& path, VertexLayoutPreset layout, VertexBuffer& vertexBuffer, IndexBuffer& indexBuffer);
+		void LoadGLTF(const std::string& path, VertexLayoutPreset layout, VertexBuffer& vertexBuffer, IndexBuffer& indexBuffer);
+
+	private:
+		GeometryPool::Range m_Geometry;
+
+		std::vector<Submesh> m_Submeshes;
+		std::vector<MeshInstance> m_Instances;
+		std::vector<Material> m_Materials;
+		uint32_t m_DrawCount = 0;
+		glm::vec4 m_Bounds = glm::vec4(0.0f);
+		uint32_t m_SortID = 0; //Of the first submesh, each submesh has its own so RenderQueue keeps their draws adjacent
+
+		static uint32_t sm_NextSortID;
+	};
+}
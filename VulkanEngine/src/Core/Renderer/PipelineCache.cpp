@@ -0,0 +1,204 @@
+#include "PipelineCache.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "Utils/Hash.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace CHIKU
+{
+    static constexpr char PIPELINE_CACHE_MAGIC[4] = { 'C', 'H', 'P', 'C' };
+    static constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+    static constexpr std::chrono::seconds SAVE_INTERVAL(30);
+    static const std::string PIPELINE_CACHE_PATH = "shader/cache/pipelines.bin";
+
+    VkPipelineCache PipelineCache::sm_PipelineCache = VK_NULL_HANDLE;
+    std::atomic<bool> PipelineCache::sm_Dirty{ false };
+    bool PipelineCache::sm_LoadedFromDisk = false;
+    std::chrono::steady_clock::time_point PipelineCache::sm_LastSave;
+
+    static bool ReadFile(const std::string& path, std::vector<char>& data)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), data.size());
+        return static_cast<bool>(file);
+    }
+
+    void PipelineCache::Init()
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(VulkanEngine::GetPhysicalDevice(), &properties);
+
+        std::vector<char> file;
+        std::vector<char> data;
+        sm_LoadedFromDisk = ReadFile(SOURCE_DIR + PIPELINE_CACHE_PATH, file) && Deserialize(properties, file, data);
+
+        VkPipelineCacheCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize = sm_LoadedFromDisk ? data.size() : 0;
+        createInfo.pInitialData = sm_LoadedFromDisk ? data.data() : nullptr;
+
+        if (vkCreatePipelineCache(VulkanEngine::GetDevice(), &createInfo, nullptr, &sm_PipelineCache) != VK_SUCCESS)
+        {
+            //Drivers may still reject data that passed our checks, an empty cache is always accepted
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            sm_LoadedFromDisk = false;
+
+            if (vkCreatePipelineCache(VulkanEngine::GetDevice(), &createInfo, nullptr, &sm_PipelineCache) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create pipeline cache!");
+            }
+        }
+
+        sm_Dirty = false;
+        sm_LastSave = std::chrono::steady_clock::now();
+    }
+
+    std::vector<char> PipelineCache::Serialize(const VkPhysicalDeviceProperties& properties, const std::vector<char>& data)
+    {
+        FileHeader header{};
+        memcpy(header.Magic, PIPELINE_CACHE_MAGIC, sizeof(PIPELINE_CACHE_MAGIC));
+        header.Version = PIPELINE_CACHE_VERSION;
+        header.VendorID = properties.vendorID;
+        header.DeviceID = properties.deviceID;
+        header.DriverVersion = properties.driverVersion;
+        memcpy(header.PipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        header.DataSize = data.size();
+        header.DataHash = Utils::HashBytes(data.data(), data.size());
+
+        std::vector<char> file(sizeof(header) + data.size());
+        memcpy(file.data(), &header, sizeof(header));
+        if (!data.empty())
+        {
+            memcpy(file.data() + sizeof(header), data.data(), data.size());
+        }
+        return file;
+    }
+
+    bool PipelineCache::Deserialize(const VkPhysicalDeviceProperties& properties, const std::vector<char>& file, std::vector<char>& data)
+    {
+        FileHeader header;
+        if (file.size() < sizeof(header))
+        {
+            return false;
+        }
+
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.Magic, PIPELINE_CACHE_MAGIC, sizeof(PIPELINE_CACHE_MAGIC)) != 0 ||
+            header.Version != PIPELINE_CACHE_VERSION ||
+            header.VendorID != properties.vendorID ||
+            header.DeviceID != properties.deviceID ||
+            header.DriverVersion != properties.driverVersion ||
+            memcmp(header.PipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+            header.DataSize != file.size() - sizeof(header))
+        {
+            std::cout << "Pipeline cache is stale or from another device, starting cold" << std::endl;
+            return false;
+        }
+
+        const char* payload = file.data() + sizeof(header);
+        if (Utils::HashBytes(payload, header.DataSize) != header.DataHash)
+        {
+            std::cerr << "Pipeline cache is corrupt, starting cold" << std::endl;
+            return false;
+        }
+
+        //The driver's own header must agree as well
+        VkPipelineCacheHeaderVersionOne driverHeader;
+        if (header.DataSize < sizeof(driverHeader))
+        {
+            return false;
+        }
+
+        memcpy(&driverHeader, payload, sizeof(driverHeader));
+        if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+            driverHeader.vendorID != properties.vendorID ||
+            driverHeader.deviceID != properties.deviceID ||
+            memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        {
+            return false;
+        }
+
+        data.assign(payload, payload + header.DataSize);
+        return true;
+    }
+
+    bool PipelineCache::Save()
+    {
+        if (sm_PipelineCache == VK_NULL_HANDLE)
+        {
+            return false;
+        }
+
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(VulkanEngine::GetDevice(), sm_PipelineCache, &dataSize, nullptr) != VK_SUCCESS)
+        {
+            return false;
+        }
+
+        std::vector<char> data(dataSize);
+        if (vkGetPipelineCacheData(VulkanEngine::GetDevice(), sm_PipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+        {
+            return false;
+        }
+        data.resize(dataSize);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(VulkanEngine::GetPhysicalDevice(), &properties);
+
+        const std::vector<char> contents = Serialize(properties, data);
+
+        //Written beside the target and renamed so a crash mid-write never leaves a truncated cache
+        const std::string path = SOURCE_DIR + PIPELINE_CACHE_PATH;
+        const std::string temporaryPath = path + ".tmp";
+
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            file.write(contents.data(), contents.size());
+            if (!file)
+            {
+                std::cerr << "Failed to write pipeline cache: " << temporaryPath << std::endl;
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+        {
+            std::cerr << "Failed to write pipeline cache: " << path << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+
+        sm_Dirty = false;
+        sm_LastSave = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    void PipelineCache::Update()
+    {
+        if (sm_Dirty && std::chrono::steady_clock::now() - sm_LastSave >= SAVE_INTERVAL)
+        {
+            Save();
+        }
+    }
+
+    void PipelineCache::CleanUp()
+    {
+        Save();
+
+        vkDestroyPipelineCache(VulkanEngine::GetDevice(), sm_PipelineCache, nullptr);
+        sm_PipelineCache = VK_NULL_HANDLE;
+    }
+}
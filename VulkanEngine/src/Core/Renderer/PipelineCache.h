@@ -0,0 +1,51 @@
+#pragma once
+#include "VulkanHeader.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace CHIKU
+{
+	//Driver pipeline cache persisted between runs. The file is only reused when vendor, device, driver version
+	//and pipelineCacheUUID all match the current device, otherwise the cache starts empty.
+	class PipelineCache
+	{
+	public:
+		static void Init();
+		static void CleanUp(); //Writes the cache back and destroys it
+
+		static VkPipelineCache Get() { return sm_PipelineCache; }
+		static void MarkDirty() { sm_Dirty = true; }
+
+		//Writes the cache when new pipelines were created since the last save, at most every SAVE_INTERVAL
+		static void Update();
+		static bool Save();
+
+		static bool WasLoadedFromDisk() { return sm_LoadedFromDisk; }
+
+		//The file form: a header naming the device, then the driver's cache data. Deserialize returns false, leaving
+		//data untouched, for a file that is truncated, corrupt or from another device or driver.
+		static std::vector<char> Serialize(const VkPhysicalDeviceProperties& properties, const std::vector<char>& data);
+		static bool Deserialize(const VkPhysicalDeviceProperties& properties, const std::vector<char>& file, std::vector<char>& data);
+
+	private:
+		struct FileHeader
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint32_t VendorID;
+			uint32_t DeviceID;
+			uint32_t DriverVersion;
+			uint8_t PipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t DataSize;
+			uint64_t DataHash;
+		};
+
+
+	private:
+		static VkPipelineCache sm_PipelineCache;
+		static std::atomic<bool> sm_Dirty; //Set from pipeline compile jobs
+		static bool sm_LoadedFromDisk;
+		static std::chrono::steady_clock::time_point sm_LastSave;
+	};
+}
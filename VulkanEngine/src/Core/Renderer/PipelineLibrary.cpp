@@ -0,0 +1,365 @@
+#include "PipelineLibrary.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "Utils/Hash.h"
+#include <cstdlib>
+#include <iostream>
+
+namespace CHIKU
+{
+    bool PipelineLibrary::sm_Enabled = false;
+    std::unordered_map<PipelineLibrary::LibraryKey, std::unique_ptr<PipelineLibrary::Library>, PipelineLibrary::LibraryKeyHash> PipelineLibrary::sm_Libraries;
+    std::vector<std::unique_ptr<PipelineLibrary::Library>> PipelineLibrary::sm_Released;
+
+    PipelineStateInfo::PipelineStateInfo(const VertexBuffer::VertexInputDescription& description, RenderState state)
+    {
+        VertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        VertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(description.BindingDescriptions.size());
+        VertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.AttributeDescription.size());
+        VertexInput.pVertexBindingDescriptions = description.BindingDescriptions.data();
+        VertexInput.pVertexAttributeDescriptions = description.AttributeDescription.data();
+
+        InputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        InputAssembly.topology = static_cast<VkPrimitiveTopology>(state.Topology);
+        InputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        Viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        Viewport.viewportCount = 1;
+        Viewport.scissorCount = 1;
+
+        Rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        Rasterization.depthClampEnable = VK_FALSE;
+        Rasterization.rasterizerDiscardEnable = VK_FALSE;
+        Rasterization.polygonMode = static_cast<VkPolygonMode>(state.PolygonMode);
+        Rasterization.lineWidth = 1.0f;
+        Rasterization.cullMode = static_cast<VkCullModeFlags>(state.CullMode);
+        Rasterization.frontFace = static_cast<VkFrontFace>(state.FrontFace);
+        Rasterization.depthBiasEnable = VK_FALSE;
+
+        Multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        Multisample.sampleShadingEnable = VK_FALSE;
+        Multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        BlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        BlendAttachment.blendEnable = state.Blend != static_cast<uint32_t>(BlendMode::Opaque);
+        BlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        BlendAttachment.dstColorBlendFactor = state.Blend == static_cast<uint32_t>(BlendMode::Additive) ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        BlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        BlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        BlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        BlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        ColorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        ColorBlend.logicOpEnable = VK_FALSE;
+        ColorBlend.logicOp = VK_LOGIC_OP_COPY;
+        ColorBlend.attachmentCount = 1;
+        ColorBlend.pAttachments = &BlendAttachment;
+
+        DepthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        DepthStencil.depthTestEnable = state.DepthTest;
+        DepthStencil.depthWriteEnable = state.DepthWrite;
+        DepthStencil.depthCompareOp = static_cast<VkCompareOp>(state.DepthCompare);
+        DepthStencil.depthBoundsTestEnable = VK_FALSE;
+        DepthStencil.minDepthBounds = 0.0f;
+        DepthStencil.maxDepthBounds = 1.0f;
+        DepthStencil.stencilTestEnable = VK_FALSE;
+
+        Dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        Dynamic.dynamicStateCount = static_cast<uint32_t>(DynamicStates.size());
+        Dynamic.pDynamicStates = DynamicStates.data();
+    }
+
+    template<typename Handle>
+    static uint64_t HandleBits(Handle handle)
+    {
+        //Non-dispatchable handles are pointers on 64-bit targets and integers on 32-bit ones
+        uint64_t bits = 0;
+        memcpy(&bits, &handle, sizeof(handle));
+        return bits;
+    }
+
+    static VkShaderModule FindModule(const std::vector<VkPipelineShaderStageCreateInfo>& stages, VkShaderStageFlagBits stage)
+    {
+        for (const auto& info : stages)
+        {
+            if (info.stage == stage)
+            {
+                return info.module;
+            }
+        }
+        return VK_NULL_HANDLE;
+    }
+
+    size_t PipelineLibrary::LibraryKeyHash::operator()(const LibraryKey& key) const noexcept
+    {
+        uint32_t part = key.LibraryPart;
+        return static_cast<size_t>(Utils::HashBytes(key.Fields.data(), sizeof(key.Fields), Utils::HashBytes(&part, sizeof(part))));
+    }
+
+    void PipelineLibrary::Init()
+    {
+        if (!VulkanEngine::IsPipelineLibraryEnabled())
+        {
+            return;
+        }
+        if (const char* disable = std::getenv("CHIKU_DISABLE_PIPELINE_LIBRARY"); disable && std::string(disable) != "0")
+        {
+            std::cout << "CHIKU_DISABLE_PIPELINE_LIBRARY is set, pipelines are compiled whole" << std::endl;
+            return;
+        }
+
+        sm_Enabled = true;
+        std::cout << "Graphics pipeline libraries enabled" << std::endl;
+    }
+
+    PipelineLibrary::LibrarySet PipelineLibrary::Acquire(const std::vector<VkPipelineShaderStageCreateInfo>& stages, VertexLayoutPreset inputDescription,
+        VkPipelineLayout layout, uint32_t features, RenderState state)
+    {
+        uint64_t vertexModule = HandleBits(FindModule(stages, VK_SHADER_STAGE_VERTEX_BIT));
+        uint64_t fragmentModule = HandleBits(FindModule(stages, VK_SHADER_STAGE_FRAGMENT_BIT));
+        uint64_t layoutBits = HandleBits(layout);
+
+        //Each part is keyed only by the state it contains, so keys that differ elsewhere share it
+        RenderState inputState;
+        inputState.Topology = state.Topology;
+
+        RenderState rasterState;
+        rasterState.PolygonMode = state.PolygonMode;
+        rasterState.CullMode = state.CullMode;
+        rasterState.FrontFace = state.FrontFace;
+
+        RenderState depthState;
+        depthState.DepthTest = state.DepthTest;
+        depthState.DepthWrite = state.DepthWrite;
+        depthState.DepthCompare = state.DepthCompare;
+
+        RenderState outputState;
+        outputState.Blend = state.Blend;
+
+        //The vertex input description is built from the layout preset and the vertex shader's inputs
+        const std::array<LibraryKey, PartCount> keys = { {
+            { VertexInput, { static_cast<uint64_t>(inputDescription), vertexModule, inputState.Pack(), 0 } },
+            { PreRasterization, { vertexModule, layoutBits, features, rasterState.Pack() } },
+            { FragmentShader, { fragmentModule, layoutBits, features, depthState.Pack() } },
+            { FragmentOutput, { outputState.Pack(), 0, 0, 0 } },
+        } };
+
+        LibrarySet libraries;
+        for (uint32_t part = 0; part < PartCount; part++)
+        {
+            std::unique_ptr<Library>& library = sm_Libraries[keys[part]];
+            if (!library)
+            {
+                library = std::make_unique<Library>();
+            }
+            library->Users.fetch_add(1, std::memory_order_relaxed);
+            libraries[part] = library.get();
+        }
+
+        return libraries;
+    }
+
+    bool PipelineLibrary::BuildParts(const LibrarySet& libraries, const std::vector<VkPipelineShaderStageCreateInfo>& stages,
+        const VertexBuffer::VertexInputDescription& description, VkPipelineLayout layout, RenderState state, VkPipelineCache cache)
+    {
+        bool built = true;
+        for (uint32_t part = 0; part < PartCount; part++)
+        {
+            Library* library = libraries[part];
+            std::call_once(library->Once, [&]()
+                {
+                    try
+                    {
+                        library->Handle = CreatePart(static_cast<Part>(part), stages, description, layout, state, cache);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::cerr << "Cannot create pipeline library part " << part << ": " << e.what() << std::endl;
+                        library->Failed = true;
+                    }
+                });
+            built &= !library->Failed;
+        }
+
+        return built;
+    }
+
+    VkPipeline PipelineLibrary::CreatePart(Part part, const std::vector<VkPipelineShaderStageCreateInfo>& stages,
+        const VertexBuffer::VertexInputDescription& description, VkPipelineLayout layout, RenderState state, VkPipelineCache cache)
+    {
+        PipelineStateInfo stateInfo(description, state);
+
+        VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+        libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = &libraryInfo;
+        //Retained so the background link can still optimize across parts
+        pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+        std::vector<VkPipelineShaderStageCreateInfo> partStages;
+        switch (part)
+        {
+        case VertexInput:
+            libraryInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+            pipelineInfo.pVertexInputState = &stateInfo.VertexInput;
+            pipelineInfo.pInputAssemblyState = &stateInfo.InputAssembly;
+            break;
+        case PreRasterization:
+            libraryInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+            for (const auto& stage : stages)
+            {
+                if (stage.stage != VK_SHADER_STAGE_FRAGMENT_BIT)
+                {
+                    partStages.push_back(stage);
+                }
+            }
+            pipelineInfo.pViewportState = &stateInfo.Viewport;
+            pipelineInfo.pRasterizationState = &stateInfo.Rasterization;
+            pipelineInfo.pDynamicState = &stateInfo.Dynamic;
+            pipelineInfo.layout = layout;
+            break;
+        case FragmentShader:
+            libraryInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+            for (const auto& stage : stages)
+            {
+                if (stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+                {
+                    partStages.push_back(stage);
+                }
+            }
+            pipelineInfo.pDepthStencilState = &stateInfo.DepthStencil;
+            pipelineInfo.pMultisampleState = &stateInfo.Multisample;
+            pipelineInfo.layout = layout;
+            break;
+        case FragmentOutput:
+            libraryInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+            pipelineInfo.pColorBlendState = &stateInfo.ColorBlend;
+            pipelineInfo.pMultisampleState = &stateInfo.Multisample;
+            break;
+        default:
+            throw std::runtime_error("unknown pipeline library part!");
+        }
+
+        pipelineInfo.stageCount = static_cast<uint32_t>(partStages.size());
+        pipelineInfo.pStages = partStages.data();
+        pipelineInfo.renderPass = part == VertexInput ? VK_NULL_HANDLE : VulkanEngine::GetRenderPass();
+        pipelineInfo.subpass = 0;
+
+        VkPipeline library;
+        if (vkCreateGraphicsPipelines(VulkanEngine::GetDevice(), cache, 1, &pipelineInfo, nullptr, &library) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline library!");
+        }
+
+        return library;
+    }
+
+    VkPipeline PipelineLibrary::Link(const LibrarySet& libraries, VkPipelineLayout layout, bool optimize, VkPipelineCache cache)
+    {
+        std::array<VkPipeline, PartCount> handles;
+        for (uint32_t part = 0; part < PartCount; part++)
+        {
+            handles[part] = libraries[part]->Handle;
+        }
+
+        VkPipelineLibraryCreateInfoKHR linkInfo{};
+        linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+        linkInfo.libraryCount = static_cast<uint32_t>(handles.size());
+        linkInfo.pLibraries = handles.data();
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = &linkInfo;
+        pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+        pipelineInfo.layout = layout;
+
+        VkPipeline pipeline;
+        if (vkCreateGraphicsPipelines(VulkanEngine::GetDevice(), cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to link graphics pipeline!");
+        }
+
+        return pipeline;
+    }
+
+    void PipelineLibrary::Release(const LibrarySet& libraries)
+    {
+        for (Library* library : libraries)
+        {
+            library->Users.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    uint32_t PipelineLibrary::GetLibraryCount(Part part)
+    {
+        uint32_t count = 0;
+        for (const auto& [key, library] : sm_Libraries)
+        {
+            count += key.LibraryPart == part && library->Handle != VK_NULL_HANDLE;
+        }
+        return count;
+    }
+
+    void PipelineLibrary::ReleaseModule(VkShaderModule module)
+    {
+        uint64_t moduleBits = HandleBits(module);
+        for (auto it = sm_Libraries.begin(); it != sm_Libraries.end();)
+        {
+            //Field positions as written by Acquire
+            const LibraryKey& key = it->first;
+            bool usesModule = (key.LibraryPart == VertexInput && key.Fields[1] == moduleBits) ||
+                ((key.LibraryPart == PreRasterization || key.LibraryPart == FragmentShader) && key.Fields[0] == moduleBits);
+            if (!usesModule)
+            {
+                ++it;
+                continue;
+            }
+
+            sm_Released.push_back(std::move(it->second));
+            it = sm_Libraries.erase(it);
+        }
+    }
+
+    void PipelineLibrary::Update()
+    {
+        for (size_t i = 0; i < sm_Released.size();)
+        {
+            Library& library = *sm_Released[i];
+            if (library.Users.load(std::memory_order_acquire) > 0)
+            {
+                i++;
+                continue;
+            }
+
+            if (library.Handle != VK_NULL_HANDLE)
+            {
+                vkDestroyPipeline(VulkanEngine::GetDevice(), library.Handle, nullptr);
+            }
+            sm_Released[i] = std::move(sm_Released.back());
+            sm_Released.pop_back();
+        }
+    }
+
+    void PipelineLibrary::CleanUp()
+    {
+        for (auto& [_, library] : sm_Libraries)
+        {
+            if (library->Handle != VK_NULL_HANDLE)
+            {
+                vkDestroyPipeline(VulkanEngine::GetDevice(), library->Handle, nullptr);
+            }
+        }
+        for (auto& library : sm_Released)
+        {
+            if (library->Handle != VK_NULL_HANDLE)
+            {
+                vkDestroyPipeline(VulkanEngine::GetDevice(), library->Handle, nullptr);
+            }
+        }
+
+        sm_Libraries.clear();
+        sm_Released.clear();
+        sm_Enabled = false;
+    }
+}
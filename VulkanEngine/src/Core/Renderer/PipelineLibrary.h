@@ -0,0 +1,103 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "VertexBuffer.h"
+#include "RenderState.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace CHIKU
+{
+	//Create infos for the fixed-function part of a pipeline, filled from a RenderState. The members point at each other
+	//and at description, which must outlive this, so it can be neither copied nor moved.
+	struct PipelineStateInfo
+	{
+		PipelineStateInfo(const VertexBuffer::VertexInputDescription& description, RenderState state);
+		PipelineStateInfo(const PipelineStateInfo&) = delete;
+		PipelineStateInfo& operator=(const PipelineStateInfo&) = delete;
+
+		VkPipelineVertexInputStateCreateInfo VertexInput{};
+		VkPipelineInputAssemblyStateCreateInfo InputAssembly{};
+		VkPipelineViewportStateCreateInfo Viewport{};
+		VkPipelineRasterizationStateCreateInfo Rasterization{};
+		VkPipelineMultisampleStateCreateInfo Multisample{};
+		VkPipelineColorBlendAttachmentState BlendAttachment{};
+		VkPipelineColorBlendStateCreateInfo ColorBlend{};
+		VkPipelineDepthStencilStateCreateInfo DepthStencil{};
+		std::array<VkDynamicState, 2> DynamicStates{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo Dynamic{};
+	};
+
+	//Graphics pipeline libraries (VK_EXT_graphics_pipeline_library). A pipeline is split into vertex input, pre-rasterization,
+	//fragment shader and fragment output parts, each compiled and cached on its own key. A new PipelineKey then mostly
+	//reuses parts built for other keys and only needs a fast link.
+	class PipelineLibrary
+	{
+	public:
+		enum Part : uint32_t
+		{
+			VertexInput,
+			PreRasterization,
+			FragmentShader,
+			FragmentOutput,
+			PartCount
+		};
+
+		//One compiled part. Built by the first compile job that needs it, jobs needing it at the same time wait on Once.
+		struct Library
+		{
+			std::once_flag Once;
+			VkPipeline Handle = VK_NULL_HANDLE;
+			bool Failed = false;
+			std::atomic<uint32_t> Users{ 0 }; //Compile jobs between Acquire and Release
+		};
+		using LibrarySet = std::array<Library*, PartCount>;
+
+		static void Init(); //Disabled when the device lacks the extension or CHIKU_DISABLE_PIPELINE_LIBRARY is set
+		static bool IsEnabled() { return sm_Enabled; }
+
+		//Main thread only. Finds or adds the parts a pipeline is made of, they are built later by BuildParts.
+		//Every Acquire is paired with a Release once the job is done building and linking from them.
+		static LibrarySet Acquire(const std::vector<VkPipelineShaderStageCreateInfo>& stages, VertexLayoutPreset inputDescription,
+			VkPipelineLayout layout, uint32_t features, RenderState state);
+
+		//Safe on any thread. Builds the parts nobody built yet, false if one of them failed.
+		static bool BuildParts(const LibrarySet& libraries, const std::vector<VkPipelineShaderStageCreateInfo>& stages,
+			const VertexBuffer::VertexInputDescription& description, VkPipelineLayout layout, RenderState state, VkPipelineCache cache);
+		//Links built parts. A fast link takes a fraction of a full compile; optimize runs link-time optimization, which costs about as much as one.
+		static VkPipeline Link(const LibrarySet& libraries, VkPipelineLayout layout, bool optimize, VkPipelineCache cache);
+		//Safe on any thread, after the last BuildParts or Link on the set
+		static void Release(const LibrarySet& libraries);
+
+		//Before a shader module is destroyed. Parts keyed on it are no longer handed out, a new module may get the same handle.
+		static void ReleaseModule(VkShaderModule module);
+		//Once per frame. Destroys released parts no compile job uses anymore, linked pipelines do not need their parts.
+		static void Update();
+
+		static uint32_t GetLibraryCount(Part part);
+		static void CleanUp(); //After every pipeline linked from the libraries is gone
+
+	private:
+		struct LibraryKey
+		{
+			Part LibraryPart;
+			std::array<uint64_t, 4> Fields; //Handles and packed state, unused fields are 0
+
+			bool operator==(const LibraryKey& other) const { return LibraryPart == other.LibraryPart && Fields == other.Fields; }
+		};
+
+		struct LibraryKeyHash
+		{
+			size_t operator()(const LibraryKey& key) const noexcept;
+		};
+
+		static VkPipeline CreatePart(Part part, const std::vector<VkPipelineShaderStageCreateInfo>& stages,
+			const VertexBuffer::VertexInputDescription& description, VkPipelineLayout layout, RenderState state, VkPipelineCache cache);
+
+	private:
+		static bool sm_Enabled;
+		static std::unordered_map<LibraryKey, std::unique_ptr<Library>, LibraryKeyHash> sm_Libraries;
+		static std::vector<std::unique_ptr<Library>> sm_Released; //Kept until Update finds no compile job using them
+	};
+}
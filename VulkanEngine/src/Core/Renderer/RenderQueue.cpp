@@ -0,0 +1,336 @@
+#include "RenderQueue.h"
+#include "GraphicsPipeline.h"
+#include "Material.h"
+#include "UniformBuffer.h"
+#include "VertexBuffer.h"
+#include "IndexBuffer.h"
+#include "InstanceBuffer.h"
+#include "IndirectBuffer.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
+#include "Utils/JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace CHIKU
+{
+    bool RenderQueue::sm_Instancing = true;
+    bool RenderQueue::sm_Indirect = false;
+
+    static uint64_t GetDepthBits(float depth)
+    {
+        //The top 16 bits of a positive float keep its order: exponent and 7 mantissa bits, finer buckets close to the camera
+        if (!(depth > 0.0f))
+        {
+            return 0;
+        }
+
+        uint32_t bits;
+        memcpy(&bits, &depth, sizeof(bits));
+        return bits >> 16;
+    }
+
+    uint64_t RenderQueue::MakeSortKey(Pass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+    {
+        uint64_t key = static_cast<uint64_t>(pass) << 60;
+        uint64_t depthBits = GetDepthBits(depth);
+
+        if (pass == Pass::Transparent)
+        {
+            key |= (0xFFFFull - depthBits) << 44;
+            key |= static_cast<uint64_t>(pipeline & 0xFFF) << 32;
+            key |= static_cast<uint64_t>(material & 0xFFFF) << 16;
+            key |= static_cast<uint64_t>(mesh & 0xFFFF);
+        }
+        else
+        {
+            key |= static_cast<uint64_t>(pipeline & 0xFFF) << 48;
+            key |= static_cast<uint64_t>(material & 0xFFFF) << 32;
+            key |= static_cast<uint64_t>(mesh & 0xFFFF) << 16;
+            key |= depthBits;
+        }
+
+        return key;
+    }
+
+    void RenderQueue::Reserve(uint32_t packetCount)
+    {
+        m_Packets.reserve(packetCount);
+        m_Order.reserve(packetCount);
+        m_Scratch.reserve(packetCount);
+    }
+
+    void RenderQueue::Clear()
+    {
+        m_Packets.clear();
+        m_Order.clear();
+        m_Transforms.clear();
+    }
+
+    void RenderQueue::Submit(uint64_t sortKey, const DrawPacket& packet)
+    {
+        m_Order.push_back({ sortKey, static_cast<uint32_t>(m_Packets.size()) });
+        m_Packets.push_back(packet);
+    }
+
+    const glm::mat4* RenderQueue::StoreTransform(const glm::mat4& transform)
+    {
+        m_Transforms.push_back(transform);
+        return &m_Transforms.back();
+    }
+
+    void RenderQueue::Sort()
+    {
+        Utils::RadixSort(m_Order, m_Scratch);
+    }
+
+    //Whether b can be drawn as another instance of a
+    static bool IsSameDraw(const DrawPacket& a, const DrawPacket& b)
+    {
+        return a.DrawMaterial == b.DrawMaterial && a.Vertices == b.Vertices && a.Indices == b.Indices &&
+            a.FirstIndex == b.FirstIndex && a.IndexCount == b.IndexCount && a.VertexOffset == b.VertexOffset &&
+            a.InstancedPipelineIndex == b.InstancedPipelineIndex;
+    }
+
+    //Whether b can be drawn by the same indirect call as a: one pipeline, material and set of buffers, any submesh
+    static bool IsSameBucket(const DrawPacket& a, const DrawPacket& b)
+    {
+        return a.DrawMaterial == b.DrawMaterial && a.Vertices == b.Vertices && a.Indices == b.Indices &&
+            a.InstancedPipelineIndex == b.InstancedPipelineIndex;
+    }
+
+    //A run never mixes materials, the color still goes per instance so the GPU-culled stream has the same layout
+    static InstanceData MakeInstance(const DrawPacket& packet)
+    {
+        return { *packet.Transform, packet.DrawMaterial->GetBaseColor(), packet.DrawMaterial->GetTextureIndex() };
+    }
+
+    uint32_t RenderQueue::Execute(GraphicsPipeline& pipeline) const
+    {
+        uint32_t boundPipeline = UINT32_MAX;
+        GraphicsPipeline::BoundPipeline bound;
+        const Material* boundMaterial = nullptr;
+        const VertexBuffer* boundVertices = nullptr;
+        const IndexBuffer* boundIndices = nullptr;
+        bool instanceStreamBound = false;
+        uint32_t drawCalls = 0;
+
+        //Both indices come from the same table, so one comparison covers instanced and single draws
+        auto bindPipeline = [&](uint32_t pipelineIndex, const Material& material, VertexLayoutPreset layout)
+            {
+                if (pipelineIndex != boundPipeline)
+                {
+                    bound = pipeline.BindPipeline(material, layout);
+                    boundPipeline = pipelineIndex;
+                    //A different pipeline layout may have disturbed the material's descriptors
+                    boundMaterial = nullptr;
+                }
+                return bound.Layout != VK_NULL_HANDLE; //Otherwise still compiling and no fallback, or failed
+            };
+
+        auto bindDrawState = [&](const DrawPacket& packet)
+            {
+                if (packet.DrawMaterial != boundMaterial)
+                {
+                    packet.DrawMaterial->Bind(bound.Layout, bound.UsesTextureTable);
+                    boundMaterial = packet.DrawMaterial;
+                }
+                if (packet.Vertices != boundVertices)
+                {
+                    packet.Vertices->Bind();
+                    boundVertices = packet.Vertices;
+                }
+                if (packet.Indices != boundIndices)
+                {
+                    packet.Indices->Bind();
+                    boundIndices = packet.Indices;
+                }
+            };
+
+        auto bindInstanced = [&](const DrawPacket& packet)
+            {
+                if (!instanceStreamBound)
+                {
+                    InstanceBuffer::Bind();
+                    instanceStreamBound = true;
+                }
+                bindDrawState(packet);
+
+                //Still needed for the camera, the instanced program ignores the model matrix
+                UniformBuffer::Bind(bound.Layout);
+            };
+
+        //Packets [begin, end) as one indirect call with a command per run of the same submesh
+        auto recordBucket = [&](size_t begin, size_t end)
+            {
+                const DrawPacket& packet = m_Packets[m_Order[begin].Index];
+                if (!bindPipeline(packet.InstancedPipelineIndex, *packet.DrawMaterial, VertexBuffer::GetInstancedLayout(packet.Vertices->GetBufferLayout())))
+                {
+                    return false;
+                }
+
+                uint32_t commandCount = 1;
+                for (size_t j = begin + 1; j < end; j++)
+                {
+                    if (!IsSameDraw(m_Packets[m_Order[j - 1].Index], m_Packets[m_Order[j].Index]))
+                    {
+                        commandCount++;
+                    }
+                }
+
+                uint32_t firstInstance = 0;
+                uint32_t firstCommand = 0;
+                InstanceData* instances = InstanceBuffer::Allocate(static_cast<uint32_t>(end - begin), firstInstance);
+                VkDrawIndexedIndirectCommand* commands = instances ? IndirectBuffer::Allocate(commandCount, firstCommand) : nullptr;
+                if (!commands)
+                {
+                    return false;
+                }
+
+                VkDrawIndexedIndirectCommand* command = commands - 1;
+                for (size_t j = begin; j < end; j++)
+                {
+                    const DrawPacket& draw = m_Packets[m_Order[j].Index];
+                    instances[j - begin] = MakeInstance(draw);
+
+                    if (j == begin || !IsSameDraw(m_Packets[m_Order[j - 1].Index], draw))
+                    {
+                        *++command = { draw.IndexCount, 0, draw.FirstIndex, draw.VertexOffset, firstInstance + static_cast<uint32_t>(j - begin) };
+                    }
+                    command->instanceCount++;
+                }
+
+                bindInstanced(packet);
+                drawCalls += IndirectBuffer::Draw(firstCommand, commandCount);
+                return true;
+            };
+
+        for (size_t i = 0; i < m_Order.size();)
+        {
+            const DrawPacket& packet = m_Packets[m_Order[i].Index];
+
+            if (sm_Indirect && sm_Instancing && packet.InstancedPipelineIndex != NO_INSTANCING)
+            {
+                size_t bucketEnd = i + 1;
+                while (bucketEnd < m_Order.size() && IsSameBucket(packet, m_Packets[m_Order[bucketEnd].Index]))
+                {
+                    bucketEnd++;
+                }
+
+                if (bucketEnd - i >= MIN_INSTANCES && recordBucket(i, bucketEnd))
+                {
+                    i = bucketEnd;
+                    continue;
+                }
+            }
+
+            size_t runEnd = i + 1;
+            if (sm_Instancing && packet.InstancedPipelineIndex != NO_INSTANCING)
+            {
+                while (runEnd < m_Order.size() && IsSameDraw(packet, m_Packets[m_Order[runEnd].Index]))
+                {
+                    runEnd++;
+                }
+            }
+
+            uint32_t instanceCount = static_cast<uint32_t>(runEnd - i);
+            if (instanceCount >= MIN_INSTANCES &&
+                bindPipeline(packet.InstancedPipelineIndex, *packet.DrawMaterial, VertexBuffer::GetInstancedLayout(packet.Vertices->GetBufferLayout())))
+            {
+                uint32_t firstInstance = 0;
+                if (InstanceData* instances = InstanceBuffer::Allocate(instanceCount, firstInstance))
+                {
+                    for (size_t j = i; j < runEnd; j++)
+                    {
+                        instances[j - i] = MakeInstance(m_Packets[m_Order[j].Index]);
+                    }
+
+                    bindInstanced(packet);
+                    CommandRecorder::DrawIndexed(packet.IndexCount, instanceCount, packet.FirstIndex, packet.VertexOffset, firstInstance);
+                    drawCalls++;
+
+                    i = runEnd;
+                    continue;
+                }
+            }
+
+            //No run, or the instanced pipeline or stream is not available: draw the run one by one
+            for (; i < runEnd; i++)
+            {
+                const DrawPacket& single = m_Packets[m_Order[i].Index];
+                if (!bindPipeline(single.PipelineIndex, *single.DrawMaterial, single.Vertices->GetBufferLayout()))
+                {
+                    continue;
+                }
+                bindDrawState(single);
+
+                UniformBuffer::Bind(bound.Layout, *single.Transform, single.DrawMaterial->GetBaseColor());
+                CommandRecorder::DrawIndexed(single.IndexCount, 1, single.FirstIndex, single.VertexOffset, 0);
+                drawCalls++;
+            }
+        }
+
+        return drawCalls;
+    }
+
+    void RenderQueue::Benchmark(uint32_t iterations)
+    {
+        //Distributions of a large scene: few pipelines, more materials, many meshes, every packet at its own depth
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<uint32_t> pipelines(0, 31);
+        std::uniform_int_distribution<uint32_t> materials(0, 1023);
+        std::uniform_int_distribution<uint32_t> meshes(0, 8191);
+        std::uniform_real_distribution<float> depths(0.1f, 1000.0f);
+        std::uniform_int_distribution<uint32_t> transparent(0, 9);
+
+        for (uint32_t packetCount : { 10000u, 100000u, 1000000u })
+        {
+            struct Source
+            {
+                uint32_t Pipeline, Material, Mesh;
+                float Depth;
+                Pass DrawPass;
+            };
+            std::vector<Source> sources(packetCount);
+            for (Source& source : sources)
+            {
+                source = { pipelines(random), materials(random), meshes(random), depths(random), transparent(random) == 0 ? Pass::Transparent : Pass::Opaque };
+            }
+
+            RenderQueue queue;
+            queue.Reserve(packetCount);
+
+            double submitMilliseconds = 0.0;
+            double sortMilliseconds = 0.0;
+            for (uint32_t iteration = 0; iteration < iterations; iteration++)
+            {
+                queue.Clear();
+
+                auto start = std::chrono::high_resolution_clock::now();
+                for (const Source& source : sources)
+                {
+                    DrawPacket packet{};
+                    packet.PipelineIndex = source.Pipeline;
+                    packet.InstancedPipelineIndex = NO_INSTANCING;
+                    queue.Submit(MakeSortKey(source.DrawPass, source.Pipeline, source.Material, source.Mesh, source.Depth), packet);
+                }
+                auto submitted = std::chrono::high_resolution_clock::now();
+                queue.Sort();
+                auto sorted = std::chrono::high_resolution_clock::now();
+
+                submitMilliseconds += std::chrono::duration<double, std::milli>(submitted - start).count();
+                sortMilliseconds += std::chrono::duration<double, std::milli>(sorted - submitted).count();
+            }
+
+            bool ordered = std::is_sorted(queue.m_Order.begin(), queue.m_Order.end(),
+                [](const Utils::SortItem& a, const Utils::SortItem& b) { return a.Key < b.Key; });
+
+            std::cout << "Render queue, " << packetCount << " packets over " << iterations << " iterations: submit "
+                << submitMilliseconds / iterations << " ms, sort " << sortMilliseconds / iterations << " ms ("
+                << Utils::JobSystem::GetWorkerCount() + 1 << " threads)" << (ordered ? "" : ", NOT SORTED") << std::endl;
+        }
+    }
+}
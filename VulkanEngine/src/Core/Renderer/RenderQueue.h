@@ -0,0 +1,84 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "Utils/RadixSort.h"
+#include <glm/glm.hpp>
+#include <deque>
+#include <vector>
+
+namespace CHIKU
+{
+	class GraphicsPipeline;
+	class Material;
+	class VertexBuffer;
+	class IndexBuffer;
+
+	//Everything needed to record one indexed draw. Only the sort key decides the order, the packet is read while walking.
+	struct DrawPacket
+	{
+		const Material* DrawMaterial;
+		const VertexBuffer* Vertices;
+		const IndexBuffer* Indices;
+		const glm::mat4* Transform; //Must stay valid until Execute
+		uint32_t FirstIndex;
+		uint32_t IndexCount;
+		int32_t VertexOffset;
+		uint32_t PipelineIndex; //GraphicsPipeline::GetPipelineIndex, compared in full when walking
+		uint32_t InstancedPipelineIndex; //Same for the instanced vertex layout, RenderQueue::NO_INSTANCING when there is none
+	};
+
+	//Draws of one frame, collected in any order, radix-sorted by a 64-bit key and recorded with a bind only where
+	//the pipeline, material or mesh actually changes. Runs of packets that draw the same submesh with the same material
+	//end up adjacent and are recorded as one instanced draw, with their transforms in InstanceBuffer.
+	//In indirect mode every run of packets sharing the material and GeometryPool buffers becomes a bucket, recorded as
+	//one IndirectBuffer call with a command per submesh.
+	class RenderQueue
+	{
+	public:
+		static constexpr uint32_t NO_INSTANCING = UINT32_MAX;
+		//Shorter runs are drawn one by one, a single instance gains nothing from the instance stream
+		static constexpr uint32_t MIN_INSTANCES = 2;
+
+		enum class Pass : uint32_t
+		{
+			Opaque,     //Grouped by pipeline, material and mesh, then front to back
+			Transparent //Back to front, grouped by state only among equal depths
+		};
+
+		//Opaque:      pass:4 | pipeline:12 | material:16 | mesh:16 | depth:16
+		//Transparent: pass:4 | inverted depth:16 | pipeline:12 | material:16 | mesh:16
+		//IDs are truncated to their field, a collision only costs a redundant bind. Depth is view space distance.
+		static uint64_t MakeSortKey(Pass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+		void Reserve(uint32_t packetCount);
+		void Clear();
+		void Submit(uint64_t sortKey, const DrawPacket& packet);
+		//Storage for transforms built while submitting, e.g. an entity's placed in its model. Valid until Clear.
+		const glm::mat4* StoreTransform(const glm::mat4& transform);
+		void Sort();
+		//Inside the render pass, after Sort. Returns the number of draw calls recorded.
+		uint32_t Execute(GraphicsPipeline& pipeline) const;
+
+		uint32_t GetPacketCount() const { return static_cast<uint32_t>(m_Packets.size()); }
+		//After Sort, the packet Execute records at position index
+		const DrawPacket& GetSortedPacket(uint32_t index) const { return m_Packets[m_Order[index].Index]; }
+
+		//Times key building plus Submit, and Sort, for 10k, 100k and 1M synthetic packets. Enabled with CHIKU_BENCHMARK_RENDER_QUEUE=<iterations>.
+		static void Benchmark(uint32_t iterations);
+
+		//On unless CHIKU_DISABLE_INSTANCING is set, see Renderer::Init
+		static void SetInstancing(bool enabled) { sm_Instancing = enabled; }
+		static bool IsInstancing() { return sm_Instancing; }
+		//Needs instancing. On when IndirectBuffer::IsSupported() unless CHIKU_DISABLE_INDIRECT is set, see Renderer::Init
+		static void SetIndirect(bool enabled) { sm_Indirect = enabled; }
+		static bool IsIndirect() { return sm_Indirect; }
+
+	private:
+		std::vector<DrawPacket> m_Packets; //Submission order
+		std::vector<Utils::SortItem> m_Order; //Sort keys with an index into m_Packets
+		std::vector<Utils::SortItem> m_Scratch;
+		std::deque<glm::mat4> m_Transforms; //Never moves an element, packets point into it
+
+		static bool sm_Instancing;
+		static bool sm_Indirect;
+	};
+}
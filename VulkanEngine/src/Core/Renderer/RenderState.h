@@ -0,0 +1,62 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "Utils/Hash.h"
+#include <cstring>
+#include <type_traits>
+
+namespace CHIKU
+{
+	enum class BlendMode : uint32_t
+	{
+		Opaque,
+		Alpha,   //src * srcAlpha + dst * (1 - srcAlpha)
+		Additive //src * srcAlpha + dst
+	};
+
+	//Fixed-function state of a pipeline packed into 32 bits. Fields hold the Vulkan enum values directly.
+	struct RenderState
+	{
+		uint32_t Topology : 4;     //VkPrimitiveTopology
+		uint32_t PolygonMode : 2;  //VkPolygonMode
+		uint32_t CullMode : 2;     //VkCullModeFlags
+		uint32_t FrontFace : 1;    //VkFrontFace
+		uint32_t DepthTest : 1;
+		uint32_t DepthWrite : 1;
+		uint32_t DepthCompare : 3; //VkCompareOp
+		uint32_t Blend : 2;        //BlendMode
+		uint32_t Unused : 16;
+
+		RenderState()
+			: Topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST), PolygonMode(VK_POLYGON_MODE_FILL), CullMode(VK_CULL_MODE_NONE),
+			FrontFace(VK_FRONT_FACE_CLOCKWISE), DepthTest(1), DepthWrite(1), DepthCompare(VK_COMPARE_OP_LESS),
+			Blend(static_cast<uint32_t>(BlendMode::Opaque)), Unused(0)
+		{
+		}
+
+		uint32_t Pack() const
+		{
+			uint32_t bits;
+			memcpy(&bits, this, sizeof(bits));
+			return bits;
+		}
+
+		static RenderState Unpack(uint32_t bits)
+		{
+			RenderState state;
+			memcpy(static_cast<void*>(&state), &bits, sizeof(bits));
+			return state;
+		}
+
+		bool operator==(const RenderState& other) const { return Pack() == other.Pack(); }
+	};
+
+	static_assert(sizeof(RenderState) == sizeof(uint32_t), "RenderState must stay packed into 32 bits");
+	static_assert(std::is_trivially_copyable<RenderState>::value, "RenderState is copied as raw bits");
+
+	//Hash of everything a material contributes to its pipeline key. Computed when the material changes, not per draw.
+	inline uint64_t HashMaterialState(uint32_t shaderID, uint32_t features, RenderState state, uint32_t materialPreset)
+	{
+		uint32_t fields[4] = { shaderID, features, state.Pack(), materialPreset };
+		return Utils::HashBytes(fields, sizeof(fields));
+	}
+}
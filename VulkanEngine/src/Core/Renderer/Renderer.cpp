@@ -1,92 +1,267 @@
 #include "Renderer.h"
 #include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
 #include "Shader.h"
 #include "UniformBuffer.h"
-#include <tiny_obj_loader.h>
-#include <fstream>
+#include "AssetManager.h"
+#include "PipelineCache.h"
+#include "DescriptorLayoutCache.h"
+#include "DescriptorAllocator.h"
+#include "TextureTable.h"
+#include "ComputePipeline.h"
+#include "InstanceBuffer.h"
+#include "IndirectBuffer.h"
+#include "GeometryPool.h"
+#include "GPUCulling.h"
+#include "Utils/FrustumCulling.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
 #include <iostream>
+#include <json.hpp>
 
 namespace CHIKU
 {
+    //Per mode, the first frames compile pipelines and are not measured
+    static constexpr uint32_t INSTANCING_BENCHMARK_WARMUP_FRAMES = 60;
+    static constexpr uint32_t INSTANCING_BENCHMARK_MEASURED_FRAMES = 240;
+    static constexpr uint32_t INSTANCING_BENCHMARK_MODE_FRAMES = INSTANCING_BENCHMARK_WARMUP_FRAMES + INSTANCING_BENCHMARK_MEASURED_FRAMES;
+
+    //One by one, instanced, indirect, GPU culled
+    static void SetDrawMode(uint32_t mode)
+    {
+        RenderQueue::SetInstancing(mode >= 1);
+        RenderQueue::SetIndirect(mode >= 2 && IndirectBuffer::IsSupported());
+        GPUCulling::SetEnabled(mode >= 3 && GPUCulling::IsSupported());
+    }
+
+    static void SetDefaultDrawMode()
+    {
+        RenderQueue::SetInstancing(std::getenv("CHIKU_DISABLE_INSTANCING") == nullptr);
+        RenderQueue::SetIndirect(RenderQueue::IsInstancing() && IndirectBuffer::IsSupported() && std::getenv("CHIKU_DISABLE_INDIRECT") == nullptr);
+        GPUCulling::SetEnabled(RenderQueue::IsIndirect() && GPUCulling::IsSupported() && std::getenv("CHIKU_DISABLE_GPU_CULLING") == nullptr);
+    }
+
     Renderer* Renderer::s_Instance = new Renderer();
 
 	void Renderer::Init()
 	{
+		AssetManager::Init();
 		VertexBuffer::Init();
 		ShaderManager::Init();
+		DescriptorAllocator::InitFrameAllocators();
         UniformBuffer::Init();
+		TextureTable::Init();
+		PipelineCache::Init();
 		m_GraphicsPipeline.Init();
+		m_GraphicsPipeline.Prewarm();
+
+		SetDefaultDrawMode();
+		GPUCulling::SetValidation(std::getenv("CHIKU_VALIDATE_GPU_CULLING") != nullptr);
+		GPUCulling::SetOcclusion(std::getenv("CHIKU_DISABLE_OCCLUSION_CULLING") == nullptr);
+		m_CPUCulling = std::getenv("CHIKU_DISABLE_CPU_CULLING") == nullptr;
+		CommandRecorder::SetFiltering(std::getenv("CHIKU_DISABLE_STATE_FILTERING") == nullptr);
+		if (const char* copies = std::getenv("CHIKU_BENCHMARK_INSTANCING"))
+		{
+			StartInstancingBenchmark(static_cast<uint32_t>(std::max(1, std::atoi(copies))));
+		}
+		else
+		{
+			LoadScene("scenes/default.json");
+		}
 
-		m_Material.CreateMaterial(MaterialPresets::Unlit);
-		LoadModel();
+		if (const char* iterations = std::getenv("CHIKU_BENCHMARK_RENDER_QUEUE"))
+		{
+			RenderQueue::Benchmark(std::max(1, std::atoi(iterations)));
+		}
+
+		if (const char* iterations = std::getenv("CHIKU_BENCHMARK_CULLING"))
+		{
+			Utils::FrustumCullBenchmark(std::max(1, std::atoi(iterations)));
+		}
 	}
 
-    void Renderer::LoadModel()
+    void Renderer::LoadScene(const std::string& path)
+    {
+        m_Scene.Load(path);
+        ReserveFrameResources();
+    }
+
+    void Renderer::ReserveFrameResources()
+    {
+        m_RenderQueue.Reserve(m_Scene.GetDrawCount());
+        InstanceBuffer::Reserve(m_Scene.GetDrawCount());
+        //A command per packet at most, when no two packets share a submesh
+        IndirectBuffer::Reserve(m_Scene.GetDrawCount());
+        m_GPUCulling.Build(m_Scene, m_GraphicsPipeline);
+    }
+
+    void Renderer::StartInstancingBenchmark(uint32_t copies)
     {
-        std::vector<uint32_t> indices;
-        std::vector<glm::vec3> data;
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
-
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, (SOURCE_DIR + "models/viking_room.obj").c_str()))
+        //Copies of the default scene's first entity on a square grid around it
+        std::vector<char> source = AssetManager::ReadFile("scenes/default.json");
+        nlohmann::json document = nlohmann::json::parse(source.begin(), source.end());
+
+        nlohmann::json entity = document["entities"][0];
+        std::vector<float> origin = entity.value("position", std::vector<float>{ 0.0f, 0.0f, 0.0f });
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(copies))));
+        const float spacing = 2.5f;
+
+        nlohmann::json entities = nlohmann::json::array();
+        for (uint32_t i = 0; i < copies; i++)
         {
-            throw std::runtime_error(warn + err);
+            float x = (static_cast<float>(i % side) - side * 0.5f) * spacing;
+            float y = (static_cast<float>(i / side) - side * 0.5f) * spacing;
+            entity["position"] = { origin[0] + x, origin[1] + y, origin[2] };
+            entities.push_back(entity);
         }
+        document["entities"] = std::move(entities);
+
+        m_Scene.Load(document, "instancing benchmark");
+        ReserveFrameResources();
+
+        SetDrawMode(0);
+        m_BenchmarkFramesLeft = INSTANCING_BENCHMARK_MODES * INSTANCING_BENCHMARK_MODE_FRAMES;
+        m_BenchmarkLastFrame = std::chrono::high_resolution_clock::now();
+        std::cout << "Instancing benchmark: " << copies << " copies, " << INSTANCING_BENCHMARK_MEASURED_FRAMES << " frames per mode" << std::endl;
+    }
+
+    void Renderer::UpdateInstancingBenchmark(double recordMilliseconds, uint32_t drawCalls)
+    {
+        auto now = std::chrono::high_resolution_clock::now();
+        uint32_t frame = INSTANCING_BENCHMARK_MODES * INSTANCING_BENCHMARK_MODE_FRAMES - m_BenchmarkFramesLeft;
+        uint32_t mode = frame / INSTANCING_BENCHMARK_MODE_FRAMES;
 
-        for (const auto& shape : shapes)
+        if (frame % INSTANCING_BENCHMARK_MODE_FRAMES >= INSTANCING_BENCHMARK_WARMUP_FRAMES)
         {
-            for (const auto& index : shape.mesh.indices)
-            {
-                glm::vec3 position = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-                };
-
-                glm::vec3 color = { 1.0f, 1.0f, 1.0f };
-                glm::vec3 texCoord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-                    1.0f };
-
-                data.emplace_back(position);
-                data.emplace_back(color);
-                data.emplace_back(texCoord);
-
-                indices.push_back((uint32_t)indices.size());
-            }
+            m_BenchmarkRecordMilliseconds[mode] += recordMilliseconds;
+            //Includes waiting for the frame in flight, so it follows the GPU once that is the bottleneck
+            m_BenchmarkFrameMilliseconds[mode] += std::chrono::duration<double, std::milli>(now - m_BenchmarkLastFrame).count();
+            m_BenchmarkDrawCalls[mode] += drawCalls;
+            m_BenchmarkIssuedCommands[mode] += CommandRecorder::GetStatistics().Issued;
+            m_BenchmarkSkippedCommands[mode] += CommandRecorder::GetStatistics().Skipped;
         }
+        m_BenchmarkLastFrame = now;
 
-        std::vector<uint8_t> vertexBytes(
-            reinterpret_cast<uint8_t*>(data.data()),
-            reinterpret_cast<uint8_t*>(data.data()) + data.size() * sizeof(glm::vec3)
-        );
+        if ((frame + 1) % INSTANCING_BENCHMARK_MODE_FRAMES == 0 && mode + 1 < INSTANCING_BENCHMARK_MODES)
+        {
+            SetDrawMode(mode + 1);
+        }
 
-        m_VertexBuffer.SetLayout(VertexLayoutPreset::UnLitMesh);
-        m_VertexBuffer.CreateVertexBuffer(vertexBytes);
-        m_IndexBuffer.CreateIndexBuffer(indices);
+        if (--m_BenchmarkFramesLeft == 0)
+        {
+            const char* names[] = { "one by one", "instanced", IndirectBuffer::IsSupported() ? "indirect" : "indirect (unsupported, instanced)",
+                GPUCulling::IsSupported() ? "GPU culled" : "GPU culled (unsupported, indirect)" };
+            for (uint32_t i = 0; i < INSTANCING_BENCHMARK_MODES; i++)
+            {
+                std::cout << "Instancing benchmark, " << names[i] << ": " << m_BenchmarkDrawCalls[i] / INSTANCING_BENCHMARK_MEASURED_FRAMES
+                    << " draw calls, " << m_BenchmarkIssuedCommands[i] / INSTANCING_BENCHMARK_MEASURED_FRAMES
+                    << " commands (" << m_BenchmarkSkippedCommands[i] / INSTANCING_BENCHMARK_MEASURED_FRAMES << " redundant skipped)"
+                    << ", record " << m_BenchmarkRecordMilliseconds[i] / INSTANCING_BENCHMARK_MEASURED_FRAMES
+                    << " ms, frame " << m_BenchmarkFrameMilliseconds[i] / INSTANCING_BENCHMARK_MEASURED_FRAMES << " ms" << std::endl;
+            }
+            SetDefaultDrawMode();
+        }
     }
 
 	void Renderer::Draw()
 	{
+        DescriptorAllocator::BeginFrame();
+
+        ShaderManager::PollHotReload();
+
+        //Compile jobs read shader modules that a registry refresh or a hot reload may destroy
+        if (!m_GraphicsPipeline.IsCompiling() && !ComputePipeline::IsCompiling())
+        {
+            ShaderManager::RefreshRegistry();
+            for (const std::string& shaderID : ShaderManager::ApplyHotReload())
+            {
+                m_GraphicsPipeline.Reload(shaderID);
+                ComputePipeline::Reload(shaderID);
+            }
+        }
+        PipelineCache::Update();
+        m_GraphicsPipeline.Update();
+        ComputePipeline::Update();
+        UniformBuffer::Update();
+        InstanceBuffer::BeginFrame();
+        IndirectBuffer::BeginFrame();
 
-		m_GraphicsPipeline.Bind(m_Material,m_VertexBuffer);
-        m_IndexBuffer.Bind();
-		vkCmdDrawIndexed(VulkanEngine::GetCommandBuffer(),m_IndexBuffer.GetCount(), 1, 0, 0, 0);
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        m_RenderQueue.Clear();
+        glm::mat4 viewProjection = UniformBuffer::GetProjection() * UniformBuffer::GetView();
+        bool gpuCulling = m_GPUCulling.IsActive();
+        if (m_CPUCulling)
+        {
+            //Entities the GPU culls are left out, the rest are few and tested one by one
+            Utils::FrustumPlanes planes = Utils::GetFrustumPlanes(viewProjection);
+            if (gpuCulling)
+            {
+                m_Scene.Cull(planes, m_GPUCulling.GetCPUEntities(), m_VisibleEntities);
+            }
+            else
+            {
+                m_Scene.Cull(planes, m_VisibleEntities);
+            }
+            m_Scene.Submit(m_RenderQueue, m_GraphicsPipeline, UniformBuffer::GetView(), m_VisibleEntities);
+        }
+        else if (gpuCulling)
+        {
+            m_Scene.Submit(m_RenderQueue, m_GraphicsPipeline, UniformBuffer::GetView(), m_GPUCulling.GetCPUEntities());
+        }
+        else
+        {
+            m_Scene.Submit(m_RenderQueue, m_GraphicsPipeline, UniformBuffer::GetView());
+        }
+        m_RenderQueue.Sort();
+        //At most one per-draw slot per packet, grown before anything of the frame binds the uniform set
+        UniformBuffer::Reserve(m_RenderQueue.GetPacketCount());
+
+        if (gpuCulling)
+        {
+            m_GPUCulling.Cull(viewProjection);
+        }
+
+        //Compute work (ComputePipeline) is recorded above this line, dispatches are not allowed inside the render pass
+        VulkanEngine::BeginRenderPass();
+        uint32_t drawCalls = gpuCulling ? m_GPUCulling.Draw(m_GraphicsPipeline) : 0;
+        if (gpuCulling && m_GPUCulling.IsOcclusionActive())
+        {
+            //Second phase against the depth of the first. The RenderQueue comes after it, its transparent draws need
+            //every opaque one drawn before them.
+            VulkanEngine::EndRenderPass();
+            m_GPUCulling.CullOcclusion(viewProjection);
+            VulkanEngine::BeginRenderPass();
+            drawCalls += m_GPUCulling.Draw(m_GraphicsPipeline, 1);
+        }
+        drawCalls += m_RenderQueue.Execute(m_GraphicsPipeline);
+
+        if (m_BenchmarkFramesLeft > 0)
+        {
+            UpdateInstancingBenchmark(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count(), drawCalls);
+        }
 	}
 
 	void Renderer::CleanUp()
 	{
-        m_Material.CleanUp();
-        m_VertexBuffer.CleanUp();
-        m_IndexBuffer.CleanUp();
+        m_GPUCulling.CleanUp();
+        m_Scene.CleanUp();
+        GeometryPool::CleanUp();
+
+		//Waits for in-flight compiles, which still use the shader modules and descriptor set layout
+		m_GraphicsPipeline.CleanUp();
+		ComputePipeline::CleanUp();
 
         UniformBuffer::CleanUp();
+        InstanceBuffer::CleanUp();
+        IndirectBuffer::CleanUp();
+		TextureTable::CleanUp();
+		DescriptorAllocator::CleanUpFrameAllocators();
 		ShaderManager::Cleanup();
+		DescriptorLayoutCache::CleanUp();
 
-		m_GraphicsPipeline.CleanUp();
+		PipelineCache::CleanUp();
+		AssetManager::CleanUp();
 	}
 
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #pragma once
 #include "VulkanHeader.h"
 #include "GraphicsPipeline.h"
+#include "Scene.h"
+#include "RenderQueue.h"
+#include "GPUCulling.h"
 #include <string>
+#include <chrono>
+#include <vector>
 
 namespace CHIKU
 {
@@ -10,15 +15,31 @@ namespace CHIKU
 	public:
 		static Renderer* s_Instance;
 		void Init();
-		void LoadModel();
+		void LoadScene(const std::string& path);
 		void Draw();
 		void CleanUp();
 
+	private:
+		void ReserveFrameResources(); //Per-frame buffers sized for the loaded scene
+		void StartInstancingBenchmark(uint32_t copies);
+		void UpdateInstancingBenchmark(double recordMilliseconds, uint32_t drawCalls);
+
 	private:
 		GraphicsPipeline m_GraphicsPipeline;
+		Scene m_Scene;
+		RenderQueue m_RenderQueue;
+		GPUCulling m_GPUCulling;
+		bool m_CPUCulling = true; //Off with CHIKU_DISABLE_CPU_CULLING
+		std::vector<uint32_t> m_VisibleEntities;
 
-		VertexBuffer m_VertexBuffer;
-		IndexBuffer m_IndexBuffer;
-		Material m_Material;
+		//CHIKU_BENCHMARK_INSTANCING=<copies>. The frames are split between drawing one by one, instanced, indirect and GPU culled.
+		static constexpr uint32_t INSTANCING_BENCHMARK_MODES = 4;
+		uint32_t m_BenchmarkFramesLeft = 0;
+		std::chrono::high_resolution_clock::time_point m_BenchmarkLastFrame;
+		double m_BenchmarkRecordMilliseconds[INSTANCING_BENCHMARK_MODES] = {};
+		double m_BenchmarkFrameMilliseconds[INSTANCING_BENCHMARK_MODES] = {};
+		uint64_t m_BenchmarkDrawCalls[INSTANCING_BENCHMARK_MODES] = {};
+		uint64_t m_BenchmarkIssuedCommands[INSTANCING_BENCHMARK_MODES] = {}; //Graphics state and draws through CommandRecorder
+		uint64_t m_BenchmarkSkippedCommands[INSTANCING_BENCHMARK_MODES] = {};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "Scene.h"
+#include "GraphicsPipeline.h"
+#include "RenderQueue.h"
+#include "AssetManager.h"
+#include "UniformBuffer.h"
+#include <json.hpp>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace CHIKU
+{
+    void Scene::Load(const std::string& path)
+    {
+        CleanUp();
+
+        std::string extension = std::filesystem::path(path).extension().string();
+        if (extension == ".json")
+        {
+            std::vector<char> source = AssetManager::ReadFile(path);
+            Compile(nlohmann::json::parse(source.begin(), source.end()), path);
+        }
+        else if (!AssetManager::MapFile(path, m_File))
+        {
+            //Packed scenes are decompressed into memory, loose ones are mapped
+            std::vector<char> data = AssetManager::ReadFile(path);
+            SetOwnedData(data.data(), data.size());
+        }
+
+        LoadTables(path);
+    }
+
+    void Scene::Load(const nlohmann::json& document, const std::string& name)
+    {
+        CleanUp();
+        Compile(document, name);
+        LoadTables(name);
+    }
+
+    void Scene::Compile(const nlohmann::json& document, const std::string& name)
+    {
+        std::vector<uint8_t> compiled;
+        std::string error;
+        if (!Utils::CompileScene(document, [](const std::string& file, std::vector<char>& data) { return AssetManager::ReadFile(file, data); }, compiled, error))
+        {
+            throw std::runtime_error("failed to compile scene " + name + ": " + error);
+        }
+
+        SetOwnedData(compiled.data(), compiled.size());
+    }
+
+    void Scene::SetOwnedData(const void* data, size_t size)
+    {
+        m_OwnedData.resize((size + sizeof(OwnedBlock) - 1) / sizeof(OwnedBlock));
+        m_OwnedSize = size;
+        if (size > 0)
+        {
+            memcpy(m_OwnedData.data(), data, size);
+        }
+    }
+
+    void Scene::LoadTables(const std::string& path)
+    {
+        const uint8_t* data = m_File.IsOpen() ? m_File.GetData() : reinterpret_cast<const uint8_t*>(m_OwnedData.data());
+        size_t size = m_File.IsOpen() ? m_File.GetSize() : m_OwnedSize;
+        if (!m_View.Open(data, size))
+        {
+            throw std::runtime_error("invalid scene file: " + path);
+        }
+
+        m_Models.resize(m_View.GetMeshCount());
+        for (uint32_t i = 0; i < m_View.GetMeshCount(); i++)
+        {
+            m_Models[i].Load(std::string(m_View.GetString(m_View.GetMeshes()[i].Path)));
+        }
+
+        m_Materials.resize(m_View.GetMaterialCount());
+        for (uint32_t i = 0; i < m_View.GetMaterialCount(); i++)
+        {
+            const Utils::SceneMaterialRecord& record = m_View.GetMaterials()[i];
+            m_Materials[i].CreateMaterial(static_cast<MaterialPresets>(record.Preset));
+            m_Materials[i].SetName(std::string(m_View.GetString(record.Name)));
+            m_Materials[i].SetBaseColor(record.BaseColor);
+            m_Materials[i].SetTexturePath(std::string(m_View.GetString(record.Texture)));
+            m_Materials[i].SetFeatures(record.Features);
+        }
+
+        const glm::mat4* transforms = m_View.GetTransforms();
+        const uint32_t* meshHandles = m_View.GetMeshHandles();
+        m_DrawCount = 0;
+        m_Bounds.Resize(m_View.GetEntityCount());
+        for (uint32_t i = 0; i < m_View.GetEntityCount(); i++)
+        {
+            m_DrawCount += m_Models[meshHandles[i]].GetDrawCount();
+            m_Bounds.Set(i, Utils::TransformSphere(transforms[i], m_Models[meshHandles[i]].GetBounds()));
+        }
+
+        UniformBuffer::Reserve(m_DrawCount);
+    }
+
+    void Scene::Submit(RenderQueue& queue, GraphicsPipeline& pipeline, const glm::mat4& view) const
+    {
+        for (uint32_t i = 0; i < m_View.GetEntityCount(); i++)
+        {
+            SubmitEntity(queue, pipeline, view, i);
+        }
+    }
+
+    void Scene::Submit(RenderQueue& queue, GraphicsPipeline& pipeline, const glm::mat4& view, const std::vector<uint32_t>& entities) const
+    {
+        for (uint32_t entity : entities)
+        {
+            SubmitEntity(queue, pipeline, view, entity);
+        }
+    }
+
+    void Scene::Cull(const Utils::FrustumPlanes& planes, std::vector<uint32_t>& visible) const
+    {
+        Utils::FrustumCull(m_Bounds, planes, visible);
+    }
+
+    void Scene::Cull(const Utils::FrustumPlanes& planes, const std::vector<uint32_t>& entities, std::vector<uint32_t>& visible) const
+    {
+        visible.clear();
+        for (uint32_t entity : entities)
+        {
+            if (Utils::IsSphereVisible(planes, m_Bounds.Get(entity)))
+            {
+                visible.push_back(entity);
+            }
+        }
+    }
+
+    void Scene::SubmitEntity(RenderQueue& queue, GraphicsPipeline& pipeline, const glm::mat4& view, uint32_t entity) const
+    {
+        const glm::mat4& transform = m_View.GetTransforms()[entity];
+        uint32_t materialHandle = m_View.GetMaterialHandles()[entity];
+
+        //Distance of the entity's origin along the view direction, the camera looks down -Z
+        float depth = -(view * transform[3]).z;
+
+        const Model& model = m_Models[m_View.GetMeshHandles()[entity]];
+        if (materialHandle != Utils::SCENE_INVALID_HANDLE)
+        {
+            model.Submit(queue, pipeline, m_Materials[materialHandle], transform, depth);
+        }
+        else
+        {
+            model.Submit(queue, pipeline, transform, depth);
+        }
+    }
+
+    void Scene::CleanUp()
+    {
+        for (auto& model : m_Models)
+        {
+            model.CleanUp();
+        }
+
+        for (auto& material : m_Materials)
+        {
+            material.CleanUp();
+        }
+
+        m_Models.clear();
+        m_Materials.clear();
+        //The scene owns every model, so the whole pool is free again
+        GeometryPool::Reset();
+        m_View = Utils::SceneView();
+        m_Bounds = Utils::BoundingSpheres();
+        m_OwnedData.clear();
+        m_OwnedSize = 0;
+        m_File.Close();
+        m_DrawCount = 0;
+    }
+}
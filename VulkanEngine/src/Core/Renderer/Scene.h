@@ -0,0 +1,63 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "Model.h"
+#include "Utils/MappedFile.h"
+#include "Utils/SceneFormat.h"
+#include "Utils/FrustumCulling.h"
+#include <string>
+#include <vector>
+
+namespace CHIKU
+{
+	class GraphicsPipeline;
+	class RenderQueue;
+
+	//Entities live in the SoA tables of a compiled scene (see Utils/SceneFormat.h). A loose .chsc is mapped and
+	//used in place, so loading costs one mmap plus one Model per distinct mesh regardless of the entity count.
+	class Scene
+	{
+	public:
+		//Accepts a compiled .chsc or a .json authoring file, which is compiled in memory
+		void Load(const std::string& path);
+		//Compiles an authoring document built in code, name is only used in errors
+		void Load(const nlohmann::json& document, const std::string& name);
+		//Adds a draw packet per entity and submesh, keyed by its view space depth under the given view matrix
+		void Submit(RenderQueue& queue, GraphicsPipeline& pipeline, const glm::mat4& view) const;
+		//Same for the listed entities only, e.g. those GPUCulling leaves to the CPU
+		void Submit(RenderQueue& queue, GraphicsPipeline& pipeline, const glm::mat4& view, const std::vector<uint32_t>& entities) const;
+		//Entities whose bounds intersect the frustum, over every entity with SIMD on the job system
+		void Cull(const Utils::FrustumPlanes& planes, std::vector<uint32_t>& visible) const;
+		//Same over the listed entities only, one at a time
+		void Cull(const Utils::FrustumPlanes& planes, const std::vector<uint32_t>& entities, std::vector<uint32_t>& visible) const;
+		void CleanUp();
+
+		const Utils::SceneView& GetView() const { return m_View; }
+		uint32_t GetDrawCount() const { return m_DrawCount; } //Pipeline binds needed to draw every entity once
+		const Model& GetModel(uint32_t meshHandle) const { return m_Models[meshHandle]; }
+		const Material& GetMaterial(uint32_t materialHandle) const { return m_Materials[materialHandle]; }
+
+	private:
+		void Compile(const nlohmann::json& document, const std::string& name);
+		void LoadTables(const std::string& path); //From the mapped file or m_OwnedData
+		void SubmitEntity(RenderQueue& queue, GraphicsPipeline& pipeline, const glm::mat4& view, uint32_t entity) const;
+
+	private:
+		//Tables are used in place, so storage of their own must be as aligned as a mapping, which a vector of char is not
+		struct alignas(Utils::SCENE_TABLE_ALIGNMENT) OwnedBlock
+		{
+			uint8_t Bytes[Utils::SCENE_TABLE_ALIGNMENT];
+		};
+
+		void SetOwnedData(const void* data, size_t size);
+
+		Utils::MappedFile m_File;
+		std::vector<OwnedBlock> m_OwnedData; //Backs m_View when the scene was compiled or read from an archive
+		size_t m_OwnedSize = 0;
+		Utils::SceneView m_View;
+
+		std::vector<Model> m_Models; //Indexed by mesh handle
+		std::vector<Material> m_Materials; //Indexed by material handle
+		Utils::BoundingSpheres m_Bounds; //World space, by entity. Entities do not move once loaded.
+		uint32_t m_DrawCount = 0;
+	};
+}
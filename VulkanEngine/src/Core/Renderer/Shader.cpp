@@ -1,39 +1,418 @@
 #include "Shader.h"
 #include "VulkanEngine/VulkanEngine.h"
+#include "AssetManager.h"
+#include "ShaderCache.h"
+#include "DescriptorLayoutCache.h"
+#include "ShaderFeatures.h"
+#include "UniformBuffer.h"
+#include "TextureTable.h"
+#include "PipelineLibrary.h"
+#include "Utils/Hash.h"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <json.hpp>
 #include <spirv_reflect.h>
 
 namespace CHIKU
 {
     std::unordered_map<std::string, ShaderManager::ShaderProgram> ShaderManager::sm_ShaderPrograms;
+    std::unordered_map<std::string, ShaderProgramInfo> ShaderManager::sm_ShaderRegistry;
+    std::filesystem::file_time_type ShaderManager::sm_RegistryWriteTime;
+    std::vector<std::string> ShaderManager::sm_InternedIDs;
+    std::unordered_map<std::string, uint32_t> ShaderManager::sm_InternedHandles;
+    Utils::FileWatcher ShaderManager::sm_SourceWatcher;
+    std::vector<std::string> ShaderManager::sm_ChangedSources;
+    std::vector<ShaderManager::ProgramReload> ShaderManager::sm_Reloads;
+    Utils::JobGroup ShaderManager::sm_ReloadJobs;
 
     ShaderManager::~ShaderManager() 
     {
         Cleanup();
     }
 
+    static const std::string SHADER_LIST_PATH = "shader/shaderlist.json";
+    static const std::string SHADER_DIRECTORY = "shader/";
+
+    static uint64_t HashCode(const std::vector<std::vector<char>>& code)
+    {
+        uint64_t hash = 0;
+        for (const auto& stage : code)
+        {
+            hash = Utils::HashBytes(stage.data(), stage.size(), hash);
+        }
+        return hash;
+    }
+
+    static bool ParseFeatures(const nlohmann::json& node, const std::string& ID, ShaderProgramInfo& program)
+    {
+        for (auto it = node.begin(); it != node.end(); ++it)
+        {
+            ShaderFeatureSwitch feature;
+            feature.Bit = GetShaderFeatureBit(it.key());
+            if (feature.Bit == 0 || (program.SupportedFeatures & feature.Bit))
+            {
+                std::cerr << "Shader program " << ID << ": unknown or repeated feature " << it.key() << std::endl;
+                return false;
+            }
+
+            const nlohmann::json& value = it.value();
+            if (value.is_object() && value.contains("constant") && value["constant"].is_number_unsigned())
+            {
+                feature.ConstantID = value["constant"].get<int32_t>();
+            }
+            else if (value.is_object() && value.contains("define") && value["define"].is_string())
+            {
+                feature.Define = value["define"].get<std::string>();
+                program.DefineFeatures |= feature.Bit;
+            }
+            else
+            {
+                std::cerr << "Shader program " << ID << ": feature " << it.key() << " needs a \"constant\" or a \"define\"" << std::endl;
+                return false;
+            }
+
+            program.SupportedFeatures |= feature.Bit;
+            program.Features.push_back(feature);
+        }
+        return true;
+    }
+
+    //Flattens nested objects into "a/b" program IDs. A program is an array of stage paths, or an object with
+    //"stages" and optional "features".
+    static void FlattenShaderList(const nlohmann::json& node, const std::string& prefix, std::unordered_map<std::string, ShaderProgramInfo>& registry)
+    {
+        const nlohmann::json* stages = node.is_array() ? &node : nullptr;
+        if (node.is_object() && node.contains("stages") && node["stages"].is_array())
+        {
+            stages = &node["stages"];
+        }
+
+        if (stages)
+        {
+            ShaderProgramInfo program;
+            for (const auto& path : *stages)
+            {
+                if (path.is_string())
+                {
+                    program.Stages.push_back(path.get<std::string>());
+                }
+            }
+
+            if (node.is_object() && node.contains("features") && !ParseFeatures(node["features"], prefix, program))
+            {
+                return;
+            }
+            registry[prefix] = std::move(program);
+            return;
+        }
+
+        if (node.is_object())
+        {
+            for (auto it = node.begin(); it != node.end(); ++it)
+            {
+                FlattenShaderList(it.value(), prefix.empty() ? it.key() : prefix + "/" + it.key(), registry);
+            }
+        }
+    }
+
+    static std::filesystem::file_time_type GetShaderListWriteTime()
+    {
+        std::error_code error;
+        auto time = std::filesystem::last_write_time(SOURCE_DIR + SHADER_LIST_PATH, error);
+        return error ? std::filesystem::file_time_type::min() : time;
+    }
+
+    bool ShaderManager::LoadRegistry(std::unordered_map<std::string, ShaderProgramInfo>& registry)
+    {
+        std::vector<char> fileData;
+        if (!AssetManager::ReadFile(SHADER_LIST_PATH, fileData))
+        {
+            std::cerr << "Error: Could not open file: " << SHADER_LIST_PATH << std::endl;
+            return false;
+        }
+
+        nlohmann::json shaderJson = nlohmann::json::parse(fileData.begin(), fileData.end(), nullptr, false);
+        if (shaderJson.is_discarded())
+        {
+            std::cerr << "Error parsing JSON: " << SHADER_LIST_PATH << std::endl;
+            return false;
+        }
+
+        FlattenShaderList(shaderJson, "", registry);
+
+        //Programs with a missing or unknown stage are left out so lookups fail at the ID, not at pipeline creation
+        for (auto it = registry.begin(); it != registry.end();)
+        {
+            bool valid = true;
+            for (const auto& stage : it->second.Stages)
+            {
+                std::string extension = std::filesystem::path(stage).extension().string();
+                if (extension != ".vert" && extension != ".frag" && extension != ".geo" && extension != ".comp")
+                {
+                    std::cerr << "Shader program " << it->first << ": unsupported stage " << stage << std::endl;
+                    valid = false;
+                }
+                else if (!ShaderCache::Exists(stage))
+                {
+                    std::cerr << "Shader program " << it->first << ": missing stage " << stage << std::endl;
+                    valid = false;
+                }
+            }
+
+            it = valid ? std::next(it) : registry.erase(it);
+        }
+
+        return true;
+    }
+
     void ShaderManager::Init()
     {
+        sm_RegistryWriteTime = GetShaderListWriteTime();
+        sm_ShaderRegistry.clear();
+        if (!LoadRegistry(sm_ShaderRegistry))
+        {
+            return;
+        }
+
+        //Compile all stages of all programs up front and in parallel, once per combination of the program's define
+        //features, so no variant a material asks for later compiles on the render thread. Programs are then created
+        //from the results.
+        std::vector<ShaderCache::ShaderVariant> variants;
+        for (const auto& [_, program] : sm_ShaderRegistry)
+        {
+            //Every subset of the define bits, walked as submasks of DefineFeatures
+            uint32_t defineFeatures = program.DefineFeatures;
+            for (uint32_t subset = defineFeatures;; subset = (subset - 1) & defineFeatures)
+            {
+                const std::vector<std::string> defines = GetDefines(program, subset);
+                for (const auto& stage : program.Stages)
+                {
+                    bool known = std::any_of(variants.begin(), variants.end(), [&](const ShaderCache::ShaderVariant& variant)
+                        {
+                            return variant.Path == stage && variant.Defines == defines;
+                        });
+                    if (!known)
+                    {
+                        variants.push_back({ stage, defines });
+                    }
+                }
+
+                if (subset == 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        ShaderCache::CompileAll(variants);
+        StartHotReload();
     }
 
-    std::vector<char> ShaderManager::ReadFile(const std::string& filePath) 
+    void ShaderManager::RefreshRegistry()
     {
-        std::ifstream file(SOURCE_DIR + filePath, std::ios::ate | std::ios::binary);
+        static auto lastCheck = std::chrono::steady_clock::now();
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastCheck < std::chrono::milliseconds(500))
+        {
+            return;
+        }
+        lastCheck = now;
+
+        auto writeTime = GetShaderListWriteTime();
+        if (writeTime == sm_RegistryWriteTime)
+        {
+            return;
+        }
+        sm_RegistryWriteTime = writeTime;
+
+        std::unordered_map<std::string, ShaderProgramInfo> registry;
+        if (!LoadRegistry(registry))
+        {
+            return; //Keep the last good registry while the file is being edited
+        }
+
+        //Only programs whose stages or features changed or disappeared are dropped; they are rebuilt on next use
+        for (const auto& [ID, program] : sm_ShaderRegistry)
+        {
+            auto updated = registry.find(ID);
+            if (updated == registry.end() || updated->second != program)
+            {
+                DestroyProgram(ID);
+            }
+        }
+
+        sm_ShaderRegistry = std::move(registry);
+    }
+
+    void ShaderManager::DestroyProgram(const std::string& ID)
+    {
+        //Pipelines keep their own copy of the code, so modules can go as soon as no pipeline is being created from them
+        for (auto program = sm_ShaderPrograms.begin(); program != sm_ShaderPrograms.end();)
+        {
+            if (program->first != ID && program->first.rfind(ID + "#", 0) != 0)
+            {
+                ++program;
+                continue;
+            }
+
+            DestroyModules(program->second);
+            program = sm_ShaderPrograms.erase(program);
+        }
+    }
+
+    void ShaderManager::DestroyModules(ShaderProgram& program)
+    {
+        for (auto& [_, module] : program.ShaderModules)
+        {
+            PipelineLibrary::ReleaseModule(module);
+            vkDestroyShaderModule(VulkanEngine::GetDevice(), module, nullptr);
+        }
+        program.ShaderModules.clear();
+        program.Stages.clear();
+    }
+
+    void ShaderManager::StartHotReload()
+    {
+        //Offline builds never run the compiler, there is nothing to reload from
+        if (ShaderCache::IsOfflineOnly() || std::getenv("CHIKU_DISABLE_HOT_RELOAD"))
+        {
+            return;
+        }
+
+        if (!sm_SourceWatcher.Start(SOURCE_DIR + SHADER_DIRECTORY))
+        {
+            std::cerr << "Shader hot reload is off, cannot watch " << SOURCE_DIR + SHADER_DIRECTORY << std::endl;
+        }
+    }
+
+    void ShaderManager::PollHotReload()
+    {
+        if (!sm_SourceWatcher.IsRunning())
+        {
+            return;
+        }
+
+        std::vector<std::string> changed;
+        sm_SourceWatcher.Poll(changed);
+        for (const auto& path : changed)
+        {
+            //Only GLSL sources and includes; compiler output, editor temporaries and shaderlist.json (RefreshRegistry's) share the tree
+            static const std::vector<std::string> sourceExtensions = { ".vert", ".frag", ".geo", ".geom", ".comp", ".tesc", ".tese", ".glsl", ".h", ".inc" };
+            std::string extension = std::filesystem::path(path).extension().string();
+            if (path.rfind("cache/", 0) == 0 || std::find(sourceExtensions.begin(), sourceExtensions.end(), extension) == sourceExtensions.end())
+            {
+                continue;
+            }
 
-        if (!file)
+            std::string source = SHADER_DIRECTORY + path;
+            if (std::find(sm_ChangedSources.begin(), sm_ChangedSources.end(), source) == sm_ChangedSources.end())
+            {
+                sm_ChangedSources.push_back(source);
+            }
+        }
+
+        //One reload at a time, edits made meanwhile are picked up by the next one
+        if (sm_ChangedSources.empty() || !sm_Reloads.empty())
         {
-            throw std::runtime_error("Failed to open shader file: " + filePath);
+            return;
         }
 
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
+        //A changed file that is no program's stage is taken to be an include and every loaded program is recompiled.
+        //Programs that do not include it hit the SPIR-V cache and are dropped by their code hash.
+        bool includeChanged = std::any_of(sm_ChangedSources.begin(), sm_ChangedSources.end(), [](const std::string& source)
+            {
+                return std::none_of(sm_ShaderRegistry.begin(), sm_ShaderRegistry.end(), [&source](const auto& program)
+                    {
+                        return std::find(program.second.Stages.begin(), program.second.Stages.end(), source) != program.second.Stages.end();
+                    });
+            });
+
+        for (const auto& [variantKey, program] : sm_ShaderPrograms)
+        {
+            const std::string ID = variantKey.substr(0, variantKey.find('#'));
+            const ShaderProgramInfo* info = GetProgramInfo(ID);
+            if (!info)
+            {
+                continue;
+            }
 
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-        file.close();
-        return buffer;
+            bool affected = includeChanged || std::any_of(info->Stages.begin(), info->Stages.end(), [](const std::string& stage)
+                {
+                    return std::find(sm_ChangedSources.begin(), sm_ChangedSources.end(), stage) != sm_ChangedSources.end();
+                });
+            if (affected)
+            {
+                sm_Reloads.push_back({ ID, variantKey, info->Stages, GetDefines(*info, program.DefineFeatures) });
+            }
+        }
+        sm_ChangedSources.clear();
+
+        //Results CompileAll kept for programs not created yet predate the edit
+        ShaderCache::DiscardPrecompiled();
+
+        //sm_Reloads is complete before the first job starts and is not resized until they are all done
+        for (auto& reload : sm_Reloads)
+        {
+            Utils::JobSystem::Submit([&reload]()
+                {
+                    reload.Code.resize(reload.Stages.size());
+                    for (size_t i = 0; i < reload.Stages.size(); i++)
+                    {
+                        //A failed compile keeps the running version instead of falling back to the prebuilt SPIR-V
+                        if (!ShaderCache::GetSPIRV(reload.Stages[i], reload.Defines, reload.Code[i], false))
+                        {
+                            return;
+                        }
+                    }
+                    reload.CodeHash = HashCode(reload.Code);
+                    reload.Compiled = true;
+                }, &sm_ReloadJobs);
+        }
+    }
+
+    std::vector<std::string> ShaderManager::ApplyHotReload()
+    {
+        std::vector<std::string> reloadedIDs;
+        if (sm_Reloads.empty() || !sm_ReloadJobs.IsDone())
+        {
+            return reloadedIDs;
+        }
+
+        for (auto& reload : sm_Reloads)
+        {
+            auto current = sm_ShaderPrograms.find(reload.VariantKey);
+            const ShaderProgramInfo* info = GetProgramInfo(reload.ID);
+
+            //A registry refresh may have dropped the program meanwhile, it is then rebuilt from scratch on next use
+            if (!reload.Compiled || current == sm_ShaderPrograms.end() || !info || info->Stages != reload.Stages ||
+                reload.CodeHash == current->second.CodeHash)
+            {
+                continue;
+            }
+
+            ShaderProgram program;
+            if (!BuildProgram(reload.ID, *info, reload.Code, program))
+            {
+                std::cerr << "Keeping the previous version of shader program " << reload.ID << std::endl;
+                continue;
+            }
+            program.DefineFeatures = current->second.DefineFeatures;
+
+            DestroyModules(current->second);
+            current->second = std::move(program);
+
+            if (std::find(reloadedIDs.begin(), reloadedIDs.end(), reload.ID) == reloadedIDs.end())
+            {
+                std::cout << "Reloaded shader program " << reload.ID << std::endl;
+                reloadedIDs.push_back(reload.ID);
+            }
+        }
+
+        sm_Reloads.clear();
+        return reloadedIDs;
     }
 
     VkShaderModule ShaderManager::CreateShaderModule(const std::vector<char>& code) 
@@ -52,164 +431,408 @@ namespace CHIKU
         return shaderModule;
     }
 
-    bool ShaderManager::GetShaderPath(const std::filesystem::path& ID, std::vector<std::string>& shaderPaths)
+    const ShaderProgramInfo* ShaderManager::GetProgramInfo(const std::filesystem::path& ID)
+    {
+        auto program = sm_ShaderRegistry.find(ID.generic_string());
+        return program != sm_ShaderRegistry.end() ? &program->second : nullptr;
+    }
+
+    std::string ShaderManager::GetVariantKey(const std::string& ID, uint32_t defineFeatures)
+    {
+        return defineFeatures == 0 ? ID : ID + "#" + std::to_string(defineFeatures);
+    }
+
+    uint32_t ShaderManager::InternID(const std::string& ID)
+    {
+        auto found = sm_InternedHandles.find(ID);
+        if (found != sm_InternedHandles.end())
+        {
+            return found->second;
+        }
+
+        uint32_t handle = static_cast<uint32_t>(sm_InternedIDs.size());
+        sm_InternedIDs.push_back(ID);
+        sm_InternedHandles.emplace(ID, handle);
+        return handle;
+    }
+
+    uint32_t ShaderManager::GetSupportedFeatures(const std::filesystem::path& ID)
+    {
+        const ShaderProgramInfo* info = GetProgramInfo(ID);
+        return info ? info->SupportedFeatures : 0;
+    }
+
+    void ShaderManager::GetSpecialization(const std::filesystem::path& ID, uint32_t features, std::vector<VkSpecializationMapEntry>& entries, std::vector<VkBool32>& values)
+    {
+        entries.clear();
+        values.clear();
+
+        const ShaderProgramInfo* info = GetProgramInfo(ID);
+        if (!info)
+        {
+            return;
+        }
+
+        for (const auto& feature : info->Features)
+        {
+            if (feature.ConstantID < 0)
+            {
+                continue;
+            }
+
+            VkSpecializationMapEntry entry{};
+            entry.constantID = static_cast<uint32_t>(feature.ConstantID);
+            entry.offset = static_cast<uint32_t>(values.size() * sizeof(VkBool32));
+            entry.size = sizeof(VkBool32);
+            entries.push_back(entry);
+            values.push_back((features & feature.Bit) ? VK_TRUE : VK_FALSE);
+        }
+    }
+
+    uint32_t ShaderManager::GetVariantCount(const std::filesystem::path& ID)
     {
-        std::vector<std::string> keys;
-        std::string filePath = SOURCE_DIR + "shader/shaderlist.json";
-        nlohmann::json shaderJson;
-        nlohmann::json* current = &shaderJson;
+        const std::string key = ID.generic_string();
+        uint32_t count = 0;
+        for (const auto& [variant, _] : sm_ShaderPrograms)
+        {
+            count += variant == key || variant.rfind(key + "#", 0) == 0;
+        }
+        return count;
+    }
 
-        //Get the Keys
-        for (const auto& part : ID)
+    bool ShaderManager::CreateShaderProgram(const std::filesystem::path& ID, uint32_t features)
+    {
+        const ShaderProgramInfo* info = GetProgramInfo(ID);
+        if (!info)
         {
-            keys.push_back(part.string());
+            std::cerr << "Shader program not found: " << ID.generic_string() << std::endl;
+            return false;
         }
 
-        //Check if Shader List file exists
-        if (!std::filesystem::exists(filePath))
+        uint32_t defineFeatures = features & info->DefineFeatures;
+        const std::string variantKey = GetVariantKey(ID.generic_string(), defineFeatures);
+        if (sm_ShaderPrograms.count(variantKey))
         {
-            std::cerr << "Error: File does not exist: " << filePath << std::endl;
-            return 1;
+            return true; // Already loaded
         }
 
-        //Load Shader List
-        std::ifstream inputFile(filePath);
-        if (!inputFile.is_open())
+        const std::vector<std::string> defines = GetDefines(*info, defineFeatures);
+        std::vector<std::vector<char>> code(info->Stages.size());
+        for (size_t i = 0; i < info->Stages.size(); i++)
         {
-            std::cerr << "Error: Could not open file: " << filePath << std::endl;
-            return 1;
+            if (!ShaderCache::GetSPIRV(info->Stages[i], defines, code[i]))
+            {
+                std::cerr << "Failed to load SPIR-V for: " << info->Stages[i] << std::endl;
+                return false;
+            }
         }
 
-        //parse the Shader Lists file into Json
-        try
+        ShaderProgram program;
+        if (!BuildProgram(ID.generic_string(), *info, code, program))
         {
-            inputFile >> shaderJson;
+            return false;
         }
-        catch (const std::exception& e)
+        program.DefineFeatures = defineFeatures;
+        sm_ShaderPrograms[variantKey] = std::move(program);
+
+        return true;
+    }
+
+    std::vector<std::string> ShaderManager::GetDefines(const ShaderProgramInfo& info, uint32_t defineFeatures)
+    {
+        std::vector<std::string> defines;
+        for (const auto& feature : info.Features)
         {
-            std::cerr << "Error parsing JSON: " << e.what() << std::endl;
-            return 1;
+            if (defineFeatures & feature.Bit)
+            {
+                defines.push_back(feature.Define + "=1");
+            }
         }
+        return defines;
+    }
 
-        for (const auto& key : keys)
+    bool ShaderManager::BuildProgram(const std::string& ID, const ShaderProgramInfo& info, const std::vector<std::vector<char>>& code, ShaderProgram& program)
+    {
+        for (size_t i = 0; i < info.Stages.size(); i++)
         {
-            if (current->contains(key))
+            const std::string& path = info.Stages[i];
+            auto index = path.find_last_of(".");
+
+            ShaderStages stage;
+            VkShaderStageFlagBits stageFlag;
+            if (path.substr(index + 1, path.size()) == "vert")
             {
-                current = &(*current)[key];
+                stage = ShaderStages::Vertex;
+                stageFlag = VK_SHADER_STAGE_VERTEX_BIT;
+            }
+            else if (path.substr(index + 1, path.size()) == "frag")
+            {
+                stage = ShaderStages::Fragment;
+                stageFlag = VK_SHADER_STAGE_FRAGMENT_BIT;
+            }
+            else if (path.substr(index + 1, path.size()) == "geo")
+            {
+                stage = ShaderStages::Geometry;
+                stageFlag = VK_SHADER_STAGE_GEOMETRY_BIT;
+            }
+            else if (path.substr(index + 1, path.size()) == "comp")
+            {
+                stage = ShaderStages::Compute;
+                stageFlag = VK_SHADER_STAGE_COMPUTE_BIT;
             }
             else
             {
-                std::cerr << "Key not found: " << key << std::endl;
-                return 1;
+                continue;
             }
+
+            if (!ReflectStage(path, code[i], stageFlag, program.Layout))
+            {
+                DestroyModules(program);
+                return false;
+            }
+            program.ShaderModules[stage] = CreateShaderModule(code[i]);
+        }
+        program.CodeHash = HashCode(code);
+
+        if (program.ShaderModules.count(ShaderStages::Compute) && program.ShaderModules.size() > 1)
+        {
+            std::cerr << "Shader program " << ID << " mixes a compute stage with graphics stages" << std::endl;
+            DestroyModules(program);
+            return false;
         }
 
-        if (current->is_array())
+        //Every set index up to the highest one used needs a layout, unused ones get the empty layout
+        uint32_t setCount = program.Layout.Sets.empty() ? 0 : program.Layout.Sets.rbegin()->first + 1;
+        program.SetLayouts.resize(setCount);
+        for (uint32_t set = 0; set < setCount; set++)
         {
-            shaderPaths.resize(current->size());
-            for (size_t i = 0; i < current->size(); ++i)
+            auto bindings = program.Layout.Sets.find(set);
+            program.SetLayouts[set] = GetEngineSetLayout(set, bindings != program.Layout.Sets.end() ? bindings->second : std::vector<VkDescriptorSetLayoutBinding>{});
+        }
+        program.PipelineLayout = DescriptorLayoutCache::GetPipelineLayout(program.SetLayouts, program.Layout.PushConstants);
+
+        for (const auto& feature : info.Features)
+        {
+            if (feature.ConstantID >= 0 && std::find(program.Layout.SpecializationConstants.begin(), program.Layout.SpecializationConstants.end(),
+                static_cast<uint32_t>(feature.ConstantID)) == program.Layout.SpecializationConstants.end())
             {
-                shaderPaths[i] = current->at(i).get<std::string>();
+                std::cerr << "Warning: shader program " << ID << " has no specialization constant " << feature.ConstantID << std::endl;
             }
         }
-        else
+
+        //In pipeline order, the map is sorted by ShaderStages
+        for (const auto& [stage, module] : program.ShaderModules)
         {
-            std::cerr << "Final element is not an array." << std::endl;
-            return 0;
+            VkPipelineShaderStageCreateInfo stageInfo{};
+            stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stageInfo.stage = GetStageFlag(stage);
+            stageInfo.module = module;
+            stageInfo.pName = "main";
+            program.Stages.push_back(stageInfo);
         }
 
-        return 1;
+        return true;
     }
 
-    bool ShaderManager::CreateShaderProgram(const std::filesystem::path& ID)
+    VkShaderStageFlagBits ShaderManager::GetStageFlag(ShaderStages stage)
     {
-        if (sm_ShaderPrograms.count(ID.string()))
+        switch (stage)
         {
-            return true; // Already loaded
+        case ShaderStages::Vertex: return VK_SHADER_STAGE_VERTEX_BIT;
+        case ShaderStages::Tessellation: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case ShaderStages::Geometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case ShaderStages::Fragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case ShaderStages::Compute: return VK_SHADER_STAGE_COMPUTE_BIT;
         }
 
-        std::vector<std::string> shaderPaths;
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    }
 
-        if (!GetShaderPath(ID,shaderPaths))
+    VkDescriptorSetLayout ShaderManager::GetEngineSetLayout(uint32_t set, const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+    {
+        //The per-draw set is always UniformBuffer's, a program that reads only part of it, e.g. the uniforms without the texture, still binds it
+        if (set == 0 && !bindings.empty())
         {
+            std::vector<VkDescriptorSetLayoutBinding> uniformBindings = UniformBuffer::GetDescriptorSetBindings(GenericUniformBuffers::MVP);
+            bool subset = std::all_of(bindings.begin(), bindings.end(), [&](const VkDescriptorSetLayoutBinding& binding)
+                {
+                    return std::any_of(uniformBindings.begin(), uniformBindings.end(), [&](const VkDescriptorSetLayoutBinding& uniform)
+                        {
+                            return uniform.binding == binding.binding && uniform.descriptorType == binding.descriptorType &&
+                                uniform.descriptorCount == binding.descriptorCount && (uniform.stageFlags & binding.stageFlags) == binding.stageFlags;
+                        });
+                });
+            if (subset)
+            {
+                return UniformBuffer::GetDescriptorSetLayout(GenericUniformBuffers::MVP);
+            }
+        }
+
+        //The texture array needs binding flags reflection cannot express, the table owns its layout
+        if (set == TextureTable::SET && TextureTable::IsEnabled() && bindings.size() == 1 &&
+            bindings[0].binding == 0 && bindings[0].descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+        {
+            return TextureTable::GetSetLayout();
+        }
+
+        return DescriptorLayoutCache::GetSetLayout(bindings);
+    }
+
+    bool ShaderManager::ReflectStage(const std::string& path, const std::vector<char>& code, VkShaderStageFlagBits stage, ShaderLayout& layout)
+    {
+        spv_reflect::ShaderModule module(code.size(), code.data());
+        if (module.GetResult() != SPV_REFLECT_RESULT_SUCCESS)
+        {
+            std::cerr << "Failed to reflect SPIR-V of " << path << std::endl;
             return false;
         }
 
-        ShaderProgram program;
-        for (auto path : shaderPaths)
+        uint32_t count = 0;
+        module.EnumerateDescriptorBindings(&count, nullptr);
+        std::vector<SpvReflectDescriptorBinding*> bindings(count);
+        module.EnumerateDescriptorBindings(&count, bindings.data());
+
+        for (const SpvReflectDescriptorBinding* reflected : bindings)
         {
-            auto index = path.find_last_of(".");
-            CreateSPIRV(path, path + ".spv");
-            auto code = ReadFile(path + ".spv");
+            VkDescriptorType type = static_cast<VkDescriptorType>(reflected->descriptor_type);
 
-            if (path.substr(index + 1, path.size()) == "vert")
+            //Set 0 of graphics programs is the per-draw set written by UniformBuffer, which hands out one slot per draw through a dynamic offset.
+            //The per-frame block beside it stays a plain uniform buffer.
+            if (reflected->set == 0 && reflected->binding == UniformBuffer::DRAW_BINDING && type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER &&
+                stage != VK_SHADER_STAGE_COMPUTE_BIT)
             {
-                program.ShaderModules[ShaderStages::Vertex] = CreateShaderModule(code);
+                type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             }
-            else if (path.substr(index + 1, path.size()) == "frag")
+
+            std::vector<VkDescriptorSetLayoutBinding>& set = layout.Sets[reflected->set];
+            auto existing = std::find_if(set.begin(), set.end(), [&](const VkDescriptorSetLayoutBinding& binding) { return binding.binding == reflected->binding; });
+            if (existing != set.end())
             {
-                program.ShaderModules[ShaderStages::Fragment] = CreateShaderModule(code);
+                if (existing->descriptorType != type || existing->descriptorCount != reflected->count)
+                {
+                    std::cerr << path << ": set " << reflected->set << " binding " << reflected->binding << " is declared differently by another stage" << std::endl;
+                    return false;
+                }
+                existing->stageFlags |= stage;
+                continue;
             }
-            else if (path.substr(index + 1, path.size()) == "geo")
+
+            VkDescriptorSetLayoutBinding binding{};
+            binding.binding = reflected->binding;
+            binding.descriptorType = type;
+            binding.descriptorCount = reflected->count;
+            binding.stageFlags = stage;
+            set.push_back(binding);
+        }
+
+        count = 0;
+        module.EnumeratePushConstantBlocks(&count, nullptr);
+        std::vector<SpvReflectBlockVariable*> pushConstants(count);
+        module.EnumeratePushConstantBlocks(&count, pushConstants.data());
+
+        for (const SpvReflectBlockVariable* block : pushConstants)
+        {
+            auto existing = std::find_if(layout.PushConstants.begin(), layout.PushConstants.end(),
+                [&](const VkPushConstantRange& range) { return range.offset == block->offset && range.size == block->size; });
+            if (existing != layout.PushConstants.end())
             {
-                program.ShaderModules[ShaderStages::Geometry] = CreateShaderModule(code);
+                existing->stageFlags |= stage;
+                continue;
             }
+
+            layout.PushConstants.push_back({ static_cast<VkShaderStageFlags>(stage), block->offset, block->size });
         }
 
-        VkPipelineShaderStageCreateInfo vertStage{};
-        vertStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertStage.module = program.ShaderModules[ShaderStages::Vertex];
-        vertStage.pName = "main";
+        if (stage == VK_SHADER_STAGE_COMPUTE_BIT)
+        {
+            const auto& localSize = module.GetShaderModule().entry_points[0].local_size;
+            layout.LocalSize = { localSize.x, localSize.y, localSize.z };
+        }
 
-        //TODO Add the code for other pipeline shaders
+        count = 0;
+        module.EnumerateSpecializationConstants(&count, nullptr);
+        std::vector<SpvReflectSpecializationConstant*> constants(count);
+        module.EnumerateSpecializationConstants(&count, constants.data());
+        for (const SpvReflectSpecializationConstant* constant : constants)
+        {
+            if (std::find(layout.SpecializationConstants.begin(), layout.SpecializationConstants.end(), constant->constant_id) == layout.SpecializationConstants.end())
+            {
+                layout.SpecializationConstants.push_back(constant->constant_id);
+            }
+        }
+
+        if (stage == VK_SHADER_STAGE_VERTEX_BIT)
+        {
+            count = 0;
+            module.EnumerateInputVariables(&count, nullptr);
+            std::vector<SpvReflectInterfaceVariable*> inputs(count);
+            module.EnumerateInputVariables(&count, inputs.data());
 
-        VkPipelineShaderStageCreateInfo fragStage{};
-        fragStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragStage.module = program.ShaderModules[ShaderStages::Fragment];
-        fragStage.pName = "main";
+            layout.VertexInputs.clear();
+            for (const SpvReflectInterfaceVariable* input : inputs)
+            {
+                if (input->decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN)
+                {
+                    continue;
+                }
+
+                layout.VertexInputs.push_back({
+                    input->name ? input->name : "",
+                    input->location,
+                    static_cast<VkFormat>(input->format),
+                    (input->type_description->type_flags & SPV_REFLECT_TYPE_FLAG_INT) != 0
+                });
+            }
 
-        program.Stages = { vertStage, fragStage };
-        sm_ShaderPrograms[ID.string()] = program;
+            std::sort(layout.VertexInputs.begin(), layout.VertexInputs.end(),
+                [](const ShaderVertexInput& a, const ShaderVertexInput& b) { return a.Location < b.Location; });
+        }
 
         return true;
     }
 
-    const std::vector<VkPipelineShaderStageCreateInfo>& ShaderManager::GetShaderStages(const std::filesystem::path& ID)
-    {   
-        if (!CreateShaderProgram(ID))
+    const ShaderManager::ShaderProgram& ShaderManager::GetProgram(const std::filesystem::path& ID, uint32_t features)
+    {
+        if (!CreateShaderProgram(ID, features))
         {
             throw std::runtime_error("Shader not loaded: " + ID.string());
         }
 
-        return sm_ShaderPrograms[ID.string()].Stages;
+        return sm_ShaderPrograms[GetVariantKey(ID.generic_string(), features & GetProgramInfo(ID)->DefineFeatures)];
     }
 
-    void ShaderManager::Cleanup() 
+    const ShaderLayout& ShaderManager::GetShaderLayout(const std::filesystem::path& ID, uint32_t features)
     {
-        for (auto& [_, program] : sm_ShaderPrograms) 
-        {
-            for (auto& [_,module] : program.ShaderModules)
-            {
-                vkDestroyShaderModule(VulkanEngine::GetDevice(), module, nullptr);
-            }
-        }
-        sm_ShaderPrograms.clear();
+        return GetProgram(ID, features).Layout;
+    }
+
+    VkPipelineLayout ShaderManager::GetPipelineLayout(const std::filesystem::path& ID, uint32_t features)
+    {
+        return GetProgram(ID, features).PipelineLayout;
     }
 
-    bool ShaderManager::CreateSPIRV(const std::string& a_ShaderPath, const std::string& a_OutPutPath)
+    VkDescriptorSetLayout ShaderManager::GetSetLayout(const std::filesystem::path& ID, uint32_t set, uint32_t features)
     {
-        std::string command = "glslc.exe " + (SOURCE_DIR + a_ShaderPath) + " -o " + (SOURCE_DIR + a_OutPutPath);
-        int result = std::system(command.c_str());
+        const auto& setLayouts = GetProgram(ID, features).SetLayouts;
+        return set < setLayouts.size() ? setLayouts[set] : VK_NULL_HANDLE;
+    }
+
+    const std::vector<VkPipelineShaderStageCreateInfo>& ShaderManager::GetShaderStages(const std::filesystem::path& ID, uint32_t features)
+    {   
+        return GetProgram(ID, features).Stages;
+    }
 
-        if (result != 0)
+    void ShaderManager::Cleanup() 
+    {
+        sm_SourceWatcher.Stop();
+        sm_ReloadJobs.Wait();
+        sm_Reloads.clear();
+        sm_ChangedSources.clear();
+
+        for (auto& [_, program] : sm_ShaderPrograms) 
         {
-            std::cerr << "Shader compilation failed with exit code: " << result << std::endl;
-            return false;
+            DestroyModules(program);
         }
-
-        std::cout << "Compiled successfully: " << a_OutPutPath << std::endl;
-        return true;
+        sm_ShaderPrograms.clear();
     }
 }
\ No newline at end of file
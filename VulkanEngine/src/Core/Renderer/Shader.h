@@ -1,11 +1,52 @@
 #pragma once
 #include "VulkanHeader.h"
 #include "VertexBuffer.h"
+#include "Utils/FileWatcher.h"
+#include "Utils/JobSystem.h"
 #include <variant>
 #include <filesystem>
 
 namespace CHIKU
 {
+    struct ShaderVertexInput
+    {
+        std::string Name;
+        uint32_t Location;
+        VkFormat Format;
+        bool Integer; //Signed or unsigned integer input, needs an integer vertex format
+    };
+
+    //Resource interface of a program, merged over all of its stages by SPIR-V reflection
+    struct ShaderLayout
+    {
+        std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> Sets; //Set index to bindings
+        std::vector<VkPushConstantRange> PushConstants;
+        std::vector<ShaderVertexInput> VertexInputs; //Sorted by location, built-ins excluded
+        std::vector<uint32_t> SpecializationConstants; //Constant IDs declared by any stage
+        std::array<uint32_t, 3> LocalSize{ 0, 0, 0 }; //Workgroup size of a compute program
+    };
+
+    //A feature switch a program implements, see ShaderFeatures.h
+    struct ShaderFeatureSwitch
+    {
+        uint32_t Bit;
+        int32_t ConstantID = -1; //Specialization constant set to VK_TRUE when the feature is on, -1 for define features
+        std::string Define;      //Compiled in as "Define=1" when the feature is on
+
+        bool operator==(const ShaderFeatureSwitch& other) const { return Bit == other.Bit && ConstantID == other.ConstantID && Define == other.Define; }
+    };
+
+    struct ShaderProgramInfo
+    {
+        std::vector<std::string> Stages;
+        std::vector<ShaderFeatureSwitch> Features;
+        uint32_t SupportedFeatures = 0;
+        uint32_t DefineFeatures = 0; //Subset of SupportedFeatures that needs its own SPIR-V
+
+        bool operator==(const ShaderProgramInfo& other) const { return Stages == other.Stages && Features == other.Features; }
+        bool operator!=(const ShaderProgramInfo& other) const { return !(*this == other); }
+    };
+
     class ShaderManager 
     {
     public:
@@ -22,23 +63,84 @@ namespace CHIKU
 
         static void Init();
 
-        static bool CreateShaderProgram(const std::filesystem::path& ID);
-        static const std::vector<VkPipelineShaderStageCreateInfo>& GetShaderStages(const std::filesystem::path& ID) ;
+        //Features are ShaderFeatures bits. Only define features select a different variant, constant features share modules.
+        static bool CreateShaderProgram(const std::filesystem::path& ID, uint32_t features = 0);
+        static const std::vector<VkPipelineShaderStageCreateInfo>& GetShaderStages(const std::filesystem::path& ID, uint32_t features = 0);
+        static const ShaderLayout& GetShaderLayout(const std::filesystem::path& ID, uint32_t features = 0);
+        static VkPipelineLayout GetPipelineLayout(const std::filesystem::path& ID, uint32_t features = 0); //Shared through DescriptorLayoutCache
+        static VkDescriptorSetLayout GetSetLayout(const std::filesystem::path& ID, uint32_t set, uint32_t features = 0);
+
+        //Small stable handle for a program ID, used by pipeline keys instead of the string. Handles are never reused.
+        static uint32_t InternID(const std::string& ID);
+        static const std::string& GetInternedID(uint32_t handle) { return sm_InternedIDs[handle]; }
+
+        //Features the program lists in shaderlist.json, 0 for unknown programs
+        static uint32_t GetSupportedFeatures(const std::filesystem::path& ID);
+        //One VkBool32 per constant feature of the program, on or off according to features
+        static void GetSpecialization(const std::filesystem::path& ID, uint32_t features, std::vector<VkSpecializationMapEntry>& entries, std::vector<VkBool32>& values);
+        //Number of distinct SPIR-V variants currently created for the program
+        static uint32_t GetVariantCount(const std::filesystem::path& ID);
         static void Cleanup();
 
+        //Re-reads shaderlist.json if it changed on disk. Cheap enough to call every frame, the file is checked at most twice a second.
+        static void RefreshRegistry();
+
+        //Watches shader/ for edited sources. Off in offline builds and with CHIKU_DISABLE_HOT_RELOAD set.
+        static void StartHotReload();
+        //Every frame. Starts recompiling the loaded programs an edit touched on a job, the frame never waits for it.
+        static void PollHotReload();
+        //Swaps recompiled programs in and destroys the modules they replace, so only while no pipeline is being created.
+        //Returns the IDs of the programs that changed; their pipelines still hold the old code and need a rebuild.
+        static std::vector<std::string> ApplyHotReload();
+
     private:
-        static bool GetShaderPath(const std::filesystem::path& ID, std::vector<std::string>& shaderPaths);
-        static bool CreateSPIRV(const std::string& a_ShaderPath, const std::string& a_OutPutPath);
+        static const ShaderProgramInfo* GetProgramInfo(const std::filesystem::path& ID);
+        static std::string GetVariantKey(const std::string& ID, uint32_t defineFeatures);
+        static bool LoadRegistry(std::unordered_map<std::string, ShaderProgramInfo>& registry);
+        static void DestroyProgram(const std::string& ID);
+        static std::vector<std::string> GetDefines(const ShaderProgramInfo& info, uint32_t defineFeatures);
         static VkShaderModule CreateShaderModule(const std::vector<char>& code);
-
-        static std::vector<char> ReadFile(const std::string& filename);
+        static VkShaderStageFlagBits GetStageFlag(ShaderStages stage);
+        static VkDescriptorSetLayout GetEngineSetLayout(uint32_t set, const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+        static bool ReflectStage(const std::string& path, const std::vector<char>& code, VkShaderStageFlagBits stage, ShaderLayout& layout);
 
         struct ShaderProgram 
         {
             std::map<ShaderStages, VkShaderModule> ShaderModules{};
             std::vector<VkPipelineShaderStageCreateInfo> Stages{};
+            ShaderLayout Layout{};
+            std::vector<VkDescriptorSetLayout> SetLayouts{}; //Indexed by set, gaps filled with an empty layout
+            VkPipelineLayout PipelineLayout = VK_NULL_HANDLE;
+            uint32_t DefineFeatures = 0;
+            uint64_t CodeHash = 0; //Over the SPIR-V of every stage, a reload that compiles to the same code is dropped
+        };
+
+        //One loaded variant being recompiled. The job fills Code, the main thread reads it once sm_ReloadJobs is done.
+        struct ProgramReload
+        {
+            std::string ID;
+            std::string VariantKey;
+            std::vector<std::string> Stages;
+            std::vector<std::string> Defines;
+            std::vector<std::vector<char>> Code; //Per stage, in registry order
+            uint64_t CodeHash = 0;
+            bool Compiled = false;
         };
 
-        static std::unordered_map<std::string, ShaderProgram> sm_ShaderPrograms;
+        static const ShaderProgram& GetProgram(const std::filesystem::path& ID, uint32_t features);
+        //Creates modules, reflects and builds the layouts from one SPIR-V blob per registry stage
+        static bool BuildProgram(const std::string& ID, const ShaderProgramInfo& info, const std::vector<std::vector<char>>& code, ShaderProgram& program);
+        static void DestroyModules(ShaderProgram& program);
+
+        static std::unordered_map<std::string, ShaderProgram> sm_ShaderPrograms; //Keyed by GetVariantKey
+        static std::unordered_map<std::string, ShaderProgramInfo> sm_ShaderRegistry; //Program ID ("default/unlit") to stages and features
+        static std::filesystem::file_time_type sm_RegistryWriteTime;
+        static std::vector<std::string> sm_InternedIDs;
+        static std::unordered_map<std::string, uint32_t> sm_InternedHandles;
+
+        static Utils::FileWatcher sm_SourceWatcher;
+        static std::vector<std::string> sm_ChangedSources; //Edits not picked up by a reload yet
+        static std::vector<ProgramReload> sm_Reloads;
+        static Utils::JobGroup sm_ReloadJobs;
     };
 }
\ No newline at end of file
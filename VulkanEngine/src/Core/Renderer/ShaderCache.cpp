@@ -0,0 +1,512 @@
+#include "ShaderCache.h"
+#include "AssetManager.h"
+#include "EmbeddedShaders.h"
+#include "Utils/Hash.h"
+#include "Utils/JobSystem.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifdef CHIKU_HAS_SHADERC
+#include <shaderc/shaderc.hpp>
+#if __has_include(<glslang/build_info.h>)
+#include <glslang/build_info.h>
+#endif
+#endif
+
+namespace CHIKU
+{
+    //Bump when the cache layout or the way keys are built changes
+    static constexpr const char* SHADER_CACHE_VERSION = "chiku-spirv-cache-1";
+    //Written at runtime, so it stays a loose directory under SOURCE_DIR and never goes through AssetManager archives
+    static constexpr const char* SHADER_CACHE_DIR = "shader/cache/";
+
+#ifdef CHIKU_SHADERS_OFFLINE
+    bool ShaderCache::sm_OfflineOnly = true;
+#else
+    bool ShaderCache::sm_OfflineOnly = false;
+#endif
+    std::once_flag ShaderCache::sm_CompilerOnce;
+    std::string ShaderCache::sm_CompilerPath;
+    std::string ShaderCache::sm_CompilerIdentity;
+    std::mutex ShaderCache::sm_CompiledMutex;
+    std::vector<ShaderCache::CompiledShader> ShaderCache::sm_Compiled;
+
+    static bool ReadLooseFile(const std::string& path, std::vector<char>& data)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), data.size());
+        return static_cast<bool>(file);
+    }
+
+    bool ShaderCache::CompileAll(const std::vector<ShaderVariant>& variants)
+    {
+        std::vector<CompiledShader> results(variants.size());
+        std::vector<std::string> errors(variants.size());
+        std::vector<char> succeeded(variants.size(), 0);
+
+        //One job per stage and define set; hits are cheap, misses compile concurrently
+        Utils::JobGroup group;
+        for (size_t i = 0; i < variants.size(); i++)
+        {
+            Utils::JobSystem::Submit([&, i]()
+                {
+                    results[i].Variant = variants[i];
+                    succeeded[i] = LoadSPIRV(variants[i].Path, variants[i].Defines, results[i].SPIRV, errors[i]);
+                }, &group);
+        }
+        group.Wait();
+
+        bool allSucceeded = true;
+        std::lock_guard<std::mutex> lock(sm_CompiledMutex);
+        for (size_t i = 0; i < variants.size(); i++)
+        {
+            if (!succeeded[i])
+            {
+                std::cerr << "Shader " << variants[i].Path << ":\n" << errors[i] << std::endl;
+                allSucceeded = false;
+                continue;
+            }
+
+            sm_Compiled.push_back(std::move(results[i]));
+        }
+
+        return allSucceeded;
+    }
+
+    bool ShaderCache::GetSPIRV(const std::string& shaderPath, const std::vector<std::string>& defines, std::vector<char>& spirv, bool allowPrebuilt)
+    {
+        {
+            std::lock_guard<std::mutex> lock(sm_CompiledMutex);
+            auto compiled = std::find_if(sm_Compiled.begin(), sm_Compiled.end(), [&](const CompiledShader& shader)
+                {
+                    return shader.Variant.Path == shaderPath && shader.Variant.Defines == defines;
+                });
+            if (compiled != sm_Compiled.end())
+            {
+                spirv = std::move(compiled->SPIRV);
+                sm_Compiled.erase(compiled);
+                return true;
+            }
+        }
+
+        std::string errors;
+        if (!LoadSPIRV(shaderPath, defines, spirv, errors, allowPrebuilt))
+        {
+            std::cerr << "Shader " << shaderPath << ":\n" << errors << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    void ShaderCache::DiscardPrecompiled()
+    {
+        std::lock_guard<std::mutex> lock(sm_CompiledMutex);
+        sm_Compiled.clear();
+    }
+
+    bool ShaderCache::Exists(const std::string& shaderPath)
+    {
+#ifdef CHIKU_EMBED_SHADERS
+        if (FindEmbeddedShader(GetPrebuiltShaderPath(shaderPath, {})))
+        {
+            return true;
+        }
+#endif
+
+        return (!sm_OfflineOnly && std::filesystem::exists(SOURCE_DIR + shaderPath)) || AssetManager::Exists(GetPrebuiltShaderPath(shaderPath, {}));
+    }
+
+    bool ShaderCache::LoadPrebuilt(const std::string& shaderPath, const std::vector<std::string>& defines, std::vector<char>& spirv, std::string& errors)
+    {
+        //Only the variant's own SPIR-V will do, the one without defines has another interface
+        const std::string prebuiltPath = GetPrebuiltShaderPath(shaderPath, defines);
+#ifdef CHIKU_EMBED_SHADERS
+        if (const EmbeddedShader* embedded = FindEmbeddedShader(prebuiltPath))
+        {
+            spirv.assign(embedded->Data, embedded->Data + embedded->Size);
+            return true;
+        }
+#endif
+
+        if (!AssetManager::ReadFile(prebuiltPath, spirv))
+        {
+            errors += "no prebuilt SPIR-V for this variant, expected " + prebuiltPath + "\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ShaderCache::LoadSPIRV(const std::string& shaderPath, const std::vector<std::string>& defines, std::vector<char>& spirv, std::string& errors, bool allowPrebuilt)
+    {
+        //Archived builds ship only the SPIR-V, so the cache is only consulted when the source is on disk
+        if (sm_OfflineOnly || !std::filesystem::exists(SOURCE_DIR + shaderPath))
+        {
+            if (!allowPrebuilt)
+            {
+                errors = "source not available";
+                return false;
+            }
+            return LoadPrebuilt(shaderPath, defines, spirv, errors);
+        }
+
+        uint64_t key = Utils::HashString(SHADER_CACHE_VERSION);
+        std::vector<std::string> visited;
+        if (!HashSource(shaderPath, key, visited))
+        {
+            if (!allowPrebuilt)
+            {
+                errors = "cannot read the source or one of its includes";
+                return false;
+            }
+            return LoadPrebuilt(shaderPath, defines, spirv, errors);
+        }
+
+        for (const auto& define : defines)
+        {
+            key = Utils::HashString(define, key);
+        }
+        key = Utils::HashString(GetCompilerIdentity(), key);
+
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+        const std::string cachePath = SOURCE_DIR + SHADER_CACHE_DIR + name + ".spv";
+
+        if (ReadLooseFile(cachePath, spirv))
+        {
+            return true;
+        }
+
+        if (!Compile(shaderPath, defines, cachePath, errors))
+        {
+            //Keep running on the last good SPIR-V, the error is still reported
+            std::string ignored;
+            if (!allowPrebuilt || !LoadPrebuilt(shaderPath, defines, spirv, ignored))
+            {
+                return false;
+            }
+
+            std::cerr << "Shader " << shaderPath << " failed to compile, using prebuilt SPIR-V:\n" << errors << std::endl;
+            return true;
+        }
+
+        return ReadLooseFile(cachePath, spirv);
+    }
+
+    bool ShaderCache::HashSource(const std::string& shaderPath, uint64_t& key, std::vector<std::string>& visited)
+    {
+        if (std::find(visited.begin(), visited.end(), shaderPath) != visited.end())
+        {
+            return true;
+        }
+        visited.push_back(shaderPath);
+
+        std::vector<char> source;
+        if (!AssetManager::ReadFile(shaderPath, source))
+        {
+            return false;
+        }
+
+        key = Utils::HashString(shaderPath, key);
+        key = Utils::HashBytes(source.data(), source.size(), key);
+
+        //Follow #include "file" and #include <file> relative to the including file
+        std::string directory = std::filesystem::path(shaderPath).parent_path().generic_string();
+        std::istringstream lines(std::string(source.begin(), source.end()));
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                continue;
+            }
+
+            size_t open = line.find_first_of("\"<", start + 8);
+            size_t close = open == std::string::npos ? open : line.find_first_of("\">", open + 1);
+            if (close == std::string::npos)
+            {
+                continue;
+            }
+
+            std::string include = line.substr(open + 1, close - open - 1);
+            std::string includePath = directory.empty() ? include : directory + "/" + include;
+
+            //A missing include still changes the key by name, the compiler reports the error itself
+            if (!HashSource(includePath, key, visited))
+            {
+                key = Utils::HashString(includePath, key);
+            }
+        }
+
+        return true;
+    }
+
+#ifdef CHIKU_HAS_SHADERC
+    //Resolves #include relative to the including file through the asset manager
+    class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
+    {
+    public:
+        shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+        {
+            Include* include = new Include();
+            std::string directory = std::filesystem::path(requestingSource).parent_path().generic_string();
+            include->Name = directory.empty() ? requestedSource : directory + "/" + requestedSource;
+
+            std::vector<char> data;
+            if (AssetManager::ReadFile(include->Name, data))
+            {
+                include->Content.assign(data.begin(), data.end());
+            }
+            else
+            {
+                //An empty source name tells shaderc the include failed, the content becomes the error message
+                include->Content = "cannot open include " + include->Name;
+                include->Name.clear();
+            }
+
+            include->Result = { include->Name.data(), include->Name.size(), include->Content.data(), include->Content.size(), include };
+            return &include->Result;
+        }
+
+        void ReleaseInclude(shaderc_include_result* result) override
+        {
+            delete static_cast<Include*>(result->user_data);
+        }
+
+    private:
+        struct Include
+        {
+            std::string Name;
+            std::string Content;
+            shaderc_include_result Result;
+        };
+    };
+
+    static shaderc_shader_kind GetShaderKind(const std::string& shaderPath)
+    {
+        std::string extension = std::filesystem::path(shaderPath).extension().string();
+        if (extension == ".vert") return shaderc_vertex_shader;
+        if (extension == ".frag") return shaderc_fragment_shader;
+        if (extension == ".geo" || extension == ".geom") return shaderc_geometry_shader;
+        if (extension == ".comp") return shaderc_compute_shader;
+        if (extension == ".tesc") return shaderc_tess_control_shader;
+        if (extension == ".tese") return shaderc_tess_evaluation_shader;
+        return shaderc_glsl_infer_from_source;
+    }
+#else
+    static std::string Quote(const std::string& argument)
+    {
+        return "\"" + argument + "\"";
+    }
+
+    static std::string FindGLSLC()
+    {
+#ifdef PLT_WINDOWS
+        const std::string executable = "glslc.exe";
+        const char separator = ';';
+#else
+        const std::string executable = "glslc";
+        const char separator = ':';
+#endif
+
+        std::vector<std::filesystem::path> directories;
+        if (const char* sdk = std::getenv("VULKAN_SDK"))
+        {
+            directories.push_back(std::filesystem::path(sdk) / "bin");
+            directories.push_back(std::filesystem::path(sdk) / "Bin");
+        }
+        if (const char* path = std::getenv("PATH"))
+        {
+            std::stringstream entries(path);
+            std::string entry;
+            while (std::getline(entries, entry, separator))
+            {
+                if (!entry.empty())
+                {
+                    directories.push_back(entry);
+                }
+            }
+        }
+
+        for (const auto& directory : directories)
+        {
+            std::error_code error;
+            std::filesystem::path candidate = directory / executable;
+            if (std::filesystem::is_regular_file(candidate, error))
+            {
+                return candidate.string();
+            }
+        }
+
+        return "";
+    }
+#endif
+
+    const std::string& ShaderCache::GetCompilerIdentity()
+    {
+        std::call_once(sm_CompilerOnce, []()
+            {
+#ifdef CHIKU_HAS_SHADERC
+                //shaderc is linked in, so the glslang front end and SDK headers it was built with name its version.
+                //The SPIR-V version alone does not change between compiler releases.
+                unsigned int version = 0, revision = 0;
+                shaderc_get_spv_version(&version, &revision);
+                sm_CompilerIdentity = "shaderc|spv " + std::to_string(version) + "." + std::to_string(revision) + "|sdk " + std::to_string(VK_HEADER_VERSION);
+#ifdef GLSLANG_VERSION_MAJOR
+                sm_CompilerIdentity += "|glslang " + std::to_string(GLSLANG_VERSION_MAJOR) + "." + std::to_string(GLSLANG_VERSION_MINOR) + "." +
+                    std::to_string(GLSLANG_VERSION_PATCH) + GLSLANG_VERSION_FLAVOR;
+#endif
+#else
+                sm_CompilerPath = FindGLSLC();
+                if (sm_CompilerPath.empty())
+                {
+                    sm_CompilerIdentity = "none";
+                    return;
+                }
+
+                //glslc --version lists shaderc, spirv-tools and glslang with their exact revisions. Asked once per launch.
+                std::ostringstream outputName;
+                outputName << SOURCE_DIR << SHADER_CACHE_DIR << "glslc-version." << std::this_thread::get_id() << ".tmp";
+                const std::string outputPath = outputName.str();
+
+                std::error_code error;
+                std::filesystem::create_directories(SOURCE_DIR + SHADER_CACHE_DIR, error);
+                std::string command = Quote(sm_CompilerPath) + " --version > " + Quote(outputPath);
+#ifdef PLT_WINDOWS
+                command = "\"" + command + "\""; //cmd.exe strips the outer quotes
+#endif
+
+                std::vector<char> version;
+                if (std::system(command.c_str()) != 0 || !ReadLooseFile(outputPath, version) || version.empty())
+                {
+                    //Size and timestamp of the binary still change with most updates
+                    auto size = std::filesystem::file_size(sm_CompilerPath, error);
+                    auto time = std::filesystem::last_write_time(sm_CompilerPath, error).time_since_epoch().count();
+                    std::cerr << "Cannot read the version of " << sm_CompilerPath << ", keying the shader cache by its size and timestamp" << std::endl;
+                    version.clear();
+                    std::string fallback = std::to_string(size) + "|" + std::to_string(time);
+                    version.assign(fallback.begin(), fallback.end());
+                }
+                std::filesystem::remove(outputPath, error);
+
+                sm_CompilerIdentity = sm_CompilerPath + "|" + std::string(version.begin(), version.end());
+#endif
+            });
+
+        return sm_CompilerIdentity;
+    }
+
+    bool ShaderCache::Compile(const std::string& shaderPath, const std::vector<std::string>& defines, const std::string& outputPath, std::string& errors)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(outputPath).parent_path(), error);
+
+        //Write to a temporary name so a failed or interrupted compile never leaves a bad cache entry.
+        //The thread id keeps concurrent compiles of the same shader from sharing it.
+        std::ostringstream temporaryName;
+        temporaryName << outputPath << "." << std::this_thread::get_id() << ".tmp";
+        const std::string temporaryPath = temporaryName.str();
+
+#ifdef CHIKU_HAS_SHADERC
+        std::vector<char> source;
+        if (!AssetManager::ReadFile(shaderPath, source))
+        {
+            errors += "cannot read source\n";
+            return false;
+        }
+
+        shaderc::CompileOptions options;
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+        options.SetIncluder(std::make_unique<ShaderIncluder>());
+        for (const auto& define : defines)
+        {
+            size_t equals = define.find('=');
+            if (equals == std::string::npos)
+            {
+                options.AddMacroDefinition(define);
+            }
+            else
+            {
+                options.AddMacroDefinition(define.substr(0, equals), define.substr(equals + 1));
+            }
+        }
+
+        shaderc::Compiler compiler;
+        shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source.data(), source.size(), GetShaderKind(shaderPath), shaderPath.c_str(), options);
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+        {
+            errors += result.GetErrorMessage();
+            return false;
+        }
+
+        {
+            std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+            output.write(reinterpret_cast<const char*>(result.cbegin()), (result.cend() - result.cbegin()) * sizeof(uint32_t));
+            if (!output)
+            {
+                errors += "cannot write " + temporaryPath + "\n";
+                return false;
+            }
+        }
+#else
+        GetCompilerIdentity(); //Resolves sm_CompilerPath
+        if (sm_CompilerPath.empty())
+        {
+            errors += "no shader compiler found on PATH or in VULKAN_SDK\n";
+            return false;
+        }
+
+        const std::string logPath = temporaryPath + ".log";
+        std::string command = Quote(sm_CompilerPath);
+        for (const auto& define : defines)
+        {
+            command += " " + Quote("-D" + define);
+        }
+        command += " " + Quote(SOURCE_DIR + shaderPath) + " -o " + Quote(temporaryPath) + " 2> " + Quote(logPath);
+
+#ifdef PLT_WINDOWS
+        command = "\"" + command + "\""; //cmd.exe strips the outer quotes
+#endif
+
+        int result = std::system(command.c_str());
+
+        std::vector<char> log;
+        ReadLooseFile(logPath, log);
+        std::filesystem::remove(logPath, error);
+
+        if (result != 0)
+        {
+            errors += std::string(log.begin(), log.end());
+            errors += "glslc exited with code " + std::to_string(result) + "\n";
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+#endif
+
+        std::filesystem::rename(temporaryPath, outputPath, error);
+        if (error)
+        {
+            errors += "cannot write " + outputPath + "\n";
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+
+        std::cout << "Compiled successfully: " << shaderPath << std::endl;
+        return true;
+    }
+}
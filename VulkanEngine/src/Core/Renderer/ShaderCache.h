@@ -0,0 +1,61 @@
+#pragma once
+#include "VulkanHeader.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace CHIKU
+{
+	//Compiled SPIR-V keyed by a hash of the GLSL source, every file it includes, the defines and the compiler build.
+	//A warm cache costs one read and hash of the sources per stage; the compiler only runs on a miss. With shaderc
+	//available (CHIKU_HAS_SHADERC) compilation happens in-process, otherwise glslc is spawned.
+	class ShaderCache
+	{
+	public:
+		//One stage compiled with one set of defines, a program variant has one per stage
+		struct ShaderVariant
+		{
+			std::string Path;
+			std::vector<std::string> Defines;
+		};
+
+		//Offline-only never runs a compiler and loads the embedded or prebuilt SPIR-V of each variant, see GetPrebuiltShaderPath
+		static void SetOfflineOnly(bool offlineOnly) { sm_OfflineOnly = offlineOnly; }
+		static bool IsOfflineOnly() { return sm_OfflineOnly; }
+
+		//Compiles every variant on the job system and keeps the results for GetSPIRV. Errors are reported per file.
+		static bool CompileAll(const std::vector<ShaderVariant>& variants);
+
+		//True if the stage can be loaded: its source is on disk, or prebuilt/embedded SPIR-V of its variant without defines exists
+		static bool Exists(const std::string& shaderPath);
+
+		//shaderPath is relative to SOURCE_DIR. Defines are NAME or NAME=VALUE.
+		//Without allowPrebuilt a stage that cannot be compiled from source fails instead of loading the variant's prebuilt SPIR-V.
+		//A variant without prebuilt SPIR-V fails too, it never falls back to another define set.
+		static bool GetSPIRV(const std::string& shaderPath, const std::vector<std::string>& defines, std::vector<char>& spirv, bool allowPrebuilt = true);
+		//Drops CompileAll results not used yet, after a source changed they may be stale
+		static void DiscardPrecompiled();
+
+	private:
+		static bool LoadSPIRV(const std::string& shaderPath, const std::vector<std::string>& defines, std::vector<char>& spirv, std::string& errors, bool allowPrebuilt = true);
+		static bool LoadPrebuilt(const std::string& shaderPath, const std::vector<std::string>& defines, std::vector<char>& spirv, std::string& errors);
+		static bool HashSource(const std::string& shaderPath, uint64_t& key, std::vector<std::string>& visited);
+		static const std::string& GetCompilerIdentity();
+		static bool Compile(const std::string& shaderPath, const std::vector<std::string>& defines, const std::string& outputPath, std::string& errors);
+
+	private:
+		struct CompiledShader
+		{
+			ShaderVariant Variant;
+			std::vector<char> SPIRV;
+		};
+
+		static bool sm_OfflineOnly;
+		static std::once_flag sm_CompilerOnce;
+		static std::string sm_CompilerPath; //Empty when glslc was not found or shaderc is used
+		static std::string sm_CompilerIdentity;
+
+		static std::mutex sm_CompiledMutex;
+		static std::vector<CompiledShader> sm_Compiled; //Filled by CompileAll, consumed by GetSPIRV
+	};
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace CHIKU
+{
+	//Feature switches a material can ask for. A program lists the ones it implements in shaderlist.json,
+	//either as a specialization constant or as a define; bits a program does not list are ignored.
+	enum ShaderFeatures : uint32_t
+	{
+		ShaderFeature_None = 0,
+		ShaderFeature_AlphaTest = 1 << 0,
+		ShaderFeature_VertexColor = 1 << 1,
+		ShaderFeature_NormalMapping = 1 << 2,
+		ShaderFeature_Instancing = 1 << 3, //Set for draws with an instanced vertex layout, see Material::UpdatePipelineKey
+		ShaderFeature_Bindless = 1 << 4, //Set by materials themselves while TextureTable is enabled, see Material::UpdatePipelineKey
+	};
+
+	//Names used by shaderlist.json and scene files, 0 when unknown
+	inline uint32_t GetShaderFeatureBit(std::string_view name)
+	{
+		if (name == "alphaTest") return ShaderFeature_AlphaTest;
+		if (name == "vertexColor") return ShaderFeature_VertexColor;
+		if (name == "normalMapping") return ShaderFeature_NormalMapping;
+		if (name == "instancing") return ShaderFeature_Instancing;
+		if (name == "bindless") return ShaderFeature_Bindless;
+		return ShaderFeature_None;
+	}
+}
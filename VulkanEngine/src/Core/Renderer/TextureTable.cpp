@@ -0,0 +1,205 @@
+#include "TextureTable.h"
+#include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
+#include "Utils/ImageUtils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace CHIKU
+{
+    bool TextureTable::sm_Enabled = false;
+    uint32_t TextureTable::sm_Capacity = 0;
+    VkDescriptorSetLayout TextureTable::sm_SetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool TextureTable::sm_DescriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet TextureTable::sm_DescriptorSet = VK_NULL_HANDLE;
+    VkSampler TextureTable::sm_Sampler = VK_NULL_HANDLE;
+    std::vector<TextureData> TextureTable::sm_Textures;
+    std::unordered_map<std::string, uint32_t> TextureTable::sm_Indices;
+
+    void TextureTable::Init()
+    {
+        if (!VulkanEngine::IsDescriptorIndexingEnabled())
+        {
+            std::cout << "Descriptor indexing not supported, textures are bound per draw" << std::endl;
+            return;
+        }
+        if (const char* disable = std::getenv("CHIKU_DISABLE_BINDLESS"); disable && std::string(disable) != "0")
+        {
+            std::cout << "CHIKU_DISABLE_BINDLESS is set, textures are bound per draw" << std::endl;
+            return;
+        }
+
+        VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(VulkanEngine::GetPhysicalDevice(), &properties);
+
+        sm_Capacity = std::min({ MAX_TEXTURES,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers });
+
+        //Partially bound so unused slots may stay empty, update-after-bind so textures can be added while the set is bound
+        VkDescriptorSetLayoutBinding binding{};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        binding.descriptorCount = sm_Capacity;
+        binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = 1;
+        bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &binding;
+
+        if (vkCreateDescriptorSetLayout(VulkanEngine::GetDevice(), &layoutInfo, nullptr, &sm_SetLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create bindless descriptor set layout!");
+        }
+
+        VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sm_Capacity };
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = 1;
+
+        if (vkCreateDescriptorPool(VulkanEngine::GetDevice(), &poolInfo, nullptr, &sm_DescriptorPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create bindless descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = sm_DescriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &sm_SetLayout;
+
+        if (vkAllocateDescriptorSets(VulkanEngine::GetDevice(), &allocInfo, &sm_DescriptorSet) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate bindless descriptor set!");
+        }
+
+        sm_Sampler = Utils::CreateTextureSampler();
+        sm_Enabled = true;
+
+        //Slot 0, the texture the per-draw set has always used
+        Register("models/Texture1.png");
+
+        std::cout << "Bindless textures enabled, " << sm_Capacity << " slots" << std::endl;
+    }
+
+    uint32_t TextureTable::Register(const std::string& path)
+    {
+        if (!sm_Enabled || path.empty())
+        {
+            return DEFAULT_TEXTURE;
+        }
+
+        auto found = sm_Indices.find(path);
+        if (found != sm_Indices.end())
+        {
+            return found->second;
+        }
+
+        if (sm_Textures.size() >= sm_Capacity)
+        {
+            std::cerr << "TextureTable: all " << sm_Capacity << " slots are used, " << path << " uses the default texture" << std::endl;
+            return DEFAULT_TEXTURE;
+        }
+
+        TextureData texture{};
+        try
+        {
+            Utils::CreateTextureImage(path, texture.TextureImage, texture.TextureImageMemory);
+        }
+        catch (const std::runtime_error& error)
+        {
+            if (sm_Textures.empty())
+            {
+                throw; //The default texture is required
+            }
+            std::cerr << "TextureTable: " << error.what() << std::endl;
+            sm_Indices[path] = DEFAULT_TEXTURE; //Do not retry the load for every material that uses it
+            return DEFAULT_TEXTURE;
+        }
+        texture.textureImageView = Utils::CreateTextureImageView(texture.TextureImage);
+        texture.textureSampler = sm_Sampler;
+
+        uint32_t index = static_cast<uint32_t>(sm_Textures.size());
+        sm_Textures.push_back(texture);
+        sm_Indices[path] = index;
+
+        WriteDescriptor(index);
+        return index;
+    }
+
+    void TextureTable::WriteDescriptor(uint32_t index)
+    {
+        //A new slot is never read by frames already in flight, which UPDATE_UNUSED_WHILE_PENDING allows
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = sm_Textures[index].textureImageView;
+        imageInfo.sampler = sm_Textures[index].textureSampler;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = sm_DescriptorSet;
+        write.dstBinding = 0;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(VulkanEngine::GetDevice(), 1, &write, 0, nullptr);
+    }
+
+    void TextureTable::Bind(VkPipelineLayout pipelineLayout)
+    {
+        CommandRecorder::BindDescriptorSet(pipelineLayout, SET, sm_DescriptorSet);
+    }
+
+    void TextureTable::PushTextureIndex(VkPipelineLayout pipelineLayout, uint32_t textureIndex)
+    {
+        CommandRecorder::PushConstants(pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &textureIndex);
+    }
+
+    void TextureTable::CleanUp()
+    {
+        auto& device = VulkanEngine::GetDevice();
+
+        for (auto& texture : sm_Textures)
+        {
+            vkDestroyImageView(device, texture.textureImageView, nullptr);
+            vkDestroyImage(device, texture.TextureImage, nullptr);
+            vkFreeMemory(device, texture.TextureImageMemory, nullptr);
+        }
+
+        if (sm_Enabled)
+        {
+            vkDestroySampler(device, sm_Sampler, nullptr);
+            vkDestroyDescriptorPool(device, sm_DescriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(device, sm_SetLayout, nullptr);
+        }
+
+        sm_Textures.clear();
+        sm_Indices.clear();
+        sm_Enabled = false;
+    }
+}
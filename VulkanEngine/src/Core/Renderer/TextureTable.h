@@ -0,0 +1,47 @@
+#pragma once
+#include "VulkanHeader.h"
+#include "UniformDescription.h"
+
+namespace CHIKU
+{
+	//Global bindless texture array. Textures are registered once and shaders index the array with a 32-bit index from
+	//a push constant, so draws with different textures share one descriptor bind. Needs descriptor indexing; without it
+	//the table stays disabled and textures come from the per-draw set like before.
+	class TextureTable
+	{
+	public:
+		static constexpr uint32_t SET = 1; //Set index bindless shaders declare the array in, at binding 0
+		static constexpr uint32_t DEFAULT_TEXTURE = 0; //Used for materials without a texture or whose texture failed to load
+
+		static void Init(); //Disabled when the device lacks descriptor indexing or CHIKU_DISABLE_BINDLESS is set
+		static bool IsEnabled() { return sm_Enabled; }
+
+		//Loads the texture on first use, later calls with the same path return the same index
+		static uint32_t Register(const std::string& path);
+		static uint32_t GetTextureCount() { return static_cast<uint32_t>(sm_Textures.size()); }
+		static VkDescriptorSetLayout GetSetLayout() { return sm_SetLayout; }
+
+		//Binds the array unless CommandRecorder has it bound for this pipeline layout already
+		static void Bind(VkPipelineLayout pipelineLayout);
+		//The texture index is the first fragment push constant of bindless shaders
+		static void PushTextureIndex(VkPipelineLayout pipelineLayout, uint32_t textureIndex);
+
+		static void CleanUp();
+
+	private:
+		static void WriteDescriptor(uint32_t index);
+
+	private:
+		static constexpr uint32_t MAX_TEXTURES = 4096;
+
+		static bool sm_Enabled;
+		static uint32_t sm_Capacity; //MAX_TEXTURES clamped to the device's update-after-bind limits
+		static VkDescriptorSetLayout sm_SetLayout;
+		static VkDescriptorPool sm_DescriptorPool;
+		static VkDescriptorSet sm_DescriptorSet;
+		static VkSampler sm_Sampler; //Shared by every texture
+
+		static std::vector<TextureData> sm_Textures; //Indexed by texture index, textureSampler is sm_Sampler
+		static std::unordered_map<std::string, uint32_t> sm_Indices;
+	};
+}
@@ -1,7 +1,10 @@
 #include "UniformBuffer.h"
 #include "Utils/ImageUtils.h"
 #include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
 #include "Utils/BufferUtils.h"
+#include "DescriptorLayoutCache.h"
+#include "DescriptorAllocator.h"
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
@@ -9,18 +12,26 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/hash.hpp>
 
-#include <chrono>
+#include <algorithm>
+#include <iostream>
 
 namespace CHIKU
 {
 	std::unordered_map<GenericUniformBuffers, UniformBufferDescription> UniformBuffer::sm_BufferDescriptions;
-	VkDescriptorPool UniformBuffer::sm_DescriptorPool;
+	UniformBufferDescription* UniformBuffer::sm_MVP = nullptr;
+	glm::mat4 UniformBuffer::sm_View = glm::mat4(1.0f);
+	glm::mat4 UniformBuffer::sm_Proj = glm::mat4(1.0f);
+	VkDeviceSize UniformBuffer::sm_DrawStride = 0;
+	uint32_t UniformBuffer::sm_DrawCapacity = 64;
+	std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> UniformBuffer::sm_FrameCapacity{};
+	uint32_t UniformBuffer::sm_DrawCursor = 1;
+	uint32_t UniformBuffer::sm_UnboundFrame = UINT32_MAX;
+	std::vector<UniformBuffer::RetiredBuffer> UniformBuffer::sm_RetiredBuffers;
 
 	void UniformBuffer::Init()
 	{
-		CreateDescriptorPool(); //Create the Descriptor Pool
-
 		GetOrBuildUniform(GenericUniformBuffers::MVP); //Here we Create Uniform Buffer to be used later
+		sm_MVP = &sm_BufferDescriptions.at(GenericUniformBuffers::MVP);
 	}
 
 	void UniformBuffer::FinalizeLayout(UniformBufferLayout& layout)
@@ -29,11 +40,24 @@ namespace CHIKU
 		{
 			switch (attribute.AttributeType)
 			{
+			case UniformPlainDataType::Vec4:
+				layout.Size += sizeof(glm::vec4);
+				break;
 			case UniformPlainDataType::Mat4:
 				layout.Size += sizeof(glm::mat4);
 				break;
 			}
 		}
+
+		for (auto attribute : layout.FrameBufferAttributes)
+		{
+			switch (attribute.AttributeType)
+			{
+			case UniformPlainDataType::Mat4:
+				layout.FrameSize += sizeof(glm::mat4);
+				break;
+			}
+		}
 	}
 
 	UniformBufferLayout UniformBuffer::GetUniformBufferLayout(GenericUniformBuffers BufferType)
@@ -44,14 +68,17 @@ namespace CHIKU
 			Layout = {
 				/* Plain Data Layout = */ {
 					{"u_Model",UniformPlainDataType::Mat4, VK_SHADER_STAGE_VERTEX_BIT},
-					{"u_View",UniformPlainDataType::Mat4, VK_SHADER_STAGE_VERTEX_BIT},
-					{"u_Proj",UniformPlainDataType::Mat4, VK_SHADER_STAGE_VERTEX_BIT}
+					{"u_BaseColor",UniformPlainDataType::Vec4, VK_SHADER_STAGE_VERTEX_BIT}
 				},
 				/* Opaque Data like Textures */ {
 					{"u_Texture",UniformOpaqueDataType::Sampler2D,VK_SHADER_STAGE_FRAGMENT_BIT}
 				},
-				/*Binding = */ 0, //This is the binding that should be used in the Shaders
-				/*Size = */ 0 //This is only here to show the layout the method to calculate the size is below
+				/*Binding = */ DRAW_BINDING, //This is the binding that should be used in the Shaders
+				/*Size = */ 0, //This is only here to show the layout the method to calculate the size is below
+				/* Per Frame Data = */ {
+					{"u_View",UniformPlainDataType::Mat4, VK_SHADER_STAGE_VERTEX_BIT},
+					{"u_Proj",UniformPlainDataType::Mat4, VK_SHADER_STAGE_VERTEX_BIT}
+				}
 			};
 
 			FinalizeLayout(Layout); //This method calculates the Size of the Uniform Buffer
@@ -62,28 +89,109 @@ namespace CHIKU
 
 	void UniformBuffer::Bind(VkPipelineLayout pipelineLayout)
 	{
-		for (auto& [_, description] : sm_BufferDescriptions)
+		//The same offset every time, so CommandRecorder drops the bind while the pipeline layout stays the same
+		uint32_t dynamicOffset = 0;
+		sm_UnboundFrame = UINT32_MAX;
+		CommandRecorder::BindDescriptorSet(pipelineLayout, 0, sm_MVP->DescriptorSets[VulkanEngine::GetCurrentFrame()], &dynamicOffset);
+	}
+
+	void UniformBuffer::Bind(VkPipelineLayout pipelineLayout, const glm::mat4& model, const glm::vec4& baseColor)
+	{
+		//Sharing a slot would draw earlier objects with a later transform
+		uint32_t slot = sm_DrawCursor++;
+		if (slot >= sm_FrameCapacity[VulkanEngine::GetCurrentFrame()])
 		{
-			vkCmdBindDescriptorSets(VulkanEngine::GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &description.DescriptorSets[VulkanEngine::GetCurrentFrame()], 0, nullptr);
+			throw std::runtime_error("UniformBuffer: more draws than reserved slots (" + std::to_string(sm_FrameCapacity[VulkanEngine::GetCurrentFrame()]) +
+				"), call Reserve before recording");
 		}
+
+		WriteSlot(slot, model, baseColor);
+		uint32_t dynamicOffset = static_cast<uint32_t>(slot * sm_DrawStride);
+		sm_UnboundFrame = UINT32_MAX;
+		CommandRecorder::BindDescriptorSet(pipelineLayout, 0, sm_MVP->DescriptorSets[VulkanEngine::GetCurrentFrame()], &dynamicOffset);
+	}
+
+	void UniformBuffer::WriteSlot(uint32_t slot, const glm::mat4& model, const glm::vec4& baseColor)
+	{
+		//The camera is in the frame block, a draw only writes its own transform and color
+		uint8_t* data = static_cast<uint8_t*>(sm_MVP->UniformBuffersMapped[VulkanEngine::GetCurrentFrame()]) + slot * sm_DrawStride;
+		memcpy(data, &model, sizeof(glm::mat4));
+		memcpy(data + sizeof(glm::mat4), &baseColor, sizeof(glm::vec4));
+	}
+
+	void UniformBuffer::WriteFrame(uint32_t frame)
+	{
+		glm::mat4 data[2] = { sm_View, sm_Proj };
+		memcpy(sm_MVP->FrameBuffersMapped[frame], data, sizeof(data));
 	}
 
 	void UniformBuffer::Update()
 	{
-		static auto startTime = std::chrono::high_resolution_clock::now();
+		sm_View = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		sm_Proj = glm::perspective(glm::radians(45.0f), (float)Window::WIDTH / (float)Window::HEIGHT, 0.1f, 10.0f);
+
+		sm_Proj[1][1] *= -1;
+
+		for (size_t i = 0; i < sm_RetiredBuffers.size();)
+		{
+			if (--sm_RetiredBuffers[i].FramesLeft == 0)
+			{
+				Utils::DestroyBuffer(sm_RetiredBuffers[i].Buffer, sm_RetiredBuffers[i].Memory);
+				sm_RetiredBuffers[i] = sm_RetiredBuffers.back();
+				sm_RetiredBuffers.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		//The frame's fence has passed, its buffer and set are free to replace and write
+		sm_UnboundFrame = VulkanEngine::GetCurrentFrame();
+		if (sm_FrameCapacity[sm_UnboundFrame] < sm_DrawCapacity)
+		{
+			GrowFrame(sm_UnboundFrame);
+		}
+		WriteFrame(sm_UnboundFrame);
+		WriteSlot(0, glm::mat4(1.0f), glm::vec4(1.0f));
+		sm_DrawCursor = 1;
+	}
+
+	void UniformBuffer::Reserve(uint32_t drawCount)
+	{
+		//Plus the identity slot
+		if (drawCount + 1 <= sm_DrawCapacity)
+		{
+			return;
+		}
+
+		sm_DrawCapacity = drawCount + 1;
+
+		//Between frames, or once the set is bound, the current frame may still be in flight, Update grows it later
+		if (sm_BufferDescriptions.empty() || sm_UnboundFrame != VulkanEngine::GetCurrentFrame())
+		{
+			return;
+		}
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+		GrowFrame(sm_UnboundFrame);
+		//Only the identity slot was written since Update, the frame block is a buffer of its own
+		WriteSlot(0, glm::mat4(1.0f), glm::vec4(1.0f));
+	}
 
-		glm::mat4 model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)Window::WIDTH / (float)Window::HEIGHT, 0.1f, 10.0f);
+	void UniformBuffer::GrowFrame(uint32_t frame)
+	{
+		for (auto& [_, description] : sm_BufferDescriptions)
+		{
+			//Like retired pipelines, destroyed once no frame in flight can still read it
+			sm_RetiredBuffers.push_back({ description.UniformBuffers[frame], description.UniformBuffersMemory[frame], MAX_FRAMES_IN_FLIGHT });
 
-		proj[1][1] *= -1;
+			Utils::CreateMappedBuffer(sm_DrawStride * sm_DrawCapacity, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				description.UniformBuffers[frame], description.UniformBuffersMemory[frame], description.UniformBuffersMapped[frame]);
 
-		glm::mat4 data[3] = { model,view,proj };
+			WriteDescriptor(description, frame);
+		}
 
-		memcpy(sm_BufferDescriptions[GenericUniformBuffers::MVP].UniformBuffersMapped[VulkanEngine::GetCurrentFrame()], data , sizeof(glm::mat4) * 3);
+		sm_FrameCapacity[frame] = sm_DrawCapacity;
 	}
 
 	UniformBufferDescription UniformBuffer::GetOrBuildUniform(GenericUniformBuffers presets)
@@ -106,140 +214,138 @@ namespace CHIKU
 		description.UniformBufferLayouts = GetUniformBufferLayout(presets);
 		description.DescriptorSetLayouts = CreateDescriptorSetLayout(description.UniformBufferLayouts);		
 
-		CreateUniformBuffer(description.UniformBufferLayouts.Size,
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(VulkanEngine::GetPhysicalDevice(), &properties);
+		VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+		sm_DrawStride = (description.UniformBufferLayouts.Size + alignment - 1) / alignment * alignment;
+
+		CreateUniformBuffer(sm_DrawStride * sm_DrawCapacity,
 			description.UniformBuffers,
 			description.UniformBuffersMemory,
 			description.UniformBuffersMapped);
+		sm_FrameCapacity.fill(sm_DrawCapacity);
 
-		CreateDescriptorSets(description.UniformBufferLayouts,
-			description.DescriptorSetLayouts,
-			description.DescriptorSets,
-			description.UniformBuffers,
-			description.Texture);
+		CreateUniformBuffer(description.UniformBufferLayouts.FrameSize,
+			description.FrameBuffers,
+			description.FrameBuffersMemory,
+			description.FrameBuffersMapped);
+
+		CreateDescriptorSets(description);
 
 		return description;
 	}
 
 	VkDescriptorSetLayout UniformBuffer::CreateDescriptorSetLayout(const UniformBufferLayout& bufferLayout)
 	{
-		VkDescriptorSetLayout layout;
+		return DescriptorLayoutCache::GetSetLayout(GetDescriptorSetBindings(bufferLayout));
+	}
 
+	std::vector<VkDescriptorSetLayoutBinding> UniformBuffer::GetDescriptorSetBindings(const UniformBufferLayout& bufferLayout)
+	{
+		//Stages come from the attributes, so the layout matches what reflection derives for shaders that use them
 		std::vector<VkDescriptorSetLayoutBinding> bindings;
 
 		if (bufferLayout.PlainBufferAttributes.size() > 0)
 		{
-			bindings.emplace_back();
-			bindings[0].binding = 0;
-			bindings[0].descriptorCount = 1;
-			bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			bindings[0].pImmutableSamplers = nullptr;
-			bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = DRAW_BINDING;
+			binding.descriptorCount = 1;
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			for (const auto& attribute : bufferLayout.PlainBufferAttributes)
+			{
+				binding.stageFlags |= attribute.ShaderStageFlag;
+			}
+			bindings.push_back(binding);
 		}
 
 		if (bufferLayout.OpaqueBufferAttributes.size() > 0)
 		{
-			bindings.emplace_back();
-			bindings[1].binding = 1;
-			bindings[1].descriptorCount = 1;
-			bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			bindings[1].pImmutableSamplers = nullptr;
-			bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = TEXTURE_BINDING;
+			binding.descriptorCount = 1;
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			for (const auto& attribute : bufferLayout.OpaqueBufferAttributes)
+			{
+				binding.stageFlags |= attribute.ShaderStageFlag;
+			}
+			bindings.push_back(binding);
 		}
 
-		VkDescriptorSetLayoutCreateInfo layoutInfo{};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
-
-		if (vkCreateDescriptorSetLayout(VulkanEngine::GetDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		//Same offset for every draw of the frame, so a plain uniform buffer
+		if (bufferLayout.FrameBufferAttributes.size() > 0)
 		{
-			throw std::runtime_error("failed to create descriptor set layout!");
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = FRAME_BINDING;
+			binding.descriptorCount = 1;
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			for (const auto& attribute : bufferLayout.FrameBufferAttributes)
+			{
+				binding.stageFlags |= attribute.ShaderStageFlag;
+			}
+			bindings.push_back(binding);
 		}
 
-		return layout;
+		return bindings;
 	}
 
-	void UniformBuffer::CreateDescriptorPool()
+	//Source of every descriptor in the uniform set, read by the update template
+	struct UniformDescriptorData
 	{
-		std::array<VkDescriptorPoolSize, 2> poolSizes{};
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-		VkDescriptorPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-		if (vkCreateDescriptorPool(VulkanEngine::GetDevice(), &poolInfo, nullptr, &sm_DescriptorPool) != VK_SUCCESS)
+		VkDescriptorBufferInfo Buffer;
+		VkDescriptorImageInfo Image;
+		VkDescriptorBufferInfo Frame;
+	};
+
+	void UniformBuffer::CreateDescriptorSets(UniformBufferDescription& description)
+	{
+		//Long-lived, these sets are rewritten in place when the buffers grow
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			throw std::runtime_error("failed to create descriptor pool!");
+			description.DescriptorSets[i] = DescriptorAllocator::GetPersistentAllocator().Allocate(description.DescriptorSetLayouts);
 		}
+
+		std::vector<VkDescriptorUpdateTemplateEntry> entries;
+		if (description.UniformBufferLayouts.PlainBufferAttributes.size() > 0)
+		{
+			entries.push_back({ DRAW_BINDING, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, offsetof(UniformDescriptorData, Buffer), 0 });
+		}
+		if (description.UniformBufferLayouts.OpaqueBufferAttributes.size() > 0)
+		{
+			entries.push_back({ TEXTURE_BINDING, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offsetof(UniformDescriptorData, Image), 0 });
+		}
+		if (description.UniformBufferLayouts.FrameBufferAttributes.size() > 0)
+		{
+			entries.push_back({ FRAME_BINDING, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, offsetof(UniformDescriptorData, Frame), 0 });
+		}
+		description.UpdateTemplate = DescriptorAllocator::CreateUpdateTemplate(description.DescriptorSetLayouts, entries);
+
+		WriteDescriptors(description);
 	}
 
-	void UniformBuffer::CreateDescriptorSets(const UniformBufferLayout& layout,
-		VkDescriptorSetLayout descriptorSetLayouts,
-		std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT>& descriptorSets,
-		std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT>& uniformBuffers,
-		/* Remove this */ 
-		TextureData texture)
+	void UniformBuffer::WriteDescriptors(const UniformBufferDescription& description)
 	{
-		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayouts);
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = sm_DescriptorPool;
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		allocInfo.pSetLayouts = layouts.data();
-
-		if (vkAllocateDescriptorSets(VulkanEngine::GetDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS)
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			throw std::runtime_error("failed to allocate descriptor sets!");
+			WriteDescriptor(description, i);
 		}
+	}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			std::vector<VkWriteDescriptorSet> descriptorWrites{};
+	void UniformBuffer::WriteDescriptor(const UniformBufferDescription& description, uint32_t frame)
+	{
+		UniformDescriptorData data{};
+		data.Buffer.buffer = description.UniformBuffers[frame];
+		data.Buffer.offset = 0;
+		data.Buffer.range = description.UniformBufferLayouts.Size;
 
-			if (layout.PlainBufferAttributes.size() > 0)
-			{
-				VkDescriptorBufferInfo bufferInfo{};
-				bufferInfo.buffer = uniformBuffers[i];
-				bufferInfo.offset = 0;
-				bufferInfo.range = layout.Size;
-
-				descriptorWrites.emplace_back();
-
-				descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				descriptorWrites[0].dstSet = descriptorSets[i];
-				descriptorWrites[0].dstBinding = 0;
-				descriptorWrites[0].dstArrayElement = 0;
-				descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-				descriptorWrites[0].descriptorCount = 1;
-				descriptorWrites[0].pBufferInfo = &bufferInfo;
-			}
+		data.Image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		data.Image.imageView = description.Texture.textureImageView;
+		data.Image.sampler = description.Texture.textureSampler;
 
-			if (layout.OpaqueBufferAttributes.size() > 0)
-			{
-				VkDescriptorImageInfo imageInfo{};
-				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageInfo.imageView = texture.textureImageView;
-				imageInfo.sampler = texture.textureSampler;
-
-				descriptorWrites.emplace_back();
-
-				descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				descriptorWrites[1].dstSet = descriptorSets[i];
-				descriptorWrites[1].dstBinding = 1;
-				descriptorWrites[1].dstArrayElement = 0;
-				descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				descriptorWrites[1].descriptorCount = 1;
-				descriptorWrites[1].pImageInfo = &imageInfo;
-			}
+		data.Frame.buffer = description.FrameBuffers[frame];
+		data.Frame.offset = 0;
+		data.Frame.range = description.UniformBufferLayouts.FrameSize;
 
-			vkUpdateDescriptorSets(VulkanEngine::GetDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-		}
+		vkUpdateDescriptorSetWithTemplate(VulkanEngine::GetDevice(), description.DescriptorSets[frame], description.UpdateTemplate, &data);
 	}
 
 	void UniformBuffer::CreateUniformBuffer(size_t Size, 
@@ -249,11 +355,8 @@ namespace CHIKU
 	{
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			Utils::CreateBuffer(Size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				UniformBuffers[i], UniformBuffersMemory[i]);
-
-			vkMapMemory(VulkanEngine::GetDevice(), UniformBuffersMemory[i], 0, Size, 0, &UniformBuffersMapped[i]);
+			Utils::CreateMappedBuffer(Size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				UniformBuffers[i], UniformBuffersMemory[i], UniformBuffersMapped[i]);
 		}
 	}
 
@@ -263,6 +366,7 @@ namespace CHIKU
 
 		for (auto& [_, description] : sm_BufferDescriptions)
 		{
+			vkDestroyDescriptorUpdateTemplate(device, description.UpdateTemplate, nullptr);
 
 			vkDestroySampler(device, description.Texture.textureSampler, nullptr);
 			vkDestroyImageView(device, description.Texture.textureImageView, nullptr);
@@ -272,13 +376,15 @@ namespace CHIKU
 
 			for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 			{
-				vkDestroyBuffer(device, description.UniformBuffers[i], nullptr);
-				vkFreeMemory(device, description.UniformBuffersMemory[i], nullptr);
+				Utils::DestroyBuffer(description.UniformBuffers[i], description.UniformBuffersMemory[i]);
+				Utils::DestroyBuffer(description.FrameBuffers[i], description.FrameBuffersMemory[i]);
 			}
-
-			vkDestroyDescriptorSetLayout(device, description.DescriptorSetLayouts, nullptr);
 		}
 
-		vkDestroyDescriptorPool(device, sm_DescriptorPool, nullptr);
+		for (const RetiredBuffer& retired : sm_RetiredBuffers)
+		{
+			Utils::DestroyBuffer(retired.Buffer, retired.Memory);
+		}
+		sm_RetiredBuffers.clear();
 	}
 }
\ No newline at end of file
@@ -2,40 +2,70 @@
 #include "VulkanHeader.h"
 #include <variant>
 #include "UniformDescription.h"
+#include <glm/glm.hpp>
 
 namespace CHIKU
 {
     class UniformBuffer
     {
     public:
-        static void Init(); //Create Descriptor Pool and Generic Descriptor Set layout and Descriptor Sets.
-        static void Bind(VkPipelineLayout pipelineLayout); //Bind the Generic Descriptor Sets.
+        //Bindings of set 0
+        static constexpr uint32_t DRAW_BINDING = 0; //u_Model and u_BaseColor, one slot per draw behind a dynamic offset
+        static constexpr uint32_t TEXTURE_BINDING = 1;
+        static constexpr uint32_t FRAME_BINDING = 2; //u_View and u_Proj, written once per frame
+
+        static void Init(); //Create Generic Descriptor Set layout and Descriptor Sets.
+        static void Bind(VkPipelineLayout pipelineLayout); //Binds the frame's identity slot, for programs that ignore u_Model. Nothing is written per draw.
+        static void Bind(VkPipelineLayout pipelineLayout, const glm::mat4& model, const glm::vec4& baseColor); //Writes the next per-draw slot and binds it with a dynamic offset. Throws past the reserved slots.
         static VkDescriptorSetLayout GetDescriptorSetLayout(GenericUniformBuffers presets) { return sm_BufferDescriptions[presets].DescriptorSetLayouts; }
-        static void Update();
+        static std::vector<VkDescriptorSetLayoutBinding> GetDescriptorSetBindings(GenericUniformBuffers presets) { return GetDescriptorSetBindings(sm_BufferDescriptions[presets].UniformBufferLayouts); }
+        static void Update(); //Once per frame: the camera block, the identity slot, the per-draw slot cursor and growing the frame's buffer.
+        static const glm::mat4& GetView() { return sm_View; }
+        static const glm::mat4& GetProjection() { return sm_Proj; }
+        //Room for drawCount per-draw slots. Grows the current frame's buffer right away when nothing of the frame is bound
+        //yet, the others in their own Update. Old buffers are destroyed once no frame in flight can read them.
+        static void Reserve(uint32_t drawCount);
         static void CleanUp();
 
     private:
-        static void CreateDescriptorPool();
-
         static UniformBufferDescription GetOrBuildUniform(GenericUniformBuffers presets);
         static UniformBufferDescription CreateUniformDescription(GenericUniformBuffers presets);
         static VkDescriptorSetLayout CreateDescriptorSetLayout(const UniformBufferLayout& presets);
-        static void CreateDescriptorSets(const UniformBufferLayout& layout,
-            VkDescriptorSetLayout descriptorSetLayouts, 
-            std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT>& descriptorSets,
-            std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT>& uniformBuffers,
-            /* Remove this */
-            TextureData texture);
+        static std::vector<VkDescriptorSetLayoutBinding> GetDescriptorSetBindings(const UniformBufferLayout& bufferLayout);
+        static void CreateDescriptorSets(UniformBufferDescription& description);
 
         static void CreateUniformBuffer(size_t Size, 
             std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT>& UniformBuffers, 
             std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT>& UniformBuffersMemory,
             std::array<void*, MAX_FRAMES_IN_FLIGHT>& UniformBuffersMapped);
 
+        static void WriteDescriptors(const UniformBufferDescription& description); //Through the description's update template
+        static void WriteDescriptor(const UniformBufferDescription& description, uint32_t frame);
+        static void GrowFrame(uint32_t frame); //Swaps in a buffer of sm_DrawCapacity slots, the frame's set must not be in use
+
+        static void WriteSlot(uint32_t slot, const glm::mat4& model, const glm::vec4& baseColor);
+        static void WriteFrame(uint32_t frame);
+
         static void FinalizeLayout(UniformBufferLayout& layout);
         static UniformBufferLayout GetUniformBufferLayout(GenericUniformBuffers BufferType);
 
-        static VkDescriptorPool sm_DescriptorPool;
         static std::unordered_map<GenericUniformBuffers, UniformBufferDescription> sm_BufferDescriptions;
+        static UniformBufferDescription* sm_MVP; //Bound at set 0 by every draw, kept to skip the map lookup
+
+        static glm::mat4 sm_View;
+        static glm::mat4 sm_Proj;
+        static VkDeviceSize sm_DrawStride; //Slot size rounded up to minUniformBufferOffsetAlignment
+        struct RetiredBuffer
+        {
+            VkBuffer Buffer;
+            VkDeviceMemory Memory;
+            uint32_t FramesLeft;
+        };
+
+        static uint32_t sm_DrawCapacity; //Reserved slots, each frame's buffer catches up in GrowFrame
+        static std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> sm_FrameCapacity;
+        static uint32_t sm_DrawCursor; //Slot 0 holds the identity model and a white base color
+        static uint32_t sm_UnboundFrame; //Updated frame whose set is not bound yet, UINT32_MAX once a draw binds it
+        static std::vector<RetiredBuffer> sm_RetiredBuffers;
     };
 }
\ No newline at end of file
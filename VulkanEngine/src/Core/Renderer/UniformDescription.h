@@ -50,6 +50,8 @@ namespace CHIKU
         std::vector<OpaqueUniformBufferAttribute> OpaqueBufferAttributes;
         uint32_t Binding;
         size_t Size;
+        std::vector<PlainUniformBufferAttribute> FrameBufferAttributes; //Written once per frame, not per draw
+        size_t FrameSize = 0;
     };
 
     struct TextureData
@@ -68,6 +70,10 @@ namespace CHIKU
         std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> UniformBuffersMemory;
         std::array<void*, MAX_FRAMES_IN_FLIGHT> UniformBuffersMapped;
         std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> DescriptorSets;
+        std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> FrameBuffers;
+        std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> FrameBuffersMemory;
+        std::array<void*, MAX_FRAMES_IN_FLIGHT> FrameBuffersMapped;
+        VkDescriptorUpdateTemplate UpdateTemplate;
         TextureData Texture;
     };
 }
\ No newline at end of file
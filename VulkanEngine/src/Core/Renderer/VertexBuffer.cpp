@@ -1,6 +1,11 @@
 #include "VertexBuffer.h"
 #include "VulkanEngine/VulkanEngine.h"
+#include "VulkanEngine/CommandRecorder.h"
 #include "Utils/BufferUtils.h"
+#include "Shader.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
 
 namespace CHIKU
 {
@@ -9,6 +14,7 @@ namespace CHIKU
     void VertexBuffer::Init()
     {
         CreatePresetDescription(VertexLayoutPreset::UnLitMesh);
+        CreatePresetDescription(VertexLayoutPreset::InstancedUnLitMesh);
     }
 
     void VertexBuffer::SetLayout(VertexLayoutPreset layout)
@@ -20,39 +26,35 @@ namespace CHIKU
     {
         VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        Utils::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(VulkanEngine::GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), (size_t)bufferSize);
-        vkUnmapMemory(VulkanEngine::GetDevice(), stagingBufferMemory);
-
-        Utils::CreateBuffer(bufferSize,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            m_VertexBuffer, m_VertexBufferMemory);
+        //Transfer source so GeometryPool can copy it
+        Utils::CreateDeviceLocalBuffer(vertices.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, m_VertexBuffer, m_VertexBufferMemory);
+        m_Size = bufferSize;
+    }
 
-        Utils::CopyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
+    void VertexBuffer::CreateVertexBuffer(VkDeviceSize size, const std::function<void(void*)>& writeVertices)
+    {
+        Utils::CreateDeviceLocalBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, writeVertices, m_VertexBuffer, m_VertexBufferMemory);
+        m_Size = size;
+    }
 
-        vkDestroyBuffer(VulkanEngine::GetDevice(), stagingBuffer, nullptr);
-        vkFreeMemory(VulkanEngine::GetDevice(), stagingBufferMemory, nullptr);
+    void VertexBuffer::CreateVertexBuffer(VkDeviceSize size)
+    {
+        Utils::CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
+        m_Size = size;
     }
 
     void VertexBuffer::Bind() const
     {
-        VkBuffer vertexBuffers[] = { m_VertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(VulkanEngine::GetCommandBuffer(), 0, 1, vertexBuffers, offsets);
+        CommandRecorder::BindVertexBuffer(0, m_VertexBuffer);
     }
 
     void VertexBuffer::CleanUp()
     {
-        vkDestroyBuffer(VulkanEngine::GetDevice(), m_VertexBuffer, nullptr);
-        vkFreeMemory(VulkanEngine::GetDevice(), m_VertexBufferMemory, nullptr);
+        Utils::DestroyBuffer(m_VertexBuffer, m_VertexBufferMemory);
+        m_VertexBuffer = VK_NULL_HANDLE;
+        m_VertexBufferMemory = VK_NULL_HANDLE;
+        m_Size = 0;
     }
 
     VertexBufferLayout VertexBuffer::GetVertexBufferLayout(VertexLayoutPreset layout)
@@ -62,49 +64,75 @@ namespace CHIKU
         case CHIKU::VertexLayoutPreset::StaticMesh:
             return {
                         {
-                            {"inPosition",VertexAttributeType::Vec3},
-                            {"inColor",VertexAttributeType::Vec3}
+                            {VERTEX_FIELD_POSITION,VertexAttributeType::Vec3},
+                            {VERTEX_FIELD_COLOR,VertexAttributeType::Vec3}
                         }
             };
         case CHIKU::VertexLayoutPreset::SkinnedMesh:
             return {
                         {
-                            {"inPosition",VertexAttributeType::Vec3},
-                            {"inColor",VertexAttributeType::Vec3}
+                            {VERTEX_FIELD_POSITION,VertexAttributeType::Vec3},
+                            {VERTEX_FIELD_COLOR,VertexAttributeType::Vec3}
                         }
             };
         case CHIKU::VertexLayoutPreset::LitMesh:
             return {
                         {
-                            {"inPosition",VertexAttributeType::Vec3},
-                            {"inColor",VertexAttributeType::Vec3}
+                            {VERTEX_FIELD_POSITION,VertexAttributeType::Vec3},
+                            {VERTEX_FIELD_COLOR,VertexAttributeType::Vec3}
                         }
             };
         case CHIKU::VertexLayoutPreset::ColoredMesh:
             return {
                         {
-                            {"inPosition",VertexAttributeType::Vec3},
-                            {"inColor",VertexAttributeType::Vec3}
+                            {VERTEX_FIELD_POSITION,VertexAttributeType::Vec3},
+                            {VERTEX_FIELD_COLOR,VertexAttributeType::Vec3}
                         }
             };        case CHIKU::VertexLayoutPreset::DebugLine:
         case CHIKU::VertexLayoutPreset::PointCloud:
             return {
                         {
-                            {"inPosition",VertexAttributeType::Vec3},
-                            {"inColor",VertexAttributeType::Vec3}
+                            {VERTEX_FIELD_POSITION,VertexAttributeType::Vec3},
+                            {VERTEX_FIELD_COLOR,VertexAttributeType::Vec3}
                         }
-            };        case CHIKU::VertexLayoutPreset::Custom:
+            };        case CHIKU::VertexLayoutPreset::InstancedUnLitMesh: //The per vertex part, see GetInstanceBufferLayout
+        case CHIKU::VertexLayoutPreset::Custom:
         default:
             return {
                         {
-                            {"inPosition",VertexAttributeType::Vec3},
-                            {"inColor",VertexAttributeType::Vec3},
-                            {"inTexCoord",VertexAttributeType::Vec3}
+                            {VERTEX_FIELD_POSITION,VertexAttributeType::Vec3},
+                            {VERTEX_FIELD_COLOR,VertexAttributeType::Vec3},
+                            {VERTEX_FIELD_TEXCOORD,VertexAttributeType::Vec3}
                         }
             };
         }
     }
 
+    VertexBufferLayout VertexBuffer::GetInstanceBufferLayout()
+    {
+        return {
+                    {
+                        {INSTANCE_FIELD_TRANSFORM0,VertexAttributeType::Vec4},
+                        {INSTANCE_FIELD_TRANSFORM1,VertexAttributeType::Vec4},
+                        {INSTANCE_FIELD_TRANSFORM2,VertexAttributeType::Vec4},
+                        {INSTANCE_FIELD_TRANSFORM3,VertexAttributeType::Vec4},
+                        {INSTANCE_FIELD_COLOR,VertexAttributeType::Vec4},
+                        {INSTANCE_FIELD_MATERIAL,VertexAttributeType::UInt}
+                    }
+        };
+    }
+
+    VertexLayoutPreset VertexBuffer::GetInstancedLayout(VertexLayoutPreset layout)
+    {
+        switch (layout)
+        {
+        case CHIKU::VertexLayoutPreset::UnLitMesh:
+            return VertexLayoutPreset::InstancedUnLitMesh;
+        default:
+            return layout;
+        }
+    }
+
     void VertexBuffer::CreatePresetDescription(VertexLayoutPreset preset)
     {
         if (sm_VertexInputDescription.find(preset) != sm_VertexInputDescription.end())
@@ -118,11 +146,28 @@ namespace CHIKU
         PrepareAttributeDescriptions(preset, bufferLayout);
     }
 
+    static VkVertexInputBindingDescription GetInstanceBindingDescription()
+    {
+        //The fields are packed like FinalizeLayout packs them, the struct may only add tail padding
+        VkVertexInputBindingDescription binding{};
+        binding.binding = VertexBuffer::INSTANCE_BINDING;
+        binding.stride = sizeof(InstanceData);
+        binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return binding;
+    }
+
     void VertexBuffer::PrepareBindingDescription(VertexLayoutPreset layout, const VertexBufferLayout& bufferLayout)
     {
-        sm_VertexInputDescription[layout].BindingDescription.binding = 0;
-        sm_VertexInputDescription[layout].BindingDescription.stride = bufferLayout.Stride;
-        sm_VertexInputDescription[layout].BindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        VkVertexInputBindingDescription binding{};
+        binding.binding = 0;
+        binding.stride = bufferLayout.Stride;
+        binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        sm_VertexInputDescription[layout].BindingDescriptions = { binding };
+        if (IsInstancedLayout(layout))
+        {
+            sm_VertexInputDescription[layout].BindingDescriptions.push_back(GetInstanceBindingDescription());
+        }
     }
 
     void VertexBuffer::PrepareAttributeDescriptions(VertexLayoutPreset layout,const VertexBufferLayout& bufferLayout)
@@ -133,8 +178,115 @@ namespace CHIKU
         {
             sm_VertexInputDescription[layout].AttributeDescription[i].binding = 0;
             sm_VertexInputDescription[layout].AttributeDescription[i].location = i;
-            sm_VertexInputDescription[layout].AttributeDescription[i].format = VK_FORMAT_R32G32B32_SFLOAT;
+            sm_VertexInputDescription[layout].AttributeDescription[i].format = Utils::MapVertexAttributeTypeToVkFormat(bufferLayout.VertexElements[i].AttributeType);
             sm_VertexInputDescription[layout].AttributeDescription[i].offset = bufferLayout.VertexElements[i].Offset;
         }
+
+        if (!IsInstancedLayout(layout))
+        {
+            return;
+        }
+
+        //Instance fields take the locations after the vertex fields
+        VertexBufferLayout instanceLayout = GetInstanceBufferLayout();
+        Utils::FinalizeLayout(instanceLayout);
+        for (const VertexAttribute& field : instanceLayout.VertexElements)
+        {
+            VkVertexInputAttributeDescription attribute{};
+            attribute.binding = INSTANCE_BINDING;
+            attribute.location = static_cast<uint32_t>(sm_VertexInputDescription[layout].AttributeDescription.size());
+            attribute.format = Utils::MapVertexAttributeTypeToVkFormat(field.AttributeType);
+            attribute.offset = field.Offset;
+            sm_VertexInputDescription[layout].AttributeDescription.push_back(attribute);
+        }
+    }
+
+    static bool IsIntegerAttribute(VertexAttributeType type)
+    {
+        switch (type)
+        {
+        case VertexAttributeType::Int: case VertexAttributeType::IVec2: case VertexAttributeType::IVec3: case VertexAttributeType::IVec4:
+        case VertexAttributeType::UInt: case VertexAttributeType::UVec2: case VertexAttributeType::UVec3: case VertexAttributeType::UVec4:
+        case VertexAttributeType::UByte4: case VertexAttributeType::Short2: case VertexAttributeType::Short4:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool NamesMatch(const std::string& a, const std::string& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+            [](char x, char y) { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); });
+    }
+
+    bool VertexBuffer::BuildInputDescription(VertexLayoutPreset preset, const std::vector<ShaderVertexInput>& inputs, VertexInputDescription& description)
+    {
+        VertexBufferLayout bufferLayout = GetVertexBufferLayout(preset);
+        Utils::FinalizeLayout(bufferLayout);
+
+        VertexBufferLayout instanceLayout;
+        if (IsInstancedLayout(preset))
+        {
+            instanceLayout = GetInstanceBufferLayout();
+            Utils::FinalizeLayout(instanceLayout);
+        }
+
+        VkVertexInputBindingDescription binding{};
+        binding.binding = 0;
+        binding.stride = bufferLayout.Stride;
+        binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        description.BindingDescriptions = { binding };
+        if (IsInstancedLayout(preset))
+        {
+            description.BindingDescriptions.push_back(GetInstanceBindingDescription());
+        }
+        description.AttributeDescription.clear();
+
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            const ShaderVertexInput& input = inputs[i];
+            auto matchesInput = [&](const VertexAttribute& attribute) { return NamesMatch(attribute.ElementName, input.Name); };
+
+            const VertexAttribute* field = nullptr;
+            uint32_t fieldBinding = 0;
+            auto vertexField = std::find_if(bufferLayout.VertexElements.begin(), bufferLayout.VertexElements.end(), matchesInput);
+            auto instanceField = std::find_if(instanceLayout.VertexElements.begin(), instanceLayout.VertexElements.end(), matchesInput);
+            if (vertexField != bufferLayout.VertexElements.end())
+            {
+                field = &*vertexField;
+            }
+            else if (instanceField != instanceLayout.VertexElements.end())
+            {
+                field = &*instanceField;
+                fieldBinding = INSTANCE_BINDING;
+            }
+            else if (i < bufferLayout.VertexElements.size())
+            {
+                field = &bufferLayout.VertexElements[i];
+            }
+
+            if (!field)
+            {
+                std::cerr << "Vertex layout has no field for shader input " << input.Name << " (location " << input.Location << ")" << std::endl;
+                return false;
+            }
+
+            //The format describes the memory, so it follows the buffer. Vulkan only requires the numeric class to match.
+            if (IsIntegerAttribute(field->AttributeType) != input.Integer)
+            {
+                std::cerr << "Vertex field " << field->ElementName << " and shader input " << input.Name << " disagree on integer vs float" << std::endl;
+                return false;
+            }
+
+            VkVertexInputAttributeDescription attribute{};
+            attribute.binding = fieldBinding;
+            attribute.location = input.Location;
+            attribute.format = Utils::MapVertexAttributeTypeToVkFormat(field->AttributeType);
+            attribute.offset = field->Offset;
+            description.AttributeDescription.push_back(attribute);
+        }
+
+        return true;
     }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "VulkanHeader.h"
 #include <glm/glm.hpp>
+#include <functional>
 
 namespace CHIKU
 {
@@ -11,6 +12,12 @@ namespace CHIKU
 #define VERTEX_FIELD_WEIGHTS "inWeights"
 #define VERTEX_FIELD_TANGENT "inTangent"
 #define VERTEX_FIELD_COLOR "inColor"
+#define INSTANCE_FIELD_TRANSFORM0 "inInstanceTransform0"
+#define INSTANCE_FIELD_TRANSFORM1 "inInstanceTransform1"
+#define INSTANCE_FIELD_TRANSFORM2 "inInstanceTransform2"
+#define INSTANCE_FIELD_TRANSFORM3 "inInstanceTransform3"
+#define INSTANCE_FIELD_COLOR "inInstanceColor"
+#define INSTANCE_FIELD_MATERIAL "inInstanceMaterial"
 
     enum class VertexAttributeType
     {
@@ -51,7 +58,16 @@ namespace CHIKU
         ColoredMesh,    // position, color
         DebugLine,      // position, color (for line rendering or gizmos)
         PointCloud,     // position only
-        Custom          // for user-defined or dynamically built layouts (use with caution)
+        Custom,         // for user-defined or dynamically built layouts (use with caution)
+        InstancedUnLitMesh // UnLitMesh at binding 0, InstanceData at binding 1 per instance
+    };
+
+    //Per-instance stream of the Instanced* layouts. Matches GetInstanceBufferLayout field for field.
+    struct InstanceData
+    {
+        glm::mat4 Transform; //Read as four vec4 columns, a vertex attribute is at most 16 bytes
+        glm::vec4 Color; //Base color of the material
+        uint32_t MaterialIndex; //TextureTable index of the material
     };
 
     struct VertexAttribute
@@ -67,12 +83,16 @@ namespace CHIKU
         uint32_t Stride;
     };
 
+    struct ShaderVertexInput;
+
 	class VertexBuffer
 	{
     public:
+        static constexpr uint32_t INSTANCE_BINDING = 1;
+
         struct VertexInputDescription
         {
-            VkVertexInputBindingDescription BindingDescription;
+            std::vector<VkVertexInputBindingDescription> BindingDescriptions; //Per vertex at binding 0, per instance at INSTANCE_BINDING
             std::vector<VkVertexInputAttributeDescription> AttributeDescription;
         };
 
@@ -80,17 +100,32 @@ namespace CHIKU
         void SetLayout(VertexLayoutPreset layout);
         void SetBinding(uint32_t binding) { m_Binding = binding; }
         void CreateVertexBuffer(const std::vector<uint8_t>& vertices);
+        void CreateVertexBuffer(VkDeviceSize size, const std::function<void(void*)>& writeVertices); //Lets importers write straight into upload memory
+        void CreateVertexBuffer(VkDeviceSize size); //Uninitialized, filled by buffer copies (GeometryPool)
 
         VertexInputDescription GetBufferDescription() const { return sm_VertexInputDescription.at(m_Layout); }
-        static inline VkVertexInputBindingDescription GetBindingDescription(VertexLayoutPreset preset) { return sm_VertexInputDescription.at(preset).BindingDescription; }
+        static inline std::vector<VkVertexInputBindingDescription> GetBindingDescriptions(VertexLayoutPreset preset) { return sm_VertexInputDescription.at(preset).BindingDescriptions; }
         static inline std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(VertexLayoutPreset preset) { return sm_VertexInputDescription.at(preset).AttributeDescription; }
 
         VertexLayoutPreset GetBufferLayout() const noexcept { return m_Layout; }
+        VkBuffer GetHandle() const noexcept { return m_VertexBuffer; }
+        VkDeviceSize GetSize() const noexcept { return m_Size; }
         void Bind() const;
         void CleanUp();
 
-    private:
         static VertexBufferLayout GetVertexBufferLayout(VertexLayoutPreset layout);
+        static VertexBufferLayout GetInstanceBufferLayout();
+
+        //The layout drawing the same vertices instanced, or the layout itself when it has no instanced counterpart
+        static VertexLayoutPreset GetInstancedLayout(VertexLayoutPreset layout);
+        static bool IsInstancedLayout(VertexLayoutPreset layout) { return layout == VertexLayoutPreset::InstancedUnLitMesh; }
+
+        //Attribute locations come from the reflected shader inputs, offsets and formats from the preset's fields.
+        //Inputs are matched to fields by name, ignoring case, and by position when no name matches. Instanced layouts
+        //also match the InstanceData fields by name.
+        static bool BuildInputDescription(VertexLayoutPreset preset, const std::vector<ShaderVertexInput>& inputs, VertexInputDescription& description);
+
+    private:
         static void CreatePresetDescription(VertexLayoutPreset preset);
         static void PrepareBindingDescription(VertexLayoutPreset layout, const VertexBufferLayout& bufferLayout);
         static void PrepareAttributeDescriptions(VertexLayoutPreset layout, const VertexBufferLayout& bufferLayout);
@@ -100,8 +135,9 @@ namespace CHIKU
 
         static std::map<VertexLayoutPreset, VertexInputDescription> sm_VertexInputDescription;
 
-        VkBuffer m_VertexBuffer;
-        VkDeviceMemory m_VertexBufferMemory;
+        VkBuffer m_VertexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory m_VertexBufferMemory = VK_NULL_HANDLE;
+        VkDeviceSize m_Size = 0;
 
         VertexLayoutPreset m_Layout;
 	};
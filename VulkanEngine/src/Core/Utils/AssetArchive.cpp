@@ -0,0 +1,242 @@
+#include "AssetArchive.h"
+#include "Compression.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		std::string NormalizeArchivePath(std::string_view path)
+		{
+			if (path.substr(0, 2) == "./" || path.substr(0, 2) == ".\\")
+			{
+				path.remove_prefix(2);
+			}
+
+			//Separators normalized so Windows and Linux paths match
+			std::string normalized(path);
+			std::replace(normalized.begin(), normalized.end(), '\\', '/');
+			return normalized;
+		}
+
+		static uint64_t HashNormalizedPath(std::string_view path)
+		{
+			//FNV-1a
+			uint64_t hash = 14695981039346656037ull;
+			for (char c : path)
+			{
+				hash ^= static_cast<uint8_t>(c);
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		uint64_t HashArchivePath(std::string_view path)
+		{
+			return HashNormalizedPath(NormalizeArchivePath(path));
+		}
+
+		bool AssetArchive::Open(const std::string& path)
+		{
+			Close();
+
+			if (!m_File.Open(path))
+			{
+				return false;
+			}
+
+			ArchiveHeader header;
+			if (m_File.GetSize() < sizeof(header))
+			{
+				Close();
+				return false;
+			}
+
+			//Every size is checked against the room left rather than added to an offset, which a damaged file could overflow
+			memcpy(&header, m_File.GetData(), sizeof(header));
+			if (memcmp(header.Magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || header.Version != ARCHIVE_VERSION ||
+				header.IndexOffset % alignof(ArchiveEntry) != 0 || header.IndexOffset > m_File.GetSize() ||
+				header.EntryCount > (m_File.GetSize() - header.IndexOffset) / sizeof(ArchiveEntry))
+			{
+				std::cerr << "Invalid asset archive: " << path << std::endl;
+				Close();
+				return false;
+			}
+
+			m_Entries = reinterpret_cast<const ArchiveEntry*>(m_File.GetData() + header.IndexOffset);
+			m_EntryCount = header.EntryCount;
+
+			for (uint32_t i = 0; i < m_EntryCount; i++)
+			{
+				const ArchiveEntry& entry = m_Entries[i];
+				const bool knownCompression = entry.Compression == ArchiveCompression::None || entry.Compression == ArchiveCompression::LZ4;
+				const uint64_t stored = entry.Compression == ArchiveCompression::None ? entry.Size : entry.CompressedSize;
+				if (!knownCompression ||
+					entry.Offset > header.IndexOffset || stored > header.IndexOffset - entry.Offset ||
+					entry.PathOffset > header.IndexOffset || entry.PathLength > header.IndexOffset - entry.PathOffset)
+				{
+					std::cerr << "Corrupt asset archive entry in: " << path << std::endl;
+					Close();
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void AssetArchive::Close()
+		{
+			m_File.Close();
+			m_Entries = nullptr;
+			m_EntryCount = 0;
+		}
+
+		const ArchiveEntry* AssetArchive::Find(std::string_view path) const
+		{
+			const std::string normalized = NormalizeArchivePath(path);
+			const uint64_t hash = HashNormalizedPath(normalized);
+			const ArchiveEntry* end = m_Entries + m_EntryCount;
+			const ArchiveEntry* entry = std::lower_bound(m_Entries, end, hash,
+				[](const ArchiveEntry& e, uint64_t value) { return e.PathHash < value; });
+
+			for (; entry != end && entry->PathHash == hash; entry++)
+			{
+				std::string_view stored(reinterpret_cast<const char*>(m_File.GetData() + entry->PathOffset), entry->PathLength);
+				if (stored == normalized)
+				{
+					return entry;
+				}
+			}
+
+			return nullptr;
+		}
+
+		bool AssetArchive::Read(const ArchiveEntry& entry, std::vector<char>& data) const
+		{
+			data.resize(static_cast<size_t>(entry.Size));
+			const uint8_t* src = m_File.GetData() + entry.Offset;
+
+			switch (entry.Compression)
+			{
+			case ArchiveCompression::None:
+				if (!data.empty())
+				{
+					memcpy(data.data(), src, data.size());
+				}
+				return true;
+			case ArchiveCompression::LZ4:
+				return Decompress(src, static_cast<size_t>(entry.CompressedSize), reinterpret_cast<uint8_t*>(data.data()), data.size());
+			}
+
+			return false;
+		}
+
+		void AssetArchiveWriter::AddFile(const std::string& path, const std::vector<uint8_t>& data, bool compress)
+		{
+			PendingEntry pending;
+			pending.Path = NormalizeArchivePath(path);
+			pending.Entry = {};
+			pending.Entry.PathHash = HashNormalizedPath(pending.Path);
+			pending.Entry.PathLength = static_cast<uint32_t>(pending.Path.size());
+			pending.Entry.Size = data.size();
+			pending.Entry.Compression = ArchiveCompression::None;
+			pending.Data = data;
+
+			if (compress && !data.empty())
+			{
+				std::vector<uint8_t> compressed = Compress(data.data(), data.size());
+				if (compressed.size() < data.size() - data.size() / 8)
+				{
+					pending.Entry.Compression = ArchiveCompression::LZ4;
+					pending.Data = std::move(compressed);
+				}
+			}
+
+			pending.Entry.CompressedSize = pending.Data.size();
+			m_Entries.push_back(std::move(pending));
+		}
+
+		bool AssetArchiveWriter::Write(const std::string& outputPath) const
+		{
+			std::vector<const PendingEntry*> sorted;
+			for (const auto& entry : m_Entries)
+			{
+				sorted.push_back(&entry);
+			}
+
+			//Paths sharing a hash sit next to each other, Find compares the stored paths to pick one
+			std::sort(sorted.begin(), sorted.end(), [](const PendingEntry* a, const PendingEntry* b)
+				{
+					return a->Entry.PathHash != b->Entry.PathHash ? a->Entry.PathHash < b->Entry.PathHash : a->Path < b->Path;
+				});
+
+			for (size_t i = 1; i < sorted.size(); i++)
+			{
+				if (sorted[i]->Path == sorted[i - 1]->Path)
+				{
+					std::cerr << "Archive path added twice: " << sorted[i]->Path << std::endl;
+					return false;
+				}
+			}
+
+			//Written to a temporary file first so a failed pack never leaves a truncated archive behind
+			std::string tempPath = outputPath + ".tmp";
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file)
+			{
+				std::cerr << "Failed to create archive: " << tempPath << std::endl;
+				return false;
+			}
+
+			ArchiveHeader header{};
+			memcpy(header.Magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+			header.Version = ARCHIVE_VERSION;
+			header.EntryCount = static_cast<uint32_t>(sorted.size());
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			std::vector<ArchiveEntry> index;
+			uint64_t offset = sizeof(header);
+			for (const PendingEntry* pending : sorted)
+			{
+				ArchiveEntry entry = pending->Entry;
+				entry.PathOffset = offset;
+				entry.Offset = offset + pending->Path.size();
+				index.push_back(entry);
+
+				file.write(pending->Path.data(), pending->Path.size());
+				file.write(reinterpret_cast<const char*>(pending->Data.data()), pending->Data.size());
+				offset = entry.Offset + pending->Data.size();
+			}
+
+			uint64_t padding = (alignof(ArchiveEntry) - offset % alignof(ArchiveEntry)) % alignof(ArchiveEntry);
+			const char zeros[alignof(ArchiveEntry)] = {};
+			file.write(zeros, static_cast<std::streamsize>(padding));
+			header.IndexOffset = offset + padding;
+
+			file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(ArchiveEntry));
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.close();
+
+			if (!file)
+			{
+				std::cerr << "Failed to write archive: " << tempPath << std::endl;
+				return false;
+			}
+
+			std::error_code error;
+			std::filesystem::rename(tempPath, outputPath, error);
+			if (error)
+			{
+				std::cerr << "Failed to move archive into place: " << error.message() << std::endl;
+				return false;
+			}
+
+			return true;
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "MappedFile.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		enum class ArchiveCompression : uint32_t
+		{
+			None,
+			LZ4
+		};
+
+		struct ArchiveHeader
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint32_t EntryCount;
+			uint32_t Reserved;
+			uint64_t IndexOffset;
+		};
+
+		//Index entries are sorted by PathHash so lookups are a binary search over the mapped file. The path itself is
+		//stored too, so two paths sharing a hash are told apart.
+		struct ArchiveEntry
+		{
+			uint64_t PathHash;
+			uint64_t Offset;
+			uint64_t Size;
+			uint64_t CompressedSize;
+			uint64_t PathOffset;
+			ArchiveCompression Compression;
+			uint32_t PathLength;
+		};
+
+		static constexpr char ARCHIVE_MAGIC[4] = { 'C', 'H', 'P', 'K' };
+		static constexpr uint32_t ARCHIVE_VERSION = 2;
+
+		//Paths are stored relative to SOURCE_DIR with forward slashes, e.g. "shader/unlit.vert.spv"
+		std::string NormalizeArchivePath(std::string_view path);
+		uint64_t HashArchivePath(std::string_view path);
+
+		class AssetArchive
+		{
+		public:
+			bool Open(const std::string& path);
+			void Close();
+
+			const ArchiveEntry* Find(std::string_view path) const;
+			bool Read(const ArchiveEntry& entry, std::vector<char>& data) const;
+
+			//Points straight into the mapping, only valid for uncompressed entries
+			const uint8_t* GetRawData(const ArchiveEntry& entry) const { return m_File.GetData() + entry.Offset; }
+
+		private:
+			MappedFile m_File;
+			const ArchiveEntry* m_Entries = nullptr;
+			uint32_t m_EntryCount = 0;
+		};
+
+		class AssetArchiveWriter
+		{
+		public:
+			//Entries are compressed unless that saves less than an eighth of their size
+			void AddFile(const std::string& path, const std::vector<uint8_t>& data, bool compress = true);
+			bool Write(const std::string& outputPath) const;
+
+		private:
+			struct PendingEntry
+			{
+				std::string Path;
+				ArchiveEntry Entry;
+				std::vector<uint8_t> Data;
+			};
+
+			std::vector<PendingEntry> m_Entries;
+		};
+	}
+}
@@ -1,23 +1,57 @@
 #include "BufferUtils.h"
 #include "VulkanEngine/VulkanEngine.h"
 #include "Utils/EngineUtility.h"
+#include <mutex>
+#include <unordered_map>
 
 namespace CHIKU
 {
 	namespace Utils
 	{
-		void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+		void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset)
 		{
 			auto commandBuffer = VulkanEngine::BeginRecordingSingleTimeCommands();
 			VkBufferCopy copyRegion{};
-			copyRegion.srcOffset = 0; // Optional
-			copyRegion.dstOffset = 0; // Optional
+			copyRegion.srcOffset = srcOffset;
+			copyRegion.dstOffset = dstOffset;
 			copyRegion.size = size;
 			vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 			VulkanEngine::EndRecordingSingleTimeCommands(commandBuffer);
 		}
 
-		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+		// Heaps at or below this size are the classic 256 MiB BAR window rather than resizable BAR.
+		static constexpr VkDeviceSize BAR_WINDOW_SIZE = 256ull * 1024 * 1024;
+
+		// Bytes taken from each heap by direct uploads, and by which allocation, so DestroyBuffer can give them back
+		static VkDeviceSize s_DirectUploadBytes[VK_MAX_MEMORY_HEAPS] = {};
+		static std::unordered_map<VkDeviceMemory, std::pair<uint32_t, VkDeviceSize>> s_DirectAllocations;
+		static std::mutex s_DirectUploadMutex;
+
+		static bool TryAllocateBufferMemory(VkBuffer buffer, const VkMemoryRequirements& memRequirements, uint32_t memoryTypeIndex, VkDeviceMemory& bufferMemory)
+		{
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = memRequirements.size;
+			allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+			if (vkAllocateMemory(VulkanEngine::GetDevice(), &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+			{
+				return false;
+			}
+
+			vkBindBufferMemory(VulkanEngine::GetDevice(), buffer, bufferMemory, 0);
+			return true;
+		}
+
+		static void AllocateBufferMemory(VkBuffer buffer, const VkMemoryRequirements& memRequirements, uint32_t memoryTypeIndex, VkDeviceMemory& bufferMemory)
+		{
+			if (!TryAllocateBufferMemory(buffer, memRequirements, memoryTypeIndex, bufferMemory))
+			{
+				throw std::runtime_error("failed to allocate buffer memory!");
+			}
+		}
+
+		static VkBuffer CreateBufferHandle(VkDeviceSize size, VkBufferUsageFlags usage)
 		{
 			VkBufferCreateInfo bufferInfo{};
 			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -25,25 +59,162 @@ namespace CHIKU
 			bufferInfo.usage = usage;
 			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+			VkBuffer buffer;
 			if (vkCreateBuffer(VulkanEngine::GetDevice(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to create buffer!");
 			}
 
+			return buffer;
+		}
+
+		// Finds the direct upload type and takes the allocation's size from its heap's budget, which
+		// TryAllocateDirectUpload gives back if the allocation then fails.
+		static bool FindDirectUploadMemoryType(const VkMemoryRequirements& memRequirements, uint32_t& memoryTypeIndex)
+		{
+			const VkMemoryPropertyFlags directFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			if (!TryFindMemoryType(VulkanEngine::GetPhysicalDevice(), memRequirements.memoryTypeBits, directFlags, memoryTypeIndex))
+			{
+				return false;
+			}
+
+			VkPhysicalDeviceMemoryProperties memProperties;
+			vkGetPhysicalDeviceMemoryProperties(VulkanEngine::GetPhysicalDevice(), &memProperties);
+			uint32_t heapIndex = memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+			VkDeviceSize heapSize = memProperties.memoryHeaps[heapIndex].size;
+
+			// A small BAR window is shared with the driver, keep large uploads out of it. Either way half the heap
+			// stays free for everything that is not a direct upload, on unified memory devices too where the heap is
+			// the system memory every other allocation also comes from.
+			VkDeviceSize maxAllocation = heapSize <= BAR_WINDOW_SIZE ? heapSize / 16 : heapSize / 4;
+			if (memRequirements.size > maxAllocation)
+			{
+				return false;
+			}
+
+			std::lock_guard<std::mutex> lock(s_DirectUploadMutex);
+			if (s_DirectUploadBytes[heapIndex] + memRequirements.size > heapSize / 2)
+			{
+				return false;
+			}
+			s_DirectUploadBytes[heapIndex] += memRequirements.size;
+			return true;
+		}
+
+		static void ReleaseDirectUpload(uint32_t memoryTypeIndex, VkDeviceSize size)
+		{
+			VkPhysicalDeviceMemoryProperties memProperties;
+			vkGetPhysicalDeviceMemoryProperties(VulkanEngine::GetPhysicalDevice(), &memProperties);
+
+			std::lock_guard<std::mutex> lock(s_DirectUploadMutex);
+			VkDeviceSize& used = s_DirectUploadBytes[memProperties.memoryTypes[memoryTypeIndex].heapIndex];
+			used -= std::min(used, size);
+		}
+
+		// Allocates from the direct upload type found above, or returns its budget and false so the caller falls back
+		static bool TryAllocateDirectUpload(VkBuffer buffer, const VkMemoryRequirements& memRequirements, uint32_t memoryTypeIndex, VkDeviceMemory& bufferMemory)
+		{
+			if (!TryAllocateBufferMemory(buffer, memRequirements, memoryTypeIndex, bufferMemory))
+			{
+				ReleaseDirectUpload(memoryTypeIndex, memRequirements.size);
+				return false;
+			}
+
+			std::lock_guard<std::mutex> lock(s_DirectUploadMutex);
+			s_DirectAllocations[bufferMemory] = { memoryTypeIndex, memRequirements.size };
+			return true;
+		}
+
+		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+		{
+			buffer = CreateBufferHandle(size, usage);
+
 			VkMemoryRequirements memRequirements;
 			vkGetBufferMemoryRequirements(VulkanEngine::GetDevice(), buffer, &memRequirements);
 
-			VkMemoryAllocateInfo allocInfo{};
-			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			allocInfo.allocationSize = memRequirements.size;
-			allocInfo.memoryTypeIndex = Utils::FindMemoryType(VulkanEngine::GetPhysicalDevice(), memRequirements.memoryTypeBits, properties);
+			AllocateBufferMemory(buffer, memRequirements, Utils::FindMemoryType(VulkanEngine::GetPhysicalDevice(), memRequirements.memoryTypeBits, properties), bufferMemory);
+		}
 
-			if (vkAllocateMemory(VulkanEngine::GetDevice(), &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+		void CreateDeviceLocalBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const std::function<void(void*)>& writeData, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+		{
+			buffer = CreateBufferHandle(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+			VkMemoryRequirements memRequirements;
+			vkGetBufferMemoryRequirements(VulkanEngine::GetDevice(), buffer, &memRequirements);
+
+			uint32_t memoryTypeIndex;
+			if (FindDirectUploadMemoryType(memRequirements, memoryTypeIndex) && TryAllocateDirectUpload(buffer, memRequirements, memoryTypeIndex, bufferMemory))
 			{
-				throw std::runtime_error("failed to allocate buffer memory!");
+				void* data;
+				vkMapMemory(VulkanEngine::GetDevice(), bufferMemory, 0, size, 0, &data);
+				writeData(data);
+				vkUnmapMemory(VulkanEngine::GetDevice(), bufferMemory);
+				return;
 			}
 
-			vkBindBufferMemory(VulkanEngine::GetDevice(), buffer, bufferMemory, 0);
+			AllocateBufferMemory(buffer, memRequirements, Utils::FindMemoryType(VulkanEngine::GetPhysicalDevice(), memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), bufferMemory);
+
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingBufferMemory;
+			CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+			void* data;
+			vkMapMemory(VulkanEngine::GetDevice(), stagingBufferMemory, 0, size, 0, &data);
+			writeData(data);
+			vkUnmapMemory(VulkanEngine::GetDevice(), stagingBufferMemory);
+
+			CopyBuffer(stagingBuffer, buffer, size);
+
+			vkDestroyBuffer(VulkanEngine::GetDevice(), stagingBuffer, nullptr);
+			vkFreeMemory(VulkanEngine::GetDevice(), stagingBufferMemory, nullptr);
+		}
+
+		void CreateDeviceLocalBuffer(const void* source, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+		{
+			CreateDeviceLocalBuffer(size, usage, [source, size](void* data) { memcpy(data, source, static_cast<size_t>(size)); }, buffer, bufferMemory);
+		}
+
+		void CreateMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory, void*& mapped)
+		{
+			buffer = CreateBufferHandle(size, usage);
+
+			VkMemoryRequirements memRequirements;
+			vkGetBufferMemoryRequirements(VulkanEngine::GetDevice(), buffer, &memRequirements);
+
+			uint32_t memoryTypeIndex;
+			if (!FindDirectUploadMemoryType(memRequirements, memoryTypeIndex) || !TryAllocateDirectUpload(buffer, memRequirements, memoryTypeIndex, bufferMemory))
+			{
+				// Written by the CPU every frame, so the fallback is plain host memory rather than a staging copy
+				memoryTypeIndex = Utils::FindMemoryType(VulkanEngine::GetPhysicalDevice(), memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				AllocateBufferMemory(buffer, memRequirements, memoryTypeIndex, bufferMemory);
+			}
+
+			vkMapMemory(VulkanEngine::GetDevice(), bufferMemory, 0, size, 0, &mapped);
+		}
+
+		void DestroyBuffer(VkBuffer buffer, VkDeviceMemory bufferMemory)
+		{
+			// Looked up while the handle is still live, the driver may hand the same value to the next allocation
+			std::pair<uint32_t, VkDeviceSize> allocation;
+			bool direct = false;
+			{
+				std::lock_guard<std::mutex> lock(s_DirectUploadMutex);
+				auto it = s_DirectAllocations.find(bufferMemory);
+				if (it != s_DirectAllocations.end())
+				{
+					allocation = it->second;
+					s_DirectAllocations.erase(it);
+					direct = true;
+				}
+			}
+
+			if (direct)
+			{
+				ReleaseDirectUpload(allocation.first, allocation.second);
+			}
+
+			vkDestroyBuffer(VulkanEngine::GetDevice(), buffer, nullptr);
+			vkFreeMemory(VulkanEngine::GetDevice(), bufferMemory, nullptr);
 		}
 
         size_t GetAttributeSize(VertexAttributeType type)
@@ -1,13 +1,22 @@
 #pragma once
 #include "VulkanHeader.h"
 #include "Renderer/VertexBuffer.h"
+#include <functional>
 
 namespace CHIKU
 {
 	namespace Utils
 	{
-		void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
 		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+
+		//Writes straight into DEVICE_LOCAL | HOST_VISIBLE memory on UMA and ReBAR devices, otherwise goes through a staging buffer.
+		void CreateDeviceLocalBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const std::function<void(void*)>& writeData, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		void CreateDeviceLocalBuffer(const void* source, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		//Persistently mapped buffer for per-frame CPU writes, placed in device-local memory when it is host visible.
+		void CreateMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory, void*& mapped);
+		//For buffers of the two functions above, returns their share of the direct upload budget
+		void DestroyBuffer(VkBuffer buffer, VkDeviceMemory bufferMemory);
         
         size_t GetAttributeSize(VertexAttributeType type);
         void FinalizeLayout(VertexBufferLayout& layout);
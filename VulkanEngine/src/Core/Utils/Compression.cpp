@@ -0,0 +1,195 @@
+#include "Compression.h"
+#include <cstring>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		static constexpr size_t MIN_MATCH = 4;
+		static constexpr size_t LAST_LITERALS = 5; //The format requires the block to end with literals
+		static constexpr size_t MATCH_SEARCH_LIMIT = 12; //No match may start closer than this to the end
+		static constexpr size_t MAX_OFFSET = 65535;
+		static constexpr uint32_t HASH_BITS = 12;
+
+		static uint32_t Read32(const uint8_t* p)
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		static uint32_t Hash(uint32_t sequence)
+		{
+			return (sequence * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		static void WriteLength(std::vector<uint8_t>& out, size_t length)
+		{
+			while (length >= 255)
+			{
+				out.push_back(255);
+				length -= 255;
+			}
+			out.push_back(static_cast<uint8_t>(length));
+		}
+
+		static void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+		{
+			size_t matchCode = matchLength >= MIN_MATCH ? matchLength - MIN_MATCH : 0;
+			uint8_t token = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+			if (offset != 0)
+			{
+				token |= static_cast<uint8_t>(matchCode < 15 ? matchCode : 15);
+			}
+
+			out.push_back(token);
+			if (literalLength >= 15)
+			{
+				WriteLength(out, literalLength - 15);
+			}
+
+			out.insert(out.end(), literals, literals + literalLength);
+
+			if (offset == 0)
+			{
+				return;
+			}
+
+			out.push_back(static_cast<uint8_t>(offset & 0xFF));
+			out.push_back(static_cast<uint8_t>(offset >> 8));
+
+			if (matchCode >= 15)
+			{
+				WriteLength(out, matchCode - 15);
+			}
+		}
+
+		size_t CompressBound(size_t size)
+		{
+			return size + size / 255 + 16;
+		}
+
+		std::vector<uint8_t> Compress(const uint8_t* src, size_t size)
+		{
+			std::vector<uint8_t> out;
+			out.reserve(CompressBound(size));
+
+			size_t anchor = 0;
+			if (size > MATCH_SEARCH_LIMIT)
+			{
+				std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0); //Position + 1, zero means empty
+				size_t matchLimit = size - LAST_LITERALS;
+				size_t ip = 0;
+
+				while (ip < size - MATCH_SEARCH_LIMIT)
+				{
+					uint32_t sequence = Read32(src + ip);
+					uint32_t& slot = table[Hash(sequence)];
+					size_t candidate = slot;
+					slot = static_cast<uint32_t>(ip + 1);
+
+					if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET || Read32(src + candidate - 1) != sequence)
+					{
+						ip++;
+						continue;
+					}
+
+					size_t ref = candidate - 1;
+					size_t length = MIN_MATCH;
+					while (ip + length < matchLimit && src[ref + length] == src[ip + length])
+					{
+						length++;
+					}
+
+					WriteSequence(out, src + anchor, ip - anchor, ip - ref, length);
+					ip += length;
+					anchor = ip;
+				}
+			}
+
+			WriteSequence(out, src + anchor, size - anchor, 0, 0);
+			return out;
+		}
+
+		bool Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+		{
+			size_t ip = 0;
+			size_t op = 0;
+
+			auto readLength = [&](size_t& length) -> bool
+				{
+					uint8_t next;
+					do
+					{
+						if (ip >= srcSize) return false;
+						next = src[ip++];
+						length += next;
+					} while (next == 255);
+					return true;
+				};
+
+			while (ip < srcSize)
+			{
+				uint8_t token = src[ip++];
+
+				size_t literalLength = token >> 4;
+				if (literalLength == 15 && !readLength(literalLength))
+				{
+					return false;
+				}
+
+				if (ip + literalLength > srcSize || op + literalLength > dstSize)
+				{
+					return false;
+				}
+
+				//An empty archive entry decodes into a null destination, which memcpy must not see even for zero bytes
+				if (literalLength > 0)
+				{
+					memcpy(dst + op, src + ip, literalLength);
+				}
+				ip += literalLength;
+				op += literalLength;
+
+				if (ip == srcSize)
+				{
+					break; //Last sequence carries literals only
+				}
+
+				if (ip + 2 > srcSize)
+				{
+					return false;
+				}
+
+				size_t offset = src[ip] | (size_t(src[ip + 1]) << 8);
+				ip += 2;
+				if (offset == 0 || offset > op)
+				{
+					return false;
+				}
+
+				size_t matchLength = token & 15;
+				if (matchLength == 15 && !readLength(matchLength))
+				{
+					return false;
+				}
+				matchLength += MIN_MATCH;
+
+				if (op + matchLength > dstSize)
+				{
+					return false;
+				}
+
+				//Matches may overlap their own output, copy byte by byte
+				const uint8_t* match = dst + op - offset;
+				for (size_t i = 0; i < matchLength; i++)
+				{
+					dst[op + i] = match[i];
+				}
+				op += matchLength;
+			}
+
+			return op == dstSize;
+		}
+	}
+}
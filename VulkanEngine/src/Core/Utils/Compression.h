@@ -0,0 +1,15 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		//LZ4 block format. Fast enough to decode at I/O speed, no external dependency.
+		size_t CompressBound(size_t size);
+		std::vector<uint8_t> Compress(const uint8_t* src, size_t size);
+		bool Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+	}
+}
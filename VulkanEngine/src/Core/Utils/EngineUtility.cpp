@@ -21,6 +21,22 @@ namespace CHIKU
 			throw std::runtime_error("failed to find suitable memory type!");
 		}
 
+		bool TryFindMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& memoryTypeIndex)
+		{
+			VkPhysicalDeviceMemoryProperties memProperties;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+			for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+			{
+				if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+					memoryTypeIndex = i;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
 		QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface)
 		{
 			QueueFamilyIndices indices;
@@ -0,0 +1,198 @@
+#include "FileWatcher.h"
+#include <algorithm>
+#include <chrono>
+
+#ifdef PLT_UNIX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		FileWatcher::~FileWatcher()
+		{
+			Stop();
+		}
+
+		bool FileWatcher::Start(const std::string& directory)
+		{
+			Stop();
+
+			std::error_code error;
+			if (!std::filesystem::is_directory(directory, error))
+			{
+				return false;
+			}
+			m_Directory = directory;
+
+#ifdef PLT_UNIX
+			m_Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (m_Inotify < 0)
+			{
+				return false;
+			}
+
+			AddWatch("");
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(m_Directory, error))
+			{
+				if (entry.is_directory(error))
+				{
+					AddWatch(std::filesystem::relative(entry.path(), m_Directory, error).generic_string() + "/");
+				}
+			}
+#else
+			Scan(false);
+#endif
+
+			m_Running = true;
+			m_Thread = std::thread(&FileWatcher::WatchLoop, this);
+			return true;
+		}
+
+		void FileWatcher::Stop()
+		{
+			if (!m_Thread.joinable())
+			{
+				return;
+			}
+
+#ifdef PLT_UNIX
+			m_Running = false;
+			m_Thread.join();
+
+			close(m_Inotify);
+			m_Inotify = -1;
+			m_Watches.clear();
+#else
+			{
+				std::lock_guard<std::mutex> lock(m_StopMutex);
+				m_Running = false;
+			}
+			m_StopCondition.notify_all();
+			m_Thread.join();
+
+			m_WriteTimes.clear();
+#endif
+
+			std::lock_guard<std::mutex> lock(m_ChangedMutex);
+			m_Changed.clear();
+		}
+
+		void FileWatcher::Poll(std::vector<std::string>& changed)
+		{
+			std::lock_guard<std::mutex> lock(m_ChangedMutex);
+			changed.insert(changed.end(), m_Changed.begin(), m_Changed.end());
+			m_Changed.clear();
+		}
+
+		void FileWatcher::AddChange(const std::string& path)
+		{
+			std::lock_guard<std::mutex> lock(m_ChangedMutex);
+			if (std::find(m_Changed.begin(), m_Changed.end(), path) == m_Changed.end())
+			{
+				m_Changed.push_back(path);
+			}
+		}
+
+#ifdef PLT_UNIX
+		bool FileWatcher::AddWatch(const std::string& relativeDirectory)
+		{
+			//Close-write and moved-to only, so a file is reported once its writer is done; editors that save by rename report the rename
+			int watch = inotify_add_watch(m_Inotify, (m_Directory + "/" + relativeDirectory).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			if (watch < 0)
+			{
+				return false;
+			}
+
+			m_Watches[watch] = relativeDirectory;
+			return true;
+		}
+
+		void FileWatcher::WatchLoop()
+		{
+			alignas(inotify_event) char buffer[4096];
+
+			while (m_Running)
+			{
+				//Wakes up regularly to notice Stop
+				pollfd descriptor{ m_Inotify, POLLIN, 0 };
+				if (poll(&descriptor, 1, 100) <= 0)
+				{
+					continue;
+				}
+
+				ssize_t length;
+				while ((length = read(m_Inotify, buffer, sizeof(buffer))) > 0)
+				{
+					for (char* cursor = buffer; cursor < buffer + length;)
+					{
+						const inotify_event* event = reinterpret_cast<const inotify_event*>(cursor);
+						cursor += sizeof(inotify_event) + event->len;
+
+						auto watch = m_Watches.find(event->wd);
+						if (event->len == 0 || watch == m_Watches.end())
+						{
+							continue;
+						}
+
+						std::string path = watch->second + event->name;
+						if (event->mask & IN_ISDIR)
+						{
+							//New directories are watched from now on, files already in them are not reported
+							if (event->mask & (IN_CREATE | IN_MOVED_TO))
+							{
+								AddWatch(path + "/");
+							}
+						}
+						else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+						{
+							AddChange(path);
+						}
+					}
+				}
+			}
+		}
+#else
+		void FileWatcher::Scan(bool report)
+		{
+			std::error_code error;
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(m_Directory, error))
+			{
+				if (!entry.is_regular_file(error))
+				{
+					continue;
+				}
+
+				auto writeTime = entry.last_write_time(error);
+				if (error)
+				{
+					continue;
+				}
+
+				std::string path = std::filesystem::relative(entry.path(), m_Directory, error).generic_string();
+				auto known = m_WriteTimes.find(path);
+				if (known == m_WriteTimes.end() || known->second != writeTime)
+				{
+					m_WriteTimes[path] = writeTime;
+					if (report)
+					{
+						AddChange(path);
+					}
+				}
+			}
+		}
+
+		void FileWatcher::WatchLoop()
+		{
+			std::unique_lock<std::mutex> lock(m_StopMutex);
+			while (!m_StopCondition.wait_for(lock, std::chrono::milliseconds(500), [this]() { return !m_Running; }))
+			{
+				Scan(true);
+			}
+		}
+#endif
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		//Collects files written under a directory tree on a background thread: inotify on Linux, a modification time
+		//scan twice a second elsewhere. Paths are relative to the watched directory, with '/' separators.
+		class FileWatcher
+		{
+		public:
+			FileWatcher() = default;
+			~FileWatcher();
+
+			FileWatcher(const FileWatcher&) = delete;
+			FileWatcher& operator=(const FileWatcher&) = delete;
+
+			bool Start(const std::string& directory);
+			void Stop();
+			bool IsRunning() const { return m_Thread.joinable(); }
+
+			//Moves out every path written since the last call, each one once. Never blocks on the watcher thread.
+			void Poll(std::vector<std::string>& changed);
+
+		private:
+			void WatchLoop();
+			void AddChange(const std::string& path);
+
+		private:
+			std::string m_Directory;
+			std::thread m_Thread;
+			std::atomic<bool> m_Running{ false };
+
+			std::mutex m_ChangedMutex;
+			std::vector<std::string> m_Changed;
+
+#ifdef PLT_UNIX
+			bool AddWatch(const std::string& relativeDirectory);
+
+			int m_Inotify = -1;
+			std::unordered_map<int, std::string> m_Watches; //Watch descriptor to directory, relative with a trailing '/' or empty for the root
+#else
+			void Scan(bool report);
+
+			std::mutex m_StopMutex;
+			std::condition_variable m_StopCondition;
+			std::unordered_map<std::string, std::filesystem::file_time_type> m_WriteTimes;
+#endif
+		};
+	}
+}
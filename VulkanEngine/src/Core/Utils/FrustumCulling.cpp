@@ -0,0 +1,409 @@
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIKU_CULLING_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CHIKU_TARGET_AVX2
+#else
+//The engine is built for baseline x86-64, so the AVX2 kernel is compiled on its own and picked at runtime
+#define CHIKU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CHIKU_CULLING_NEON
+#include <arm_neon.h>
+#endif
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		//Below this many spheres per block the jobs cost more than the tests they split
+		static constexpr uint32_t MIN_BLOCK_SIZE = 16384;
+		static constexpr uint32_t MAX_BLOCKS = 64;
+
+		enum class InstructionSet
+		{
+			Scalar,
+			SSE,
+			AVX2,
+			NEON
+		};
+
+		static const char* GetInstructionSetName(InstructionSet set)
+		{
+			switch (set)
+			{
+			case InstructionSet::SSE: return "SSE";
+			case InstructionSet::AVX2: return "AVX2";
+			case InstructionSet::NEON: return "NEON";
+			default: return "scalar";
+			}
+		}
+
+		static uint32_t RoundUpToGroup(uint32_t count)
+		{
+			return (count + BoundingSpheres::GROUP_SIZE - 1) / BoundingSpheres::GROUP_SIZE * BoundingSpheres::GROUP_SIZE;
+		}
+
+		static bool HasAVX2()
+		{
+#if defined(CHIKU_CULLING_X86) && defined(_MSC_VER) && !defined(__clang__)
+			int info[4];
+			__cpuid(info, 1);
+			bool osSavesAVX = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+			if (!osSavesAVX)
+			{
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#elif defined(CHIKU_CULLING_X86)
+			return __builtin_cpu_supports("avx2");
+#else
+			return false;
+#endif
+		}
+
+		static InstructionSet GetInstructionSet()
+		{
+#if defined(CHIKU_CULLING_X86)
+			static const InstructionSet set = HasAVX2() ? InstructionSet::AVX2 : InstructionSet::SSE;
+#elif defined(CHIKU_CULLING_NEON)
+			static const InstructionSet set = InstructionSet::NEON;
+#else
+			static const InstructionSet set = InstructionSet::Scalar;
+#endif
+			return set;
+		}
+
+		//Writes every lane and only advances past the visible ones, so there is no branch per sphere
+		static inline uint32_t AppendGroup(uint32_t mask, uint32_t first, uint32_t lanes, uint32_t* out)
+		{
+			uint32_t written = 0;
+			for (uint32_t lane = 0; lane < lanes; lane++)
+			{
+				out[written] = first + lane;
+				written += (mask >> lane) & 1;
+			}
+			return written;
+		}
+
+		static uint32_t CullScalar(const BoundingSpheres& spheres, const FrustumPlanes& planes, uint32_t begin, uint32_t end, uint32_t* out)
+		{
+			uint32_t written = 0;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				out[written] = i;
+				written += IsSphereVisible(planes, spheres.Get(i)) ? 1 : 0;
+			}
+			return written;
+		}
+
+#if defined(CHIKU_CULLING_X86)
+		static uint32_t CullSSE(const BoundingSpheres& spheres, const FrustumPlanes& planes, uint32_t begin, uint32_t end, uint32_t* out)
+		{
+			__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+			for (int p = 0; p < 6; p++)
+			{
+				planeX[p] = _mm_set1_ps(planes[p].x);
+				planeY[p] = _mm_set1_ps(planes[p].y);
+				planeZ[p] = _mm_set1_ps(planes[p].z);
+				planeW[p] = _mm_set1_ps(planes[p].w);
+			}
+			const __m128 zero = _mm_setzero_ps();
+
+			uint32_t written = 0;
+			for (uint32_t i = begin; i < end; i += 4)
+			{
+				__m128 x = _mm_loadu_ps(spheres.CenterX.data() + i);
+				__m128 y = _mm_loadu_ps(spheres.CenterY.data() + i);
+				__m128 z = _mm_loadu_ps(spheres.CenterZ.data() + i);
+				__m128 r = _mm_loadu_ps(spheres.Radius.data() + i);
+
+				//Same order of operations as IsSphereVisible, so every path agrees on spheres touching a plane
+				__m128 inside = _mm_cmpeq_ps(zero, zero);
+				for (int p = 0; p < 6; p++)
+				{
+					__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_mul_ps(planeZ[p], z)), planeW[p]), r);
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+				}
+				written += AppendGroup(static_cast<uint32_t>(_mm_movemask_ps(inside)), i, 4, out + written);
+			}
+			return written;
+		}
+
+		CHIKU_TARGET_AVX2 static uint32_t CullAVX2(const BoundingSpheres& spheres, const FrustumPlanes& planes, uint32_t begin, uint32_t end, uint32_t* out)
+		{
+			__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+			for (int p = 0; p < 6; p++)
+			{
+				planeX[p] = _mm256_set1_ps(planes[p].x);
+				planeY[p] = _mm256_set1_ps(planes[p].y);
+				planeZ[p] = _mm256_set1_ps(planes[p].z);
+				planeW[p] = _mm256_set1_ps(planes[p].w);
+			}
+			const __m256 zero = _mm256_setzero_ps();
+
+			uint32_t written = 0;
+			for (uint32_t i = begin; i < end; i += 8)
+			{
+				__m256 x = _mm256_loadu_ps(spheres.CenterX.data() + i);
+				__m256 y = _mm256_loadu_ps(spheres.CenterY.data() + i);
+				__m256 z = _mm256_loadu_ps(spheres.CenterZ.data() + i);
+				__m256 r = _mm256_loadu_ps(spheres.Radius.data() + i);
+
+				__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+				for (int p = 0; p < 6; p++)
+				{
+					__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+						_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)), _mm256_mul_ps(planeZ[p], z)), planeW[p]), r);
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+				}
+				written += AppendGroup(static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, 8, out + written);
+			}
+			return written;
+		}
+#endif
+
+#if defined(CHIKU_CULLING_NEON)
+		static uint32_t CullNEON(const BoundingSpheres& spheres, const FrustumPlanes& planes, uint32_t begin, uint32_t end, uint32_t* out)
+		{
+			float32x4_t planeX[6], planeY[6], planeZ[6], planeW[6];
+			for (int p = 0; p < 6; p++)
+			{
+				planeX[p] = vdupq_n_f32(planes[p].x);
+				planeY[p] = vdupq_n_f32(planes[p].y);
+				planeZ[p] = vdupq_n_f32(planes[p].z);
+				planeW[p] = vdupq_n_f32(planes[p].w);
+			}
+			const float32x4_t zero = vdupq_n_f32(0.0f);
+			const uint32x4_t laneBits = { 1, 2, 4, 8 };
+
+			uint32_t written = 0;
+			for (uint32_t i = begin; i < end; i += 4)
+			{
+				float32x4_t x = vld1q_f32(spheres.CenterX.data() + i);
+				float32x4_t y = vld1q_f32(spheres.CenterY.data() + i);
+				float32x4_t z = vld1q_f32(spheres.CenterZ.data() + i);
+				float32x4_t r = vld1q_f32(spheres.Radius.data() + i);
+
+				uint32x4_t inside = vdupq_n_u32(~0u);
+				for (int p = 0; p < 6; p++)
+				{
+					float32x4_t distance = vaddq_f32(vaddq_f32(vaddq_f32(vaddq_f32(
+						vmulq_f32(planeX[p], x), vmulq_f32(planeY[p], y)), vmulq_f32(planeZ[p], z)), planeW[p]), r);
+					inside = vandq_u32(inside, vcgeq_f32(distance, zero));
+				}
+				//Lanes are all ones or all zeros, keeping one bit of each gives a movemask
+				written += AppendGroup(vaddvq_u32(vandq_u32(inside, laneBits)), i, 4, out + written);
+			}
+			return written;
+		}
+#endif
+
+		static uint32_t CullRange(InstructionSet set, const BoundingSpheres& spheres, const FrustumPlanes& planes, uint32_t begin, uint32_t end, uint32_t* out)
+		{
+			switch (set)
+			{
+#if defined(CHIKU_CULLING_X86)
+			case InstructionSet::SSE: return CullSSE(spheres, planes, begin, end, out);
+			case InstructionSet::AVX2: return CullAVX2(spheres, planes, begin, end, out);
+#endif
+#if defined(CHIKU_CULLING_NEON)
+			case InstructionSet::NEON: return CullNEON(spheres, planes, begin, end, out);
+#endif
+			default: return CullScalar(spheres, planes, begin, end, out);
+			}
+		}
+
+		void BoundingSpheres::Resize(uint32_t count)
+		{
+			//Padding spheres have a radius no plane distance can make up for
+			uint32_t padded = RoundUpToGroup(count);
+			CenterX.assign(padded, 0.0f);
+			CenterY.assign(padded, 0.0f);
+			CenterZ.assign(padded, 0.0f);
+			Radius.assign(padded, -FLT_MAX);
+			Count = count;
+		}
+
+		void BoundingSpheres::Set(uint32_t index, const glm::vec4& sphere)
+		{
+			CenterX[index] = sphere.x;
+			CenterY[index] = sphere.y;
+			CenterZ[index] = sphere.z;
+			Radius[index] = sphere.w;
+		}
+
+		FrustumPlanes GetFrustumPlanes(const glm::mat4& viewProjection)
+		{
+			//Rows of the matrix, glm is column major
+			glm::vec4 rows[4];
+			for (int i = 0; i < 4; i++)
+			{
+				rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+			}
+
+			FrustumPlanes planes = {
+				rows[3] + rows[0], //Left
+				rows[3] - rows[0], //Right
+				rows[3] + rows[1], //Bottom
+				rows[3] - rows[1], //Top
+				rows[2],           //Near, depth is zero to one
+				rows[3] - rows[2]  //Far
+			};
+
+			for (glm::vec4& plane : planes)
+			{
+				plane /= glm::length(glm::vec3(plane));
+			}
+			return planes;
+		}
+
+		glm::vec4 TransformSphere(const glm::mat4& transform, const glm::vec4& sphere)
+		{
+			glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+			float scale = std::max(std::max(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1]))), glm::length(glm::vec3(transform[2])));
+			return glm::vec4(center, sphere.w * scale);
+		}
+
+		bool IsSphereVisible(const FrustumPlanes& planes, const glm::vec4& sphere)
+		{
+			for (const glm::vec4& plane : planes)
+			{
+				if (!(plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w + sphere.w >= 0.0f))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		uint32_t FrustumCullRange(const BoundingSpheres& spheres, const FrustumPlanes& planes, uint32_t begin, uint32_t end, uint32_t* out)
+		{
+			return CullRange(GetInstructionSet(), spheres, planes, begin, end, out);
+		}
+
+		const char* GetFrustumCullInstructionSet()
+		{
+			return GetInstructionSetName(GetInstructionSet());
+		}
+
+		void FrustumCull(const BoundingSpheres& spheres, const FrustumPlanes& planes, std::vector<uint32_t>& visible)
+		{
+			const uint32_t count = spheres.Count;
+			if (count == 0)
+			{
+				visible.clear();
+				return;
+			}
+
+			//Each block writes at its own offset, then the results are moved together
+			uint32_t blockCount = std::clamp(count / MIN_BLOCK_SIZE, 1u, std::min(MAX_BLOCKS, JobSystem::GetWorkerCount() + 1));
+			uint32_t blockSize = RoundUpToGroup((count + blockCount - 1) / blockCount);
+			std::array<uint32_t, MAX_BLOCKS> written{};
+			visible.resize(RoundUpToGroup(count));
+
+			InstructionSet set = GetInstructionSet();
+			JobSystem::ParallelFor(blockCount, 1, [&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t block = begin; block < end; block++)
+					{
+						uint32_t first = block * blockSize;
+						uint32_t last = std::min(count, first + blockSize);
+						written[block] = first < last ? CullRange(set, spheres, planes, first, last, visible.data() + first) : 0;
+					}
+				});
+
+			uint32_t total = written[0];
+			for (uint32_t block = 1; block < blockCount; block++)
+			{
+				memmove(visible.data() + total, visible.data() + size_t(block) * blockSize, written[block] * sizeof(uint32_t));
+				total += written[block];
+			}
+			visible.resize(total);
+		}
+
+		void FrustumCullBenchmark(uint32_t iterations)
+		{
+			//A camera at the origin looking down -Z with a 90 degree field of view, spheres in a box around it
+			const float diagonal = 0.70710678f;
+			const FrustumPlanes planes = {
+				glm::vec4(diagonal, 0.0f, -diagonal, 0.0f),
+				glm::vec4(-diagonal, 0.0f, -diagonal, 0.0f),
+				glm::vec4(0.0f, diagonal, -diagonal, 0.0f),
+				glm::vec4(0.0f, -diagonal, -diagonal, 0.0f),
+				glm::vec4(0.0f, 0.0f, -1.0f, -0.1f),
+				glm::vec4(0.0f, 0.0f, 1.0f, 1000.0f)
+			};
+
+			std::mt19937 random(1234);
+			std::uniform_real_distribution<float> horizontal(-1000.0f, 1000.0f);
+			std::uniform_real_distribution<float> depth(-1100.0f, 100.0f);
+			std::uniform_real_distribution<float> radius(0.5f, 5.0f);
+
+			std::vector<InstructionSet> sets = { InstructionSet::Scalar };
+#if defined(CHIKU_CULLING_X86)
+			sets.push_back(InstructionSet::SSE);
+			if (HasAVX2())
+			{
+				sets.push_back(InstructionSet::AVX2);
+			}
+#elif defined(CHIKU_CULLING_NEON)
+			sets.push_back(InstructionSet::NEON);
+#endif
+
+			for (uint32_t count : { 10000u, 100000u, 1000000u })
+			{
+				BoundingSpheres spheres;
+				spheres.Resize(count);
+				for (uint32_t i = 0; i < count; i++)
+				{
+					spheres.Set(i, glm::vec4(horizontal(random), horizontal(random), depth(random), radius(random)));
+				}
+
+				std::vector<uint32_t> out(RoundUpToGroup(count));
+				uint32_t expected = CullScalar(spheres, planes, 0, count, out.data());
+
+				for (InstructionSet set : sets)
+				{
+					uint32_t visibleCount = 0;
+					auto start = std::chrono::high_resolution_clock::now();
+					for (uint32_t iteration = 0; iteration < iterations; iteration++)
+					{
+						visibleCount = CullRange(set, spheres, planes, 0, count, out.data());
+					}
+					double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+					std::cout << "Frustum culling, " << count << " spheres, " << GetInstructionSetName(set) << ": "
+						<< double(count) * iterations / seconds / 1e6 << " M spheres/s on one core, " << visibleCount << " visible"
+						<< (visibleCount == expected ? "" : ", NOT MATCHING SCALAR") << std::endl;
+				}
+
+				std::vector<uint32_t> visible;
+				auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t iteration = 0; iteration < iterations; iteration++)
+				{
+					FrustumCull(spheres, planes, visible);
+				}
+				double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+				uint32_t threads = JobSystem::GetWorkerCount() + 1;
+				double rate = double(count) * iterations / seconds / 1e6;
+
+				std::cout << "Frustum culling, " << count << " spheres, " << GetFrustumCullInstructionSet() << " on " << threads << " threads: "
+					<< rate << " M spheres/s, " << rate / threads << " M per core, " << visible.size() << " visible"
+					<< (visible.size() == expected ? "" : ", NOT MATCHING SCALAR") << std::endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		using FrustumPlanes = std::array<glm::vec4, 6>;
+
+		//World space bounding spheres as structure of arrays. Storage is padded to a whole SIMD group with spheres that
+		//are never visible, so the culling loops have no scalar tail.
+		struct BoundingSpheres
+		{
+			static constexpr uint32_t GROUP_SIZE = 8;
+
+			std::vector<float> CenterX;
+			std::vector<float> CenterY;
+			std::vector<float> CenterZ;
+			std::vector<float> Radius;
+			uint32_t Count = 0;
+
+			void Resize(uint32_t count);
+			void Set(uint32_t index, const glm::vec4& sphere); //Center in xyz, radius in w
+			glm::vec4 Get(uint32_t index) const { return glm::vec4(CenterX[index], CenterY[index], CenterZ[index], Radius[index]); }
+		};
+
+		//Inward, normalized planes (left, right, bottom, top, near, far) of a projection with zero-to-one depth
+		FrustumPlanes GetFrustumPlanes(const glm::mat4& viewProjection);
+		//Moves the center and scales the radius by the transform's largest axis scale
+		glm::vec4 TransformSphere(const glm::mat4& transform, const glm::vec4& sphere);
+		bool IsSphereVisible(const FrustumPlanes& planes, const glm::vec4& sphere);
+
+		//Indices of the spheres that intersect the frustum, in ascending order. Large inputs are split into blocks on
+		//the job system. visible is resized to the result and keeps its capacity between calls.
+		void FrustumCull(const BoundingSpheres& spheres, const FrustumPlanes& planes, std::vector<uint32_t>& visible);
+		//[begin, end) on the calling thread. begin is a multiple of GROUP_SIZE, end too unless it is Count. out needs
+		//room for end - begin rounded up to GROUP_SIZE indices. Returns how many were written.
+		uint32_t FrustumCullRange(const BoundingSpheres& spheres, const FrustumPlanes& planes, uint32_t begin, uint32_t end, uint32_t* out);
+		//AVX2, SSE, NEON or scalar, picked once from the CPU the engine runs on
+		const char* GetFrustumCullInstructionSet();
+
+		//Spheres culled per second on one core for every instruction set the CPU has, and on the job system, for 10k,
+		//100k and 1M random spheres. Enabled with CHIKU_BENCHMARK_CULLING=<iterations>.
+		void FrustumCullBenchmark(uint32_t iterations);
+	}
+}
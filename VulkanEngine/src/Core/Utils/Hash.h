@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+		static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+		//FNV-1a. Pass the previous result as hash to chain several buffers into one key.
+		inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= FNV_PRIME;
+			}
+			return hash;
+		}
+
+		inline uint64_t HashString(std::string_view string, uint64_t hash = FNV_OFFSET_BASIS)
+		{
+			//The length is mixed in so ("ab","c") and ("a","bc") chain to different keys
+			uint64_t length = string.size();
+			hash = HashBytes(&length, sizeof(length), hash);
+			return HashBytes(string.data(), string.size(), hash);
+		}
+	}
+}
@@ -3,6 +3,7 @@
 #include "BufferUtils.h"
 #include "EngineUtility.h"
 #include "VulkanEngine/VulkanEngine.h"
+#include "Renderer/AssetManager.h"
 #include <stb_image.h>
 
 namespace CHIKU
@@ -17,7 +18,8 @@ namespace CHIKU
 			VkImageUsageFlags usage, 
 			VkMemoryPropertyFlags properties, 
 			VkImage& image, 
-			VkDeviceMemory& imageMemory)
+			VkDeviceMemory& imageMemory,
+			uint32_t mipLevels)
 		{
 				VkImageCreateInfo imageInfo{};
 			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -25,7 +27,7 @@ namespace CHIKU
 			imageInfo.extent.width = width;
 			imageInfo.extent.height = height;
 			imageInfo.extent.depth = 1;
-			imageInfo.mipLevels = 1;
+			imageInfo.mipLevels = mipLevels;
 			imageInfo.arrayLayers = 1;
 			imageInfo.format = format;
 			imageInfo.tiling = tiling;
@@ -55,7 +57,7 @@ namespace CHIKU
 		
 		}
 
-		VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+		VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMip, uint32_t mipCount)
 		{
 			VkImageViewCreateInfo viewInfo{};
 			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -63,8 +65,8 @@ namespace CHIKU
 			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 			viewInfo.format = format;
 			viewInfo.subresourceRange.aspectMask = aspectFlags;
-			viewInfo.subresourceRange.baseMipLevel = 0;
-			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseMipLevel = baseMip;
+			viewInfo.subresourceRange.levelCount = mipCount;
 			viewInfo.subresourceRange.baseArrayLayer = 0;
 			viewInfo.subresourceRange.layerCount = 1;
 
@@ -193,8 +195,14 @@ namespace CHIKU
 
 		void CreateTextureImage(const std::string& texturePath, VkImage& textureImage, VkDeviceMemory& textureImageMemory)
 		{
+			std::vector<char> fileData;
+			if (!AssetManager::ReadFile(texturePath, fileData))
+			{
+				throw std::runtime_error("failed to open texture file: " + texturePath);
+			}
+
 			int texWidth, texHeight, texChannels;
-			stbi_uc* pixels = stbi_load((SOURCE_DIR + texturePath).c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+			stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(fileData.data()), static_cast<int>(fileData.size()), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 			VkDeviceSize imageSize = texWidth * texHeight * 4;
 
 			if (!pixels) 
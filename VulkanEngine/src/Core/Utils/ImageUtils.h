@@ -14,9 +14,11 @@ namespace CHIKU
 			VkImageUsageFlags usage, 
 			VkMemoryPropertyFlags properties, 
 			VkImage& image, 
-			VkDeviceMemory& imageMemory);
+			VkDeviceMemory& imageMemory,
+			uint32_t mipLevels = 1);
 
-		VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+		//mipCount levels starting at baseMip, VK_REMAINING_MIP_LEVELS for all of them
+		VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMip = 0, uint32_t mipCount = 1);
 		void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 		void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
@@ -0,0 +1,178 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <iostream>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		std::vector<std::thread> JobSystem::sm_Workers;
+		std::deque<JobSystem::Job> JobSystem::sm_Queue;
+		std::mutex JobSystem::sm_QueueMutex;
+		std::condition_variable JobSystem::sm_QueueCondition;
+		bool JobSystem::sm_Running = false;
+
+		void JobGroup::Wait()
+		{
+			while (!IsDone())
+			{
+				if (!JobSystem::RunPendingJob(this))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		void JobSystem::Init(uint32_t workerCount)
+		{
+			if (sm_Running)
+			{
+				return;
+			}
+
+			if (workerCount == 0)
+			{
+				workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+			}
+
+			sm_Running = true;
+			for (uint32_t i = 0; i < workerCount; i++)
+			{
+				sm_Workers.emplace_back(WorkerLoop);
+			}
+		}
+
+		void JobSystem::Shutdown()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sm_QueueMutex);
+				sm_Running = false;
+			}
+			sm_QueueCondition.notify_all();
+
+			for (auto& worker : sm_Workers)
+			{
+				worker.join();
+			}
+			sm_Workers.clear();
+
+			//Anything still queued runs here so no group is left waiting forever
+			while (RunPendingJob())
+			{
+			}
+		}
+
+		void JobSystem::Submit(std::function<void()> job, JobGroup* group)
+		{
+			Job entry = { std::move(job), group };
+			if (group)
+			{
+				group->m_Pending.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			if (sm_Workers.empty())
+			{
+				Execute(entry);
+				return;
+			}
+
+			Enqueue(std::move(entry), false);
+		}
+
+		void JobSystem::Enqueue(Job job, bool front)
+		{
+			{
+				std::lock_guard<std::mutex> lock(sm_QueueMutex);
+				if (front)
+				{
+					sm_Queue.push_front(std::move(job));
+				}
+				else
+				{
+					sm_Queue.push_back(std::move(job));
+				}
+			}
+			sm_QueueCondition.notify_one();
+		}
+
+		void JobSystem::ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& function)
+		{
+			batchSize = std::max(1u, batchSize);
+			if (sm_Workers.empty() || count <= batchSize)
+			{
+				if (count > 0)
+				{
+					function(0, count);
+				}
+				return;
+			}
+
+			//Pushed to the front last batch first, so they still start in order
+			JobGroup group;
+			uint32_t batchCount = (count + batchSize - 1) / batchSize;
+			group.m_Pending.fetch_add(batchCount, std::memory_order_relaxed);
+			for (uint32_t batch = batchCount; batch-- > 0;)
+			{
+				uint32_t begin = batch * batchSize;
+				uint32_t end = std::min(count, begin + batchSize);
+				Enqueue({ [&function, begin, end]() { function(begin, end); }, &group }, true);
+			}
+			group.Wait();
+		}
+
+		bool JobSystem::RunPendingJob(const JobGroup* group)
+		{
+			Job job;
+			{
+				std::lock_guard<std::mutex> lock(sm_QueueMutex);
+				auto it = group ? std::find_if(sm_Queue.begin(), sm_Queue.end(), [group](const Job& queued) { return queued.Group == group; }) : sm_Queue.begin();
+				if (it == sm_Queue.end())
+				{
+					return false;
+				}
+				job = std::move(*it);
+				sm_Queue.erase(it);
+			}
+
+			Execute(job);
+			return true;
+		}
+
+		void JobSystem::Execute(Job& job)
+		{
+			try
+			{
+				job.Function();
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Job failed: " << e.what() << std::endl;
+			}
+
+			if (job.Group)
+			{
+				job.Group->m_Pending.fetch_sub(1, std::memory_order_release);
+			}
+		}
+
+		void JobSystem::WorkerLoop()
+		{
+			while (true)
+			{
+				Job job;
+				{
+					std::unique_lock<std::mutex> lock(sm_QueueMutex);
+					sm_QueueCondition.wait(lock, []() { return !sm_Running || !sm_Queue.empty(); });
+					if (sm_Queue.empty())
+					{
+						return;
+					}
+					job = std::move(sm_Queue.front());
+					sm_Queue.pop_front();
+				}
+
+				Execute(job);
+			}
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		//Tracks a batch of submitted jobs
+		class JobGroup
+		{
+		public:
+			bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+			//Runs the group's own queued jobs on the calling thread until every job of the group has finished. Other
+			//jobs are left to the workers, so waiting on a short group never picks up a long unrelated one.
+			void Wait();
+
+		private:
+			friend class JobSystem;
+			std::atomic<uint32_t> m_Pending{ 0 };
+		};
+
+		//Fixed pool of worker threads sharing one queue, FIFO apart from ParallelFor batches. Without Init every job runs inline on the caller.
+		class JobSystem
+		{
+		public:
+			static void Init(uint32_t workerCount = 0); //0 uses one worker per hardware thread minus the main thread
+			static void Shutdown();
+			static uint32_t GetWorkerCount() { return static_cast<uint32_t>(sm_Workers.size()); }
+
+			static void Submit(std::function<void()> job, JobGroup* group = nullptr);
+
+			//Splits [0, count) into batches and runs function(begin, end) on the pool and the calling thread. Returns once all batches are done.
+			//Batches go ahead of jobs already queued, the caller is waiting on them.
+			static void ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& function);
+
+		private:
+			struct Job
+			{
+				std::function<void()> Function;
+				JobGroup* Group;
+			};
+
+			friend class JobGroup;
+			static void Enqueue(Job job, bool front);
+			static bool RunPendingJob(const JobGroup* group = nullptr); //The oldest queued job of group, any job for nullptr
+			static void Execute(Job& job);
+			static void WorkerLoop();
+
+		private:
+			static std::vector<std::thread> sm_Workers;
+			static std::deque<Job> sm_Queue;
+			static std::mutex sm_QueueMutex;
+			static std::condition_variable sm_QueueCondition;
+			static bool sm_Running;
+		};
+	}
+}
@@ -0,0 +1,107 @@
+#include "MappedFile.h"
+
+#ifdef PLT_WINDOWS
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		MappedFile::~MappedFile()
+		{
+			Close();
+		}
+
+		bool MappedFile::Open(const std::string& path)
+		{
+			Close();
+
+#ifdef PLT_WINDOWS
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+			{
+				CloseHandle(file);
+				return false;
+			}
+
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr)
+			{
+				CloseHandle(file);
+				return false;
+			}
+
+			void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (data == nullptr)
+			{
+				CloseHandle(mapping);
+				CloseHandle(file);
+				return false;
+			}
+
+			m_File = file;
+			m_Mapping = mapping;
+			m_Data = static_cast<const uint8_t*>(data);
+			m_Size = static_cast<size_t>(size.QuadPart);
+#else
+			int file = open(path.c_str(), O_RDONLY);
+			if (file < 0)
+			{
+				return false;
+			}
+
+			struct stat info;
+			if (fstat(file, &info) != 0 || info.st_size == 0)
+			{
+				close(file);
+				return false;
+			}
+
+			void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			close(file); //The mapping keeps its own reference to the file
+
+			if (data == MAP_FAILED)
+			{
+				return false;
+			}
+
+			m_Data = static_cast<const uint8_t*>(data);
+			m_Size = static_cast<size_t>(info.st_size);
+#endif
+			return true;
+		}
+
+		void MappedFile::Close()
+		{
+			if (m_Data == nullptr)
+			{
+				return;
+			}
+
+#ifdef PLT_WINDOWS
+			UnmapViewOfFile(m_Data);
+			CloseHandle(m_Mapping);
+			CloseHandle(m_File);
+			m_Mapping = nullptr;
+			m_File = nullptr;
+#else
+			munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+			m_Data = nullptr;
+			m_Size = 0;
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		//Read-only memory mapping of a whole file. The mapping lives as long as the object.
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			~MappedFile();
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			bool Open(const std::string& path);
+			void Close();
+
+			const uint8_t* GetData() const { return m_Data; }
+			size_t GetSize() const { return m_Size; }
+			bool IsOpen() const { return m_Data != nullptr; }
+
+		private:
+			const uint8_t* m_Data = nullptr;
+			size_t m_Size = 0;
+
+#ifdef PLT_WINDOWS
+			void* m_File = nullptr;
+			void* m_Mapping = nullptr;
+#endif
+		};
+	}
+}
@@ -0,0 +1,106 @@
+#include "RadixSort.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <array>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		static constexpr uint32_t RADIX_BITS = 8;
+		static constexpr uint32_t BUCKET_COUNT = 1u << RADIX_BITS;
+		static constexpr uint32_t PASS_COUNT = 64 / RADIX_BITS;
+		//Below this many items per block the jobs cost more than the counting they split
+		static constexpr uint32_t MIN_BLOCK_SIZE = 16384;
+		static constexpr uint32_t MAX_BLOCKS = 64;
+
+		using Histogram = std::array<uint32_t, BUCKET_COUNT>;
+
+		void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+		{
+			const uint32_t count = static_cast<uint32_t>(items.size());
+			if (count < 2)
+			{
+				return;
+			}
+			scratch.resize(count);
+
+			//Each block is counted and scattered by one job. Scattering a block in order into offsets that follow every
+			//earlier block keeps the sort stable.
+			uint32_t blockCount = std::clamp(count / MIN_BLOCK_SIZE, 1u, std::min(MAX_BLOCKS, JobSystem::GetWorkerCount() + 1));
+			uint32_t blockSize = (count + blockCount - 1) / blockCount;
+			std::vector<Histogram> histograms(blockCount);
+
+			SortItem* source = items.data();
+			SortItem* destination = scratch.data();
+			for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+			{
+				const uint32_t shift = pass * RADIX_BITS;
+
+				JobSystem::ParallelFor(blockCount, 1, [&](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t block = begin; block < end; block++)
+						{
+							Histogram& histogram = histograms[block];
+							histogram.fill(0);
+
+							uint32_t first = block * blockSize;
+							uint32_t last = std::min(count, first + blockSize);
+							for (uint32_t i = first; i < last; i++)
+							{
+								histogram[(source[i].Key >> shift) & (BUCKET_COUNT - 1)]++;
+							}
+						}
+					});
+
+				//Turn the counts into each block's first write position per bucket, bucket-major then block order
+				uint32_t offset = 0;
+				bool singleBucket = false;
+				for (uint32_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+				{
+					uint32_t bucketStart = offset;
+					for (Histogram& histogram : histograms)
+					{
+						uint32_t bucketCount = histogram[bucket];
+						histogram[bucket] = offset;
+						offset += bucketCount;
+					}
+
+					if (offset - bucketStart == count)
+					{
+						singleBucket = true;
+						break;
+					}
+				}
+
+				//Every key has the same byte here, the order would not change
+				if (singleBucket)
+				{
+					continue;
+				}
+
+				JobSystem::ParallelFor(blockCount, 1, [&](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t block = begin; block < end; block++)
+						{
+							Histogram& positions = histograms[block];
+
+							uint32_t first = block * blockSize;
+							uint32_t last = std::min(count, first + blockSize);
+							for (uint32_t i = first; i < last; i++)
+							{
+								destination[positions[(source[i].Key >> shift) & (BUCKET_COUNT - 1)]++] = source[i];
+							}
+						}
+					});
+
+				std::swap(source, destination);
+			}
+
+			if (source != items.data())
+			{
+				items.swap(scratch);
+			}
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		//A key and the position of whatever it sorts, so the payload itself never moves
+		struct SortItem
+		{
+			uint64_t Key;
+			uint32_t Index;
+		};
+
+		//Stable LSD radix sort on Key, one byte per pass. Passes in which every key has the same byte are skipped, so
+		//keys that leave bits unused cost less. Large inputs are counted and scattered in blocks on the job system.
+		//scratch is resized to the input and can be kept between calls to avoid the allocation.
+		void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+	}
+}
@@ -0,0 +1,398 @@
+#include "SceneFormat.h"
+#include "Renderer/ShaderFeatures.h"
+#include <json.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		static uint64_t AlignTable(uint64_t offset)
+		{
+			return (offset + SCENE_TABLE_ALIGNMENT - 1) & ~(SCENE_TABLE_ALIGNMENT - 1);
+		}
+
+		static SceneBounds EmptyBounds()
+		{
+			const float max = std::numeric_limits<float>::max();
+			return { glm::vec4(max, max, max, 0.0f), glm::vec4(-max, -max, -max, 0.0f) };
+		}
+
+		static void GrowBounds(SceneBounds& bounds, const glm::vec3& point)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				bounds.Min[i] = std::min(bounds.Min[i], point[i]);
+				bounds.Max[i] = std::max(bounds.Max[i], point[i]);
+			}
+		}
+
+		static glm::vec3 ReadVec3(const nlohmann::json& value, const glm::vec3& fallback)
+		{
+			if (value.is_number())
+			{
+				return glm::vec3(value.get<float>());
+			}
+			if (!value.is_array() || value.size() < 3)
+			{
+				return fallback;
+			}
+			return glm::vec3(value[0].get<float>(), value[1].get<float>(), value[2].get<float>());
+		}
+
+		static bool ComputeOBJBounds(const std::vector<char>& file, SceneBounds& bounds)
+		{
+			const char* cursor = file.data();
+			const char* end = file.data() + file.size();
+
+			while (cursor < end)
+			{
+				const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+				if (!lineEnd)
+				{
+					lineEnd = end;
+				}
+
+				if (lineEnd - cursor > 2 && cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t'))
+				{
+					//The line is copied so strtof can never read past the end of an unterminated buffer
+					std::string line(cursor + 2, lineEnd);
+					char* next = line.data();
+					glm::vec3 position;
+					for (int i = 0; i < 3; i++)
+					{
+						position[i] = std::strtof(next, &next);
+					}
+					GrowBounds(bounds, position);
+				}
+
+				cursor = lineEnd + 1;
+			}
+
+			return bounds.Min.x <= bounds.Max.x;
+		}
+
+		static bool ComputeGLTFBounds(const std::vector<char>& file, bool binary, SceneBounds& bounds)
+		{
+			std::string_view json(file.data(), file.size());
+			if (binary)
+			{
+				//12 byte GLB header followed by the JSON chunk header
+				uint32_t chunkLength = 0;
+				if (file.size() < 20 || memcmp(file.data(), "glTF", 4) != 0 || memcmp(file.data() + 16, "JSON", 4) != 0)
+				{
+					return false;
+				}
+				memcpy(&chunkLength, file.data() + 12, sizeof(chunkLength));
+				if (20 + uint64_t(chunkLength) > file.size())
+				{
+					return false;
+				}
+				json = std::string_view(file.data() + 20, chunkLength);
+			}
+
+			nlohmann::json document = nlohmann::json::parse(json.begin(), json.end(), nullptr, false);
+			if (document.is_discarded() || !document.contains("meshes") || !document.contains("accessors"))
+			{
+				return false;
+			}
+
+			//Node transforms are ignored, this is the union of every POSITION accessor's min/max
+			const nlohmann::json& accessors = document["accessors"];
+			for (const auto& mesh : document["meshes"])
+			{
+				for (const auto& primitive : mesh.value("primitives", nlohmann::json::array()))
+				{
+					const nlohmann::json& attributes = primitive.value("attributes", nlohmann::json::object());
+					if (!attributes.contains("POSITION"))
+					{
+						continue;
+					}
+
+					size_t accessorIndex = attributes["POSITION"].get<size_t>();
+					if (accessorIndex >= accessors.size() || !accessors[accessorIndex].contains("min") || !accessors[accessorIndex].contains("max"))
+					{
+						return false;
+					}
+
+					GrowBounds(bounds, ReadVec3(accessors[accessorIndex]["min"], glm::vec3(0.0f)));
+					GrowBounds(bounds, ReadVec3(accessors[accessorIndex]["max"], glm::vec3(0.0f)));
+				}
+			}
+
+			return bounds.Min.x <= bounds.Max.x;
+		}
+
+		bool ComputeMeshBounds(const std::string& path, const std::vector<char>& file, SceneBounds& bounds)
+		{
+			bounds = EmptyBounds();
+
+			std::string extension = std::filesystem::path(path).extension().string();
+			if (extension == ".glb")
+			{
+				return ComputeGLTFBounds(file, true, bounds);
+			}
+			if (extension == ".gltf")
+			{
+				return ComputeGLTFBounds(file, false, bounds);
+			}
+			return ComputeOBJBounds(file, bounds);
+		}
+
+		SceneBounds TransformBounds(const SceneBounds& bounds, const glm::mat4& transform)
+		{
+			//Arvo's method: transform the center, then sum the absolute contribution of each axis to the extent
+			glm::vec3 center = (glm::vec3(bounds.Min) + glm::vec3(bounds.Max)) * 0.5f;
+			glm::vec3 extent = (glm::vec3(bounds.Max) - glm::vec3(bounds.Min)) * 0.5f;
+
+			glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+			glm::vec3 worldExtent(0.0f);
+			for (int column = 0; column < 3; column++)
+			{
+				for (int row = 0; row < 3; row++)
+				{
+					worldExtent[row] += std::abs(transform[column][row]) * extent[column];
+				}
+			}
+
+			return { glm::vec4(worldCenter - worldExtent, 0.0f), glm::vec4(worldCenter + worldExtent, 0.0f) };
+		}
+
+		static glm::mat4 ReadEntityTransform(const nlohmann::json& entity)
+		{
+			if (entity.contains("transform") && entity["transform"].is_array() && entity["transform"].size() == 16)
+			{
+				glm::mat4 transform;
+				for (int i = 0; i < 16; i++)
+				{
+					transform[i / 4][i % 4] = entity["transform"][i].get<float>(); //Column major, like glTF
+				}
+				return transform;
+			}
+
+			glm::vec3 position = ReadVec3(entity.value("position", nlohmann::json()), glm::vec3(0.0f));
+			glm::vec3 rotation = ReadVec3(entity.value("rotation", nlohmann::json()), glm::vec3(0.0f));
+			glm::vec3 scale = ReadVec3(entity.value("scale", nlohmann::json()), glm::vec3(1.0f));
+
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+			transform = glm::rotate(transform, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+			transform = glm::rotate(transform, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+			transform = glm::rotate(transform, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+			return glm::scale(transform, scale);
+		}
+
+		bool CompileScene(const nlohmann::json& document, const SceneFileReader& readFile, std::vector<uint8_t>& output, std::string& error)
+		{
+			const nlohmann::json empty = nlohmann::json::array();
+			const nlohmann::json& meshes = document.contains("meshes") ? document["meshes"] : empty;
+			const nlohmann::json& materials = document.contains("materials") ? document["materials"] : empty;
+			const nlohmann::json& entities = document.contains("entities") ? document["entities"] : empty;
+
+			std::string strings;
+			auto addString = [&strings](const std::string& value) -> SceneString
+				{
+					SceneString string = { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(value.size()) };
+					strings += value;
+					return string;
+				};
+
+			std::vector<SceneMeshRecord> meshRecords(meshes.size());
+			for (size_t i = 0; i < meshes.size(); i++)
+			{
+				const nlohmann::json& mesh = meshes[i];
+				std::string path = mesh.is_string() ? mesh.get<std::string>() : mesh.value("path", "");
+				if (path.empty())
+				{
+					error = "mesh " + std::to_string(i) + " has no path";
+					return false;
+				}
+
+				SceneMeshRecord& record = meshRecords[i];
+				record.Path = addString(path);
+
+				if (mesh.is_object() && mesh.contains("bounds"))
+				{
+					record.LocalBounds.Min = glm::vec4(ReadVec3(mesh["bounds"].value("min", nlohmann::json()), glm::vec3(-1.0f)), 0.0f);
+					record.LocalBounds.Max = glm::vec4(ReadVec3(mesh["bounds"].value("max", nlohmann::json()), glm::vec3(1.0f)), 0.0f);
+					continue;
+				}
+
+				std::vector<char> file;
+				if (!readFile || !readFile(path, file) || !ComputeMeshBounds(path, file, record.LocalBounds))
+				{
+					error = "failed to compute bounds of mesh: " + path;
+					return false;
+				}
+			}
+
+			std::vector<SceneMaterialRecord> materialRecords(materials.size());
+			for (size_t i = 0; i < materials.size(); i++)
+			{
+				const nlohmann::json& material = materials[i];
+				SceneMaterialRecord& record = materialRecords[i];
+
+				record.Name = addString(material.value("name", ""));
+				record.Texture = addString(material.value("texture", ""));
+
+				glm::vec4 color(1.0f);
+				if (material.contains("baseColor") && material["baseColor"].is_array())
+				{
+					for (size_t c = 0; c < std::min<size_t>(4, material["baseColor"].size()); c++)
+					{
+						color[c] = material["baseColor"][c].get<float>();
+					}
+				}
+				record.BaseColor = color;
+
+				//Matches MaterialPresets, which lives with the renderer
+				record.Preset = material.value("preset", "Unlit") == "Lit" ? 0 : 1;
+
+				if (material.contains("features") && material["features"].is_array())
+				{
+					for (const auto& feature : material["features"])
+					{
+						uint32_t bit = feature.is_string() ? GetShaderFeatureBit(feature.get<std::string>()) : 0;
+						if (bit == 0)
+						{
+							error = "unknown shader feature in material " + material.value("name", std::to_string(i));
+							return false;
+						}
+						record.Features |= bit;
+					}
+				}
+			}
+
+			const uint32_t entityCount = static_cast<uint32_t>(entities.size());
+
+			SceneHeader header;
+			memset(&header, 0, sizeof(header));
+			memcpy(header.Magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+			header.Version = SCENE_VERSION;
+			header.EntityCount = entityCount;
+			header.MeshCount = static_cast<uint32_t>(meshRecords.size());
+			header.MaterialCount = static_cast<uint32_t>(materialRecords.size());
+			header.StringTableSize = static_cast<uint32_t>(strings.size());
+
+			header.TransformOffset = AlignTable(sizeof(SceneHeader));
+			header.BoundsOffset = AlignTable(header.TransformOffset + uint64_t(entityCount) * sizeof(glm::mat4));
+			header.MeshHandleOffset = AlignTable(header.BoundsOffset + uint64_t(entityCount) * sizeof(SceneBounds));
+			header.MaterialHandleOffset = AlignTable(header.MeshHandleOffset + uint64_t(entityCount) * sizeof(uint32_t));
+			header.MeshTableOffset = AlignTable(header.MaterialHandleOffset + uint64_t(entityCount) * sizeof(uint32_t));
+			header.MaterialTableOffset = AlignTable(header.MeshTableOffset + meshRecords.size() * sizeof(SceneMeshRecord));
+			header.StringTableOffset = AlignTable(header.MaterialTableOffset + materialRecords.size() * sizeof(SceneMaterialRecord));
+
+			output.assign(header.StringTableOffset + strings.size(), 0);
+			memcpy(output.data(), &header, sizeof(header));
+
+			glm::mat4* transforms = reinterpret_cast<glm::mat4*>(output.data() + header.TransformOffset);
+			SceneBounds* bounds = reinterpret_cast<SceneBounds*>(output.data() + header.BoundsOffset);
+			uint32_t* meshHandles = reinterpret_cast<uint32_t*>(output.data() + header.MeshHandleOffset);
+			uint32_t* materialHandles = reinterpret_cast<uint32_t*>(output.data() + header.MaterialHandleOffset);
+
+			for (uint32_t i = 0; i < entityCount; i++)
+			{
+				const nlohmann::json& entity = entities[i];
+
+				uint32_t mesh = entity.value("mesh", SCENE_INVALID_HANDLE);
+				if (mesh >= meshRecords.size())
+				{
+					error = "entity " + std::to_string(i) + " references an invalid mesh";
+					return false;
+				}
+
+				uint32_t material = entity.value("material", SCENE_INVALID_HANDLE);
+				if (material != SCENE_INVALID_HANDLE && material >= materialRecords.size())
+				{
+					error = "entity " + std::to_string(i) + " references an invalid material";
+					return false;
+				}
+
+				transforms[i] = ReadEntityTransform(entity);
+				bounds[i] = TransformBounds(meshRecords[mesh].LocalBounds, transforms[i]);
+				meshHandles[i] = mesh;
+				materialHandles[i] = material;
+			}
+
+			memcpy(output.data() + header.MeshTableOffset, meshRecords.data(), meshRecords.size() * sizeof(SceneMeshRecord));
+			memcpy(output.data() + header.MaterialTableOffset, materialRecords.data(), materialRecords.size() * sizeof(SceneMaterialRecord));
+			memcpy(output.data() + header.StringTableOffset, strings.data(), strings.size());
+
+			return true;
+		}
+
+		bool SceneView::Open(const uint8_t* data, size_t size)
+		{
+			*this = SceneView();
+
+			if (size < sizeof(SceneHeader) || reinterpret_cast<uintptr_t>(data) % SCENE_TABLE_ALIGNMENT != 0)
+			{
+				return false;
+			}
+
+			const SceneHeader* header = reinterpret_cast<const SceneHeader*>(data);
+			if (memcmp(header->Magic, SCENE_MAGIC, sizeof(SCENE_MAGIC)) != 0 || header->Version != SCENE_VERSION)
+			{
+				return false;
+			}
+
+			auto tableFits = [size](uint64_t offset, uint64_t bytes)
+				{
+					return offset % SCENE_TABLE_ALIGNMENT == 0 && offset <= size && bytes <= size - offset;
+				};
+
+			const uint64_t entities = header->EntityCount;
+			if (!tableFits(header->TransformOffset, entities * sizeof(glm::mat4)) ||
+				!tableFits(header->BoundsOffset, entities * sizeof(SceneBounds)) ||
+				!tableFits(header->MeshHandleOffset, entities * sizeof(uint32_t)) ||
+				!tableFits(header->MaterialHandleOffset, entities * sizeof(uint32_t)) ||
+				!tableFits(header->MeshTableOffset, uint64_t(header->MeshCount) * sizeof(SceneMeshRecord)) ||
+				!tableFits(header->MaterialTableOffset, uint64_t(header->MaterialCount) * sizeof(SceneMaterialRecord)) ||
+				!tableFits(header->StringTableOffset, header->StringTableSize))
+			{
+				return false;
+			}
+
+			m_Header = header;
+			m_Transforms = reinterpret_cast<const glm::mat4*>(data + header->TransformOffset);
+			m_Bounds = reinterpret_cast<const SceneBounds*>(data + header->BoundsOffset);
+			m_MeshHandles = reinterpret_cast<const uint32_t*>(data + header->MeshHandleOffset);
+			m_MaterialHandles = reinterpret_cast<const uint32_t*>(data + header->MaterialHandleOffset);
+			m_Meshes = reinterpret_cast<const SceneMeshRecord*>(data + header->MeshTableOffset);
+			m_Materials = reinterpret_cast<const SceneMaterialRecord*>(data + header->MaterialTableOffset);
+			m_Strings = reinterpret_cast<const char*>(data + header->StringTableOffset);
+
+			//Strings and handles are validated once here so the renderer can index without checks
+			auto stringFits = [header](const SceneString& string)
+				{
+					return uint64_t(string.Offset) + string.Length <= header->StringTableSize;
+				};
+
+			bool valid = true;
+			for (uint32_t i = 0; i < header->MeshCount; i++)
+			{
+				valid &= stringFits(m_Meshes[i].Path);
+			}
+			for (uint32_t i = 0; i < header->MaterialCount; i++)
+			{
+				valid &= stringFits(m_Materials[i].Name) && stringFits(m_Materials[i].Texture);
+			}
+			for (uint32_t i = 0; i < header->EntityCount; i++)
+			{
+				valid &= m_MeshHandles[i] < header->MeshCount &&
+					(m_MaterialHandles[i] == SCENE_INVALID_HANDLE || m_MaterialHandles[i] < header->MaterialCount);
+			}
+
+			if (!valid)
+			{
+				*this = SceneView();
+			}
+			return valid;
+		}
+	}
+}
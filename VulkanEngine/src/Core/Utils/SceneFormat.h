@@ -0,0 +1,107 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <json_fwd.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CHIKU
+{
+	namespace Utils
+	{
+		static constexpr char SCENE_MAGIC[4] = { 'C', 'H', 'S', 'C' };
+		static constexpr uint32_t SCENE_VERSION = 1;
+		static constexpr uint32_t SCENE_INVALID_HANDLE = 0xFFFFFFFF;
+		static constexpr uint64_t SCENE_TABLE_ALIGNMENT = 16; //Of every table and of the data SceneView::Open is given
+
+		//Offsets are from the start of the file. Every table is 16 byte aligned so it can be used in place.
+		struct SceneHeader
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint32_t EntityCount;
+			uint32_t MeshCount;
+			uint32_t MaterialCount;
+			uint32_t StringTableSize;
+			uint64_t TransformOffset;      //glm::mat4[EntityCount]
+			uint64_t BoundsOffset;         //SceneBounds[EntityCount], world space
+			uint64_t MeshHandleOffset;     //uint32_t[EntityCount]
+			uint64_t MaterialHandleOffset; //uint32_t[EntityCount], SCENE_INVALID_HANDLE keeps the mesh's own materials
+			uint64_t MeshTableOffset;      //SceneMeshRecord[MeshCount]
+			uint64_t MaterialTableOffset;  //SceneMaterialRecord[MaterialCount]
+			uint64_t StringTableOffset;
+		};
+
+		struct SceneBounds
+		{
+			glm::vec4 Min; //w unused
+			glm::vec4 Max;
+		};
+
+		struct SceneString
+		{
+			uint32_t Offset; //Into the string table
+			uint32_t Length;
+		};
+
+		struct SceneMeshRecord
+		{
+			SceneString Path;
+			uint32_t Reserved[2];
+			SceneBounds LocalBounds;
+		};
+
+		struct SceneMaterialRecord
+		{
+			SceneString Name;
+			SceneString Texture;
+			glm::vec4 BaseColor;
+			uint32_t Preset; //MaterialPresets value
+			uint32_t Features; //ShaderFeatures bits
+			uint32_t Reserved[2];
+		};
+
+		//Reads a file relative to SOURCE_DIR, used to measure meshes that have no authored bounds
+		using SceneFileReader = std::function<bool(const std::string& path, std::vector<char>& data)>;
+
+		//Compiles the JSON authoring form into the binary form. See README for the schema.
+		bool CompileScene(const nlohmann::json& document, const SceneFileReader& readFile, std::vector<uint8_t>& output, std::string& error);
+
+		//Local bounds of an .obj, .gltf or .glb file, computed from positions without building any vertex data
+		bool ComputeMeshBounds(const std::string& path, const std::vector<char>& file, SceneBounds& bounds);
+
+		SceneBounds TransformBounds(const SceneBounds& bounds, const glm::mat4& transform);
+
+		//Non-owning view over a compiled scene. Nothing is copied, all getters point into the given memory.
+		class SceneView
+		{
+		public:
+			bool Open(const uint8_t* data, size_t size);
+
+			uint32_t GetEntityCount() const { return m_Header ? m_Header->EntityCount : 0; }
+			uint32_t GetMeshCount() const { return m_Header ? m_Header->MeshCount : 0; }
+			uint32_t GetMaterialCount() const { return m_Header ? m_Header->MaterialCount : 0; }
+
+			const glm::mat4* GetTransforms() const { return m_Transforms; }
+			const SceneBounds* GetBounds() const { return m_Bounds; }
+			const uint32_t* GetMeshHandles() const { return m_MeshHandles; }
+			const uint32_t* GetMaterialHandles() const { return m_MaterialHandles; }
+			const SceneMeshRecord* GetMeshes() const { return m_Meshes; }
+			const SceneMaterialRecord* GetMaterials() const { return m_Materials; }
+
+			std::string_view GetString(const SceneString& string) const { return std::string_view(m_Strings + string.Offset, string.Length); }
+
+		private:
+			const SceneHeader* m_Header = nullptr;
+			const glm::mat4* m_Transforms = nullptr;
+			const SceneBounds* m_Bounds = nullptr;
+			const uint32_t* m_MeshHandles = nullptr;
+			const uint32_t* m_MaterialHandles = nullptr;
+			const SceneMeshRecord* m_Meshes = nullptr;
+			const SceneMaterialRecord* m_Materials = nullptr;
+			const char* m_Strings = nullptr;
+		};
+	}
+}
@@ -0,0 +1,164 @@
+#include "CommandRecorder.h"
+#include "VulkanEngine.h"
+
+namespace CHIKU
+{
+	VkPipeline CommandRecorder::sm_Pipeline = VK_NULL_HANDLE;
+	std::array<CommandRecorder::BoundDescriptorSet, CommandRecorder::MAX_DESCRIPTOR_SETS> CommandRecorder::sm_DescriptorSets{};
+	std::array<CommandRecorder::BoundVertexBuffer, CommandRecorder::MAX_VERTEX_BINDINGS> CommandRecorder::sm_VertexBuffers{};
+	VkBuffer CommandRecorder::sm_IndexBuffer = VK_NULL_HANDLE;
+	VkDeviceSize CommandRecorder::sm_IndexOffset = 0;
+	VkIndexType CommandRecorder::sm_IndexType = VK_INDEX_TYPE_UINT32;
+	VkViewport CommandRecorder::sm_Viewport{};
+	VkRect2D CommandRecorder::sm_Scissor{};
+	bool CommandRecorder::sm_HasViewport = false;
+	bool CommandRecorder::sm_HasScissor = false;
+	bool CommandRecorder::sm_Filtering = true;
+	CommandRecorder::Statistics CommandRecorder::sm_Statistics{};
+	CommandRecorder::Statistics CommandRecorder::sm_LastFrameStatistics{};
+
+	void CommandRecorder::BeginFrame()
+	{
+		sm_Pipeline = VK_NULL_HANDLE;
+		sm_DescriptorSets.fill({});
+		sm_VertexBuffers.fill({});
+		sm_IndexBuffer = VK_NULL_HANDLE;
+		sm_HasViewport = false;
+		sm_HasScissor = false;
+
+		sm_LastFrameStatistics = sm_Statistics;
+		sm_Statistics = {};
+	}
+
+	bool CommandRecorder::Record(bool redundant)
+	{
+		if (redundant && sm_Filtering)
+		{
+			sm_Statistics.Skipped++;
+			return false;
+		}
+
+		sm_Statistics.Issued++;
+		return true;
+	}
+
+	void CommandRecorder::BindPipeline(VkPipeline pipeline)
+	{
+		if (Record(pipeline == sm_Pipeline))
+		{
+			vkCmdBindPipeline(VulkanEngine::GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			sm_Pipeline = pipeline;
+		}
+	}
+
+	void CommandRecorder::BindDescriptorSet(VkPipelineLayout layout, uint32_t set, VkDescriptorSet descriptorSet, const uint32_t* dynamicOffset)
+	{
+		bool redundant = false;
+		if (set < MAX_DESCRIPTOR_SETS)
+		{
+			const BoundDescriptorSet& bound = sm_DescriptorSets[set];
+			redundant = bound.Layout == layout && bound.Set == descriptorSet && bound.HasDynamicOffset == (dynamicOffset != nullptr) &&
+				(!dynamicOffset || bound.DynamicOffset == *dynamicOffset);
+		}
+
+		if (!Record(redundant))
+		{
+			return;
+		}
+
+		vkCmdBindDescriptorSets(VulkanEngine::GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, 1, &descriptorSet,
+			dynamicOffset ? 1 : 0, dynamicOffset);
+
+		//Sets bound through the same layout are compatible with it, anything else may have been disturbed
+		for (BoundDescriptorSet& bound : sm_DescriptorSets)
+		{
+			if (bound.Layout != layout)
+			{
+				bound = {};
+			}
+		}
+
+		if (set < MAX_DESCRIPTOR_SETS)
+		{
+			sm_DescriptorSets[set] = { layout, descriptorSet, dynamicOffset != nullptr, dynamicOffset ? *dynamicOffset : 0 };
+		}
+	}
+
+	void CommandRecorder::BindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset)
+	{
+		bool redundant = binding < MAX_VERTEX_BINDINGS && sm_VertexBuffers[binding].Buffer == buffer && sm_VertexBuffers[binding].Offset == offset;
+		if (!Record(redundant))
+		{
+			return;
+		}
+
+		vkCmdBindVertexBuffers(VulkanEngine::GetCommandBuffer(), binding, 1, &buffer, &offset);
+		if (binding < MAX_VERTEX_BINDINGS)
+		{
+			sm_VertexBuffers[binding] = { buffer, offset };
+		}
+	}
+
+	void CommandRecorder::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+	{
+		if (Record(buffer == sm_IndexBuffer && offset == sm_IndexOffset && indexType == sm_IndexType))
+		{
+			vkCmdBindIndexBuffer(VulkanEngine::GetCommandBuffer(), buffer, offset, indexType);
+			sm_IndexBuffer = buffer;
+			sm_IndexOffset = offset;
+			sm_IndexType = indexType;
+		}
+	}
+
+	void CommandRecorder::SetViewport(const VkViewport& viewport)
+	{
+		bool redundant = sm_HasViewport && viewport.x == sm_Viewport.x && viewport.y == sm_Viewport.y &&
+			viewport.width == sm_Viewport.width && viewport.height == sm_Viewport.height &&
+			viewport.minDepth == sm_Viewport.minDepth && viewport.maxDepth == sm_Viewport.maxDepth;
+		if (Record(redundant))
+		{
+			vkCmdSetViewport(VulkanEngine::GetCommandBuffer(), 0, 1, &viewport);
+			sm_Viewport = viewport;
+			sm_HasViewport = true;
+		}
+	}
+
+	void CommandRecorder::SetScissor(const VkRect2D& scissor)
+	{
+		bool redundant = sm_HasScissor && scissor.offset.x == sm_Scissor.offset.x && scissor.offset.y == sm_Scissor.offset.y &&
+			scissor.extent.width == sm_Scissor.extent.width && scissor.extent.height == sm_Scissor.extent.height;
+		if (Record(redundant))
+		{
+			vkCmdSetScissor(VulkanEngine::GetCommandBuffer(), 0, 1, &scissor);
+			sm_Scissor = scissor;
+			sm_HasScissor = true;
+		}
+	}
+
+	void CommandRecorder::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data)
+	{
+		Record(false);
+		vkCmdPushConstants(VulkanEngine::GetCommandBuffer(), layout, stages, offset, size, data);
+	}
+
+	void CommandRecorder::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+	{
+		Record(false);
+		sm_Statistics.Draws++;
+		vkCmdDrawIndexed(VulkanEngine::GetCommandBuffer(), indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	}
+
+	void CommandRecorder::DrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+	{
+		Record(false);
+		sm_Statistics.Draws++;
+		vkCmdDrawIndexedIndirect(VulkanEngine::GetCommandBuffer(), buffer, offset, drawCount, stride);
+	}
+
+	void CommandRecorder::DrawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride)
+	{
+		Record(false);
+		sm_Statistics.Draws++;
+		VulkanEngine::GetDrawIndexedIndirectCount()(VulkanEngine::GetCommandBuffer(), buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+	}
+}
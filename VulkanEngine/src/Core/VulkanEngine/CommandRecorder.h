@@ -0,0 +1,79 @@
+#pragma once
+#include "VulkanHeader.h"
+#include <array>
+
+namespace CHIKU
+{
+	//Graphics state and draws of the frame command buffer. Remembers the bound pipeline, descriptor sets per slot,
+	//vertex and index buffers, viewport and scissor, and drops a call that would bind what is already bound.
+	//Draws and push constants are always recorded. Compute work binds its own bind point and is not tracked.
+	class CommandRecorder
+	{
+	public:
+		static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4;
+		static constexpr uint32_t MAX_VERTEX_BINDINGS = 4;
+
+		struct Statistics
+		{
+			uint32_t Issued = 0;  //Recorded into the command buffer, draws included
+			uint32_t Skipped = 0; //Dropped because the state was already bound
+			uint32_t Draws = 0;
+		};
+
+		//With each new recording of the frame command buffer, which starts with nothing bound
+		static void BeginFrame();
+		//On unless CHIKU_DISABLE_STATE_FILTERING is set, see Renderer::Init. Off records every call, still counted.
+		static void SetFiltering(bool enabled) { sm_Filtering = enabled; }
+
+		static void BindPipeline(VkPipeline pipeline);
+		//At most one dynamic offset. Sets bound with another pipeline layout are forgotten, this bind may disturb them.
+		static void BindDescriptorSet(VkPipelineLayout layout, uint32_t set, VkDescriptorSet descriptorSet, const uint32_t* dynamicOffset = nullptr);
+		static void BindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0);
+		static void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+		static void SetViewport(const VkViewport& viewport);
+		static void SetScissor(const VkRect2D& scissor);
+		static void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+
+		static void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+		static void DrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride);
+		//Needs VulkanEngine::GetDrawIndexedIndirectCount
+		static void DrawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride);
+
+		static const Statistics& GetStatistics() { return sm_Statistics; } //Recorded so far this frame
+		static const Statistics& GetLastFrameStatistics() { return sm_LastFrameStatistics; }
+
+	private:
+		struct BoundDescriptorSet
+		{
+			VkPipelineLayout Layout = VK_NULL_HANDLE; //VK_NULL_HANDLE when unknown
+			VkDescriptorSet Set = VK_NULL_HANDLE;
+			bool HasDynamicOffset = false;
+			uint32_t DynamicOffset = 0;
+		};
+
+		struct BoundVertexBuffer
+		{
+			VkBuffer Buffer = VK_NULL_HANDLE;
+			VkDeviceSize Offset = 0;
+		};
+
+		//True when the call has to be recorded, counts it either way
+		static bool Record(bool redundant);
+
+	private:
+		static VkPipeline sm_Pipeline;
+		static std::array<BoundDescriptorSet, MAX_DESCRIPTOR_SETS> sm_DescriptorSets;
+		static std::array<BoundVertexBuffer, MAX_VERTEX_BINDINGS> sm_VertexBuffers;
+		static VkBuffer sm_IndexBuffer;
+		static VkDeviceSize sm_IndexOffset;
+		static VkIndexType sm_IndexType;
+		static VkViewport sm_Viewport;
+		static VkRect2D sm_Scissor;
+		static bool sm_HasViewport;
+		static bool sm_HasScissor;
+
+		static bool sm_Filtering;
+		static Statistics sm_Statistics;
+		static Statistics sm_LastFrameStatistics;
+	};
+}
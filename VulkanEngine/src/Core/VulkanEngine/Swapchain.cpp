@@ -11,7 +11,8 @@ namespace CHIKU
         m_LogicalDevice = logicalDevice;
         CreateSwapchain(window,physicalDevice,surface);
         CreateImageViews();
-        CreateRenderpass(physicalDevice);
+        CreateRenderpass(physicalDevice, false, m_RenderPass);
+        CreateRenderpass(physicalDevice, true, m_LoadRenderPass);
         CreateDepthResources(physicalDevice);
         CreateFrameBuffers();
     }
@@ -34,6 +35,7 @@ namespace CHIKU
 
         vkDestroySwapchainKHR(m_LogicalDevice, m_SwapChain, nullptr);
         vkDestroyRenderPass(m_LogicalDevice, Swapchain::m_RenderPass, nullptr);
+        vkDestroyRenderPass(m_LogicalDevice, m_LoadRenderPass, nullptr);
     }
 
     void Swapchain::RecreateSwapchain(GLFWwindow* window,const VkPhysicalDevice& physicalDevice,const VkSurfaceKHR& surface)
@@ -60,20 +62,21 @@ namespace CHIKU
         return  Utils::FindSupportedFormat(physicalDevice,
             { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
             VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
         );
     }
 
     void Swapchain::CreateDepthResources(const VkPhysicalDevice&physicalDevice)
     {
         VkFormat depthFormat = FindDepthFormat(physicalDevice);
+        m_DepthFormat = depthFormat;
 
         Utils::CreateImage(
             m_SwapChainExtent.width, 
             m_SwapChainExtent.height, 
             depthFormat,
             VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, //Sampled by DepthPyramid
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             m_DepthImage,
             m_DepthImageMemory);
@@ -88,11 +91,11 @@ namespace CHIKU
     }
 
     bool u = false;
-    void Swapchain::BeginRenderPass(const VkCommandBuffer& commandBuffer,uint32_t imageIndex)
+    void Swapchain::BeginRenderPass(const VkCommandBuffer& commandBuffer,uint32_t imageIndex, bool load)
     {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = m_RenderPass;
+        renderPassInfo.renderPass = load ? m_LoadRenderPass : m_RenderPass;
         renderPassInfo.framebuffer = SwapChainFramebuffers[imageIndex];
         renderPassInfo.renderArea.offset = { 0, 0 };
         renderPassInfo.renderArea.extent = m_SwapChainExtent;
@@ -102,25 +105,10 @@ namespace CHIKU
         clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
         clearValues[1].depthStencil = { 1.0f, 0 };
 
-        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.clearValueCount = load ? 0 : static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
         vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(m_SwapChainExtent.width);
-        viewport.height = static_cast<float>(m_SwapChainExtent.height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-        VkRect2D scissor{};
-        scissor.offset = { 0, 0 };
-        scissor.extent = m_SwapChainExtent;
-
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
     }
 
     void Swapchain::EndRenderPass(const VkCommandBuffer& commandBuffer)
@@ -128,26 +116,27 @@ namespace CHIKU
         vkCmdEndRenderPass(commandBuffer);
     }
 
-    void Swapchain::CreateRenderpass(const VkPhysicalDevice&physicalDevice)
+    void Swapchain::CreateRenderpass(const VkPhysicalDevice&physicalDevice, bool load, VkRenderPass& renderPass)
     {
         VkAttachmentDescription colorAttachment{};
         colorAttachment.format = m_SwapChainImageFormat;
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.initialLayout = load ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
         colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+        //Depth is kept after the first pass of a frame for DepthPyramid and the passes that continue it
         VkAttachmentDescription depthAttachment{};
         depthAttachment.format = FindDepthFormat(physicalDevice);
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.initialLayout = load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
         depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
         VkAttachmentReference colorAttachmentRef{};
@@ -172,6 +161,12 @@ namespace CHIKU
         dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
         dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
         dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        if (load)
+        {
+            //Reads what the previous pass of the frame wrote
+            dependency.srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        }
 
         std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
         VkRenderPassCreateInfo renderPassInfo{};
@@ -183,7 +178,7 @@ namespace CHIKU
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
-        if (vkCreateRenderPass(m_LogicalDevice, &renderPassInfo, nullptr, &m_RenderPass) != VK_SUCCESS) {
+        if (vkCreateRenderPass(m_LogicalDevice, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
     }
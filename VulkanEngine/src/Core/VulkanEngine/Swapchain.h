@@ -18,11 +18,17 @@ namespace CHIKU
 		void RecreateSwapchain(GLFWwindow* window, const VkPhysicalDevice& physicalDevice, const VkSurfaceKHR& surface);
 		void CreateDepthResources(const VkPhysicalDevice& physicalDevice);
 		VkResult AcquireNextImageInSwapchain(const VkDevice& device, const VkSemaphore& semaphore, uint32_t* pImageIndex);
-		void BeginRenderPass(const VkCommandBuffer& commandBuffer, uint32_t imageIndex);
+		//load continues on what an earlier render pass of the frame left in the attachments instead of clearing them
+		void BeginRenderPass(const VkCommandBuffer& commandBuffer, uint32_t imageIndex, bool load = false);
 		void EndRenderPass(const VkCommandBuffer& commandBuffer);
 		
 		const VkSwapchainKHR& GetSwapchain() const { return m_SwapChain; }
 		const VkRenderPass& GetRenderPass() const { return m_RenderPass; }
+		const VkExtent2D& GetExtent() const { return m_SwapChainExtent; }
+		//Sampleable, depth aspect only. Stored by the render passes and left in DEPTH_STENCIL_ATTACHMENT_OPTIMAL.
+		const VkImage& GetDepthImage() const { return m_DepthImage; }
+		const VkImageView& GetDepthImageView() const { return m_DepthImageView; }
+		VkFormat GetDepthFormat() const { return m_DepthFormat; }
 
 	private:
 		SwapChainSupportDetails QuerySwapChainSupport(const VkPhysicalDevice& device, const VkSurfaceKHR& surface);
@@ -31,7 +37,7 @@ namespace CHIKU
 		VkExtent2D ChooseSwapExtent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities);
 		VkFormat FindDepthFormat(const VkPhysicalDevice& physicalDevice);
 
-		void CreateRenderpass(const VkPhysicalDevice& physicalDevice);
+		void CreateRenderpass(const VkPhysicalDevice& physicalDevice, bool load, VkRenderPass& renderPass);
 		void CreateSwapchain(GLFWwindow* window, const VkPhysicalDevice& physicalDevice,const VkSurfaceKHR& surface);
 		void CreateImageViews();
 		void CreateFrameBuffers();
@@ -41,11 +47,13 @@ namespace CHIKU
 		VkExtent2D m_SwapChainExtent;
 		VkDevice m_LogicalDevice;
 		VkRenderPass m_RenderPass;
+		VkRenderPass m_LoadRenderPass; //Compatible with m_RenderPass, so the same framebuffers and pipelines work with it
 		VkFormat m_SwapChainImageFormat;
 
 		VkImage m_DepthImage;
 		VkDeviceMemory m_DepthImageMemory;
 		VkImageView m_DepthImageView;
+		VkFormat m_DepthFormat;
 
 		std::vector<VkFramebuffer> SwapChainFramebuffers;
 		std::vector<VkImage> m_SwapChainImages;
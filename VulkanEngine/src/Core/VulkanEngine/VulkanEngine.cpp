@@ -1,4 +1,5 @@
 #include "VulkanEngine.h"
+#include "CommandRecorder.h"
 #include "Utils/EngineUtility.h"
 
 #include <iostream>
@@ -99,6 +100,8 @@ namespace CHIKU
 		vkResetFences(m_LogicalDevice, 1, &m_InFlightFence[m_CurrentFrame]);
 		vkResetCommandBuffer(commandBuffer, 0);
 		BeginRecordingCommands(commandBuffer);
+		CommandRecorder::BeginFrame();
+		m_RenderPassRecorded = false;
 	}
 
 	void VulkanEngine::PrivateEndFrame()
@@ -150,13 +153,49 @@ namespace CHIKU
 		{
 			throw std::runtime_error("failed to begin recording command buffer!");
 		}
+	}
 
-		m_Swapchain.BeginRenderPass(commandBuffer, m_ImageIndex);
+	void VulkanEngine::PrivateBeginRenderPass()
+	{
+		if (!m_InRenderPass)
+		{
+			m_Swapchain.BeginRenderPass(m_Commands.GetCommandBuffer(m_CurrentFrame), m_ImageIndex, m_RenderPassRecorded);
+			m_InRenderPass = true;
+
+			//Dynamic state outlives the render pass, a pass that continues the frame finds it set already
+			const VkExtent2D& extent = m_Swapchain.GetExtent();
+			VkViewport viewport{};
+			viewport.x = 0.0f;
+			viewport.y = 0.0f;
+			viewport.width = static_cast<float>(extent.width);
+			viewport.height = static_cast<float>(extent.height);
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+			CommandRecorder::SetViewport(viewport);
+
+			VkRect2D scissor{};
+			scissor.offset = { 0, 0 };
+			scissor.extent = extent;
+			CommandRecorder::SetScissor(scissor);
+		}
+	}
+
+	void VulkanEngine::PrivateEndRenderPass()
+	{
+		if (m_InRenderPass)
+		{
+			m_Swapchain.EndRenderPass(m_Commands.GetCommandBuffer(m_CurrentFrame));
+			m_InRenderPass = false;
+			m_RenderPassRecorded = true;
+		}
 	}
 
 	void VulkanEngine::EndRecordingCommands(const VkCommandBuffer& commandBuffer)
 	{
+		//A frame that drew nothing still clears and transitions the swapchain image
+		PrivateBeginRenderPass();
 		m_Swapchain.EndRenderPass(commandBuffer);
+		m_InRenderPass = false;
 
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 		{
@@ -233,7 +272,7 @@ namespace CHIKU
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "CHIKU";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		appInfo.apiVersion = VK_API_VERSION_1_2;
 
 		VkInstanceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -386,10 +425,31 @@ namespace CHIKU
 
 		VkPhysicalDeviceFeatures deviceFeatures{};
 
+		std::vector<const char*> deviceExtensions = m_DeviceExtensions;
+		VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		m_DescriptorIndexing = QueryDescriptorIndexing(indexingFeatures, deviceExtensions);
+		if (m_DescriptorIndexing)
+		{
+			indexingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+			createInfo.pNext = &indexingFeatures;
+		}
+
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures{};
+		libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+		m_PipelineLibrary = QueryPipelineLibrary(libraryFeatures, deviceExtensions);
+		if (m_PipelineLibrary)
+		{
+			libraryFeatures.pNext = const_cast<void*>(createInfo.pNext);
+			createInfo.pNext = &libraryFeatures;
+		}
+
+		m_DrawIndirectCount = QueryIndirectDraw(deviceFeatures, deviceExtensions);
+
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(uniqueQueueFamilies.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(m_DeviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 		createInfo.pEnabledFeatures = &deviceFeatures;
 		createInfo.enabledLayerCount = 0;
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
@@ -407,6 +467,103 @@ namespace CHIKU
 
 		vkGetDeviceQueue(m_LogicalDevice, indices.GraphicsFamily.value(), 0, &m_GraphicsQueue);
 		vkGetDeviceQueue(m_LogicalDevice, indices.PresentFamily.value(), 0, &m_PresentQueue);
+
+		if (m_DrawIndirectCount)
+		{
+			m_DrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(m_LogicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
+	}
+
+	bool VulkanEngine::QueryDescriptorIndexing(VkPhysicalDeviceDescriptorIndexingFeatures& features, std::vector<const char*>& extensions)
+	{
+		//Core since 1.2, older devices may still expose it as an extension
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+		bool core = properties.apiVersion >= VK_API_VERSION_1_2;
+		bool extension = Utils::CheckDeviceExtensionSupport(m_PhysicalDevice, { VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME });
+		if (!core && !extension)
+		{
+			return false;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeatures supported{};
+		supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supported;
+		vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &features2);
+
+		if (!supported.runtimeDescriptorArray || !supported.descriptorBindingPartiallyBound ||
+			!supported.descriptorBindingSampledImageUpdateAfterBind || !supported.descriptorBindingUpdateUnusedWhilePending)
+		{
+			return false;
+		}
+
+		//Only what the bindless texture table needs
+		features.runtimeDescriptorArray = VK_TRUE;
+		features.descriptorBindingPartiallyBound = VK_TRUE;
+		features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+		if (!core)
+		{
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+		return true;
+	}
+
+	bool VulkanEngine::QueryPipelineLibrary(VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT& features, std::vector<const char*>& extensions)
+	{
+		if (!Utils::CheckDeviceExtensionSupport(m_PhysicalDevice, { VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME }))
+		{
+			return false;
+		}
+
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supported{};
+		supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supported;
+		vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &features2);
+
+		//Without fast linking a link costs about as much as a full compile and libraries gain nothing
+		VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties{};
+		libraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &libraryProperties;
+		vkGetPhysicalDeviceProperties2(m_PhysicalDevice, &properties2);
+
+		if (!supported.graphicsPipelineLibrary || !libraryProperties.graphicsPipelineLibraryFastLinking)
+		{
+			return false;
+		}
+
+		features.graphicsPipelineLibrary = VK_TRUE;
+		extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		return true;
+	}
+
+	bool VulkanEngine::QueryIndirectDraw(VkPhysicalDeviceFeatures& features, std::vector<const char*>& extensions)
+	{
+		VkPhysicalDeviceFeatures supported;
+		vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supported);
+
+		//Indirect draws address their instance data through firstInstance, without it they are not used at all
+		m_IndirectFirstInstance = supported.drawIndirectFirstInstance;
+		m_MultiDrawIndirect = supported.multiDrawIndirect && m_IndirectFirstInstance;
+		features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+		features.multiDrawIndirect = m_MultiDrawIndirect;
+
+		//The extension rather than the 1.2 feature, whose struct cannot be chained next to the descriptor indexing one
+		if (!m_MultiDrawIndirect || !Utils::CheckDeviceExtensionSupport(m_PhysicalDevice, { VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME }))
+		{
+			return false;
+		}
+
+		extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		return true;
 	}
 
 	void VulkanEngine::CreateSyncObjects()
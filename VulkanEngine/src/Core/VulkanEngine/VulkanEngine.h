@@ -20,15 +20,35 @@ namespace CHIKU
 		static const inline  VkCommandBuffer GetCommandBuffer() noexcept { return s_Instance->m_Commands.GetCommandBuffer(s_Instance->m_CurrentFrame); }
 		static const inline  void BeginFrame() noexcept { s_Instance->PrivateBeginFrame(); }
 		static const inline  void EndFrame() noexcept { s_Instance->PrivateEndFrame(); }
+		//The frame's command buffer starts outside the render pass so compute work can be recorded first
+		static const inline  void BeginRenderPass() noexcept { s_Instance->PrivateBeginRenderPass(); }
+		//Lets compute work be recorded in the middle of a frame. The next BeginRenderPass continues on the same attachments.
+		static const inline  void EndRenderPass() noexcept { s_Instance->PrivateEndRenderPass(); }
+		static const inline  bool IsInRenderPass() noexcept { return s_Instance->m_InRenderPass; }
 		static const inline  VkRenderPass& GetRenderPass() noexcept { return s_Instance->m_Swapchain.GetRenderPass(); }
+		static const inline  VkExtent2D& GetSwapchainExtent() noexcept { return s_Instance->m_Swapchain.GetExtent(); }
+		static const inline  VkImage& GetDepthImage() noexcept { return s_Instance->m_Swapchain.GetDepthImage(); }
+		static const inline  VkImageView& GetDepthImageView() noexcept { return s_Instance->m_Swapchain.GetDepthImageView(); }
+		static const inline  VkFormat GetDepthFormat() noexcept { return s_Instance->m_Swapchain.GetDepthFormat(); }
 		static const inline  VkPhysicalDevice& GetPhysicalDevice() noexcept { return s_Instance->m_PhysicalDevice; }
 		static const inline  VkDevice& GetDevice() noexcept { return s_Instance->m_LogicalDevice; }
+		//Partially bound, update-after-bind arrays of sampled images were enabled at device creation
+		static const inline  bool IsDescriptorIndexingEnabled() noexcept { return s_Instance->m_DescriptorIndexing; }
+		//VK_EXT_graphics_pipeline_library with fast linking was enabled at device creation
+		static const inline  bool IsPipelineLibraryEnabled() noexcept { return s_Instance->m_PipelineLibrary; }
+		//Indirect draws may use firstInstance, and more than one draw per call with multiDrawIndirect
+		static const inline  bool IsIndirectFirstInstanceEnabled() noexcept { return s_Instance->m_IndirectFirstInstance; }
+		static const inline  bool IsMultiDrawIndirectEnabled() noexcept { return s_Instance->m_MultiDrawIndirect; }
+		//From VK_KHR_draw_indirect_count, nullptr when the device does not have it
+		static const inline  PFN_vkCmdDrawIndexedIndirectCountKHR GetDrawIndexedIndirectCount() noexcept { return s_Instance->m_DrawIndexedIndirectCount; }
 		static const inline  VkCommandBuffer BeginRecordingSingleTimeCommands() noexcept { return s_Instance->BeginSingleTimeCommands(); }
 		static const inline  void EndRecordingSingleTimeCommands(VkCommandBuffer commandBuffer) noexcept { return s_Instance->EndSingleTimeCommands(commandBuffer); }
 
 	private:
 		void PrivateBeginFrame();
 		void PrivateEndFrame();
+		void PrivateBeginRenderPass();
+		void PrivateEndRenderPass();
 
 		void BeginRecordingCommands(const VkCommandBuffer& commandBuffer);
 		void EndRecordingCommands(const VkCommandBuffer& commandBuffer);
@@ -58,6 +78,9 @@ namespace CHIKU
 
 		void SetupDebugMessenger();
 		void CreateLogicalDevice();
+		bool QueryDescriptorIndexing(VkPhysicalDeviceDescriptorIndexingFeatures& features, std::vector<const char*>& extensions);
+		bool QueryPipelineLibrary(VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT& features, std::vector<const char*>& extensions);
+		bool QueryIndirectDraw(VkPhysicalDeviceFeatures& features, std::vector<const char*>& extensions);
 		void CreateSyncObjects();
 
 	private:
@@ -82,6 +105,8 @@ namespace CHIKU
 		Swapchain m_Swapchain;
 		uint32_t m_ImageIndex = 0;
 		uint32_t m_CurrentFrame = 0;
+		bool m_InRenderPass = false;
+		bool m_RenderPassRecorded = false; //A render pass of this frame has ended, the next one loads the attachments
 
 		const std::vector<const char*> m_ValidationLayers = {
 			"VK_LAYER_KHRONOS_validation"
@@ -92,6 +117,12 @@ namespace CHIKU
 		};
 
 		std::vector<const char*> m_Extension;
+		bool m_DescriptorIndexing = false;
+		bool m_PipelineLibrary = false;
+		bool m_IndirectFirstInstance = false;
+		bool m_MultiDrawIndirect = false;
+		bool m_DrawIndirectCount = false;
+		PFN_vkCmdDrawIndexedIndirectCountKHR m_DrawIndexedIndirectCount = nullptr;
 
 		VkPipelineLayout m_PipelineLayout;
 		VkPipeline m_GraphicsPipeline;
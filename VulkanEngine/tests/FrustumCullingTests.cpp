@@ -0,0 +1,142 @@
+#include "Test.h"
+#include "Utils/FrustumCulling.h"
+#include "Utils/JobSystem.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace CHIKU;
+
+static constexpr uint32_t WORKER_COUNT = 2;
+
+//A camera at the origin looking down -Z with a 90 degree field of view, as in FrustumCullBenchmark
+static Utils::FrustumPlanes GetTestPlanes()
+{
+	const float diagonal = 0.70710678f;
+	return {
+		glm::vec4(diagonal, 0.0f, -diagonal, 0.0f),
+		glm::vec4(-diagonal, 0.0f, -diagonal, 0.0f),
+		glm::vec4(0.0f, diagonal, -diagonal, 0.0f),
+		glm::vec4(0.0f, -diagonal, -diagonal, 0.0f),
+		glm::vec4(0.0f, 0.0f, -1.0f, -0.1f),
+		glm::vec4(0.0f, 0.0f, 1.0f, 100.0f)
+	};
+}
+
+//Spheres around the frustum, so a good share of them crosses a plane
+static Utils::BoundingSpheres MakeSpheres(uint32_t count, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> horizontal(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> depth(-110.0f, 10.0f);
+	std::uniform_real_distribution<float> radius(0.0f, 20.0f);
+
+	Utils::BoundingSpheres spheres;
+	spheres.Resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		spheres.Set(i, glm::vec4(horizontal(random), horizontal(random), depth(random), radius(random)));
+	}
+	return spheres;
+}
+
+//The scalar test, one sphere at a time
+static std::vector<uint32_t> CullReference(const Utils::BoundingSpheres& spheres, const Utils::FrustumPlanes& planes, uint32_t begin, uint32_t end)
+{
+	std::vector<uint32_t> visible;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		if (Utils::IsSphereVisible(planes, spheres.Get(i)))
+		{
+			visible.push_back(i);
+		}
+	}
+	return visible;
+}
+
+//The SIMD kernel the CPU picks gives the scalar result, including the padded tail of counts that are not a whole group
+static void TestMatchesScalar(std::mt19937& random)
+{
+	const Utils::FrustumPlanes planes = GetTestPlanes();
+	for (uint32_t count : { 0u, 1u, 7u, 8u, 9u, 1000u, 16385u, 70000u })
+	{
+		Utils::BoundingSpheres spheres = MakeSpheres(count, random);
+		std::vector<uint32_t> expected = CullReference(spheres, planes, 0, count);
+
+		std::vector<uint32_t> visible;
+		Utils::FrustumCull(spheres, planes, visible);
+		CHIKU_CHECK(visible == expected);
+
+		//One range per group boundary, the last one ending at Count
+		const uint32_t group = Utils::BoundingSpheres::GROUP_SIZE;
+		uint32_t begin = count / 2 / group * group;
+		std::vector<uint32_t> range(count - begin + group);
+		range.resize(Utils::FrustumCullRange(spheres, planes, begin, count, range.data()));
+		CHIKU_CHECK(range == CullReference(spheres, planes, begin, count));
+	}
+}
+
+//Like every ParallelFor user, culling on the render thread must not pick up a slow job queued by someone else
+static void TestSkipsUnrelatedJobs(std::mt19937& random)
+{
+	std::atomic<uint32_t> blockersStarted{ 0 };
+	std::atomic<bool> releaseBlockers{ false };
+	std::atomic<bool> unrelatedRan{ false };
+
+	Utils::JobGroup blockers;
+	for (uint32_t i = 0; i < WORKER_COUNT; i++)
+	{
+		Utils::JobSystem::Submit([&]()
+			{
+				blockersStarted.fetch_add(1);
+				while (!releaseBlockers.load())
+				{
+					std::this_thread::yield();
+				}
+			}, &blockers);
+	}
+	while (blockersStarted.load() < WORKER_COUNT)
+	{
+		std::this_thread::yield();
+	}
+
+	Utils::JobGroup unrelated;
+	Utils::JobSystem::Submit([&]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			unrelatedRan.store(true);
+		}, &unrelated);
+
+	//Enough spheres for more than one block
+	const Utils::FrustumPlanes planes = GetTestPlanes();
+	Utils::BoundingSpheres spheres = MakeSpheres(70000, random);
+	std::vector<uint32_t> visible;
+	Utils::FrustumCull(spheres, planes, visible);
+
+	CHIKU_CHECK(!unrelatedRan.load());
+	CHIKU_CHECK(visible == CullReference(spheres, planes, 0, spheres.Count));
+
+	releaseBlockers.store(true);
+	blockers.Wait();
+	while (!unrelated.IsDone())
+	{
+		std::this_thread::yield();
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1234);
+	std::cout << "Culling with " << Utils::GetFrustumCullInstructionSet() << std::endl;
+
+	TestMatchesScalar(random);
+
+	Utils::JobSystem::Init(WORKER_COUNT);
+	TestMatchesScalar(random);
+	TestSkipsUnrelatedJobs(random);
+	Utils::JobSystem::Shutdown();
+
+	return CHIKU_TEST_RESULT();
+}
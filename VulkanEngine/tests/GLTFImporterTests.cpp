@@ -0,0 +1,142 @@
+#include "Test.h"
+#include "Renderer/GLTFImporter.h"
+#include <cmath>
+#include <vector>
+
+using namespace CHIKU;
+
+//A triangle at (0,0,0), (1,0,0), (0,1,0) referenced by three nodes under a root moved to x = 10, plus one node that is
+//not part of the scene. COLOR_0 is an accessor without a buffer view.
+static const char* MULTI_NODE = "tests/fixtures/multi_node.gltf";
+//The same document with an index past the triangle's vertices
+static const char* BAD_INDEX = "tests/fixtures/bad_index.gltf";
+//The same document with the second child listing the root as its own child
+static const char* NODE_CYCLE = "tests/fixtures/node_cycle.gltf";
+//The same document with a node using a mesh that does not exist
+static const char* BAD_MESH = "tests/fixtures/bad_mesh.gltf";
+//The same document with COLOR_0 one element shorter than POSITION, and a second primitive of the triangle without it
+static const char* SHORT_ATTRIBUTE = "tests/fixtures/short_attribute.gltf";
+
+static bool Near(const glm::vec3& a, const glm::vec3& b)
+{
+	return glm::length(a - b) < 1e-5f;
+}
+
+static glm::vec3 ReadField(const std::vector<uint8_t>& vertices, const VertexBufferLayout& layout, uint32_t vertex, const std::string& field)
+{
+	for (const auto& element : layout.VertexElements)
+	{
+		if (element.ElementName == field)
+		{
+			const float* value = reinterpret_cast<const float*>(vertices.data() + size_t(vertex) * layout.Stride + element.Offset);
+			return glm::vec3(value[0], value[1], value[2]);
+		}
+	}
+	return glm::vec3(NAN);
+}
+
+static void TestNodeHierarchy()
+{
+	GLTFImporter importer;
+	CHIKU_CHECK(importer.Load(MULTI_NODE));
+	importer.Build(VertexLayoutPreset::UnLitMesh);
+
+	//One instance per node in the scene, all sharing one model space copy of the triangle. The mirrored node adds a
+	//second set of indices, not vertices.
+	const auto& instances = importer.GetInstances();
+	CHIKU_CHECK(instances.size() == 3);
+	CHIKU_CHECK(importer.GetVertexCount() == 3);
+	CHIKU_CHECK(importer.GetIndexCount() == 6);
+	if (instances.size() != 3 || importer.GetVertexCount() != 3 || importer.GetIndexCount() != 6)
+	{
+		return;
+	}
+
+	const glm::vec3 expected[3][3] = {
+		{ { 10.0f, 0.0f, 0.0f }, { 11.0f, 0.0f, 0.0f }, { 10.0f, 1.0f, 0.0f } }, //Root translation
+		{ { 10.0f, 5.0f, 0.0f }, { 12.0f, 5.0f, 0.0f }, { 10.0f, 7.0f, 0.0f } }, //Then its own translation and scale
+		{ { 10.0f, 0.0f, 0.0f }, { 9.0f, 0.0f, 0.0f }, { 10.0f, 1.0f, 0.0f } }   //Mirrored on x
+	};
+	const glm::vec3 modelled[3] = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		CHIKU_CHECK(instances[i].Mesh == instances[0].Mesh);
+		CHIKU_CHECK(instances[i].IsMirrored() == (i == 2));
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			CHIKU_CHECK(Near(glm::vec3(instances[i].Transform * glm::vec4(modelled[corner], 1.0f)), expected[i][corner]));
+		}
+	}
+
+	std::vector<uint8_t> vertices(size_t(importer.GetVertexCount()) * importer.GetLayout().Stride);
+	std::vector<uint32_t> indices(importer.GetIndexCount());
+	importer.WriteVertices(vertices.data());
+	importer.WriteIndices(indices.data());
+
+	const GLTFMesh& mesh = importer.GetMeshes()[instances[0].Mesh];
+	CHIKU_CHECK(mesh.Ranges.size() == 1 && mesh.MirroredRanges.size() == 1);
+	if (mesh.Ranges.size() != 1 || mesh.MirroredRanges.size() != 1)
+	{
+		return;
+	}
+
+	for (const GLTFPrimitive* range : { &mesh.Ranges[0], &mesh.MirroredRanges[0] })
+	{
+		CHIKU_CHECK(range->IndexCount == 3);
+		CHIKU_CHECK(range->MaterialIndex == -1);
+		CHIKU_CHECK(Near(range->BoundsMin, glm::vec3(0.0f)));
+		CHIKU_CHECK(Near(range->BoundsMax, glm::vec3(1.0f, 1.0f, 0.0f)));
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t index = indices[range->FirstIndex + corner];
+			CHIKU_CHECK(index >= static_cast<uint32_t>(range->VertexOffset) && index < static_cast<uint32_t>(range->VertexOffset) + 3);
+		}
+
+		//The mirrored indices swap two corners to keep the front face
+		uint32_t second = indices[range->FirstIndex + 1] - static_cast<uint32_t>(range->VertexOffset);
+		CHIKU_CHECK(second == (range == &mesh.MirroredRanges[0] ? 2u : 1u));
+	}
+
+	for (uint32_t corner = 0; corner < 3; corner++)
+	{
+		uint32_t vertex = static_cast<uint32_t>(mesh.Ranges[0].VertexOffset) + corner;
+		CHIKU_CHECK(Near(ReadField(vertices, importer.GetLayout(), vertex, VERTEX_FIELD_POSITION), modelled[corner]));
+		CHIKU_CHECK(Near(ReadField(vertices, importer.GetLayout(), vertex, VERTEX_FIELD_COLOR), glm::vec3(0.0f)));
+	}
+}
+
+static void TestIndexOutOfRange()
+{
+	GLTFImporter importer;
+	CHIKU_CHECK(!importer.Load(BAD_INDEX));
+}
+
+//Damaged node graphs fail Load instead of recursing forever or throwing later from Build
+static void TestBadNodes()
+{
+	GLTFImporter cycle;
+	CHIKU_CHECK(!cycle.Load(NODE_CYCLE));
+
+	GLTFImporter mesh;
+	CHIKU_CHECK(!mesh.Load(BAD_MESH));
+}
+
+//The primitive is dropped rather than leaving the vertices past the short attribute unwritten
+static void TestShortAttribute()
+{
+	GLTFImporter importer;
+	CHIKU_CHECK(importer.Load(SHORT_ATTRIBUTE));
+	importer.Build(VertexLayoutPreset::UnLitMesh);
+	CHIKU_CHECK(importer.GetVertexCount() == 3);
+	CHIKU_CHECK(importer.GetIndexCount() == 6);
+}
+
+int main()
+{
+	TestNodeHierarchy();
+	TestIndexOutOfRange();
+	TestBadNodes();
+	TestShortAttribute();
+	return CHIKU_TEST_RESULT();
+}
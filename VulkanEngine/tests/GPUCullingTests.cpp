@@ -0,0 +1,209 @@
+#include "Test.h"
+#include "Renderer/GPUCulling.h"
+#include "Utils/FrustumCulling.h"
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace CHIKU;
+
+//A camera at the origin looking down -Z with a 90 degree field of view, as in FrustumCullingTests
+static Utils::FrustumPlanes GetTestPlanes()
+{
+	const float diagonal = 0.70710678f;
+	return {
+		glm::vec4(diagonal, 0.0f, -diagonal, 0.0f),
+		glm::vec4(-diagonal, 0.0f, -diagonal, 0.0f),
+		glm::vec4(0.0f, diagonal, -diagonal, 0.0f),
+		glm::vec4(0.0f, -diagonal, -diagonal, 0.0f),
+		glm::vec4(0.0f, 0.0f, -1.0f, -0.1f),
+		glm::vec4(0.0f, 0.0f, 1.0f, 100.0f)
+	};
+}
+
+static glm::mat4 MakeTranslation(const glm::vec3& position)
+{
+	glm::mat4 transform(1.0f);
+	transform[3] = glm::vec4(position, 1.0f);
+	return transform;
+}
+
+//Only the addresses of the materials and buffers matter to Build, nothing is created on a device
+struct TestScene
+{
+	Material Materials[3];
+	VertexBuffer Vertices[2];
+	IndexBuffer Indices[2];
+};
+
+static GPUCulling::CullSource MakeSource(const TestScene& scene, uint32_t material, uint32_t buffers, uint32_t id, const glm::vec4& bounds,
+	const glm::mat4& transform)
+{
+	Submesh submesh;
+	submesh.FirstIndex = id * 3;
+	submesh.IndexCount = 3;
+	submesh.VertexOffset = static_cast<int32_t>(id);
+	submesh.Bounds = bounds;
+	return { &scene.Materials[material], &scene.Vertices[buffers], &scene.Indices[buffers], submesh, transform };
+}
+
+//Every material and buffer pair ends up in one contiguous bucket, and every object points at its own instance, its
+//bucket and that bucket's first command
+static void TestBuildBuckets(std::mt19937& random)
+{
+	TestScene scene;
+	for (uint32_t m = 0; m < 3; m++)
+	{
+		scene.Materials[m].SetBaseColor(glm::vec4(0.25f * static_cast<float>(m), 0.5f, 1.0f, 1.0f));
+	}
+	std::uniform_int_distribution<uint32_t> materials(0, 2);
+	std::uniform_int_distribution<uint32_t> buffers(0, 1);
+
+	const uint32_t count = 500;
+	std::vector<GPUCulling::CullSource> sources;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		sources.push_back(MakeSource(scene, materials(random), buffers(random), i, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+			MakeTranslation(glm::vec3(static_cast<float>(i), 0.0f, 0.0f))));
+	}
+
+	std::vector<GPUCulling::CullObject> objects;
+	std::vector<InstanceData> instances;
+	std::vector<GPUCulling::Bucket> buckets;
+	GPUCulling::BuildObjects(sources, objects, instances, buckets);
+
+	CHIKU_CHECK(objects.size() == count);
+	CHIKU_CHECK(instances.size() == count);
+	CHIKU_CHECK(buckets.size() <= 6);
+
+	std::set<std::pair<const Material*, const VertexBuffer*>> seen;
+	uint32_t covered = 0;
+	for (uint32_t b = 0; b < buckets.size(); b++)
+	{
+		const GPUCulling::Bucket& bucket = buckets[b];
+		CHIKU_CHECK(bucket.FirstCommand == covered);
+		CHIKU_CHECK(bucket.ObjectCount > 0);
+		CHIKU_CHECK(seen.insert({ bucket.DrawMaterial, bucket.Vertices }).second);
+
+		for (uint32_t i = bucket.FirstCommand; i < bucket.FirstCommand + bucket.ObjectCount; i++)
+		{
+			const GPUCulling::CullObject& object = objects[i];
+			const GPUCulling::CullSource& source = sources[i];
+			CHIKU_CHECK(source.DrawMaterial == bucket.DrawMaterial);
+			CHIKU_CHECK(source.Vertices == bucket.Vertices && source.Indices == bucket.Indices);
+			CHIKU_CHECK(object.Bucket == b);
+			CHIKU_CHECK(object.BucketFirstCommand == bucket.FirstCommand);
+			CHIKU_CHECK(object.Instance == i);
+			CHIKU_CHECK(object.FirstIndex == source.Range.FirstIndex && object.IndexCount == source.Range.IndexCount);
+			CHIKU_CHECK(object.VertexOffset == source.Range.VertexOffset);
+			CHIKU_CHECK(instances[i].Transform == source.Transform);
+			CHIKU_CHECK(instances[i].Color == source.DrawMaterial->GetBaseColor());
+			CHIKU_CHECK(instances[i].MaterialIndex == source.DrawMaterial->GetTextureIndex());
+		}
+		covered += bucket.ObjectCount;
+	}
+	CHIKU_CHECK(covered == count);
+
+	//Sorting is stable, so the submission order survives within a bucket
+	for (uint32_t i = 1; i < count; i++)
+	{
+		if (objects[i].Bucket == objects[i - 1].Bucket)
+		{
+			CHIKU_CHECK(objects[i - 1].VertexOffset < objects[i].VertexOffset);
+		}
+	}
+}
+
+//Spheres clearly inside and outside count the same either way, one touching a plane may go either way
+static void TestReferenceKnownSpheres()
+{
+	TestScene scene;
+	const glm::vec4 bounds(0.0f, 0.0f, 0.0f, 1.0f);
+	std::vector<GPUCulling::CullSource> sources = {
+		MakeSource(scene, 0, 0, 0, bounds, MakeTranslation(glm::vec3(0.0f, 0.0f, -10.0f))),
+		MakeSource(scene, 0, 0, 1, bounds, MakeTranslation(glm::vec3(0.0f, 0.0f, 10.0f))),
+		//Tangent to the near plane from behind
+		MakeSource(scene, 0, 0, 2, bounds, MakeTranslation(glm::vec3(0.0f, 0.0f, 0.9f))),
+		MakeSource(scene, 1, 0, 3, bounds, MakeTranslation(glm::vec3(0.0f, 0.0f, -50.0f))),
+		//Model space bounds off center, moved into view by the transform
+		MakeSource(scene, 1, 0, 4, glm::vec4(0.0f, 0.0f, 200.0f, 1.0f), MakeTranslation(glm::vec3(0.0f, 0.0f, -210.0f))),
+		MakeSource(scene, 1, 0, 5, bounds, MakeTranslation(glm::vec3(500.0f, 0.0f, -10.0f))),
+	};
+
+	std::vector<GPUCulling::CullObject> objects;
+	std::vector<InstanceData> instances;
+	std::vector<GPUCulling::Bucket> buckets;
+	GPUCulling::BuildObjects(sources, objects, instances, buckets);
+	CHIKU_CHECK(buckets.size() == 2);
+
+	std::vector<uint32_t> minimum;
+	std::vector<uint32_t> maximum;
+	GPUCulling::CullReference(objects, instances, static_cast<uint32_t>(buckets.size()), GetTestPlanes(), minimum, maximum);
+
+	uint32_t first = buckets[0].DrawMaterial == &scene.Materials[0] ? 0 : 1;
+	CHIKU_CHECK(minimum[first] == 1 && maximum[first] == 2);
+	CHIKU_CHECK(minimum[1 - first] == 2 && maximum[1 - first] == 2);
+}
+
+//The per bucket counts bracket what the CPU culler sees for the same spheres
+static void TestReferenceMatchesFrustumCull(std::mt19937& random)
+{
+	TestScene scene;
+	std::uniform_int_distribution<uint32_t> materials(0, 2);
+	std::uniform_int_distribution<uint32_t> buffers(0, 1);
+	std::uniform_real_distribution<float> horizontal(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> depth(-110.0f, 10.0f);
+	std::uniform_real_distribution<float> radius(0.0f, 20.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	const uint32_t count = 2000;
+	std::vector<GPUCulling::CullSource> sources;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		glm::vec4 bounds(horizontal(random) * 0.1f, horizontal(random) * 0.1f, depth(random) * 0.1f, radius(random));
+		glm::mat4 transform = MakeTranslation(glm::vec3(horizontal(random), horizontal(random), depth(random)));
+		float size = scale(random);
+		transform[0][0] = size;
+		transform[1][1] = size;
+		transform[2][2] = size;
+		sources.push_back(MakeSource(scene, materials(random), buffers(random), i, bounds, transform));
+	}
+
+	std::vector<GPUCulling::CullObject> objects;
+	std::vector<InstanceData> instances;
+	std::vector<GPUCulling::Bucket> buckets;
+	GPUCulling::BuildObjects(sources, objects, instances, buckets);
+
+	const Utils::FrustumPlanes planes = GetTestPlanes();
+	std::vector<uint32_t> minimum;
+	std::vector<uint32_t> maximum;
+	GPUCulling::CullReference(objects, instances, static_cast<uint32_t>(buckets.size()), planes, minimum, maximum);
+
+	std::vector<uint32_t> visible(buckets.size(), 0);
+	for (const GPUCulling::CullObject& object : objects)
+	{
+		glm::vec4 sphere = Utils::TransformSphere(instances[object.Instance].Transform, object.Bounds);
+		visible[object.Bucket] += Utils::IsSphereVisible(planes, sphere) ? 1 : 0;
+	}
+
+	uint32_t total = 0;
+	for (uint32_t b = 0; b < buckets.size(); b++)
+	{
+		CHIKU_CHECK(minimum[b] <= visible[b] && visible[b] <= maximum[b]);
+		CHIKU_CHECK(maximum[b] <= buckets[b].ObjectCount);
+		total += visible[b];
+	}
+	//Some of each, or the test says little
+	CHIKU_CHECK(total > 0 && total < count);
+}
+
+int main()
+{
+	std::mt19937 random(1234);
+
+	TestBuildBuckets(random);
+	TestReferenceKnownSpheres();
+	TestReferenceMatchesFrustumCull(random);
+
+	return CHIKU_TEST_RESULT();
+}
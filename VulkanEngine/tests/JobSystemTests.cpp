@@ -0,0 +1,98 @@
+#include "Test.h"
+#include "Utils/JobSystem.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace CHIKU;
+
+static constexpr uint32_t WORKER_COUNT = 2;
+
+//Every index is visited exactly once, with and without workers
+static void TestParallelForCoverage()
+{
+	for (uint32_t count : { 0u, 1u, 7u, 1000u, 4097u })
+	{
+		std::vector<std::atomic<uint32_t>> visits(count);
+		Utils::JobSystem::ParallelFor(count, 64, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					visits[i].fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+
+		bool once = true;
+		for (const auto& visit : visits)
+		{
+			once &= visit.load() == 1;
+		}
+		CHIKU_CHECK(once);
+	}
+}
+
+//A slow job from elsewhere, a pipeline compile for example, queued ahead of a ParallelFor must not run inline on the
+//thread that waits for the ParallelFor
+static void TestParallelForSkipsUnrelatedJobs()
+{
+	std::atomic<uint32_t> blockersStarted{ 0 };
+	std::atomic<bool> releaseBlockers{ false };
+	std::atomic<bool> unrelatedRan{ false };
+	std::thread::id unrelatedThread;
+
+	//Keep every worker busy so the unrelated job stays queued while the ParallelFor waits
+	Utils::JobGroup blockers;
+	for (uint32_t i = 0; i < WORKER_COUNT; i++)
+	{
+		Utils::JobSystem::Submit([&]()
+			{
+				blockersStarted.fetch_add(1);
+				while (!releaseBlockers.load())
+				{
+					std::this_thread::yield();
+				}
+			}, &blockers);
+	}
+	while (blockersStarted.load() < WORKER_COUNT)
+	{
+		std::this_thread::yield();
+	}
+
+	Utils::JobGroup unrelated;
+	Utils::JobSystem::Submit([&]()
+		{
+			unrelatedThread = std::this_thread::get_id();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			unrelatedRan.store(true);
+		}, &unrelated);
+
+	std::atomic<uint32_t> visited{ 0 };
+	Utils::JobSystem::ParallelFor(1000, 10, [&](uint32_t begin, uint32_t end) { visited.fetch_add(end - begin); });
+
+	CHIKU_CHECK(visited.load() == 1000);
+	CHIKU_CHECK(!unrelatedRan.load());
+
+	//Polled rather than waited on, Wait would run it here
+	releaseBlockers.store(true);
+	blockers.Wait();
+	while (!unrelated.IsDone())
+	{
+		std::this_thread::yield();
+	}
+	CHIKU_CHECK(unrelatedRan.load());
+	CHIKU_CHECK(unrelatedThread != std::this_thread::get_id());
+}
+
+int main()
+{
+	//Without Init everything runs inline
+	TestParallelForCoverage();
+
+	Utils::JobSystem::Init(WORKER_COUNT);
+	TestParallelForCoverage();
+	TestParallelForSkipsUnrelatedJobs();
+	Utils::JobSystem::Shutdown();
+
+	return CHIKU_TEST_RESULT();
+}
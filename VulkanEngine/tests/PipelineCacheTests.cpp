@@ -0,0 +1,113 @@
+#include "Test.h"
+#include "Renderer/PipelineCache.h"
+#include <cstring>
+#include <vector>
+
+using namespace CHIKU;
+
+static VkPhysicalDeviceProperties MakeProperties()
+{
+	VkPhysicalDeviceProperties properties{};
+	properties.vendorID = 0x10DE;
+	properties.deviceID = 0x2684;
+	properties.driverVersion = 0x0220C000;
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+	{
+		properties.pipelineCacheUUID[i] = static_cast<uint8_t>(i * 7 + 1);
+	}
+	return properties;
+}
+
+//What vkGetPipelineCacheData returns: the driver's header, then its own bytes
+static std::vector<char> MakeDriverData(const VkPhysicalDeviceProperties& properties)
+{
+	VkPipelineCacheHeaderVersionOne header{};
+	header.headerSize = sizeof(header);
+	header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	std::vector<char> data(sizeof(header) + 100);
+	memcpy(data.data(), &header, sizeof(header));
+	for (size_t i = sizeof(header); i < data.size(); i++)
+	{
+		data[i] = static_cast<char>(i);
+	}
+	return data;
+}
+
+static bool Accepts(const VkPhysicalDeviceProperties& properties, const std::vector<char>& file)
+{
+	std::vector<char> data;
+	return PipelineCache::Deserialize(properties, file, data);
+}
+
+static void TestRoundTrip()
+{
+	const VkPhysicalDeviceProperties properties = MakeProperties();
+	const std::vector<char> data = MakeDriverData(properties);
+
+	std::vector<char> loaded;
+	CHIKU_CHECK(PipelineCache::Deserialize(properties, PipelineCache::Serialize(properties, data), loaded));
+	CHIKU_CHECK(loaded == data);
+}
+
+//Any other vendor, device, driver or cache UUID starts cold
+static void TestRejectsOtherDevices()
+{
+	const VkPhysicalDeviceProperties properties = MakeProperties();
+	const std::vector<char> file = PipelineCache::Serialize(properties, MakeDriverData(properties));
+
+	VkPhysicalDeviceProperties other = properties;
+	other.vendorID++;
+	CHIKU_CHECK(!Accepts(other, file));
+
+	other = properties;
+	other.deviceID++;
+	CHIKU_CHECK(!Accepts(other, file));
+
+	other = properties;
+	other.driverVersion++;
+	CHIKU_CHECK(!Accepts(other, file));
+
+	other = properties;
+	other.pipelineCacheUUID[VK_UUID_SIZE - 1]++;
+	CHIKU_CHECK(!Accepts(other, file));
+}
+
+static void TestRejectsDamagedFiles()
+{
+	const VkPhysicalDeviceProperties properties = MakeProperties();
+	const std::vector<char> data = MakeDriverData(properties);
+	const std::vector<char> file = PipelineCache::Serialize(properties, data);
+
+	CHIKU_CHECK(!Accepts(properties, {}));
+
+	std::vector<char> truncated(file.begin(), file.end() - 1);
+	CHIKU_CHECK(!Accepts(properties, truncated));
+
+	std::vector<char> corrupt = file;
+	corrupt.back() ^= 1;
+	CHIKU_CHECK(!Accepts(properties, corrupt));
+
+	std::vector<char> magic = file;
+	magic[0] = 'X';
+	CHIKU_CHECK(!Accepts(properties, magic));
+
+	//Our header matches but the driver's names another device
+	VkPhysicalDeviceProperties other = properties;
+	other.deviceID++;
+	CHIKU_CHECK(!Accepts(properties, PipelineCache::Serialize(properties, MakeDriverData(other))));
+
+	//Too short to hold the driver's header
+	CHIKU_CHECK(!Accepts(properties, PipelineCache::Serialize(properties, std::vector<char>(8, 0))));
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestRejectsOtherDevices();
+	TestRejectsDamagedFiles();
+	return CHIKU_TEST_RESULT();
+}
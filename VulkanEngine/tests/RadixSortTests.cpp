@@ -0,0 +1,50 @@
+#include "Test.h"
+#include "Utils/RadixSort.h"
+#include "Utils/JobSystem.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace CHIKU;
+
+//Same order as std::stable_sort, equal keys included, for sizes on both sides of the parallel block size
+static void TestMatchesStableSort(std::mt19937_64& random)
+{
+	for (uint32_t count : { 0u, 1u, 2u, 100u, 16383u, 100000u, 300000u })
+	{
+		//Full 64 bit keys, keys with few distinct values so stability matters, and keys that leave bytes unused so
+		//passes are skipped, like the render queue's
+		for (uint64_t mask : { ~0ull, 0xFull, 0xFF00FF0000000000ull })
+		{
+			std::vector<Utils::SortItem> items(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				items[i] = { random() & mask, i };
+			}
+
+			std::vector<Utils::SortItem> expected = items;
+			std::stable_sort(expected.begin(), expected.end(), [](const Utils::SortItem& a, const Utils::SortItem& b) { return a.Key < b.Key; });
+
+			std::vector<Utils::SortItem> scratch;
+			Utils::RadixSort(items, scratch);
+
+			CHIKU_CHECK(items.size() == expected.size());
+			CHIKU_CHECK(std::equal(items.begin(), items.end(), expected.begin(), expected.end(),
+				[](const Utils::SortItem& a, const Utils::SortItem& b) { return a.Key == b.Key && a.Index == b.Index; }));
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937_64 random(1234);
+
+	//Inline, then split over workers
+	TestMatchesStableSort(random);
+
+	Utils::JobSystem::Init(3);
+	TestMatchesStableSort(random);
+	Utils::JobSystem::Shutdown();
+
+	return CHIKU_TEST_RESULT();
+}
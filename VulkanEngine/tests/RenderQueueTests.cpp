@@ -0,0 +1,101 @@
+#include "Test.h"
+#include "Renderer/RenderQueue.h"
+#include <random>
+#include <set>
+#include <tuple>
+
+using namespace CHIKU;
+
+//The packet fields stand in for what the sort key was built from: PipelineIndex, then material in FirstIndex, mesh in
+//IndexCount and depth in VertexOffset
+static DrawPacket MakePacket(uint32_t pipeline, uint32_t material, uint32_t mesh, int32_t depth)
+{
+	DrawPacket packet{};
+	packet.PipelineIndex = pipeline;
+	packet.InstancedPipelineIndex = RenderQueue::NO_INSTANCING;
+	packet.FirstIndex = material;
+	packet.IndexCount = mesh;
+	packet.VertexOffset = depth;
+	return packet;
+}
+
+//Instanced and indirect draws are only merged from adjacent packets, so the order after Sort has to put every opaque
+//packet of one pipeline, material and mesh in a single run, front to back, with the transparent ones after all of
+//them, back to front
+static void TestSortGroupsDraws()
+{
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> pipelines(0, 2);
+	std::uniform_int_distribution<uint32_t> materials(0, 3);
+	std::uniform_int_distribution<uint32_t> meshes(0, 4);
+	//Whole numbers up to 200 keep their own 16 bit depth bucket
+	std::uniform_int_distribution<int32_t> depths(1, 200);
+
+	RenderQueue queue;
+	const uint32_t opaqueCount = 600;
+	const uint32_t transparentCount = 100;
+	for (uint32_t i = 0; i < opaqueCount + transparentCount; i++)
+	{
+		RenderQueue::Pass pass = i % 7 == 0 && i / 7 < transparentCount ? RenderQueue::Pass::Transparent : RenderQueue::Pass::Opaque;
+		DrawPacket packet = MakePacket(pipelines(random), materials(random), meshes(random), depths(random));
+		queue.Submit(RenderQueue::MakeSortKey(pass, packet.PipelineIndex, packet.FirstIndex, packet.IndexCount, static_cast<float>(packet.VertexOffset)),
+			packet);
+	}
+	queue.Sort();
+	CHIKU_CHECK(queue.GetPacketCount() == opaqueCount + transparentCount);
+
+	std::set<std::tuple<uint32_t, uint32_t, uint32_t>> finishedRuns;
+	uint32_t position = 0;
+	for (; position < opaqueCount; position++)
+	{
+		const DrawPacket& packet = queue.GetSortedPacket(position);
+		auto draw = std::make_tuple(packet.PipelineIndex, packet.FirstIndex, packet.IndexCount);
+		CHIKU_CHECK(finishedRuns.count(draw) == 0);
+
+		bool runContinues = position + 1 < opaqueCount;
+		if (runContinues)
+		{
+			const DrawPacket& next = queue.GetSortedPacket(position + 1);
+			runContinues = std::make_tuple(next.PipelineIndex, next.FirstIndex, next.IndexCount) == draw;
+			if (runContinues)
+			{
+				CHIKU_CHECK(packet.VertexOffset <= next.VertexOffset);
+			}
+		}
+		if (!runContinues)
+		{
+			finishedRuns.insert(draw);
+		}
+	}
+
+	for (; position + 1 < opaqueCount + transparentCount; position++)
+	{
+		CHIKU_CHECK(queue.GetSortedPacket(position).VertexOffset >= queue.GetSortedPacket(position + 1).VertexOffset);
+	}
+}
+
+//Equal keys keep their submission order, which the instanced draws rely on to stay deterministic between frames
+static void TestSortIsStable()
+{
+	RenderQueue queue;
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		DrawPacket packet = MakePacket(i % 2, 0, 0, static_cast<int32_t>(i));
+		queue.Submit(RenderQueue::MakeSortKey(RenderQueue::Pass::Opaque, packet.PipelineIndex, 0, 0, 1.0f), packet);
+	}
+	queue.Sort();
+
+	for (uint32_t i = 1; i < 1000; i++)
+	{
+		const DrawPacket& previous = queue.GetSortedPacket(i - 1);
+		const DrawPacket& packet = queue.GetSortedPacket(i);
+		CHIKU_CHECK(previous.PipelineIndex < packet.PipelineIndex || previous.VertexOffset < packet.VertexOffset);
+	}
+}
+
+int main()
+{
+	TestSortGroupsDraws();
+	TestSortIsStable();
+	return CHIKU_TEST_RESULT();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+
+//Checks for the test executables. A failed check is printed and the test keeps going, ctest reads the exit code of
+//CHIKU_TEST_RESULT.
+namespace CHIKU
+{
+	namespace Test
+	{
+		inline int& GetFailures()
+		{
+			static int failures = 0;
+			return failures;
+		}
+	}
+}
+
+#define CHIKU_CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+			CHIKU::Test::GetFailures()++; \
+		} \
+	} while (false)
+
+#define CHIKU_TEST_RESULT() (CHIKU::Test::GetFailures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
@@ -0,0 +1,163 @@
+#include "ShaderVariants.h"
+#include "Utils/AssetArchive.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static bool IsShaderSource(const std::filesystem::path& file)
+{
+	const std::string extension = file.extension().string();
+	return extension == ".vert" || extension == ".frag" || extension == ".geom" || extension == ".comp";
+}
+
+//VULKAN_SDK first, like the engine's shader cache, then PATH
+static std::string FindCompiler()
+{
+	if (const char* sdk = std::getenv("VULKAN_SDK"))
+	{
+		for (const char* directory : { "bin", "Bin" })
+		{
+			for (const char* name : { "glslc", "glslc.exe" })
+			{
+				std::filesystem::path candidate = std::filesystem::path(sdk) / directory / name;
+				if (std::filesystem::exists(candidate))
+				{
+					return candidate.string();
+				}
+			}
+		}
+	}
+
+	return "glslc";
+}
+
+//Rewrites the prebuilt SPIR-V beside every shader source under the path, one file per variant named by
+//GetPrebuiltShaderPath. Offline builds and archives without sources load these.
+static bool RefreshSPIRV(const std::filesystem::path& path, const std::filesystem::path& root, const std::string& compiler,
+	const std::vector<ShaderVariant>& variants, size_t& shaderCount)
+{
+	auto compile = [&](const std::filesystem::path& source) -> bool
+		{
+			const std::string stage = std::filesystem::relative(source, root).generic_string();
+			for (const auto& defines : GetStageDefines(variants, stage))
+			{
+				if (!CompileShaderVariant(compiler, source, defines, root / CHIKU::GetPrebuiltShaderPath(stage, defines)))
+				{
+					return false;
+				}
+				shaderCount++;
+			}
+			return true;
+		};
+
+	if (!std::filesystem::is_directory(path))
+	{
+		return !IsShaderSource(path) || compile(path);
+	}
+
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+	{
+		if (entry.is_regular_file() && IsShaderSource(entry.path()) && !compile(entry.path()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//Usage: AssetPacker [--refresh-spirv] <output.chpk> <root> <file or directory relative to root>...
+//Entries are stored under their path relative to root, which is how the engine looks them up.
+//--refresh-spirv first recompiles the prebuilt SPIR-V of every variant of every shader being packed, the engine never writes it.
+int main(int argc, char** argv)
+{
+	int first = 1;
+	bool refreshSPIRV = false;
+	if (argc > 1 && std::string(argv[1]) == "--refresh-spirv")
+	{
+		refreshSPIRV = true;
+		first++;
+	}
+
+	if (argc - first < 3)
+	{
+		std::cerr << "Usage: AssetPacker [--refresh-spirv] <output.chpk> <root> <file or directory>..." << std::endl;
+		return 1;
+	}
+
+	const std::filesystem::path root = argv[first + 1];
+	CHIKU::Utils::AssetArchiveWriter writer;
+	size_t fileCount = 0;
+
+	if (refreshSPIRV)
+	{
+		//The define sets come from the shader list under root, the same file the engine reads
+		std::vector<ShaderVariant> variants;
+		if (!LoadShaderVariants(root / "shader/shaderlist.json", variants))
+		{
+			return 1;
+		}
+
+		const std::string compiler = FindCompiler();
+		size_t shaderCount = 0;
+		for (int i = first + 2; i < argc; i++)
+		{
+			if (!RefreshSPIRV(root / argv[i], root, compiler, variants, shaderCount))
+			{
+				return 1;
+			}
+		}
+
+		std::cout << "Refreshed the SPIR-V of " << shaderCount << " shader variants" << std::endl;
+	}
+
+	auto addFile = [&](const std::filesystem::path& file) -> bool
+		{
+			std::ifstream input(file, std::ios::ate | std::ios::binary);
+			if (!input)
+			{
+				std::cerr << "Failed to read: " << file << std::endl;
+				return false;
+			}
+
+			std::vector<uint8_t> data(static_cast<size_t>(input.tellg()));
+			input.seekg(0);
+			input.read(reinterpret_cast<char*>(data.data()), data.size());
+
+			std::string archivePath = std::filesystem::relative(file, root).generic_string();
+			writer.AddFile(archivePath, data);
+			fileCount++;
+			return true;
+		};
+
+	for (int i = first + 2; i < argc; i++)
+	{
+		std::filesystem::path path = root / argv[i];
+
+		if (std::filesystem::is_directory(path))
+		{
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+			{
+				if (entry.is_regular_file() && !addFile(entry.path()))
+				{
+					return 1;
+				}
+			}
+		}
+		else if (!addFile(path))
+		{
+			return 1;
+		}
+	}
+
+	if (!writer.Write(argv[first]))
+	{
+		return 1;
+	}
+
+	std::cout << "Packed " << fileCount << " files into " << argv[first] << std::endl;
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include "Utils/SceneFormat.h"
+#include <json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+//Usage: SceneCompiler <root> <scene.json> <output.chsc>
+//Mesh paths inside the scene are relative to root, the same way the engine resolves them.
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: SceneCompiler <root> <scene.json> <output.chsc>" << std::endl;
+		return 1;
+	}
+
+	const std::filesystem::path root = argv[1];
+
+	auto readFile = [&root](const std::string& path, std::vector<char>& data) -> bool
+		{
+			std::ifstream input(root / path, std::ios::ate | std::ios::binary);
+			if (!input)
+			{
+				return false;
+			}
+
+			data.resize(static_cast<size_t>(input.tellg()));
+			input.seekg(0);
+			input.read(data.data(), data.size());
+			return static_cast<bool>(input);
+		};
+
+	std::vector<char> source;
+	if (!readFile(argv[2], source))
+	{
+		std::cerr << "Failed to read: " << argv[2] << std::endl;
+		return 1;
+	}
+
+	nlohmann::json document = nlohmann::json::parse(source.begin(), source.end(), nullptr, false);
+	if (document.is_discarded())
+	{
+		std::cerr << "Invalid JSON: " << argv[2] << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> compiled;
+	std::string error;
+	if (!CHIKU::Utils::CompileScene(document, readFile, compiled, error))
+	{
+		std::cerr << error << std::endl;
+		return 1;
+	}
+
+	//Written beside the target and renamed so a running engine never maps a half written scene
+	std::string temporaryPath = std::string(argv[3]) + ".tmp";
+	{
+		std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+		output.write(reinterpret_cast<const char*>(compiled.data()), compiled.size());
+		if (!output)
+		{
+			std::cerr << "Failed to write: " << temporaryPath << std::endl;
+			return 1;
+		}
+	}
+
+	std::error_code errorCode;
+	std::filesystem::rename(temporaryPath, argv[3], errorCode);
+	if (errorCode)
+	{
+		std::cerr << "Failed to write: " << argv[3] << std::endl;
+		return 1;
+	}
+
+	std::cout << "Compiled " << document.value("entities", nlohmann::json::array()).size() << " entities into " << argv[3] << std::endl;
+	return 0;
+}
@@ -0,0 +1,87 @@
+#include "ShaderVariants.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+//Usage: ShaderEmbedder <output.cpp> <glslc> <source root> <shader>...
+//Compiles every variant shaderlist.json asks of each shader into "embedded/" beside the output and writes the table
+//behind FindEmbeddedShader, keyed by GetPrebuiltShaderPath.
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: ShaderEmbedder <output.cpp> <glslc> <source root> <shader>..." << std::endl;
+		return 1;
+	}
+
+	const std::string compiler = argv[2];
+	const std::filesystem::path root = argv[3];
+	const std::filesystem::path spirvRoot = std::filesystem::path(argv[1]).parent_path() / "embedded";
+
+	std::vector<ShaderVariant> variants;
+	if (!LoadShaderVariants(root / "shader/shaderlist.json", variants))
+	{
+		return 1;
+	}
+
+	std::ostringstream arrays;
+	std::ostringstream table;
+	size_t index = 0;
+
+	for (int i = 4; i < argc; i++)
+	{
+		std::string shader = std::filesystem::path(argv[i]).generic_string();
+		for (const auto& defines : GetStageDefines(variants, shader))
+		{
+			const std::string prebuiltPath = CHIKU::GetPrebuiltShaderPath(shader, defines);
+			const std::filesystem::path spirvPath = spirvRoot / prebuiltPath;
+			if (!CompileShaderVariant(compiler, root / shader, defines, spirvPath))
+			{
+				return 1;
+			}
+
+			std::ifstream input(spirvPath, std::ios::ate | std::ios::binary);
+			if (!input)
+			{
+				std::cerr << "Failed to read: " << spirvPath << std::endl;
+				return 1;
+			}
+
+			std::vector<unsigned char> data(static_cast<size_t>(input.tellg()));
+			input.seekg(0);
+			input.read(reinterpret_cast<char*>(data.data()), data.size());
+
+			//SPIR-V is consumed as uint32_t words, keep the bytes word aligned
+			arrays << "\talignas(4) static const unsigned char SHADER_" << index << "[] = {";
+			for (size_t b = 0; b < data.size(); b++)
+			{
+				arrays << (b % 16 == 0 ? "\n\t\t" : " ") << static_cast<unsigned int>(data[b]) << ",";
+			}
+			arrays << "\n\t};\n\n";
+
+			table << "\t\t{ \"" << prebuiltPath << "\", SHADER_" << index << ", sizeof(SHADER_" << index << ") },\n";
+			index++;
+		}
+	}
+
+	std::ofstream output(argv[1], std::ios::trunc);
+	output << "//Generated by ShaderEmbedder, do not edit\n";
+	output << "#include \"Renderer/EmbeddedShaders.h\"\n\n";
+	output << "namespace CHIKU\n{\n";
+	output << arrays.str();
+	output << "\tstatic const EmbeddedShader EMBEDDED_SHADERS[] = {\n" << table.str() << "\t\t{ nullptr, nullptr, 0 }\n\t};\n\n";
+	output << "\tconst EmbeddedShader* FindEmbeddedShader(const std::string& prebuiltPath)\n\t{\n";
+	output << "\t\tfor (const EmbeddedShader* shader = EMBEDDED_SHADERS; shader->Path; shader++)\n\t\t{\n";
+	output << "\t\t\tif (prebuiltPath == shader->Path)\n\t\t\t{\n\t\t\t\treturn shader;\n\t\t\t}\n\t\t}\n\n";
+	output << "\t\treturn nullptr;\n\t}\n}\n";
+
+	if (!output)
+	{
+		std::cerr << "Failed to write: " << argv[1] << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
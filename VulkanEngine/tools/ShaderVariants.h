@@ -0,0 +1,143 @@
+#pragma once
+#include "Renderer/EmbeddedShaders.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <json.hpp>
+#include <string>
+#include <vector>
+
+//Prebuilt SPIR-V is needed for every define set the engine compiles a stage with. Shared by AssetPacker and
+//ShaderEmbedder, which cannot link the engine's ShaderManager.
+struct ShaderVariant
+{
+	std::string Stage; //Relative to the source root, e.g. "shader/unlit.vert"
+	std::vector<std::string> Defines;
+};
+
+//Walks shaderlist.json like ShaderManager::LoadRegistry: one variant per stage and subset of the program's "define"
+//features, each define written NAME=1 in the order the features are iterated, as ShaderManager::GetDefines does
+inline void CollectShaderVariants(const nlohmann::json& node, std::vector<ShaderVariant>& variants)
+{
+	const nlohmann::json* stages = node.is_array() ? &node : nullptr;
+	if (node.is_object() && node.contains("stages") && node["stages"].is_array())
+	{
+		stages = &node["stages"];
+	}
+
+	if (!stages)
+	{
+		if (node.is_object())
+		{
+			for (auto it = node.begin(); it != node.end(); ++it)
+			{
+				CollectShaderVariants(it.value(), variants);
+			}
+		}
+		return;
+	}
+
+	std::vector<std::string> features;
+	if (node.is_object() && node.contains("features") && node["features"].is_object())
+	{
+		for (const auto& feature : node["features"])
+		{
+			if (feature.is_object() && feature.contains("define") && feature["define"].is_string())
+			{
+				features.push_back(feature["define"].get<std::string>() + "=1");
+			}
+		}
+	}
+
+	for (uint32_t subset = 0; subset < (1u << features.size()); subset++)
+	{
+		std::vector<std::string> defines;
+		for (size_t i = 0; i < features.size(); i++)
+		{
+			if (subset & (1u << i))
+			{
+				defines.push_back(features[i]);
+			}
+		}
+
+		for (const auto& stage : *stages)
+		{
+			if (!stage.is_string())
+			{
+				continue;
+			}
+
+			ShaderVariant variant{ stage.get<std::string>(), defines };
+			bool known = std::any_of(variants.begin(), variants.end(), [&](const ShaderVariant& other)
+				{
+					return other.Stage == variant.Stage && other.Defines == variant.Defines;
+				});
+			if (!known)
+			{
+				variants.push_back(std::move(variant));
+			}
+		}
+	}
+}
+
+inline bool LoadShaderVariants(const std::filesystem::path& shaderList, std::vector<ShaderVariant>& variants)
+{
+	std::ifstream input(shaderList);
+	nlohmann::json json = nlohmann::json::parse(input, nullptr, false);
+	if (!input || json.is_discarded())
+	{
+		std::cerr << "Failed to read: " << shaderList << std::endl;
+		return false;
+	}
+
+	CollectShaderVariants(json, variants);
+	return true;
+}
+
+//The define sets a stage is built with; a stage no program lists only gets the variant without defines
+inline std::vector<std::vector<std::string>> GetStageDefines(const std::vector<ShaderVariant>& variants, const std::string& stage)
+{
+	std::vector<std::vector<std::string>> defines;
+	for (const auto& variant : variants)
+	{
+		if (variant.Stage == stage)
+		{
+			defines.push_back(variant.Defines);
+		}
+	}
+
+	if (defines.empty())
+	{
+		defines.emplace_back();
+	}
+	return defines;
+}
+
+inline bool CompileShaderVariant(const std::string& compiler, const std::filesystem::path& source, const std::vector<std::string>& defines,
+	const std::filesystem::path& output)
+{
+	std::error_code error;
+	std::filesystem::create_directories(output.parent_path(), error);
+
+	std::string command = "\"" + compiler + "\"";
+	for (const auto& define : defines)
+	{
+		command += " \"-D" + define + "\"";
+	}
+	command += " \"" + source.string() + "\" -o \"" + output.string() + "\"";
+
+	if (std::system(command.c_str()) != 0)
+	{
+		std::cerr << "Failed to compile: " << source;
+		for (const auto& define : defines)
+		{
+			std::cerr << " -D" << define;
+		}
+		std::cerr << std::endl;
+		return false;
+	}
+
+	return true;
+}